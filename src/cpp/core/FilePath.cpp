@@ -1169,6 +1169,63 @@ Error FilePath::open_w(boost::shared_ptr<std::ostream>* pStream, bool truncate)
    return Success();
 }
 
+Error FilePath::open_rw(boost::shared_ptr<std::iostream>* pStream) const
+{
+   try
+   {
+      std::iostream* pResult = NULL;
+   #ifdef _WIN32
+      using namespace boost::iostreams;
+      HANDLE hFile = ::CreateFileW(pImpl_->path.wstring().c_str(),
+                                   GENERIC_READ | GENERIC_WRITE,
+                                   0, // exclusive access
+                                   NULL,
+                                   OPEN_ALWAYS,
+                                   0,
+                                   NULL);
+      if (hFile == INVALID_HANDLE_VALUE)
+      {
+         Error error = systemError(::GetLastError(), ERROR_LOCATION);
+         error.addProperty("path", absolutePath());
+         return error;
+      }
+      file_descriptor fd;
+      fd.open(hFile, close_handle);
+      pResult = new boost::iostreams::stream<file_descriptor>(fd);
+   #else
+      using std::ios_base;
+
+      // an fstream opened for input won't create the file
+      if (!exists())
+         std::ofstream(absolutePath().c_str(), ios_base::out | ios_base::binary);
+
+      pResult = new std::fstream(absolutePath().c_str(),
+                                 ios_base::in | ios_base::out | ios_base::binary);
+   #endif
+
+      if (!(*pResult))
+      {
+         delete pResult;
+
+         Error error = systemError(boost::system::errc::no_such_file_or_directory, ERROR_LOCATION);
+         error.addProperty("path", absolutePath());
+         return error;
+      }
+
+      pStream->reset(pResult);
+   }
+   catch(const std::exception& e)
+   {
+      Error error = systemError(boost::system::errc::io_error,
+                                ERROR_LOCATION);
+      error.addProperty("what", e.what());
+      error.addProperty("path", absolutePath());
+      return error;
+   }
+
+   return Success();
+}
+
 // check for equivalence (point to the same file-system entity)
 bool FilePath::isEquivalentTo(const FilePath& filePath) const
 {
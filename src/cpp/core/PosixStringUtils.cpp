@@ -38,6 +38,74 @@ namespace rstudio {
 namespace core {
 namespace string_utils {
 
+namespace {
+
+// decode well-formed UTF-8 (which is nearly all we see) directly, returning
+// false for anything else (overlong forms, surrogates, truncated sequences)
+// so that it gets the full conversion below
+bool decodeUtf8(const std::string& value, std::wstring* pWide)
+{
+   const unsigned char* pos =
+         reinterpret_cast<const unsigned char*>(value.data());
+   const unsigned char* end = pos + value.size();
+
+   pWide->resize(value.size());
+   wchar_t* out = &(*pWide)[0];
+   while (pos < end)
+   {
+      unsigned int ch = *pos++;
+      if (ch < 0x80)
+      {
+         *out++ = static_cast<wchar_t>(ch);
+         continue;
+      }
+
+      int count;
+      unsigned int min;
+      if ((ch & 0xE0) == 0xC0)
+      {
+         count = 1;
+         min = 0x80;
+         ch &= 0x1F;
+      }
+      else if ((ch & 0xF0) == 0xE0)
+      {
+         count = 2;
+         min = 0x800;
+         ch &= 0x0F;
+      }
+      else if ((ch & 0xF8) == 0xF0)
+      {
+         count = 3;
+         min = 0x10000;
+         ch &= 0x07;
+      }
+      else
+      {
+         return false;
+      }
+
+      if (end - pos < count)
+         return false;
+      for (int i = 0; i < count; i++)
+      {
+         unsigned int next = *pos++;
+         if ((next & 0xC0) != 0x80)
+            return false;
+         ch = (ch << 6) | (next & 0x3F);
+      }
+
+      if (ch < min || ch > 0x10FFFF || (ch >= 0xD800 && ch <= 0xDFFF))
+         return false;
+      *out++ = static_cast<wchar_t>(ch);
+   }
+
+   pWide->resize(out - &(*pWide)[0]);
+   return true;
+}
+
+} // anonymous namespace
+
 std::string wideToUtf8(const std::wstring& value)
 {
    try
@@ -55,6 +123,10 @@ std::string wideToUtf8(const std::wstring& value)
 
 std::wstring utf8ToWide(const std::string& value, const std::string& context)
 {
+   std::wstring wide;
+   if (value.empty() || decodeUtf8(value, &wide))
+      return wide;
+
    try
    {
       boost::program_options::detail::utf8_codecvt_facet utf8_facet;
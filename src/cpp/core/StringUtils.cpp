@@ -492,9 +492,7 @@ bool isalpha(wchar_t c)
 
 bool isalnum(wchar_t c)
 {
-   static std::vector<bool> lookup;
-   if (lookup.empty())
-      lookup = initAlnumLookupTable();
+   static std::vector<bool> lookup = initAlnumLookupTable();
 
    if (c >= 0xFFFF)
       return false; // This function only supports BMP
@@ -55,6 +55,17 @@ context("isSubsequence")
       expect_true(trimWhitespace("abc") == "abc");
       expect_true(trimWhitespace("") == "");
    }
+
+   test_that("utf8ToWide decodes UTF-8")
+   {
+      expect_true(utf8ToWide("") == L"");
+      expect_true(utf8ToWide("abc") == L"abc");
+      expect_true(utf8ToWide("a\xC3\xA9z") == L"a\x00E9z");
+      expect_true(utf8ToWide("\xE2\x82\xAC") == L"\x20AC");
+      expect_true(utf8ToWide("\xF0\x9F\x98\x80!") == L"\x1F600!");
+      expect_true(wideToUtf8(utf8ToWide("x \xE2\x86\x90 1")) ==
+                  "x \xE2\x86\x90 1");
+   }
 }
 
 } // end namespace string_utils
@@ -24,6 +24,7 @@
 #include <core/system/System.hpp>
 #include <core/http/Request.hpp>
 #include <core/http/Response.hpp>
+#include <core/http/StaticFileCache.hpp>
 
 
 namespace rstudio {
@@ -32,6 +33,13 @@ namespace gwt {
    
 namespace {
    
+// the client's compiled assets don't change while we run (other than during
+// development) so we hash and compress each of them just once
+http::StaticFileCache& staticFileCache()
+{
+   static http::StaticFileCache instance;
+   return instance;
+}
 
 void handleFileRequest(const std::string& wwwLocalPath,
                        const std::string& baseUri,
@@ -98,14 +106,14 @@ void handleFileRequest(const std::string& wwwLocalPath,
    if (regex_utils::match(uri, boost::regex(".*\\.cache\\..*")))
    {
       pResponse->setCacheForeverHeaders();
-      pResponse->setFile(filePath, request);
+      staticFileCache().setFile(filePath, request, pResponse);
    }
    
    // case: files designated to never be cached 
    else if (regex_utils::match(uri, boost::regex(".*\\.nocache\\..*")))
    {
       pResponse->setNoCacheHeaders();
-      pResponse->setFile(filePath, request);
+      staticFileCache().setFile(filePath, request, pResponse);
    }
    // case: main page -- don't cache and dynamically set compiler stack mode
    else if (uri == mainPage)
@@ -139,7 +147,7 @@ void handleFileRequest(const std::string& wwwLocalPath,
    {
       // since these are application components we force revalidation
       pResponse->setCacheWithRevalidationHeaders();
-      pResponse->setCacheableFile(filePath, request);
+      staticFileCache().setFile(filePath, request, pResponse);
    }
   
 }
@@ -0,0 +1,198 @@
+/*
+ * FileStreamer.cpp
+ *
+ * Copyright (C) 2009-17 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <core/http/FileStreamer.hpp>
+
+#include <algorithm>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+namespace rstudio {
+namespace core {
+namespace http {
+
+namespace {
+
+// size of the chunks in which files are read when they can't be sent
+// directly
+const boost::uint64_t kReadChunkSize = 64 * 1024;
+
+#ifdef __linux__
+// the most sendfile will transfer in one call
+const boost::uint64_t kMaxSendSize = 0x7ffff000;
+#endif
+
+Error unexpectedEndOfFileError(const FilePath& filePath,
+                               const ErrorLocation& location)
+{
+   // the file was truncated after we sent its length
+   Error error = systemError(boost::system::errc::io_error, location);
+   error.addProperty("path", filePath.absolutePath());
+   return error;
+}
+
+} // anonymous namespace
+
+FileStreamer::FileStreamer(const StreamedFile& file)
+   : file_(file),
+     offset_(file.offset),
+     remaining_(file.length)
+#ifndef _WIN32
+     , fd_(-1)
+#endif
+{
+}
+
+FileStreamer::~FileStreamer()
+{
+#ifndef _WIN32
+   if (fd_ != -1)
+      ::close(fd_);
+#endif
+}
+
+Error FileStreamer::open()
+{
+#ifndef _WIN32
+   fd_ = ::open(file_.path.absolutePath().c_str(), O_RDONLY);
+   if (fd_ == -1)
+   {
+      Error error = systemError(errno, ERROR_LOCATION);
+      error.addProperty("path", file_.path.absolutePath());
+      return error;
+   }
+#else
+   Error error = file_.path.open_r(&pIfs_);
+   if (error)
+      return error;
+
+   try
+   {
+      pIfs_->exceptions(std::istream::failbit | std::istream::badbit);
+      pIfs_->seekg(offset_);
+   }
+   catch(const std::exception& e)
+   {
+      Error error = systemError(boost::system::errc::io_error,
+                                ERROR_LOCATION);
+      error.addProperty("what", e.what());
+      error.addProperty("path", file_.path.absolutePath());
+      return error;
+   }
+#endif
+
+   return Success();
+}
+
+#ifndef _WIN32
+Error FileStreamer::send(int socket, bool* pWouldBlock, bool* pUnsupported)
+{
+   *pWouldBlock = false;
+   *pUnsupported = false;
+
+#ifdef __linux__
+   while (remaining_ > 0)
+   {
+      off_t offset = static_cast<off_t>(offset_);
+      std::size_t count = static_cast<std::size_t>(
+                                 std::min(remaining_, kMaxSendSize));
+      ssize_t sent = ::sendfile(socket, fd_, &offset, count);
+      if (sent > 0)
+      {
+         offset_ += sent;
+         remaining_ -= sent;
+      }
+      else if (sent == 0)
+      {
+         return unexpectedEndOfFileError(file_.path, ERROR_LOCATION);
+      }
+      else if (errno == EINTR)
+      {
+         continue;
+      }
+      else if (errno == EAGAIN || errno == EWOULDBLOCK)
+      {
+         *pWouldBlock = true;
+         return Success();
+      }
+      else if (errno == EINVAL || errno == ENOSYS)
+      {
+         // e.g. a file system which doesn't support it
+         *pUnsupported = true;
+         return Success();
+      }
+      else
+      {
+         return systemError(errno, ERROR_LOCATION);
+      }
+   }
+#else
+   *pUnsupported = true;
+#endif
+
+   return Success();
+}
+#endif
+
+Error FileStreamer::read(std::vector<char>* pBuffer)
+{
+   std::size_t count = static_cast<std::size_t>(
+                              std::min(remaining_, kReadChunkSize));
+   pBuffer->resize(count);
+   if (count == 0)
+      return Success();
+
+#ifndef _WIN32
+   std::size_t total = 0;
+   while (total < count)
+   {
+      ssize_t bytes = ::pread(fd_,
+                              &(*pBuffer)[total],
+                              count - total,
+                              static_cast<off_t>(offset_ + total));
+      if (bytes > 0)
+         total += bytes;
+      else if (bytes == 0)
+         return unexpectedEndOfFileError(file_.path, ERROR_LOCATION);
+      else if (errno != EINTR)
+         return systemError(errno, ERROR_LOCATION);
+   }
+#else
+   try
+   {
+      pIfs_->read(&(*pBuffer)[0], count);
+   }
+   catch(const std::exception&)
+   {
+      return unexpectedEndOfFileError(file_.path, ERROR_LOCATION);
+   }
+#endif
+
+   offset_ += count;
+   remaining_ -= count;
+   return Success();
+}
+
+} // namespace http
+} // namespace core
+} // namespace rstudio
@@ -0,0 +1,130 @@
+/*
+ * FileStreamerTests.cpp
+ *
+ * Copyright (C) 2009-17 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef _WIN32
+
+#include <core/http/FileStreamer.hpp>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+#include <boost/asio/local/connect_pair.hpp>
+
+#include <core/FileSerializer.hpp>
+
+#define RSTUDIO_NO_TESTTHAT_ALIASES
+#include <tests/TestThat.hpp>
+
+namespace rstudio {
+namespace core {
+namespace tests {
+
+namespace {
+
+typedef boost::asio::local::stream_protocol::socket LocalSocket;
+
+// reads from the socket until the other end closes it
+void readAll(LocalSocket* pSocket, std::string* pContents)
+{
+   char buffer[4096];
+   boost::system::error_code ec;
+   while (!ec)
+   {
+      std::size_t bytes = pSocket->read_some(boost::asio::buffer(buffer), ec);
+      pContents->append(buffer, bytes);
+   }
+}
+
+void onStreamed(const boost::system::error_code& ec,
+                LocalSocket* pSocket,
+                boost::system::error_code* pResult)
+{
+   *pResult = ec;
+   pSocket->close();
+}
+
+// large enough that the socket will fill up while it is being written
+http::StreamedFile createFile(std::string* pContents)
+{
+   for (int i = 0; i < 1024 * 1024; i++)
+      pContents->push_back(static_cast<char>((i * 7) % 251));
+
+   http::StreamedFile file;
+   FilePath::tempFilePath(&file.path);
+   writeStringToFile(file.path, *pContents);
+   file.offset = 1000;
+   file.length = pContents->size() - 2000;
+   return file;
+}
+
+} // anonymous namespace
+
+TEST_CASE("File Streaming")
+{
+   std::string contents;
+   http::StreamedFile file = createFile(&contents);
+   std::string expected = contents.substr(1000, contents.size() - 2000);
+
+   boost::asio::io_service ioService;
+   LocalSocket writer(ioService), reader(ioService);
+   boost::asio::local::connect_pair(writer, reader);
+
+   std::string received;
+   boost::thread readThread(boost::bind(readAll, &reader, &received));
+
+   SECTION("Blocking writes send the file range")
+   {
+      Error error = http::writeStreamedFile(writer, file);
+      writer.close();
+      readThread.join();
+
+      CHECK(!error);
+      CHECK(received == expected);
+   }
+
+   SECTION("Asynchronous writes send the file range")
+   {
+      boost::system::error_code result =
+            boost::asio::error::make_error_code(boost::asio::error::timed_out);
+      http::AsyncFileStreamer<LocalSocket>::write(
+               writer, file, boost::bind(onStreamed, _1, &writer, &result));
+      ioService.run();
+      readThread.join();
+
+      CHECK(!result);
+      CHECK(received == expected);
+   }
+
+   SECTION("Missing files fail to open")
+   {
+      http::StreamedFile missing = file;
+      missing.path = file.path.parent().childPath("no-such-file");
+      Error error = http::writeStreamedFile(writer, missing);
+      writer.close();
+      readThread.join();
+
+      CHECK(error);
+      CHECK(received.empty());
+   }
+
+   file.path.removeIfExists();
+}
+
+} // namespace tests
+} // namespace core
+} // namespace rstudio
+
+#endif // _WIN32
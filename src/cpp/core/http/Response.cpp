@@ -19,10 +19,12 @@
 
 #include <boost/regex.hpp>
 #include <boost/format.hpp>
+#include <boost/foreach.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/algorithm/string.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/asio/buffer.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
 
 #include <core/http/URL.hpp>
 #include <core/http/Util.hpp>
@@ -155,6 +157,89 @@ Error Response::setBody(const std::string& content)
    return setBody(is);
 }
 
+Error Response::setBodyFromBuffer(std::string* pContent)
+{
+   if (contentEncoding() == kGzipEncoding)
+   {
+#ifdef _WIN32
+      // never gzip on win32
+      removeHeader("Content-Encoding");
+#else
+      try
+      {
+         body_.clear();
+         boost::iostreams::filtering_ostream filteringStream;
+         filteringStream.push(boost::iostreams::gzip_compressor());
+         filteringStream.push(boost::iostreams::back_inserter(body_));
+         filteringStream.write(pContent->data(), pContent->size());
+         filteringStream.reset();
+      }
+      catch(const std::exception& e)
+      {
+         pContent->clear();
+         Error error = systemError(boost::system::errc::io_error,
+                                   ERROR_LOCATION);
+         error.addProperty("what", e.what());
+         return error;
+      }
+
+      pContent->clear();
+      streamedFile_ = StreamedFile();
+      setContentLength(body_.length());
+      return Success();
+#endif
+   }
+
+   body_.clear();
+   body_.swap(*pContent);
+   streamedFile_ = StreamedFile();
+   setContentLength(body_.length());
+   return Success();
+}
+
+Error Response::setStreamedFile(const FilePath& filePath)
+{
+   return setStreamedFile(filePath, 0, filePath.size());
+}
+
+Error Response::setStreamedFile(const FilePath& filePath,
+                                boost::uint64_t offset,
+                                boost::uint64_t length)
+{
+   // make sure we'll be able to read the file when it comes time to send it
+   // (errors after the headers are sent can only close the connection)
+   if (filePath.isDirectory())
+   {
+      Error error = systemError(boost::system::errc::is_a_directory,
+                                ERROR_LOCATION);
+      error.addProperty("path", filePath.absolutePath());
+      return error;
+   }
+   boost::shared_ptr<std::istream> pIfs;
+   Error error = filePath.open_r(&pIfs);
+   if (error)
+      return error;
+
+   body_.clear();
+   streamedFile_.path = filePath;
+   streamedFile_.offset = offset;
+   streamedFile_.length = length;
+
+   // (setContentLength takes an int)
+   setHeader("Content-Length", safe_convert::numberToString(length));
+   return Success();
+}
+
+bool isEncodableFile(const FilePath& filePath)
+{
+   std::string mimeType = filePath.mimeContentType();
+   bool compressible = filePath.hasTextMimeType() ||
+                       boost::algorithm::ends_with(mimeType, "/json") ||
+                       boost::algorithm::ends_with(mimeType, "/javascript");
+
+   return compressible && filePath.size() <= kMaxEncodedFileSize;
+}
+
 Error Response::setCacheableBody(const FilePath& filePath,
                                  const Request& request)
 {
@@ -181,75 +266,302 @@ void Response::setDynamicHtml(const std::string& html,
    setBody(html);
 }
 
-void Response::setRangeableFile(const FilePath& filePath,
-                                const Request& request)
+namespace {
+
+// an inclusive range of bytes within some content
+struct ByteRange
 {
-   // read the file in from disk
-   std::string contents;
-   Error error = core::readStringFromFile(filePath, &contents);
-   if (error)
+   ByteRange(boost::uint64_t begin, boost::uint64_t end)
+      : begin(begin), end(end)
    {
-      setError(error);
-      return;
    }
 
-   setRangeableFile(contents, filePath.mimeContentType(), request);
+   boost::uint64_t length() const { return end - begin + 1; }
+
+   bool operator<(const ByteRange& other) const
+   {
+      return begin < other.begin;
+   }
+
+   boost::uint64_t begin;
+   boost::uint64_t end;
+};
+
+enum RangeRequest
+{
+   RangeRequestNone,           // no (usable) Range header, send everything
+   RangeRequestSatisfiable,
+   RangeRequestUnsatisfiable
+};
+
+// multiple ranges are assembled in memory, so requests for more than this are
+// answered with the whole content instead (which RFC 7233 permits)
+const boost::uint64_t kMaxMultipleRangesSize = kMaxEncodedFileSize;
+
+bool isDigits(const std::string& value)
+{
+   return std::find_if(value.begin(),
+                       value.end(),
+                       !boost::algorithm::is_digit()) == value.end();
 }
 
-void Response::setRangeableFile(const std::string& contents,
-                                const std::string& mimeType,
-                                const Request& request)
+// parse a Range header (e.g. "bytes=0-499, 1000-, -500") against content of
+// the given size. overlapping and adjacent ranges are coalesced.
+RangeRequest parseRanges(const std::string& header,
+                         boost::uint64_t total,
+                         std::vector<ByteRange>* pRanges)
 {
-   // set content type
-   setContentType(mimeType);
+   const std::string kPrefix("bytes=");
+   if (!boost::algorithm::starts_with(header, kPrefix))
+      return RangeRequestNone;
+
+   const boost::uint64_t kNone = -1;
+   std::vector<std::string> specs;
+   std::string specList = header.substr(kPrefix.length());
+   boost::algorithm::split(specs, specList, boost::algorithm::is_any_of(","));
 
-   // parse the range field
-   std::string range = request.headerValue("Range");
-   boost::regex re("bytes=(\\d*)\\-(\\d*)");
-   boost::smatch match;
-   if (regex_utils::match(range, match, re))
+   std::vector<ByteRange> ranges;
+   BOOST_FOREACH(std::string spec, specs)
    {
-      // specify partial content
-      setStatusCode(http::status::PartialContent);
+      boost::algorithm::trim(spec);
+      std::size_t pos = spec.find('-');
+      if (pos == std::string::npos)
+         return RangeRequestNone;
+
+      std::string first = spec.substr(0, pos);
+      std::string last = spec.substr(pos + 1);
+      if (!isDigits(first) || !isDigits(last) || (first.empty() && last.empty()))
+         return RangeRequestNone;
+
+      if (first.empty())
+      {
+         // suffix range (the last n bytes)
+         boost::uint64_t n = safe_convert::stringTo<boost::uint64_t>(last, kNone);
+         if (n > 0 && total > 0)
+            ranges.push_back(ByteRange(total - std::min(n, total), total - 1));
+      }
+      else
+      {
+         boost::uint64_t begin = safe_convert::stringTo<boost::uint64_t>(first,
+                                                                        kNone);
+         boost::uint64_t end = last.empty() ?
+                  kNone : safe_convert::stringTo<boost::uint64_t>(last, kNone);
+         if (end < begin)
+            return RangeRequestNone;
+
+         // ranges starting past the end can't be satisfied
+         if (begin < total)
+            ranges.push_back(ByteRange(begin, std::min(end, total - 1)));
+      }
+   }
+
+   if (ranges.empty())
+      return RangeRequestUnsatisfiable;
+
+   std::sort(ranges.begin(), ranges.end());
+   pRanges->push_back(ranges.front());
+   for (std::size_t i = 1; i < ranges.size(); i++)
+   {
+      ByteRange& previous = pRanges->back();
+      if (ranges[i].begin <= previous.end + 1)
+         previous.end = std::max(previous.end, ranges[i].end);
+      else
+         pRanges->push_back(ranges[i]);
+   }
+
+   return RangeRequestSatisfiable;
+}
+
+boost::uint64_t totalLength(const std::vector<ByteRange>& ranges)
+{
+   boost::uint64_t length = 0;
+   BOOST_FOREACH(const ByteRange& range, ranges)
+   {
+      length += range.length();
+   }
+   return length;
+}
 
-      // determine the byte range
-      const size_t kNone = -1;
-      size_t begin = safe_convert::stringTo<size_t>(match[1], kNone);
-      size_t end = safe_convert::stringTo<size_t>(match[2], kNone);
-      size_t total = contents.length();
+std::string contentRange(const ByteRange& range, boost::uint64_t total)
+{
+   boost::format fmt("bytes %1%-%2%/%3%");
+   return boost::str(fmt % range.begin % range.end % total);
+}
 
-      if (end == kNone)
+Error readRanges(const FilePath& filePath,
+                 const std::vector<ByteRange>& ranges,
+                 std::vector<std::string>* pParts)
+{
+   boost::shared_ptr<std::istream> pIfs;
+   Error error = filePath.open_r(&pIfs);
+   if (error)
+      return error;
+
+   try
+   {
+      pIfs->exceptions(std::istream::failbit | std::istream::badbit);
+      BOOST_FOREACH(const ByteRange& range, ranges)
       {
-         end = total-1;
+         std::string part(static_cast<std::size_t>(range.length()), '\0');
+         pIfs->seekg(static_cast<std::streamoff>(range.begin));
+         pIfs->read(&part[0], part.size());
+         pParts->push_back(part);
       }
-      if (begin == kNone)
+   }
+   catch(const std::exception& e)
+   {
+      Error error = systemError(boost::system::errc::io_error,
+                                ERROR_LOCATION);
+      error.addProperty("what", e.what());
+      error.addProperty("path", filePath.absolutePath());
+      return error;
+   }
+
+   return Success();
+}
+
+void setRangeNotSatisfiable(boost::uint64_t total, Response* pResponse)
+{
+   pResponse->setStatusCode(http::status::RangeNotSatisfiable);
+   boost::format fmt("bytes */%1%");
+   pResponse->setHeader("Content-Range", boost::str(fmt % total));
+   pResponse->setBodyUnencoded(std::string());
+}
+
+void setMultipleRanges(const std::vector<ByteRange>& ranges,
+                       const std::vector<std::string>& parts,
+                       const std::string& mimeType,
+                       boost::uint64_t total,
+                       Response* pResponse)
+{
+   // choose a boundary which doesn't occur within any of the parts
+   std::string boundary;
+   for (int i = 0; boundary.empty(); i++)
+   {
+      boundary = "BYTE_RANGE_BOUNDARY_" + safe_convert::numberToString(i);
+      BOOST_FOREACH(const std::string& part, parts)
       {
-         begin = total - end;
-         end = total-1;
+         if (part.find(boundary) != std::string::npos)
+         {
+            boundary.clear();
+            break;
+         }
       }
+   }
+
+   std::string body;
+   for (std::size_t i = 0; i < ranges.size(); i++)
+   {
+      body.append("\r\n--" + boundary + "\r\n");
+      body.append("Content-Type: " + mimeType + "\r\n");
+      body.append("Content-Range: " + contentRange(ranges[i], total) + "\r\n");
+      body.append("\r\n");
+      body.append(parts[i]);
+   }
+   body.append("\r\n--" + boundary + "--\r\n");
+
+   pResponse->setStatusCode(http::status::PartialContent);
+   pResponse->setContentType("multipart/byteranges; boundary=" + boundary);
+   pResponse->setBodyUnencoded(body);
+}
+
+} // anonymous namespace
+
+void Response::setRangeableFile(const FilePath& filePath,
+                                const Request& request)
+{
+   // ensure that the file exists
+   if (!filePath.exists() || filePath.isDirectory())
+   {
+      setNotFoundError(request.uri());
+      return;
+   }
 
-      // set the byte range
-      addHeader("Accept-Ranges", "bytes");
-      boost::format fmt("bytes %1%-%2%/%3%");
-      std::string range = boost::str(fmt % begin % end % contents.length());
-      addHeader("Content-Range", range);
+   // only the requested bytes are read from disk (ranges aren't gzipped as
+   // Content-Range would then refer to the encoded content)
+   std::string mimeType = filePath.mimeContentType();
+   boost::uint64_t total = filePath.size();
+   std::vector<ByteRange> ranges;
+   RangeRequest rangeRequest = parseRanges(request.headerValue("Range"),
+                                           total,
+                                           &ranges);
+   setHeader("Accept-Ranges", "bytes");
+   removeHeader("Content-Encoding");
+
+   Error error;
+   if (rangeRequest == RangeRequestUnsatisfiable)
+   {
+      setRangeNotSatisfiable(total, this);
+   }
+   else if (rangeRequest == RangeRequestNone ||
+            (ranges.size() > 1 && totalLength(ranges) > kMaxMultipleRangesSize))
+   {
+      setContentType(mimeType);
+      error = setStreamedFile(filePath);
+   }
+   else if (ranges.size() == 1)
+   {
+      setStatusCode(http::status::PartialContent);
+      setContentType(mimeType);
+      setHeader("Content-Range", contentRange(ranges.front(), total));
+      error = setStreamedFile(filePath,
+                              ranges.front().begin,
+                              ranges.front().length());
+   }
+   else
+   {
+      std::vector<std::string> parts;
+      error = readRanges(filePath, ranges, &parts);
+      if (!error)
+         setMultipleRanges(ranges, parts, mimeType, total, this);
+   }
 
-      // always attempt gzip
+   if (error)
+      setError(error);
+}
+
+void Response::setRangeableFile(const std::string& contents,
+                                const std::string& mimeType,
+                                const Request& request)
+{
+   boost::uint64_t total = contents.length();
+   std::vector<ByteRange> ranges;
+   RangeRequest rangeRequest = parseRanges(request.headerValue("Range"),
+                                           total,
+                                           &ranges);
+   setHeader("Accept-Ranges", "bytes");
+
+   if (rangeRequest == RangeRequestUnsatisfiable)
+   {
+      setRangeNotSatisfiable(total, this);
+   }
+   else if (rangeRequest == RangeRequestNone)
+   {
+      // gzip if possible
+      setContentType(mimeType);
       if (request.acceptsEncoding(http::kGzipEncoding))
          setContentEncoding(http::kGzipEncoding);
-
-      // set body
-      if (begin == 0 && end == (contents.length()-1))
-         setBody(contents);
-      else
-         setBody(contents.substr(begin, end-begin+1));
+      setBody(contents);
+   }
+   else if (ranges.size() == 1)
+   {
+      setStatusCode(http::status::PartialContent);
+      setContentType(mimeType);
+      setHeader("Content-Range", contentRange(ranges.front(), total));
+      setBodyUnencoded(contents.substr(
+                          static_cast<std::size_t>(ranges.front().begin),
+                          static_cast<std::size_t>(ranges.front().length())));
    }
    else
    {
-      setStatusCode(http::status::RangeNotSatisfiable);
-      boost::format fmt("bytes */%1%");
-      std::string range = boost::str(fmt % contents.length());
-      addHeader("Content-Range", range);
+      std::vector<std::string> parts;
+      BOOST_FOREACH(const ByteRange& range, ranges)
+      {
+         parts.push_back(contents.substr(
+                            static_cast<std::size_t>(range.begin),
+                            static_cast<std::size_t>(range.length())));
+      }
+      setMultipleRanges(ranges, parts, mimeType, total, this);
    }
 }
    
@@ -257,6 +569,16 @@ void Response::setBodyUnencoded(const std::string& body)
 {
    removeHeader("Content-Encoding");
    body_ = body;
+   streamedFile_ = StreamedFile();
+   setContentLength(body_.length());
+}
+
+void Response::setEncodedBody(const std::string& body,
+                              const std::string& encoding)
+{
+   setContentEncoding(encoding);
+   body_ = body;
+   streamedFile_ = StreamedFile();
    setContentLength(body_.length());
 }
    
@@ -317,6 +639,7 @@ void Response::resetMembers()
 	statusCode_ = status::Ok ;
 	statusCodeStr_.clear() ;
 	statusMessage_.clear() ;
+	streamedFile_ = StreamedFile();
 }
    
 void Response::removeCachingHeaders()
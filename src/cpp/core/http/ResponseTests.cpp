@@ -0,0 +1,123 @@
+/*
+ * ResponseTests.cpp
+ *
+ * Copyright (C) 2009-17 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <core/http/Response.hpp>
+
+#include <core/FilePath.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/http/Request.hpp>
+
+#define RSTUDIO_NO_TESTTHAT_ALIASES
+#include <tests/TestThat.hpp>
+
+namespace rstudio {
+namespace core {
+namespace tests {
+
+TEST_CASE("Byte Range Responses")
+{
+   std::string contents;
+   for (int i = 0; i < 10000; i++)
+      contents.push_back(static_cast<char>('a' + (i % 26)));
+
+   FilePath file;
+   FilePath::tempFilePath(&file);
+   file = file.parent().childPath(file.filename() + ".bin");
+   REQUIRE(!writeStringToFile(file, contents));
+
+   http::Request request;
+   request.setMethod("GET");
+   request.setUri("/file.bin");
+   http::Response response;
+
+   SECTION("Single ranges are streamed from the file")
+   {
+      request.setHeader("Range", "bytes=100-199");
+      response.setRangeableFile(file, request);
+
+      CHECK(response.statusCode() == http::status::PartialContent);
+      CHECK(response.headerValue("Content-Range") == "bytes 100-199/10000");
+      CHECK(response.headerValue("Content-Length") == "100");
+      CHECK(response.streamedFile().path == file);
+      CHECK(response.streamedFile().offset == 100);
+      CHECK(response.streamedFile().length == 100);
+   }
+
+   SECTION("Open and suffix ranges extend to the end")
+   {
+      request.setHeader("Range", "bytes=9000-");
+      response.setRangeableFile(file, request);
+      CHECK(response.headerValue("Content-Range") == "bytes 9000-9999/10000");
+
+      http::Response suffixResponse;
+      request.setHeader("Range", "bytes=-500");
+      suffixResponse.setRangeableFile(file, request);
+      CHECK(suffixResponse.headerValue("Content-Range") ==
+            "bytes 9500-9999/10000");
+      CHECK(suffixResponse.streamedFile().offset == 9500);
+   }
+
+   SECTION("Ranges past the end are truncated or unsatisfiable")
+   {
+      request.setHeader("Range", "bytes=9990-20000");
+      response.setRangeableFile(file, request);
+      CHECK(response.headerValue("Content-Range") == "bytes 9990-9999/10000");
+
+      http::Response unsatisfiableResponse;
+      request.setHeader("Range", "bytes=10000-");
+      unsatisfiableResponse.setRangeableFile(file, request);
+      CHECK(unsatisfiableResponse.statusCode() ==
+            http::status::RangeNotSatisfiable);
+      CHECK(unsatisfiableResponse.headerValue("Content-Range") ==
+            "bytes */10000");
+   }
+
+   SECTION("Multiple ranges are sent as multipart content")
+   {
+      request.setHeader("Range", "bytes=0-9, 20-29, 25-39");
+      response.setRangeableFile(file, request);
+
+      CHECK(response.statusCode() == http::status::PartialContent);
+      CHECK(response.contentType().find("multipart/byteranges") == 0);
+      CHECK(response.body().find("Content-Range: bytes 0-9/10000\r\n\r\n" +
+                                 contents.substr(0, 10)) != std::string::npos);
+      CHECK(response.body().find("Content-Range: bytes 20-39/10000\r\n\r\n" +
+                                 contents.substr(20, 20)) != std::string::npos);
+   }
+
+   SECTION("Malformed ranges send the whole file")
+   {
+      request.setHeader("Range", "bytes=abc");
+      response.setRangeableFile(file, request);
+
+      CHECK(response.statusCode() == http::status::Ok);
+      CHECK(response.streamedFile().length == contents.size());
+   }
+
+   SECTION("Ranges of in memory content")
+   {
+      request.setHeader("Range", "bytes=-3");
+      response.setRangeableFile(contents, "text/plain", request);
+
+      CHECK(response.statusCode() == http::status::PartialContent);
+      CHECK(response.body() == contents.substr(contents.size() - 3));
+   }
+
+   file.removeIfExists();
+}
+
+} // namespace tests
+} // namespace core
+} // namespace rstudio
@@ -0,0 +1,202 @@
+/*
+ * StaticFileCache.cpp
+ *
+ * Copyright (C) 2009-17 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <core/http/StaticFileCache.hpp>
+
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include <core/Log.hpp>
+#include <core/Hash.hpp>
+#include <core/Thread.hpp>
+#include <core/FilePath.hpp>
+#include <core/BrowserUtils.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/http/Util.hpp>
+#include <core/http/Request.hpp>
+#include <core/http/Response.hpp>
+
+namespace rstudio {
+namespace core {
+namespace http {
+
+namespace {
+
+#ifndef _WIN32
+Error gzipContents(const std::string& contents, std::string* pEncoded)
+{
+   try
+   {
+      boost::iostreams::filtering_ostream filteringStream;
+      filteringStream.push(boost::iostreams::gzip_compressor());
+      filteringStream.push(boost::iostreams::back_inserter(*pEncoded));
+      filteringStream.write(contents.data(), contents.size());
+      filteringStream.reset();
+   }
+   catch(const std::exception& e)
+   {
+      Error error = systemError(boost::system::errc::io_error,
+                                ERROR_LOCATION);
+      error.addProperty("what", e.what());
+      return error;
+   }
+
+   return Success();
+}
+#endif
+
+} // anonymous namespace
+
+StaticFileCache::StaticFileCache(std::size_t maxSize)
+   : maxSize_(maxSize), size_(0)
+{
+}
+
+void StaticFileCache::setFile(const FilePath& filePath,
+                              const Request& request,
+                              Response* pResponse)
+{
+   // ensure that the file exists
+   if (!filePath.exists())
+   {
+      pResponse->setNotFoundError(request.uri());
+      return;
+   }
+
+   // html served to Qt is padded on the way out so can't be cached as is
+   bool padding =
+       browser_utils::isQt(request.headerValue("User-Agent")) &&
+       filePath.mimeContentType() == "text/html";
+
+   boost::shared_ptr<const Entry> pEntry;
+   if (!padding)
+      pEntry = entry(filePath);
+   if (!pEntry)
+   {
+      pResponse->setCacheableFile(filePath, request);
+      return;
+   }
+
+   pResponse->setContentType(filePath.mimeContentType());
+
+   using namespace boost::posix_time;
+   ptime lastModifiedDate = from_time_t(pEntry->lastWriteTime);
+   pResponse->setHeader("Last-Modified", util::httpDate(lastModifiedDate));
+   pResponse->setHeader("ETag", pEntry->eTag);
+
+   // prefer the client's ETag, falling back on its modification time
+   std::string ifNoneMatch = request.headerValue("If-None-Match");
+   bool notModified = ifNoneMatch.empty() ?
+                         lastModifiedDate == request.ifModifiedSince() :
+                         ifNoneMatch == pEntry->eTag;
+   if (notModified)
+   {
+      pResponse->removeHeader("Content-Type");
+      pResponse->setStatusCode(status::NotModified);
+   }
+   else if (pEntry->encoded && request.acceptsEncoding(kGzipEncoding))
+   {
+      pResponse->setEncodedBody(pEntry->gzipContents, kGzipEncoding);
+   }
+   else
+   {
+      pResponse->removeHeader("Content-Encoding");
+      Error error = pResponse->setStreamedFile(filePath);
+      if (error)
+         pResponse->setError(status::InternalServerError,
+                             error.code().message());
+   }
+}
+
+boost::shared_ptr<const StaticFileCache::Entry> StaticFileCache::entry(
+                                             const FilePath& filePath)
+{
+   std::string key = filePath.absolutePath();
+   std::time_t lastWriteTime = filePath.lastWriteTime();
+   std::size_t size = static_cast<std::size_t>(filePath.size());
+
+   LOCK_MUTEX(mutex_)
+   {
+      std::map<std::string, boost::shared_ptr<const Entry> >::const_iterator it =
+            entries_.find(key);
+      if (it != entries_.end() &&
+          it->second->lastWriteTime == lastWriteTime &&
+          it->second->size == size)
+      {
+         return it->second;
+      }
+   }
+   END_LOCK_MUTEX
+
+   // large files are streamed from disk rather than held in memory
+   if (size > kMaxEncodedFileSize)
+      return boost::shared_ptr<const Entry>();
+
+   // read and encode the file outside of the lock (concurrent requests for
+   // the same file may both do this, which is harmless)
+   std::string contents;
+   Error error = readStringFromFile(filePath, &contents);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return boost::shared_ptr<const Entry>();
+   }
+
+   boost::shared_ptr<Entry> pEntry(new Entry());
+   pEntry->lastWriteTime = lastWriteTime;
+   pEntry->size = contents.size();
+   pEntry->eTag = hash::crc32Hash(contents);
+   pEntry->encoded = false;
+
+#ifndef _WIN32
+   // never gzip on win32
+   if (isEncodableFile(filePath))
+   {
+      error = gzipContents(contents, &pEntry->gzipContents);
+      if (error)
+         LOG_ERROR(error);
+      else
+         pEntry->encoded = true;
+   }
+#endif
+
+   LOCK_MUTEX(mutex_)
+   {
+      std::map<std::string, boost::shared_ptr<const Entry> >::iterator it =
+            entries_.find(key);
+      if (it != entries_.end())
+      {
+         size_ -= it->second->gzipContents.size();
+         entries_.erase(it);
+      }
+
+      // when full we just stop caching (the client's assets are a fixed set
+      // which comfortably fit, so there is no need for eviction)
+      if (size_ + pEntry->gzipContents.size() <= maxSize_)
+      {
+         entries_[key] = pEntry;
+         size_ += pEntry->gzipContents.size();
+      }
+   }
+   END_LOCK_MUTEX
+
+   return pEntry;
+}
+
+} // namespace http
+} // namespace core
+} // namespace rstudio
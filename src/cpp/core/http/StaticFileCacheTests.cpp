@@ -0,0 +1,158 @@
+/*
+ * StaticFileCacheTests.cpp
+ *
+ * Copyright (C) 2009-17 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef _WIN32
+
+#include <core/http/StaticFileCache.hpp>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/iostreams/copy.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+
+#include <core/FilePath.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/http/Request.hpp>
+#include <core/http/Response.hpp>
+
+#define RSTUDIO_NO_TESTTHAT_ALIASES
+#include <tests/TestThat.hpp>
+
+namespace rstudio {
+namespace core {
+namespace tests {
+
+namespace {
+
+std::string gunzip(const std::string& encoded)
+{
+   std::string decoded;
+   boost::iostreams::filtering_istream filteringStream;
+   filteringStream.push(boost::iostreams::gzip_decompressor());
+   filteringStream.push(boost::iostreams::array_source(encoded.data(),
+                                                       encoded.size()));
+   boost::iostreams::copy(filteringStream,
+                          boost::iostreams::back_inserter(decoded));
+   return decoded;
+}
+
+void initRequest(const std::string& acceptEncoding, http::Request* pRequest)
+{
+   pRequest->setMethod("GET");
+   pRequest->setUri("/rstudio.nocache.js");
+   if (!acceptEncoding.empty())
+      pRequest->setHeader("Accept-Encoding", acceptEncoding);
+}
+
+} // anonymous namespace
+
+TEST_CASE("Static File Cache")
+{
+   FilePath dir;
+   FilePath::tempFilePath(&dir);
+   REQUIRE(!dir.ensureDirectory());
+   FilePath file = dir.childPath("rstudio.nocache.js");
+
+   std::string contents;
+   for (int i = 0; i < 2000; i++)
+      contents += "var x" + boost::lexical_cast<std::string>(i) + " = 1;\n";
+   REQUIRE(!writeStringToFile(file, contents));
+
+   http::StaticFileCache cache;
+
+   SECTION("Encoded files are served compressed with an ETag")
+   {
+      http::Request request;
+      initRequest("gzip, deflate", &request);
+      http::Response response;
+      cache.setFile(file, request, &response);
+
+      CHECK(response.statusCode() == http::status::Ok);
+      CHECK(response.contentEncoding() == http::kGzipEncoding);
+      CHECK(!response.headerValue("ETag").empty());
+      CHECK(response.body().size() < contents.size());
+      CHECK(gunzip(response.body()) == contents);
+   }
+
+   SECTION("Clients which don't accept gzip get the file from disk")
+   {
+      http::Request request;
+      initRequest("", &request);
+      http::Response response;
+      cache.setFile(file, request, &response);
+
+      CHECK(response.statusCode() == http::status::Ok);
+      CHECK(response.contentEncoding().empty());
+      CHECK(response.streamedFile().path == file);
+      CHECK(response.streamedFile().length == contents.size());
+   }
+
+   SECTION("Matching ETags are not modified")
+   {
+      http::Request request;
+      initRequest("gzip", &request);
+      http::Response response;
+      cache.setFile(file, request, &response);
+      std::string eTag = response.headerValue("ETag");
+
+      request.setHeader("If-None-Match", eTag);
+      http::Response cachedResponse;
+      cache.setFile(file, request, &cachedResponse);
+
+      CHECK(cachedResponse.statusCode() == http::status::NotModified);
+      CHECK(cachedResponse.body().empty());
+   }
+
+   SECTION("Changed files are revalidated")
+   {
+      http::Request request;
+      initRequest("gzip", &request);
+      http::Response response;
+      cache.setFile(file, request, &response);
+      std::string eTag = response.headerValue("ETag");
+
+      std::string changed = contents + "var y = 2;\n";
+      REQUIRE(!writeStringToFile(file, changed));
+      file.setLastWriteTime(file.lastWriteTime() + 10);
+
+      request.setHeader("If-None-Match", eTag);
+      http::Response changedResponse;
+      cache.setFile(file, request, &changedResponse);
+
+      CHECK(changedResponse.statusCode() == http::status::Ok);
+      CHECK(changedResponse.headerValue("ETag") != eTag);
+      CHECK(gunzip(changedResponse.body()) == changed);
+   }
+
+   SECTION("Missing files are not found")
+   {
+      http::Request request;
+      initRequest("gzip", &request);
+      http::Response response;
+      cache.setFile(dir.childPath("missing.js"), request, &response);
+
+      CHECK(response.statusCode() == http::status::NotFound);
+   }
+
+   dir.removeIfExists();
+}
+
+} // namespace tests
+} // namespace core
+} // namespace rstudio
+
+#endif // _WIN32
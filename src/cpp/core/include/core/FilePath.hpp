@@ -199,6 +199,9 @@ public:
    Error open_r(boost::shared_ptr<std::istream>* pStream) const;
    Error open_w(boost::shared_ptr<std::ostream>* pStream, bool truncate = true) const;
 
+   // open for reading and writing at any position (creating if necessary)
+   Error open_rw(boost::shared_ptr<std::iostream>* pStream) const;
+
    // check for equivalence (point to the same file-system entity)
    bool isEquivalentTo(const FilePath& filePath) const;
 
@@ -73,7 +73,10 @@ public:
                bool logToStderr = false)
       : ioService_(ioService),
         connectionRetryContext_(ioService),
-        logToStderr_(logToStderr)
+        logToStderr_(logToStderr),
+        keepAlive_(false),
+        connectionReusable_(false),
+        reusingConnection_(false)
    {
    }
 
@@ -92,6 +95,22 @@ public:
       connectionRetryContext_.profile = connectionRetryProfile;
    }
 
+   // request a persistent connection. if the server agrees to keep the
+   // connection alive (and delimits the response with a Content-Length)
+   // then the connection is left open after the response is received and
+   // the client can be executed again (with a new request) over the same
+   // connection. must do this prior to calling execute
+   void setKeepAlive(bool keepAlive)
+   {
+      keepAlive_ = keepAlive;
+   }
+
+   // is the connection open and available for another request?
+   bool connectionReusable() const
+   {
+      return connectionReusable_;
+   }
+
    // execute the async client
    void execute(const ResponseHandler& responseHandler,
                 const ErrorHandler& errorHandler)
@@ -100,9 +119,24 @@ public:
       responseHandler_ = responseHandler;
       errorHandler_ = errorHandler;
 
-      // connect and write request (implmented in a protocol
-      // specific manner by subclassees)
-      connectAndWriteRequest();
+      // reset state from any previous execution
+      connectionRetryContext_.stopTryingTime = boost::posix_time::ptime();
+      response_.reset();
+
+      if (connectionReusable_)
+      {
+         // write the request over the existing connection
+         connectionReusable_ = false;
+         reusingConnection_ = true;
+         writeRequest();
+      }
+      else
+      {
+         // connect and write request (implmented in a protocol
+         // specific manner by subclassees)
+         reusingConnection_ = false;
+         connectAndWriteRequest();
+      }
    }
 
    // if an embedder of this class calls close() on AsyncClient in it's
@@ -138,6 +172,7 @@ public:
 
    void close()
    {
+      connectionReusable_ = false;
       Error error = closeSocket(socket().lowest_layer());
       if (error && !core::http::isConnectionTerminatedError(error))
          logError(error);
@@ -169,12 +204,15 @@ protected:
    void writeRequest()
    {
       // specify closing of the connection after the request unless this is
-      // an attempt to upgrade to websockets
+      // an attempt to upgrade to websockets or a persistent connection
       Header overrideHeader;
       if (!boost::algorithm::iequals(request_.headerValue("Connection"),
                                      "Upgrade"))
       {
-         overrideHeader = Header::connectionClose();
+         if (keepAlive_)
+            overrideHeader = Header("Connection", "keep-alive");
+         else
+            overrideHeader = Header::connectionClose();
       }
 
       // write
@@ -197,6 +235,23 @@ protected:
          errorHandler_(error);
    }
 
+   // the server may close a persistent connection while it is idle. if
+   // that means we couldn't write the request then it is re-sent over a
+   // new connection (note that requests are never re-sent once written,
+   // so clients should stop reusing idle connections well before the
+   // server would close them)
+   bool retryOverNewConnection()
+   {
+      if (!reusingConnection_)
+         return false;
+
+      reusingConnection_ = false;
+      close();
+      responseBuffer_.consume(responseBuffer_.size());
+      connectAndWriteRequest();
+      return true;
+   }
+
    void handleErrorCode(const boost::system::error_code& ec,
                         const ErrorLocation& location)
    {
@@ -325,7 +380,7 @@ private:
                           AsyncClient<SocketService>::shared_from_this(),
                           boost::asio::placeholders::error));
          }
-         else
+         else if (!retryOverNewConnection())
          {
             handleErrorCode(ec, ERROR_LOCATION);
          }
@@ -360,6 +415,8 @@ private:
          }
          else
          {
+            // never retry once the request has been written (the server
+            // may have acted on it even if we didn't get a response)
             handleErrorCode(ec, ERROR_LOCATION);
          }
       }
@@ -368,6 +425,18 @@ private:
 
    void readSomeContent()
    {
+      // a response on a persistent connection is complete once we have
+      // read Content-Length bytes (leave the connection open for reuse)
+      if (responseAllowsReuse() &&
+          response_.body().length() >= response_.contentLength())
+      {
+         connectionReusable_ =
+               response_.body().length() == response_.contentLength() &&
+               responseBuffer_.size() == 0;
+         closeAndRespond();
+         return;
+      }
+
       // provide a hook for subclasses to force termination of
       // content reads (this is needed for named pipes on windows,
       // where the client disconnecting from the server is part
@@ -400,6 +469,19 @@ private:
       return false;
    }
 
+   bool responseAllowsReuse()
+   {
+      // responses which never have a body (or which don't delimit their
+      // body) always end by closing the connection
+      int status = response_.statusCode();
+      return keepAlive_ &&
+             status != status::NoContent &&
+             status != status::NotModified &&
+             boost::algorithm::iequals(response_.headerValue("Connection"),
+                                       "keep-alive") &&
+             !response_.headerValue("Content-Length").empty();
+   }
+
    void handleReadHeaders(const boost::system::error_code& ec)
    {
       try
@@ -456,6 +538,18 @@ private:
 
    void closeAndRespond()
    {
+      if (connectionReusable_)
+      {
+         // release the handlers (which may retain e.g. the connection the
+         // request is being made on behalf of) while we are idle. note we
+         // invoke a copy since the handler may execute us again
+         ResponseHandler responseHandler = responseHandler_;
+         disableHandlers();
+         if (responseHandler)
+            responseHandler(response_);
+         return;
+      }
+
       if (!keepConnectionAlive())
          close();
 
@@ -501,6 +595,9 @@ private:
    ErrorHandler errorHandler_;
    http::Request request_;
    boost::asio::streambuf responseBuffer_;
+   bool keepAlive_;
+   bool connectionReusable_;
+   bool reusingConnection_;
 };
    
 
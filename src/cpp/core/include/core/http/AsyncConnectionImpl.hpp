@@ -30,6 +30,7 @@
 
 #include <core/http/Request.hpp>
 #include <core/http/Response.hpp>
+#include <core/http/FileStreamer.hpp>
 #include <core/http/SocketUtils.hpp>
 #include <core/http/RequestParser.hpp>
 #include <core/http/AsyncConnection.hpp>
@@ -99,12 +100,14 @@ public:
       if (responseFilter_)
          responseFilter_(originalUri_, &response_);
 
-      // write
+      // write (streamed files follow the headers)
       boost::asio::async_write(
           socket_,
           response_.toBuffers(),
           boost::bind(
-               &AsyncConnectionImpl<ProtocolType>::handleWrite,
+               response_.streamedFile().empty() ?
+                  &AsyncConnectionImpl<ProtocolType>::handleWrite :
+                  &AsyncConnectionImpl<ProtocolType>::handleHeadersWrite,
                AsyncConnectionImpl<ProtocolType>::shared_from_this(),
                boost::asio::placeholders::error,
                close)
@@ -243,6 +246,24 @@ private:
                &request_);
    }
 
+   void handleHeadersWrite(const boost::system::error_code& e, bool close)
+   {
+      if (e)
+      {
+         handleWrite(e, close);
+         return;
+      }
+
+      AsyncFileStreamer<typename ProtocolType::socket>::write(
+         socket_,
+         response_.streamedFile(),
+         boost::bind(
+               &AsyncConnectionImpl<ProtocolType>::handleWrite,
+               AsyncConnectionImpl<ProtocolType>::shared_from_this(),
+               _1,
+               close));
+   }
+
    void handleWrite(const boost::system::error_code& e, bool close)
    {
       try
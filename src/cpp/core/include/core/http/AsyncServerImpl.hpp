@@ -70,6 +70,9 @@ public:
    {
    }
 
+   // the primary io_service. in io_service per thread mode (see run) it is
+   // run by only one of the threads, so work posted to it (and its timers)
+   // shares that thread with the connections it accepts
    virtual boost::asio::io_service& ioService()
    {
       return acceptorService_.ioService();
@@ -142,14 +145,14 @@ public:
       running_ = true;
 
       // get ready for next connection
-      acceptNextConnection();
+      acceptNextConnection(&acceptorService_);
 
       // initialize scheduled command timer
       waitForScheduledCommandTimer();
 
 
       // run
-      runServiceThread();
+      runServiceThread(&acceptorService_.ioService());
 
 
       return Success();
@@ -162,8 +165,36 @@ public:
          // update state
          running_ = true;
 
+         // in io_service per thread mode each additional thread gets its
+         // own io_service and acceptor (listening on the same endpoint).
+         // connections are then handled entirely on the thread which
+         // accepted them, so threads don't contend for the acceptor or for
+         // the io_service's handler queue. if an acceptor can't be created
+         // we just use fewer of them (the remaining threads share the
+         // primary io_service). note that the scheduled command timer and
+         // anything else using ioService() stays on the primary io_service,
+         // so scheduled commands should remain short as they hold up the
+         // connections on its thread while they run
+         if (threadPoolSize > 1 && ioServicePerThread())
+         {
+            for (std::size_t i=1; i < threadPoolSize; ++i)
+            {
+               boost::shared_ptr<SocketAcceptorService<ProtocolType> >
+                     pAcceptorService(new SocketAcceptorService<ProtocolType>());
+               Error error = initAdditionalAcceptor(pAcceptorService.get());
+               if (error)
+               {
+                  LOG_ERROR(error);
+                  break;
+               }
+               additionalAcceptorServices_.push_back(pAcceptorService);
+            }
+         }
+
          // get ready for next connection
-         acceptNextConnection();
+         acceptNextConnection(&acceptorService_);
+         for (std::size_t i=0; i < additionalAcceptorServices_.size(); ++i)
+            acceptNextConnection(additionalAcceptorServices_[i].get());
 
          // initialize scheduled command timer
          waitForScheduledCommandTimer();
@@ -178,10 +209,17 @@ public:
          // create the threads
          for (std::size_t i=0; i < threadPoolSize; ++i)
          {
+            // determine the io_service (thread 0 and any threads without
+            // an acceptor of their own run the primary io_service)
+            boost::asio::io_service* pIoService = &acceptorService_.ioService();
+            if (i > 0 && i <= additionalAcceptorServices_.size())
+               pIoService = &additionalAcceptorServices_[i - 1]->ioService();
+
             // run the thread
             boost::shared_ptr<boost::thread> pThread(new boost::thread(
                               &AsyncServerImpl<ProtocolType>::runServiceThread,
-                              this));
+                              this,
+                              pIoService));
             
             // add to list of threads
             threads_.push_back(pThread);            
@@ -203,9 +241,17 @@ public:
       acceptorService_.closeAcceptor(closeEc);
       if (closeEc)
          LOG_ERROR(Error(closeEc, ERROR_LOCATION));
+      for (std::size_t i=0; i < additionalAcceptorServices_.size(); ++i)
+      {
+         additionalAcceptorServices_[i]->closeAcceptor(closeEc);
+         if (closeEc)
+            LOG_ERROR(Error(closeEc, ERROR_LOCATION));
+      }
       
       // stop the server 
       acceptorService_.ioService().stop();
+      for (std::size_t i=0; i < additionalAcceptorServices_.size(); ++i)
+         additionalAcceptorServices_[i]->ioService().stop();
 
       // update state
       running_ = false;
@@ -225,25 +271,27 @@ public:
    
 private:
 
-   void runServiceThread()
+   void runServiceThread(boost::asio::io_service* pIoService)
    {
       try
       {
          boost::system::error_code ec;
-         acceptorService_.ioService().run(ec);
+         pIoService->run(ec);
          if (ec)
             LOG_ERROR(Error(ec, ERROR_LOCATION));
       }
       CATCH_UNEXPECTED_EXCEPTION
    }
 
-   void acceptNextConnection()
+   void acceptNextConnection(
+            SocketAcceptorService<ProtocolType>* pAcceptorService)
    {
       // create a new connection 
-      ptrNextConnection_.reset(new AsyncConnectionImpl<ProtocolType>(
+      boost::shared_ptr<AsyncConnectionImpl<ProtocolType> > ptrNextConnection(
+         new AsyncConnectionImpl<ProtocolType>(
                                                                  
          // controlling io_service
-         acceptorService_.ioService(),
+         pAcceptorService->ioService(),
 
          // connection handler
          boost::bind(&AsyncServerImpl<ProtocolType>::handleConnection,
@@ -259,22 +307,27 @@ private:
       ));
       
       // wait for next connection
-      acceptorService_.asyncAccept(
-         ptrNextConnection_->socket(), 
+      pAcceptorService->asyncAccept(
+         ptrNextConnection->socket(), 
          boost::bind(&AsyncServerImpl<ProtocolType>::handleAccept,
                      this,
+                     pAcceptorService,
+                     ptrNextConnection,
                      boost::asio::placeholders::error)
       );
    }
    
-   void handleAccept(const boost::system::error_code& ec) 
+   void handleAccept(
+         SocketAcceptorService<ProtocolType>* pAcceptorService,
+         boost::shared_ptr<AsyncConnectionImpl<ProtocolType> > ptrConnection,
+         const boost::system::error_code& ec) 
    {
       try
       {
          if (!ec) 
          {
             // start connection
-            ptrNextConnection_->startReading();
+            ptrConnection->startReading();
          }
          else
          {
@@ -305,7 +358,7 @@ private:
       // ALWAYS accept next connection
       try
       {
-         acceptNextConnection() ;
+         acceptNextConnection(pAcceptorService) ;
       }
       CATCH_UNEXPECTED_EXCEPTION
    }
@@ -438,6 +491,20 @@ protected:
       return acceptorService_;
    }
    
+   // protocols which support several acceptors listening on the same
+   // endpoint can override these to enable io_service per thread mode
+   virtual bool ioServicePerThread()
+   {
+      return false;
+   }
+
+   virtual Error initAdditionalAcceptor(
+         SocketAcceptorService<ProtocolType>* pAcceptorService)
+   {
+      return systemError(boost::system::errc::operation_not_supported,
+                         ERROR_LOCATION);
+   }
+
 private:
 
    virtual void onRequest(typename ProtocolType::socket* pSocket,
@@ -488,11 +555,12 @@ private:
    bool abortOnResourceError_;
    std::string serverName_;
    std::string baseUri_;
-   boost::shared_ptr<AsyncConnectionImpl<ProtocolType> > ptrNextConnection_;
    AsyncUriHandlers uriHandlers_ ;
    AsyncUriHandlerFunction defaultHandler_;
    std::vector<boost::shared_ptr<boost::thread> > threads_;
    SocketAcceptorService<ProtocolType> acceptorService_;
+   std::vector<boost::shared_ptr<SocketAcceptorService<ProtocolType> > >
+                                                additionalAcceptorServices_;
    boost::posix_time::time_duration scheduledCommandInterval_;
    boost::asio::deadline_timer scheduledCommandTimer_;
    std::vector<boost::shared_ptr<ScheduledCommand> > scheduledCommands_;
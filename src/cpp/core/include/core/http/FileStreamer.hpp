@@ -0,0 +1,239 @@
+/*
+ * FileStreamer.hpp
+ *
+ * Copyright (C) 2009-17 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef CORE_HTTP_FILE_STREAMER_HPP
+#define CORE_HTTP_FILE_STREAMER_HPP
+
+#include <vector>
+
+#include <boost/utility.hpp>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/enable_shared_from_this.hpp>
+
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/asio/placeholders.hpp>
+
+#include <core/Error.hpp>
+#include <core/http/Response.hpp>
+
+namespace rstudio {
+namespace core {
+namespace http {
+
+// Sends the streamed file of a response (see Response::setStreamedFile). On
+// Linux the file is handed to the socket with sendfile(2), so its contents
+// never pass through user space; elsewhere (or where sendfile isn't
+// supported for the file) it is read in fixed size chunks.
+class FileStreamer : boost::noncopyable
+{
+public:
+   explicit FileStreamer(const StreamedFile& file);
+   virtual ~FileStreamer();
+
+   Error open();
+
+   bool finished() const { return remaining_ == 0; }
+
+#ifndef _WIN32
+   // send as much of the file as the socket will take. sets *pWouldBlock
+   // if the (non-blocking) socket must become writable before more can be
+   // sent, and *pUnsupported if the file can't be sent directly (the rest
+   // must then be read)
+   Error send(int socket, bool* pWouldBlock, bool* pUnsupported);
+#endif
+
+   // read the next chunk of the file
+   Error read(std::vector<char>* pBuffer);
+
+private:
+   StreamedFile file_;
+   boost::uint64_t offset_;
+   boost::uint64_t remaining_;
+#ifndef _WIN32
+   int fd_;
+#else
+   boost::shared_ptr<std::istream> pIfs_;
+#endif
+};
+
+// write the streamed file to a (blocking or non-blocking) socket
+template <typename SocketType>
+Error writeStreamedFile(SocketType& socket, const StreamedFile& file)
+{
+   FileStreamer streamer(file);
+   Error error = streamer.open();
+   if (error)
+      return error;
+
+   boost::system::error_code ec;
+
+#ifndef _WIN32
+   while (!streamer.finished())
+   {
+      bool wouldBlock, unsupported;
+      error = streamer.send(socket.native_handle(), &wouldBlock, &unsupported);
+      if (error)
+         return error;
+
+      if (unsupported)
+         break;
+
+      // wait for the socket to become writable
+      if (wouldBlock)
+      {
+         socket.write_some(boost::asio::null_buffers(), ec);
+         if (ec)
+            return Error(ec, ERROR_LOCATION);
+      }
+   }
+#endif
+
+   std::vector<char> buffer;
+   while (!streamer.finished())
+   {
+      error = streamer.read(&buffer);
+      if (error)
+         return error;
+
+      boost::asio::write(socket, boost::asio::buffer(buffer), ec);
+      if (ec)
+         return Error(ec, ERROR_LOCATION);
+   }
+
+   return Success();
+}
+
+// asynchronously write the streamed file to a socket (the socket must
+// outlive the write, typically by the handler holding its owner)
+template <typename SocketType>
+class AsyncFileStreamer :
+   public boost::enable_shared_from_this<AsyncFileStreamer<SocketType> >,
+   boost::noncopyable
+{
+public:
+   typedef boost::function<void(const boost::system::error_code&)> Handler;
+
+   static void write(SocketType& socket,
+                     const StreamedFile& file,
+                     const Handler& handler)
+   {
+      boost::shared_ptr<AsyncFileStreamer<SocketType> > pStreamer(
+               new AsyncFileStreamer<SocketType>(socket, file, handler));
+      pStreamer->start();
+   }
+
+private:
+   AsyncFileStreamer(SocketType& socket,
+                     const StreamedFile& file,
+                     const Handler& handler)
+      : socket_(socket), streamer_(file), handler_(handler), direct_(true)
+   {
+   }
+
+   void start()
+   {
+      Error error = streamer_.open();
+      if (error)
+      {
+         handler_(error.code());
+         return;
+      }
+
+#ifndef _WIN32
+      // sendfile mustn't block the thread running the io service
+      boost::system::error_code ec;
+      socket_.native_non_blocking(true, ec);
+      if (ec)
+         direct_ = false;
+#else
+      direct_ = false;
+#endif
+
+      writeSome();
+   }
+
+   void writeSome()
+   {
+#ifndef _WIN32
+      if (direct_)
+      {
+         bool wouldBlock, unsupported;
+         Error error = streamer_.send(socket_.native_handle(),
+                                      &wouldBlock,
+                                      &unsupported);
+         if (error)
+         {
+            handler_(error.code());
+            return;
+         }
+
+         if (wouldBlock)
+         {
+            socket_.async_write_some(
+               boost::asio::null_buffers(),
+               boost::bind(&AsyncFileStreamer<SocketType>::handleWrite,
+                           AsyncFileStreamer<SocketType>::shared_from_this(),
+                           boost::asio::placeholders::error));
+            return;
+         }
+
+         direct_ = !unsupported;
+      }
+#endif
+
+      if (streamer_.finished())
+      {
+         handler_(boost::system::error_code());
+         return;
+      }
+
+      Error error = streamer_.read(&buffer_);
+      if (error)
+      {
+         handler_(error.code());
+         return;
+      }
+
+      boost::asio::async_write(
+         socket_,
+         boost::asio::buffer(buffer_),
+         boost::bind(&AsyncFileStreamer<SocketType>::handleWrite,
+                     AsyncFileStreamer<SocketType>::shared_from_this(),
+                     boost::asio::placeholders::error));
+   }
+
+   void handleWrite(const boost::system::error_code& ec)
+   {
+      if (ec)
+         handler_(ec);
+      else
+         writeSome();
+   }
+
+private:
+   SocketType& socket_;
+   FileStreamer streamer_;
+   Handler handler_;
+   bool direct_;
+   std::vector<char> buffer_;
+};
+
+} // namespace http
+} // namespace core
+} // namespace rstudio
+
+#endif // CORE_HTTP_FILE_STREAMER_HPP
@@ -18,6 +18,7 @@
 
 #include <iostream>
 #include <sstream>
+#include <boost/cstdint.hpp>
 #include <boost/type_traits/is_same.hpp>
 #include <boost/iostreams/copy.hpp>
 #include <boost/iostreams/concepts.hpp>
@@ -50,6 +51,7 @@ enum Code {
    SwitchingProtocols = 101,
    Ok = 200,
    Created = 201,
+   NoContent = 204,
    PartialContent = 206,
    MovedPermanently = 301,
    MovedTemporarily = 302,
@@ -70,6 +72,27 @@ enum Code {
 };
 } 
 
+// files larger than this are streamed from disk as is rather than being
+// read into memory to be compressed
+const boost::uint64_t kMaxEncodedFileSize = 4 * 1024 * 1024;
+
+// a range of a file which is sent as the body of a response when the
+// response is written (rather than being read into memory)
+struct StreamedFile
+{
+   StreamedFile() : offset(0), length(0) {}
+
+   bool empty() const { return path.empty(); }
+
+   FilePath path;
+   boost::uint64_t offset;
+   boost::uint64_t length;
+};
+
+// whether it's worth gzip encoding a file (compressing images, archives, very
+// large files etc. gains little)
+bool isEncodableFile(const FilePath& filePath);
+
 class NullOutputFilter : public boost::iostreams::multichar_output_filter 
 {   
 public:
@@ -98,6 +121,7 @@ public:
       statusCode_ = response.statusCode_;
       statusCodeStr_ = response.statusCodeStr_;
       statusMessage_ = response.statusMessage_;
+      streamedFile_ = response.streamedFile_;
    }
 
 public:   
@@ -122,6 +146,22 @@ public:
    void addCookie(const Cookie& cookie) ;
    
    Error setBody(const std::string& content);
+
+   // set the body from a buffer the caller no longer needs. when no content
+   // encoding is required the buffer is swapped in rather than copied, and
+   // otherwise it is compressed directly into the body (*pContent is
+   // always left empty)
+   Error setBodyFromBuffer(std::string* pContent);
+
+   // stream the body from a file (or a range of one) as the response is
+   // written, so that memory use doesn't depend on the size of the file.
+   // no content encoding is applied. writers which send responses must
+   // check streamedFile() and send the file after the headers.
+   Error setStreamedFile(const FilePath& filePath);
+   Error setStreamedFile(const FilePath& filePath,
+                         boost::uint64_t offset,
+                         boost::uint64_t length);
+   const StreamedFile& streamedFile() const { return streamedFile_; }
    
    Error setCacheableBody(const std::string& content,
                           const Request& request)
@@ -205,6 +245,7 @@ public:
          
          // set body 
          body_ = bodyStream.str();
+         streamedFile_ = StreamedFile();
 
          if (padding && body_.length() < 1024)
          {
@@ -289,7 +330,18 @@ public:
           browser_utils::isQt(request.headerValue("User-Agent")) &&
           filePath.mimeContentType() == "text/html";
 
-      Error error = setBody(filePath, filter, 128, padding);
+      // send files we don't need to transform straight from disk
+      Error error;
+      if (boost::is_same<Filter, NullOutputFilter>::value && !padding &&
+          !(contentEncoding() == kGzipEncoding && isEncodableFile(filePath)))
+      {
+         removeHeader("Content-Encoding");
+         error = setStreamedFile(filePath);
+      }
+      else
+      {
+         error = setBody(filePath, filter, 128, padding);
+      }
       if (error)
          setError(status::InternalServerError, error.code().message());
    }
@@ -337,6 +389,7 @@ public:
 
    // these calls do no stream io or encoding so don't return errors
    void setBodyUnencoded(const std::string& body);
+   void setEncodedBody(const std::string& body, const std::string& encoding);
    void setError(int statusCode, const std::string& message);
    void setNotFoundError(const std::string& uri);
    void setError(const Error& error);
@@ -368,6 +421,9 @@ private:
 
    // string storage for integer members (need for toBuffers)
    mutable std::string statusCodeStr_ ;
+
+   // file to send as the body (if any)
+   StreamedFile streamedFile_;
 };
 
 std::ostream& operator << (std::ostream& stream, const Response& r) ;
@@ -0,0 +1,78 @@
+/*
+ * StaticFileCache.hpp
+ *
+ * Copyright (C) 2009-17 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef CORE_HTTP_STATIC_FILE_CACHE_HPP
+#define CORE_HTTP_STATIC_FILE_CACHE_HPP
+
+#include <ctime>
+#include <map>
+#include <string>
+
+#include <boost/utility.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace rstudio {
+namespace core {
+
+class FilePath;
+
+namespace http {
+
+class Request;
+class Response;
+
+// Cache of static files (e.g. the compiled GWT client) which serves them with
+// an ETag computed from their contents, and keeps the gzip encoding of those
+// worth compressing so that it is computed once rather than on every request.
+// Entries are keyed by path and revalidated against the file's modification
+// time and size on each request. Safe to use from multiple threads.
+class StaticFileCache : boost::noncopyable
+{
+public:
+   // maxSize is the most (compressed) content the cache will hold
+   explicit StaticFileCache(std::size_t maxSize = 64 * 1024 * 1024);
+
+   // respond with the file (gzip encoded if the client accepts that), or
+   // with Not Modified if the client's copy is current. files too large to
+   // cache are served as cacheable files (revalidated by modification time)
+   void setFile(const FilePath& filePath,
+                const Request& request,
+                Response* pResponse);
+
+private:
+   struct Entry
+   {
+      std::time_t lastWriteTime;
+      std::size_t size;
+      std::string eTag;
+      bool encoded;
+      std::string gzipContents;
+   };
+
+   boost::shared_ptr<const Entry> entry(const FilePath& filePath);
+
+private:
+   std::size_t maxSize_;
+   boost::mutex mutex_;
+   std::size_t size_;
+   std::map<std::string, boost::shared_ptr<const Entry> > entries_;
+};
+
+} // namespace http
+} // namespace core
+} // namespace rstudio
+
+#endif // CORE_HTTP_STATIC_FILE_CACHE_HPP
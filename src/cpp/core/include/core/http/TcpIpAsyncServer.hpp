@@ -30,15 +30,45 @@ class TcpIpAsyncServer : public AsyncServerImpl<boost::asio::ip::tcp>
 public:
    TcpIpAsyncServer(const std::string& serverName,
                     const std::string& baseUri = std::string())
-      : AsyncServerImpl<boost::asio::ip::tcp>(serverName, baseUri)
+      : AsyncServerImpl<boost::asio::ip::tcp>(serverName, baseUri),
+        reusePort_(false)
    {
    }
    
 public:
-   Error init(const std::string& address, const std::string& port)
+   // when reusePort is true and the server is run with a thread pool each
+   // thread gets its own io_service and listening socket (see
+   // AsyncServerImpl::run)
+   Error init(const std::string& address,
+              const std::string& port,
+              bool reusePort = false)
    {
-      return initTcpIpAcceptor(acceptorService(), address, port);
+      reusePort_ = reusePort;
+      return initTcpIpAcceptor(acceptorService(), address, port, reusePort);
    }
+
+protected:
+   virtual bool ioServicePerThread()
+   {
+      return reusePort_;
+   }
+
+   virtual Error initAdditionalAcceptor(
+         SocketAcceptorService<boost::asio::ip::tcp>* pAcceptorService)
+   {
+      // listen on exactly the endpoint the primary acceptor is bound to
+      // (which also resolves an ephemeral port to the one it was given)
+      boost::system::error_code ec;
+      boost::asio::ip::tcp::endpoint endpoint =
+                           acceptorService().acceptor().local_endpoint(ec);
+      if (ec)
+         return Error(ec, ERROR_LOCATION);
+
+      return initTcpIpAcceptor(*pAcceptorService, endpoint, true);
+   }
+
+private:
+   bool reusePort_;
 };
 
 } // namespace http
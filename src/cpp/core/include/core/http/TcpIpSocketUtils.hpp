@@ -69,23 +69,44 @@ Error connect(boost::asio::io_service& ioService,
 }
                      
 
+// check that nothing is listening on an endpoint yet, by binding to it
+// without SO_REUSEPORT (which would otherwise let us share the port with
+// another server rather than fail, e.g. if a second rserver is started)
+inline Error checkTcpIpEndpointAvailable(
+            boost::asio::io_service& ioService,
+            const boost::asio::ip::tcp::endpoint& endpoint)
+{
+   using boost::asio::ip::tcp;
+
+   tcp::acceptor acceptor(ioService);
+   boost::system::error_code ec;
+   acceptor.open(endpoint.protocol(), ec);
+   if (ec)
+      return Error(ec, ERROR_LOCATION);
+
+   acceptor.set_option(tcp::acceptor::reuse_address(true), ec);
+   if (ec)
+      return Error(ec, ERROR_LOCATION);
+
+   acceptor.bind(endpoint, ec);
+   if (ec)
+      return Error(ec, ERROR_LOCATION);
+
+   acceptor.close(ec);
+   return Success();
+}
+
+// reusePort allows several acceptors to listen on the same endpoint (the
+// kernel then distributes incoming connections between them)
 inline Error initTcpIpAcceptor(
             SocketAcceptorService<boost::asio::ip::tcp>& acceptorService,
-            const std::string& address,
-            const std::string& port)
+            const boost::asio::ip::tcp::endpoint& endpoint,
+            bool reusePort)
 {
    using boost::asio::ip::tcp;
-   
-   tcp::resolver resolver(acceptorService.ioService()) ;
-   tcp::resolver::query query(address, port) ;
-   
-   boost::system::error_code ec ;
-   tcp::resolver::iterator entries = resolver.resolve(query,ec) ;
-   if (ec)
-      return Error(ec, ERROR_LOCATION) ;
-   
+
+   boost::system::error_code ec;
    tcp::acceptor& acceptor = acceptorService.acceptor();
-   const tcp::endpoint& endpoint = *entries ;
    acceptor.open(endpoint.protocol(), ec) ;
    if (ec)
       return Error(ec, ERROR_LOCATION) ;
@@ -93,6 +114,20 @@ inline Error initTcpIpAcceptor(
    acceptor.set_option(tcp::acceptor::reuse_address(true), ec) ;
    if (ec)
       return Error(ec, ERROR_LOCATION) ;
+
+   if (reusePort)
+   {
+#ifdef SO_REUSEPORT
+      typedef boost::asio::detail::socket_option::boolean<SOL_SOCKET,
+                                                          SO_REUSEPORT>
+                                                                  reuse_port;
+      acceptor.set_option(reuse_port(true), ec) ;
+#else
+      ec = boost::asio::error::operation_not_supported;
+#endif
+      if (ec)
+         return Error(ec, ERROR_LOCATION) ;
+   }
    
    acceptor.set_option(tcp::no_delay(true), ec) ;
    if (ec)
@@ -108,6 +143,37 @@ inline Error initTcpIpAcceptor(
    
    return Success() ;
 }
+
+// when reusePort is true further acceptors can be added on the endpoint
+// the acceptor was bound to with the overload above (the endpoint is first
+// checked to be free, so the port still can't be shared with another server)
+inline Error initTcpIpAcceptor(
+            SocketAcceptorService<boost::asio::ip::tcp>& acceptorService,
+            const std::string& address,
+            const std::string& port,
+            bool reusePort = false)
+{
+   using boost::asio::ip::tcp;
+   
+   tcp::resolver resolver(acceptorService.ioService()) ;
+   tcp::resolver::query query(address, port) ;
+   
+   boost::system::error_code ec ;
+   tcp::resolver::iterator entries = resolver.resolve(query,ec) ;
+   if (ec)
+      return Error(ec, ERROR_LOCATION) ;
+   
+   const tcp::endpoint& endpoint = *entries ;
+   if (reusePort)
+   {
+      Error error = checkTcpIpEndpointAvailable(acceptorService.ioService(),
+                                                endpoint);
+      if (error)
+         return error;
+   }
+
+   return initTcpIpAcceptor(acceptorService, endpoint, reusePort);
+}
    
 } // namespace http
 } // namespace core
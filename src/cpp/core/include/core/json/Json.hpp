@@ -209,6 +209,12 @@ bool fillMap(const Object& array, std::map< std::string, std::vector<std::string
 bool parse(const std::string& input, Value* pValue);
 
 void write(const Value& value, std::ostream& os);
+
+// appends the (unformatted) json for value directly to *pOutput; this is
+// considerably faster than the stream based writers and is what should be
+// used for large payloads (e.g. rpc responses and client events)
+void write(const Value& value, std::string* pOutput);
+
 void writeFormatted(const Value& value, std::ostream& os);
 
 std::string write(const Value& value);
@@ -0,0 +1,106 @@
+/*
+ * JsonParser.hpp
+ *
+ * Copyright (C) 2009-17 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef CORE_JSON_JSON_PARSER_HPP
+#define CORE_JSON_JSON_PARSER_HPP
+
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/utility.hpp>
+
+#include <core/json/Json.hpp>
+
+namespace rstudio {
+namespace core {
+namespace json {
+
+// receives events from parseEvents as the input is scanned (SAX style).
+// returning false from any callback stops the parse (which then fails).
+// strings are passed via a scratch buffer which the handler is free to
+// swap out (e.g. to take ownership of large string values without a copy)
+class ParseHandler
+{
+public:
+   virtual ~ParseHandler() {}
+
+   virtual bool onNull() = 0;
+   virtual bool onBool(bool value) = 0;
+   virtual bool onInteger(boost::int64_t value) = 0;
+   virtual bool onUnsigned(boost::uint64_t value) = 0;
+   virtual bool onReal(double value) = 0;
+   virtual bool onString(std::string* pValue) = 0;
+
+   virtual bool onStartObject() = 0;
+   virtual bool onKey(std::string* pKey) = 0;
+   virtual bool onEndObject() = 0;
+
+   virtual bool onStartArray() = 0;
+   virtual bool onEndArray() = 0;
+};
+
+// parse handler which builds a json::Value (the DOM) from parse events.
+// can also be fed a subset of the events of a larger parse (e.g. to
+// materialize a single member of an object)
+class ValueBuilder : public ParseHandler,
+                     boost::noncopyable
+{
+public:
+   explicit ValueBuilder(Value* pValue)
+      : pValue_(pValue), complete_(false)
+   {
+   }
+
+   // true once a complete top-level value has been built
+   bool complete() const { return complete_; }
+
+   virtual bool onNull();
+   virtual bool onBool(bool value);
+   virtual bool onInteger(boost::int64_t value);
+   virtual bool onUnsigned(boost::uint64_t value);
+   virtual bool onReal(double value);
+   virtual bool onString(std::string* pValue);
+
+   virtual bool onStartObject();
+   virtual bool onKey(std::string* pKey);
+   virtual bool onEndObject();
+
+   virtual bool onStartArray();
+   virtual bool onEndArray();
+
+private:
+   Value* add(const Value& value);
+   bool endCompound();
+
+private:
+   Value* pValue_;
+   bool complete_;
+   std::vector<Value*> stack_;
+   std::string key_;
+};
+
+// parse input, delivering events to the handler. the first complete json
+// value in the input is parsed (leading whitespace is skipped and trailing
+// input is ignored, consistent with json_spirit). returns false if the
+// input is not valid json or if the handler stopped the parse
+bool parseEvents(const std::string& input, ParseHandler* pHandler);
+bool parseEvents(const char* begin, const char* end, ParseHandler* pHandler);
+
+} // namespace json
+} // namespace core
+} // namespace rstudio
+
+#endif // CORE_JSON_JSON_PARSER_HPP
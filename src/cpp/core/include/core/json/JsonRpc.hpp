@@ -1136,6 +1136,7 @@ public:
    json::Object getRawResponse();
    
    void write(std::ostream& os) const;
+   void write(std::string* pOutput) const;
    
 private:
    json::Object response_;
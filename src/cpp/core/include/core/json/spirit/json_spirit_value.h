@@ -70,6 +70,7 @@ namespace json_spirit
         boost::uint64_t    get_uint64() const;
         double             get_real()   const;
 
+        String_type& get_str();
         Object& get_obj();
         Array&  get_array();
 
@@ -420,6 +421,14 @@ namespace json_spirit
         return boost::get< double >( v_ );
     }
 
+    template< class Config >
+    typename Config::String_type& Value_impl< Config >::get_str()
+    {
+        check_type(  str_type );
+
+        return *boost::get< String_type >( &v_ );
+    }
+
     template< class Config >
     typename Value_impl< Config >::Object& Value_impl< Config >::get_obj()
     {
@@ -193,8 +193,21 @@ public:
    //   - Must be UTF-8 encoded
    //   - Must use \n only for linebreaks
    //
+   // Packages loaded by the code are recorded in the set of inferred
+   // packages shared by all indexes. Pass false for registerPackages to
+   // defer this (the shared set is not thread safe, so indexes built on a
+   // background thread should call registerInferredPackages once they are
+   // handed back to the main thread).
+   //
+   RSourceIndex(const std::string& context,
+                const std::string& code,
+                bool registerPackages = true);
+
+   // Re-create an index from previously indexed items (e.g. from a cache)
    RSourceIndex(const std::string& context,
-                const std::string& code);
+                const std::vector<RSourceItem>& items,
+                const std::vector<std::string>& inferredPkgNames,
+                bool registerPackages = true);
 
    const std::string& context() const { return context_; }
 
@@ -370,7 +383,17 @@ public:
    void addInferredPackage(const std::string& packageName)
    {
       inferredPkgNames_.push_back(packageName);
-      s_allInferredPkgNames_.insert(packageName);
+      if (registerPackages_)
+         s_allInferredPkgNames_.insert(packageName);
+   }
+
+   // add the packages inferred by this index to the shared set (note that
+   // this doesn't modify the index, so may be called for indexes which are
+   // shared with other threads)
+   void registerInferredPackages() const
+   {
+      s_allInferredPkgNames_.insert(inferredPkgNames_.begin(),
+                                    inferredPkgNames_.end());
    }
    
    static void addGloballyInferredPackage(const std::string& pkgName)
@@ -425,6 +448,7 @@ private:
    // but we share that state in a static variable (so that we can
    // cache and share across all indexes)
    std::vector<std::string> inferredPkgNames_;
+   bool registerPackages_;
    static std::set<std::string> s_importedPackages_;
    static ImportFromMap s_importFromDirectives_;
    static std::set<std::string> s_allInferredPkgNames_;
@@ -259,7 +259,7 @@ public:
       return currentToken().content();
    }
    
-   const std::string& contentAsUtf8() const
+   std::string contentAsUtf8() const
    {
       return currentToken().contentAsUtf8();
    }
@@ -27,6 +27,7 @@
 #include <core/StringUtils.hpp>
 #include <core/collection/Position.hpp>
 
+#include <boost/cstdint.hpp>
 #include <boost/utility.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/regex.hpp>
@@ -58,7 +59,9 @@ private:
 // RToken. Note that RToken instances are only valid as long as the class
 // which yielded them (RTokenizer or RTokens) is alive. This is because
 // they contain iterators into the original source data rather than their
-// own copy of their contents.
+// own copy of their contents. Tokens are kept compact (a single iterator
+// plus 32-bit length, offset and position) since whole documents' worth of
+// them are held in RTokens.
 class RToken : public virtual RToken_lock
 {
 public:
@@ -87,11 +90,11 @@ public:
 public:
    
    RToken()
-      : offset_(-1)
+      : length_(0), offset_(kNoOffset), row_(0), column_(0)
    {}
    
    explicit RToken(TokenType type)
-      : type_(type), offset_(-1)
+      : length_(0), offset_(kNoOffset), row_(0), column_(0), type_(type)
    {}
 
    RToken(TokenType type,
@@ -100,17 +103,24 @@ public:
           std::size_t offset,
           std::size_t row,
           std::size_t column)
-      : type_(type), begin_(begin), end_(end),
-        offset_(offset), row_(row), column_(column)
+      : begin_(begin),
+        length_(static_cast<boost::uint32_t>(end - begin)),
+        offset_(static_cast<boost::uint32_t>(offset)),
+        row_(static_cast<boost::uint32_t>(row)),
+        column_(static_cast<boost::uint32_t>(column)),
+        type_(type)
    {
    }
    
    // accessors
    TokenType type() const { return type_; }
-   std::wstring content() const { return std::wstring(begin_, end_); }
-   const std::string& contentAsUtf8() const;
-   std::size_t offset() const { return offset_; }
-   std::size_t length() const { return end_ - begin_; }
+   std::wstring content() const { return std::wstring(begin_, end()); }
+   std::string contentAsUtf8() const;
+   std::size_t offset() const
+   {
+      return offset_ == kNoOffset ? static_cast<std::size_t>(-1) : offset_;
+   }
+   std::size_t length() const { return length_; }
    std::size_t row() const { return row_; }
    std::size_t column() const { return column_; }
    
@@ -122,30 +132,29 @@ public:
    // efficient comparison operations
    bool contentEquals(const std::wstring& text) const
    {
-      std::size_t distance = std::distance(begin_, end_);
-      return distance == text.size() &&
-             std::equal(begin_, end_, text.begin());
+      return length_ == text.size() &&
+             std::equal(begin_, end(), text.begin());
    }
    
    bool contentEquals(wchar_t character) const
    {
-      return std::distance(begin_, end_) == 1 && *begin_ == character;
+      return length_ == 1 && *begin_ == character;
    }
    
    bool contentContains(const wchar_t character) const
    {
-      return std::find(begin_, end_, character) != end_;
+      return std::find(begin_, end(), character) != end();
    }
 
    bool contentStartsWith(const std::wstring& text) const
    {
-      return std::search(begin_, end_, text.begin(), text.end()) == begin_;
+      return std::search(begin_, end(), text.begin(), text.end()) == begin_;
    }
 
    bool isOperator(const std::wstring& op) const
    {
       return (type_ == RToken::OPER) &&
-              std::equal(begin_, end_, op.begin());
+              std::equal(begin_, end(), op.begin());
    }
 
    bool isType(TokenType type) const
@@ -158,13 +167,11 @@ public:
    static void unspecified_bool_true() {}
    operator unspecified_bool_type() const
    {
-      return offset_ == static_cast<std::size_t>(-1) ?
-                                             0 :
-                                             unspecified_bool_true;
+      return offset_ == kNoOffset ? 0 : unspecified_bool_true;
    }
    bool operator!() const
    {
-      return offset_ == static_cast<std::size_t>(-1);
+      return offset_ == kNoOffset;
    }
    
    std::wstring::const_iterator begin() const
@@ -174,12 +181,12 @@ public:
    
    std::wstring::const_iterator end() const
    {
-      return end_;
+      return begin_ + length_;
    }
    
    std::pair<std::wstring::const_iterator, std::wstring::const_iterator> range() const
    {
-      return std::make_pair(begin_, end_);
+      return std::make_pair(begin_, end());
    }
    
    std::string asString() const;
@@ -190,18 +197,22 @@ public:
    }
 
 private:
-   TokenType type_;
+   static const boost::uint32_t kNoOffset = static_cast<boost::uint32_t>(-1);
+
    std::wstring::const_iterator begin_;
-   std::wstring::const_iterator end_;
-   std::size_t offset_;
-   std::size_t row_;
-   std::size_t column_;
+   boost::uint32_t length_;
+   boost::uint32_t offset_;
+   boost::uint32_t row_;
+   boost::uint32_t column_;
+   TokenType type_;
 };
 
 // Tokenize R code. Note that the RToken instances which are returned are
 // valid only during the lifetime of the RTokenizer which yielded them
 // (because they store iterators into their content rather than making a copy
-// of the content)
+// of the content). The code is still held (and scanned) as wide characters:
+// RToken's iterators, and the offsets and columns consumers take from it,
+// are in characters rather than UTF-8 bytes.
 class RTokenizer : boost::noncopyable
 {
 public:
@@ -221,6 +232,21 @@ public:
 
    RToken nextToken();
 
+   // resume tokenizing at the start of line 'row', which begins 'offset'
+   // characters into the data (with no '[' or '[[' open)
+   void seekToLine(std::size_t offset, std::size_t row)
+   {
+      pos_ = begin_ + offset;
+      row_ = row;
+      column_ = 0;
+      braceStack_.clear();
+   }
+
+   const std::wstring& data() const { return data_; }
+   std::size_t offset() const { return pos_ - begin_; }
+   std::size_t row() const { return row_; }
+   bool isWithinBrackets() const { return !braceStack_.empty(); }
+
 private:
    RToken matchWhitespace();
    RToken matchNewline();
@@ -235,8 +261,6 @@ private:
    wchar_t peek();
    wchar_t peek(std::size_t lookahead);
    wchar_t eat();
-   std::size_t tokenLength(const boost::wregex& regex);
-   void eatUntil(const boost::wregex& regex);
    RToken consumeToken(RToken::TokenType tokenType, std::size_t length);
    
 private:
@@ -295,25 +319,44 @@ public:
    
    RTokens()
       : tokenizer_(L""),
-        dummyToken_(RToken::ERR)
+        dummyToken_(RToken::ERR),
+        flags_(None),
+        reusedPrefixEnd_(0),
+        reusedSuffixBegin_(0)
    {}
    
    explicit RTokens(const std::wstring& code, int flags = None)
-      : tokenizer_(code), dummyToken_(RToken::ERR)
+      : tokenizer_(code),
+        dummyToken_(RToken::ERR),
+        flags_(flags),
+        reusedPrefixEnd_(0),
+        reusedSuffixBegin_(0)
    {
-      RToken token;
-      while ((token = tokenizer_.nextToken()))
+      while (tokenizeNext())
       {
-         if ((flags & StripWhitespace) && token.type() == RToken::WHITESPACE)
-            continue;
-
-         if ((flags & StripComments) && token.type() == RToken::COMMENT)
-            continue;
-
-         push_back(token);
       }
+      reusedSuffixBegin_ = tokens_.size();
    }
    
+   // Tokenize 'code', an edited copy of the code 'previous' was created
+   // from in which the 'removed' characters at 'offset' were replaced by
+   // 'inserted' new ones. Only the lines around the edit are re-scanned;
+   // the tokens before and after them are carried over from 'previous'.
+   RTokens(const std::wstring& code,
+           const RTokens& previous,
+           std::size_t offset,
+           std::size_t removed,
+           std::size_t inserted);
+   
+   // Number of tokens carried over from the start of the previous tokens
+   // (the tokens from here on were re-scanned), or 0 if there were none.
+   std::size_t reusedPrefixEnd() const { return reusedPrefixEnd_; }
+   
+   // Index of the first token carried over from the end of the previous
+   // tokens (tokens from here on correspond one to one with the last
+   // tokens of 'previous'), or size() if there were none.
+   std::size_t reusedSuffixBegin() const { return reusedSuffixBegin_; }
+   
    friend std::ostream& operator <<(std::ostream& os,
                                     const RTokens& rTokens)
    {
@@ -323,9 +366,15 @@ public:
    }
 
 private:
+    // tokenize the next token, keeping it unless it's stripped
+    RToken tokenizeNext();
+
     RTokenizer tokenizer_;
     Tokens tokens_;
     RToken dummyToken_;
+    int flags_;
+    std::size_t reusedPrefixEnd_;
+    std::size_t reusedSuffixBegin_;
 };
 
 namespace token_utils {
@@ -39,12 +39,19 @@ namespace system {
 struct FileScannerOptions
 {
    FileScannerOptions()
-      : recursive(false), yield(false)
+      : recursive(false), yield(false), parallel(false)
    {
    }
 
    bool recursive;
    bool yield;
+
+   // read subdirectories of recursive scans concurrently. the filter and
+   // onBeforeScanDir callbacks are then invoked from the scanning threads
+   // (one at a time, but not in any particular order). not supported on
+   // windows, where scans are always serial
+   bool parallel;
+
    boost::function<bool(const FileInfo&)> filter;
    boost::function<Error(const FileInfo&)> onBeforeScanDir;
 };
@@ -0,0 +1,129 @@
+/*
+ * FileTreeSnapshot.hpp
+ *
+ * Copyright (C) 2009-17 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef CORE_SYSTEM_FILE_TREE_SNAPSHOT_HPP
+#define CORE_SYSTEM_FILE_TREE_SNAPSHOT_HPP
+
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/function.hpp>
+
+#include <core/FileInfo.hpp>
+#include <core/collection/Tree.hpp>
+
+#include <core/system/FileChangeEvent.hpp>
+
+namespace rstudio {
+namespace core {
+namespace system {
+
+// Compact, immutable copy of a scanned file tree, for keeping the state of
+// a tree around in order to diff it against a later scan. Rather than a node
+// and a full path string per file, entries are stored contiguously in
+// pre-order (so each subtree is a contiguous range) with their names interned
+// in a single buffer; paths are rebuilt from the names of ancestors on demand.
+//
+// Being immutable, snapshots suit state which is only ever replaced by a
+// fresh scan (e.g. the session's polled scratch paths) and diffing rescanned
+// subtrees. The platform file monitors keep their tree<FileInfo> since they
+// update it in place, node by node, as individual change notifications come
+// in (see rstudio-core-snapshot-benchmark for the memory and diff costs).
+class FileTreeSnapshot
+{
+public:
+   FileTreeSnapshot()
+   {
+   }
+
+   // snapshot the (sub)tree rooted at the given node
+   explicit FileTreeSnapshot(const tree<FileInfo>::iterator_base& root);
+
+   // COPYING: via compiler (copyable members)
+
+public:
+   bool empty() const { return entries_.empty(); }
+   std::size_t size() const { return entries_.size(); }
+
+   // entries are numbered in pre-order, so 0 is the root and the subtree
+   // of an entry runs up to (but not including) subtreeEnd
+   FileInfo fileInfo(std::size_t index) const;
+   std::string absolutePath(std::size_t index) const;
+   std::time_t lastWriteTime(std::size_t index) const
+   {
+      return entries_[index].lastWriteTime;
+   }
+   std::size_t subtreeEnd(std::size_t index) const
+   {
+      return entries_[index].end;
+   }
+
+   // order an entry relative to one in another snapshot with the same
+   // parent path (in the order of fileInfoPathCompare)
+   int compare(std::size_t index,
+               const FileTreeSnapshot& other,
+               std::size_t otherIndex) const;
+
+   // approximate number of bytes held
+   std::size_t memoryUsage() const;
+
+   // rebuild the equivalent tree (for consumers of tree<FileInfo>)
+   void toTree(tree<FileInfo>* pTree) const;
+
+private:
+   struct Entry
+   {
+      boost::uint32_t parent;
+      boost::uint32_t end;
+      boost::uint32_t nameOffset;
+      boost::uint32_t nameLength;
+      boost::uint64_t size;
+      std::time_t lastWriteTime;
+      bool isDirectory;
+      bool isSymlink;
+   };
+
+   struct Builder;
+
+private:
+   std::vector<Entry> entries_;
+   std::string names_;
+};
+
+// collect the events which turn one snapshot into the other, in time
+// proportional to their size (the snapshots are diffed sibling by sibling)
+void collectFileChangeEvents(
+                     const FileTreeSnapshot& prev,
+                     const FileTreeSnapshot& curr,
+                     const boost::function<bool(const FileInfo&)>& filter,
+                     std::vector<FileChangeEvent>* pEvents);
+
+inline void collectFileChangeEvents(const FileTreeSnapshot& prev,
+                                    const FileTreeSnapshot& curr,
+                                    std::vector<FileChangeEvent>* pEvents)
+{
+   collectFileChangeEvents(prev,
+                           curr,
+                           boost::function<bool(const FileInfo&)>(),
+                           pEvents);
+}
+
+} // namespace system
+} // namespace core
+} // namespace rstudio
+
+#endif // CORE_SYSTEM_FILE_TREE_SNAPSHOT_HPP
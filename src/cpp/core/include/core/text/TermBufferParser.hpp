@@ -22,6 +22,39 @@ namespace rstudio {
 namespace core {
 namespace text {
 
+// An ANSI control sequence: ESC '[', then an optional '?' marking a private
+// (DEC) sequence, then any digits, then a final byte (any byte other than a
+// digit or ESC).
+struct ControlSequence
+{
+   enum Status
+   {
+      // not a control sequence; length covers the bytes preceding the one
+      // which didn't fit (e.g. the ESC alone in "ESC x"), which are text
+      Invalid,
+
+      // the input ended part way through; length covers the rest of it
+      Incomplete,
+
+      // length covers the ESC through the final byte
+      Complete
+   };
+
+   Status status;
+   std::size_t length;
+   bool isPrivate;
+   std::string params;
+   char final;
+};
+
+// Find the next ESC in [begin, end), or end if there is none. Runs of text
+// are skipped with memchr, which the C runtime vectorizes, so the cost of
+// scanning text which has few or no escapes is close to that of copying it.
+const char* findEscape(const char* begin, const char* end);
+
+// Parse the control sequence starting at begin, which must point at an ESC.
+ControlSequence parseControlSequence(const char* begin, const char* end);
+
 // Remove all text between start/end alt-buffer escape sequences (vt100/xterm).
 //
 // The alt-buffer is used by full-screen programs such as vim. The terminal
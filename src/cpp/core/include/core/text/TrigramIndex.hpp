@@ -0,0 +1,91 @@
+/*
+ * TrigramIndex.hpp
+ *
+ * Copyright (C) 2009-17 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef CORE_TEXT_TRIGRAM_INDEX_HPP
+#define CORE_TEXT_TRIGRAM_INDEX_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/utility.hpp>
+
+namespace rstudio {
+namespace core {
+namespace text {
+
+// Index of the trigrams (three byte sequences) contained in a set of files,
+// used to narrow down the files which need to be scanned for a search.
+//
+// Trigrams are indexed with ASCII letters folded to lower case (so the same
+// index serves case sensitive and insensitive searches) and trigrams which
+// span a line break are skipped (searches are line based). Files are
+// identified by path; re-adding a path replaces its previous contents.
+//
+// The index only ever produces candidates: the files it returns may not
+// actually contain a match, but files which are not returned cannot.
+class TrigramIndex : boost::noncopyable
+{
+public:
+   TrigramIndex() : deadCount_(0) {}
+
+   // add (or replace) the contents of a file
+   void add(const std::string& path, const std::string& contents);
+
+   // remove a file, or all of the files within a directory
+   void remove(const std::string& path);
+   void removeDirectory(const std::string& path);
+
+   void clear();
+
+   bool contains(const std::string& path) const;
+   std::size_t size() const { return ids_.size(); }
+
+   // determine the files which may contain all of the passed literals
+   // (in path order). literals shorter than three bytes don't narrow the
+   // search; if no literal does then every file is returned
+   void candidates(const std::vector<std::string>& literals,
+                   std::vector<std::string>* pPaths) const;
+
+private:
+   void compact();
+
+private:
+   // file paths by id (removed files leave an empty path behind until
+   // the index is compacted)
+   std::vector<std::string> paths_;
+   std::map<std::string, boost::uint32_t> ids_;
+   std::size_t deadCount_;
+
+   // sorted file ids for each trigram
+   boost::unordered_map<boost::uint32_t, std::vector<boost::uint32_t> > postings_;
+};
+
+// Determine literal strings which every line matched by a grep style search
+// must contain (pattern is a basic regular expression unless isRegex is false,
+// in which case it is a fixed string). Returns false if there are none (e.g.
+// the pattern contains alternation), in which case all files must be searched.
+bool requiredLiterals(const std::string& pattern,
+                      bool isRegex,
+                      bool ignoreCase,
+                      std::vector<std::string>* pLiterals);
+
+} // namespace text
+} // namespace core
+} // namespace rstudio
+
+#endif // CORE_TEXT_TRIGRAM_INDEX_HPP
@@ -14,17 +14,21 @@
  */
 
 #include <core/json/Json.hpp>
+#include <core/json/JsonParser.hpp>
 #include <core/json/JsonRpc.hpp>
 
+#include <algorithm>
+#include <cstdio>
 #include <cstdlib>
 #include <sstream>
 
+#include <boost/cstdint.hpp>
 #include <boost/format.hpp>
 #include <boost/foreach.hpp>
 #include <boost/scoped_array.hpp>
+#include <boost/utility.hpp>
 
 #include <core/Log.hpp>
-#include <core/Thread.hpp>
 
 #include "spirit/json_spirit.h"
 
@@ -118,22 +122,172 @@ bool fillMap(const Object& object, std::map< std::string, std::vector<std::strin
 
 bool parse(const std::string& input, Value* pValue)
 {
-   // two threads simultaneously using the json parser has been observed
-   // to crash the process. protect it globally with a mutex. note this was
-   // probably a result of not defining BOOST_SPIRIT_THREADSAFE (which we
-   // have subsequently defined) however since there isn't much documentation 
-   // on the behavior of boost spirit w/ threads and the specific behavior
-   // of this constant we leave in mutex just to be sure   
-      
-   static boost::mutex s_spiritMutex ;
-   LOCK_MUTEX(s_spiritMutex)
+   ValueBuilder builder(pValue);
+   return parseEvents(input, &builder) && builder.complete();
+}
+
+namespace {
+
+// returns the escape sequence for a character (or NULL if the character
+// should be written as-is). note that this matches the escaping performed
+// by json_spirit (with HANDLE_UTF8) so the two writers produce identical
+// output
+inline const char* escapeSequence(char ch)
+{
+   switch (ch)
    {
-      return json_spirit::read(input, *pValue);
+      case '"':  return "\\\"";
+      case '\\': return "\\\\";
+      case '\b': return "\\b";
+      case '\f': return "\\f";
+      case '\n': return "\\n";
+      case '\r': return "\\r";
+      case '\t': return "\\t";
+      default:   return NULL;
    }
-   END_LOCK_MUTEX
-   
-   // mutex related error
-   return false;
+}
+
+// writes json values directly into a string buffer. this avoids the
+// std::ostream machinery (and per-string escaping copies) of the
+// json_spirit generator, which dominates the cost of serializing large
+// rpc responses and client event payloads
+class BufferWriter : boost::noncopyable
+{
+public:
+   explicit BufferWriter(std::string* pOutput)
+      : pOutput_(pOutput)
+   {
+   }
+
+   void write(const Value& value)
+   {
+      switch (value.type())
+      {
+         case json_spirit::obj_type:
+            writeObject(value.get_obj());
+            break;
+         case json_spirit::array_type:
+            writeArray(value.get_array());
+            break;
+         case json_spirit::str_type:
+            writeString(value.get_str());
+            break;
+         case json_spirit::bool_type:
+            pOutput_->append(value.get_bool() ? "true" : "false");
+            break;
+         case json_spirit::int_type:
+            if (value.is_uint64())
+               writeUnsigned(value.get_uint64());
+            else
+               writeInteger(value.get_int64());
+            break;
+         case json_spirit::real_type:
+            writeReal(value.get_real());
+            break;
+         case json_spirit::null_type:
+         default:
+            pOutput_->append("null");
+            break;
+      }
+   }
+
+private:
+   void writeObject(const Object& object)
+   {
+      pOutput_->push_back('{');
+      for (Object::const_iterator it = object.begin(); it != object.end(); ++it)
+      {
+         if (it != object.begin())
+            pOutput_->push_back(',');
+         writeString(it->first);
+         pOutput_->push_back(':');
+         write(it->second);
+      }
+      pOutput_->push_back('}');
+   }
+
+   void writeArray(const Array& array)
+   {
+      pOutput_->push_back('[');
+      for (Array::const_iterator it = array.begin(); it != array.end(); ++it)
+      {
+         if (it != array.begin())
+            pOutput_->push_back(',');
+         write(*it);
+      }
+      pOutput_->push_back(']');
+   }
+
+   void writeString(const std::string& value)
+   {
+      pOutput_->push_back('"');
+
+      // copy runs of characters which don't require escaping in one shot
+      const char* pBegin = value.data();
+      const char* pEnd = pBegin + value.size();
+      const char* pRun = pBegin;
+      for (const char* pCh = pBegin; pCh != pEnd; ++pCh)
+      {
+         const char* escaped = escapeSequence(*pCh);
+         if (escaped == NULL)
+            continue;
+
+         pOutput_->append(pRun, pCh - pRun);
+         pOutput_->append(escaped, 2);
+         pRun = pCh + 1;
+      }
+      pOutput_->append(pRun, pEnd - pRun);
+
+      pOutput_->push_back('"');
+   }
+
+   void writeUnsigned(boost::uint64_t value)
+   {
+      // digits are generated in reverse from the end of the buffer
+      char buffer[32];
+      char* pEnd = buffer + sizeof(buffer);
+      char* pBegin = pEnd;
+      do
+      {
+         *--pBegin = static_cast<char>('0' + (value % 10));
+         value /= 10;
+      } while (value != 0);
+      pOutput_->append(pBegin, pEnd - pBegin);
+   }
+
+   void writeInteger(boost::int64_t value)
+   {
+      if (value < 0)
+      {
+         pOutput_->push_back('-');
+
+         // negate in unsigned space so that INT64_MIN doesn't overflow
+         writeUnsigned(~static_cast<boost::uint64_t>(value) + 1);
+      }
+      else
+      {
+         writeUnsigned(static_cast<boost::uint64_t>(value));
+      }
+   }
+
+   void writeReal(double value)
+   {
+      // equivalent to std::showpoint << std::setprecision(16)
+      char buffer[64];
+      int n = ::snprintf(buffer, sizeof(buffer), "%#.16g", value);
+      if (n > 0)
+         pOutput_->append(buffer, std::min<std::size_t>(n, sizeof(buffer) - 1));
+   }
+
+private:
+   std::string* pOutput_;
+};
+
+} // anonymous namespace
+
+void write(const Value& value, std::string* pOutput)
+{
+   BufferWriter(pOutput).write(value);
 }
 
 void write(const Value& value, std::ostream& os)
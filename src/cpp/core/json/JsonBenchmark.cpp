@@ -0,0 +1,248 @@
+/*
+ * JsonBenchmark.cpp
+ *
+ * Copyright (C) 2009-17 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+// Measures json parsing and serialization throughput (in MB/s of json) over
+// a set of captured json-rpc payloads, comparing them with the json_spirit
+// reader and writer, e.g.
+//
+//    rstudio-core-json-benchmark ~/rpc-payloads
+//
+// Each argument is either a .json file holding a single rpc request or
+// response body (as captured with the browser's developer tools, e.g. the
+// save_document request for a large file or the get_environment_state
+// response for a large workspace) or a directory which is searched
+// (recursively) for them.
+
+#include <iostream>
+#include <iomanip>
+
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/function.hpp>
+
+#include <core/Error.hpp>
+#include <core/FilePath.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/Log.hpp>
+#include <core/system/System.hpp>
+
+#include <core/json/Json.hpp>
+#include <core/json/JsonRpc.hpp>
+
+#include "spirit/json_spirit_reader.h"
+
+using namespace rstudio;
+using namespace rstudio::core;
+
+namespace {
+
+// each benchmark is repeated for at least this long
+const long kMinDurationMs = 2000;
+
+bool addPayloadFile(int, const FilePath& filePath,
+                    std::vector<FilePath>* pFiles)
+{
+   if (!filePath.isDirectory() && filePath.extensionLowerCase() == ".json")
+      pFiles->push_back(filePath);
+   return true;
+}
+
+std::size_t parse(const std::vector<std::string>& payloads)
+{
+   std::size_t count = 0;
+   for (std::size_t i = 0; i < payloads.size(); i++)
+   {
+      json::Value value;
+      if (json::parse(payloads[i], &value))
+         count++;
+   }
+   return count;
+}
+
+std::size_t spiritParse(const std::vector<std::string>& payloads)
+{
+   std::size_t count = 0;
+   for (std::size_t i = 0; i < payloads.size(); i++)
+   {
+      json::Value value;
+      if (json_spirit::read(payloads[i], value))
+         count++;
+   }
+   return count;
+}
+
+std::size_t parseRequests(const std::vector<std::string>& requests)
+{
+   std::size_t count = 0;
+   for (std::size_t i = 0; i < requests.size(); i++)
+   {
+      json::JsonRpcRequest request;
+      if (!json::parseJsonRpcRequest(requests[i], &request))
+         count++;
+   }
+   return count;
+}
+
+std::size_t write(const std::vector<json::Value>& values)
+{
+   std::size_t count = 0;
+   for (std::size_t i = 0; i < values.size(); i++)
+   {
+      std::string output;
+      json::write(values[i], &output);
+      count += output.size();
+   }
+   return count;
+}
+
+std::size_t spiritWrite(const std::vector<json::Value>& values)
+{
+   std::size_t count = 0;
+   for (std::size_t i = 0; i < values.size(); i++)
+      count += json::write(values[i]).size();
+   return count;
+}
+
+void run(const std::string& name,
+         const boost::function<std::size_t()>& benchmark,
+         std::size_t bytes)
+{
+   using namespace boost::posix_time;
+
+   // warm up
+   std::size_t count = benchmark();
+
+   int iterations = 0;
+   ptime start = microsec_clock::universal_time();
+   time_duration elapsed;
+   do
+   {
+      benchmark();
+      iterations++;
+      elapsed = microsec_clock::universal_time() - start;
+   } while (elapsed.total_milliseconds() < kMinDurationMs);
+
+   double seconds = elapsed.total_microseconds() / 1000000.0 / iterations;
+   std::cout << std::left << std::setw(14) << name << std::right
+             << std::fixed << std::setprecision(1)
+             << std::setw(10) << (bytes / seconds / (1024 * 1024)) << " MB/s"
+             << std::setw(12) << (seconds * 1000) << " ms"
+             << std::setw(12) << count << std::endl;
+}
+
+} // anonymous namespace
+
+int main(int argc, char * argv[])
+{
+   try
+   {
+      initializeStderrLog("rstudio-core-json-benchmark",
+                          core::system::kLogLevelWarning);
+
+      if (argc < 2)
+      {
+         std::cerr << "usage: " << argv[0] << " <file or directory>..."
+                   << std::endl;
+         return EXIT_FAILURE;
+      }
+
+      std::vector<FilePath> files;
+      for (int i = 1; i < argc; i++)
+      {
+         FilePath path(argv[i]);
+         if (path.isDirectory())
+         {
+            Error error = path.childrenRecursive(
+                     boost::bind(addPayloadFile, _1, _2, &files));
+            if (error)
+               LOG_ERROR(error);
+         }
+         else if (path.exists())
+         {
+            files.push_back(path);
+         }
+      }
+
+      // keep the payloads which parse, noting which of them are requests
+      std::vector<std::string> payloads;
+      std::vector<json::Value> values;
+      std::vector<std::string> requests;
+      std::size_t bytes = 0;
+      std::size_t requestBytes = 0;
+      for (std::size_t i = 0; i < files.size(); i++)
+      {
+         std::string payload;
+         Error error = readStringFromFile(files[i], &payload);
+         if (error)
+         {
+            LOG_ERROR(error);
+            continue;
+         }
+
+         json::Value value;
+         if (!json::parse(payload, &value))
+         {
+            LOG_WARNING_MESSAGE("Invalid json in " + files[i].absolutePath());
+            continue;
+         }
+
+         if (value.type() == json::ObjectType &&
+             value.get_obj().find("method") != value.get_obj().end())
+         {
+            requests.push_back(payload);
+            requestBytes += payload.size();
+         }
+
+         bytes += payload.size();
+         payloads.push_back(payload);
+         values.push_back(value);
+      }
+
+      if (bytes == 0)
+      {
+         std::cerr << "no json payloads found" << std::endl;
+         return EXIT_FAILURE;
+      }
+
+      std::cout << payloads.size() << " payloads (" << requests.size()
+                << " requests), " << bytes << " bytes"
+                << std::endl << std::endl;
+
+      // parse:         json::parse (count is payloads parsed)
+      // spirit-parse:  json_spirit's reader, for comparison
+      // rpc-parse:     parseJsonRpcRequest over the requests alone (count
+      //                is requests parsed)
+      // write:         json::write into a string, as used for rpc
+      //                responses (count is bytes written)
+      // spirit-write:  json_spirit's writer, for comparison
+      run("parse", boost::bind(parse, boost::cref(payloads)), bytes);
+      run("spirit-parse", boost::bind(spiritParse, boost::cref(payloads)),
+          bytes);
+      if (!requests.empty())
+      {
+         run("rpc-parse", boost::bind(parseRequests, boost::cref(requests)),
+             requestBytes);
+      }
+      run("write", boost::bind(write, boost::cref(values)), bytes);
+      run("spirit-write", boost::bind(spiritWrite, boost::cref(values)),
+          bytes);
+
+      return EXIT_SUCCESS;
+   }
+   CATCH_UNEXPECTED_EXCEPTION
+
+   // if we got this far we had an unexpected exception
+   return EXIT_FAILURE;
+}
@@ -0,0 +1,536 @@
+/*
+ * JsonParser.cpp
+ *
+ * Copyright (C) 2009-17 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <core/json/JsonParser.hpp>
+
+#include <cstdlib>
+#include <limits>
+
+namespace rstudio {
+namespace core {
+namespace json {
+
+namespace {
+
+// guard against stack exhaustion on (malicious) deeply nested input
+const int kMaxDepth = 512;
+
+inline bool isWhitespace(char ch)
+{
+   return ch == ' ' || ch == '\n' || ch == '\r' || ch == '\t' ||
+          ch == '\f' || ch == '\v';
+}
+
+inline bool isDigit(char ch)
+{
+   return ch >= '0' && ch <= '9';
+}
+
+inline int hexValue(char ch)
+{
+   if (ch >= '0' && ch <= '9')
+      return ch - '0';
+   else if (ch >= 'a' && ch <= 'f')
+      return ch - 'a' + 10;
+   else if (ch >= 'A' && ch <= 'F')
+      return ch - 'A' + 10;
+   else
+      return -1;
+}
+
+void appendUtf8(unsigned int codePoint, std::string* pOutput)
+{
+   if (codePoint < 0x80)
+   {
+      pOutput->push_back(static_cast<char>(codePoint));
+   }
+   else if (codePoint < 0x800)
+   {
+      pOutput->push_back(static_cast<char>(0xC0 | (codePoint >> 6)));
+      pOutput->push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+   }
+   else if (codePoint < 0x10000)
+   {
+      pOutput->push_back(static_cast<char>(0xE0 | (codePoint >> 12)));
+      pOutput->push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+      pOutput->push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+   }
+   else
+   {
+      pOutput->push_back(static_cast<char>(0xF0 | (codePoint >> 18)));
+      pOutput->push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F)));
+      pOutput->push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+      pOutput->push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+   }
+}
+
+// recursive descent parser which scans the input in a single pass and
+// reports what it finds to a ParseHandler. string and number tokens are
+// decoded into reusable scratch buffers so that (other than the growth of
+// those buffers) the parser itself does not allocate
+class Parser : boost::noncopyable
+{
+public:
+   Parser(const char* begin, const char* end, ParseHandler* pHandler)
+      : pos_(begin), end_(end), pHandler_(pHandler), depth_(0)
+   {
+   }
+
+   bool parse()
+   {
+      skipWhitespace();
+      return parseValue();
+   }
+
+private:
+   void skipWhitespace()
+   {
+      while (pos_ != end_ && isWhitespace(*pos_))
+         ++pos_;
+   }
+
+   bool consume(char ch)
+   {
+      skipWhitespace();
+      if (pos_ == end_ || *pos_ != ch)
+         return false;
+
+      ++pos_;
+      return true;
+   }
+
+   bool parseValue()
+   {
+      if (pos_ == end_)
+         return false;
+
+      switch (*pos_)
+      {
+         case '{':
+            return parseObject();
+         case '[':
+            return parseArray();
+         case '"':
+            return parseString(&scratch_) && pHandler_->onString(&scratch_);
+         case 't':
+            return parseLiteral("true") && pHandler_->onBool(true);
+         case 'f':
+            return parseLiteral("false") && pHandler_->onBool(false);
+         case 'n':
+            return parseLiteral("null") && pHandler_->onNull();
+         default:
+            return parseNumber();
+      }
+   }
+
+   bool parseObject()
+   {
+      ++pos_;
+      if (++depth_ > kMaxDepth || !pHandler_->onStartObject())
+         return false;
+
+      skipWhitespace();
+      if (pos_ != end_ && *pos_ == '}')
+      {
+         ++pos_;
+         --depth_;
+         return pHandler_->onEndObject();
+      }
+
+      for (;;)
+      {
+         if (pos_ == end_ || *pos_ != '"')
+            return false;
+
+         if (!parseString(&scratch_) || !pHandler_->onKey(&scratch_))
+            return false;
+
+         if (!consume(':'))
+            return false;
+
+         skipWhitespace();
+         if (!parseValue())
+            return false;
+
+         skipWhitespace();
+         if (pos_ == end_)
+            return false;
+
+         char ch = *pos_++;
+         if (ch == '}')
+         {
+            --depth_;
+            return pHandler_->onEndObject();
+         }
+         else if (ch != ',')
+         {
+            return false;
+         }
+
+         skipWhitespace();
+      }
+   }
+
+   bool parseArray()
+   {
+      ++pos_;
+      if (++depth_ > kMaxDepth || !pHandler_->onStartArray())
+         return false;
+
+      skipWhitespace();
+      if (pos_ != end_ && *pos_ == ']')
+      {
+         ++pos_;
+         --depth_;
+         return pHandler_->onEndArray();
+      }
+
+      for (;;)
+      {
+         if (!parseValue())
+            return false;
+
+         skipWhitespace();
+         if (pos_ == end_)
+            return false;
+
+         char ch = *pos_++;
+         if (ch == ']')
+         {
+            --depth_;
+            return pHandler_->onEndArray();
+         }
+         else if (ch != ',')
+         {
+            return false;
+         }
+
+         skipWhitespace();
+      }
+   }
+
+   bool parseLiteral(const char* literal)
+   {
+      for (const char* pCh = literal; *pCh != '\0'; ++pCh, ++pos_)
+      {
+         if (pos_ == end_ || *pos_ != *pCh)
+            return false;
+      }
+      return true;
+   }
+
+   bool parseString(std::string* pOutput)
+   {
+      // skip opening quote
+      ++pos_;
+      pOutput->clear();
+
+      // copy runs of unescaped characters in one shot
+      const char* pRun = pos_;
+      while (pos_ != end_)
+      {
+         char ch = *pos_;
+         if (ch == '"')
+         {
+            pOutput->append(pRun, pos_ - pRun);
+            ++pos_;
+            return true;
+         }
+         else if (ch != '\\')
+         {
+            ++pos_;
+            continue;
+         }
+
+         pOutput->append(pRun, pos_ - pRun);
+         if (++pos_ == end_)
+            return false;
+
+         switch (*pos_++)
+         {
+            case '"':  pOutput->push_back('"');  break;
+            case '\\': pOutput->push_back('\\'); break;
+            case '/':  pOutput->push_back('/');  break;
+            case 'b':  pOutput->push_back('\b'); break;
+            case 'f':  pOutput->push_back('\f'); break;
+            case 'n':  pOutput->push_back('\n'); break;
+            case 'r':  pOutput->push_back('\r'); break;
+            case 't':  pOutput->push_back('\t'); break;
+            case 'u':
+               if (!parseUnicodeEscape(pOutput))
+                  return false;
+               break;
+            default:
+               return false;
+         }
+
+         pRun = pos_;
+      }
+
+      // unterminated string
+      return false;
+   }
+
+   bool parseHex4(unsigned int* pValue)
+   {
+      if (end_ - pos_ < 4)
+         return false;
+
+      unsigned int value = 0;
+      for (int i = 0; i < 4; ++i)
+      {
+         int digit = hexValue(*pos_++);
+         if (digit < 0)
+            return false;
+         value = (value << 4) | digit;
+      }
+
+      *pValue = value;
+      return true;
+   }
+
+   bool parseUnicodeEscape(std::string* pOutput)
+   {
+      unsigned int codePoint;
+      if (!parseHex4(&codePoint))
+         return false;
+
+      // combine surrogate pairs; lone surrogates become U+FFFD
+      if (codePoint >= 0xD800 && codePoint <= 0xDBFF)
+      {
+         unsigned int low = 0;
+         if (end_ - pos_ >= 6 && pos_[0] == '\\' && pos_[1] == 'u')
+         {
+            pos_ += 2;
+            if (!parseHex4(&low))
+               return false;
+         }
+
+         if (low >= 0xDC00 && low <= 0xDFFF)
+            codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+         else
+            codePoint = 0xFFFD;
+      }
+      else if (codePoint >= 0xDC00 && codePoint <= 0xDFFF)
+      {
+         codePoint = 0xFFFD;
+      }
+
+      appendUtf8(codePoint, pOutput);
+      return true;
+   }
+
+   bool parseNumber()
+   {
+      const char* pStart = pos_;
+
+      bool negative = false;
+      if (*pos_ == '-')
+      {
+         negative = true;
+         ++pos_;
+      }
+
+      if (pos_ == end_ || !isDigit(*pos_))
+         return false;
+
+      // accumulate the integer part, noting if it overflows
+      const boost::uint64_t kMax = std::numeric_limits<boost::uint64_t>::max();
+      boost::uint64_t value = 0;
+      bool overflow = false;
+      for (; pos_ != end_ && isDigit(*pos_); ++pos_)
+      {
+         unsigned int digit = *pos_ - '0';
+         if (value > (kMax - digit) / 10)
+            overflow = true;
+         else
+            value = value * 10 + digit;
+      }
+
+      bool real = false;
+      if (pos_ != end_ && *pos_ == '.')
+      {
+         real = true;
+         if (++pos_ == end_ || !isDigit(*pos_))
+            return false;
+         while (pos_ != end_ && isDigit(*pos_))
+            ++pos_;
+      }
+
+      if (pos_ != end_ && (*pos_ == 'e' || *pos_ == 'E'))
+      {
+         real = true;
+         if (++pos_ != end_ && (*pos_ == '+' || *pos_ == '-'))
+            ++pos_;
+         if (pos_ == end_ || !isDigit(*pos_))
+            return false;
+         while (pos_ != end_ && isDigit(*pos_))
+            ++pos_;
+      }
+
+      // integers are reported as such where they fit (as json_spirit does)
+      const boost::uint64_t kMaxInt =
+            static_cast<boost::uint64_t>(std::numeric_limits<boost::int64_t>::max());
+      if (!real && !overflow)
+      {
+         if (!negative && value <= kMaxInt)
+            return pHandler_->onInteger(static_cast<boost::int64_t>(value));
+         else if (!negative)
+            return pHandler_->onUnsigned(value);
+         else if (value <= kMaxInt + 1)
+            return pHandler_->onInteger(
+                     static_cast<boost::int64_t>(~value + 1));
+      }
+
+      // copy into a null terminated buffer for strtod
+      numberScratch_.assign(pStart, pos_);
+      char* pEnd = NULL;
+      double realValue = std::strtod(numberScratch_.c_str(), &pEnd);
+      if (pEnd != numberScratch_.c_str() + numberScratch_.size())
+         return false;
+
+      return pHandler_->onReal(realValue);
+   }
+
+private:
+   const char* pos_;
+   const char* end_;
+   ParseHandler* pHandler_;
+   int depth_;
+   std::string scratch_;
+   std::string numberScratch_;
+};
+
+} // anonymous namespace
+
+Value* ValueBuilder::add(const Value& value)
+{
+   if (stack_.empty())
+   {
+      *pValue_ = value;
+      return pValue_;
+   }
+
+   Value* pParent = stack_.back();
+   if (pParent->type() == ArrayType)
+   {
+      Array& array = pParent->get_array();
+      array.push_back(value);
+      return &array.back();
+   }
+   else
+   {
+      return &(pParent->get_obj()[key_] = value);
+   }
+}
+
+bool ValueBuilder::endCompound()
+{
+   if (stack_.empty())
+      return false;
+
+   stack_.pop_back();
+   if (stack_.empty())
+      complete_ = true;
+
+   return true;
+}
+
+bool ValueBuilder::onNull()
+{
+   add(Value());
+   complete_ = stack_.empty();
+   return true;
+}
+
+bool ValueBuilder::onBool(bool value)
+{
+   add(Value(value));
+   complete_ = stack_.empty();
+   return true;
+}
+
+bool ValueBuilder::onInteger(boost::int64_t value)
+{
+   add(Value(value));
+   complete_ = stack_.empty();
+   return true;
+}
+
+bool ValueBuilder::onUnsigned(boost::uint64_t value)
+{
+   add(Value(value));
+   complete_ = stack_.empty();
+   return true;
+}
+
+bool ValueBuilder::onReal(double value)
+{
+   add(Value(value));
+   complete_ = stack_.empty();
+   return true;
+}
+
+bool ValueBuilder::onString(std::string* pValue)
+{
+   // add an empty string and swap the decoded one into it (rather than
+   // copying it into a temporary value and then again into the container)
+   add(Value(std::string()))->get_str().swap(*pValue);
+   complete_ = stack_.empty();
+   return true;
+}
+
+bool ValueBuilder::onStartObject()
+{
+   stack_.push_back(add(Object()));
+   return true;
+}
+
+bool ValueBuilder::onKey(std::string* pKey)
+{
+   key_.swap(*pKey);
+   return true;
+}
+
+bool ValueBuilder::onEndObject()
+{
+   return endCompound();
+}
+
+bool ValueBuilder::onStartArray()
+{
+   stack_.push_back(add(Array()));
+   return true;
+}
+
+bool ValueBuilder::onEndArray()
+{
+   return endCompound();
+}
+
+bool parseEvents(const char* begin, const char* end, ParseHandler* pHandler)
+{
+   return Parser(begin, end, pHandler).parse();
+}
+
+bool parseEvents(const std::string& input, ParseHandler* pHandler)
+{
+   const char* begin = input.data();
+   return parseEvents(begin, begin + input.size(), pHandler);
+}
+
+} // namespace json
+} // namespace core
+} // namespace rstudio
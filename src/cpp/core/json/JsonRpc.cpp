@@ -17,7 +17,10 @@
 
 #include <sstream>
 
+#include <boost/scoped_ptr.hpp>
+
 #include <core/Log.hpp>
+#include <core/json/JsonParser.hpp>
 #include <core/http/Response.hpp>
 
 
@@ -30,79 +33,238 @@ const char * const kRpcAsyncHandle = "asyncHandle";
 const char * const kRpcError = "error";
 const char * const kJsonContentType = "application/json" ;   
    
-Error parseJsonRpcRequest(const std::string& input, JsonRpcRequest* pRequest) 
+namespace {
+
+// parse handler which extracts the fields of a json-rpc request as they are
+// scanned. only params and kwparams are materialized (directly into the
+// request); unrecognized fields are skipped without building any values
+class JsonRpcRequestHandler : public ParseHandler,
+                              boost::noncopyable
 {
-   // json_spirit is not documented to throw an exceptions but surround 
-   // the code with an exception handling block just to be defensive...
-   try 
+public:
+   explicit JsonRpcRequestHandler(JsonRpcRequest* pRequest)
+      : pRequest_(pRequest), depth_(0)
+   {
+   }
+
+   const Error& error() const { return error_; }
+
+   virtual bool onNull()
+   {
+      return onScalar(Value());
+   }
+
+   virtual bool onBool(bool value)
+   {
+      return onScalar(Value(value));
+   }
+
+   virtual bool onInteger(boost::int64_t value)
+   {
+      return onScalar(Value(value));
+   }
+
+   virtual bool onUnsigned(boost::uint64_t value)
+   {
+      return onScalar(Value(value));
+   }
+
+   virtual bool onReal(double value)
+   {
+      return onScalar(Value(value));
+   }
+
+   virtual bool onString(std::string* pValue)
+   {
+      if (pBuilder_)
+         return pBuilder_->onString(pValue);
+      else if (depth_ != 1)
+         return true;
+
+      if (field_ == "method")
+         pRequest_->method.swap(*pValue);
+      else if (field_ == "sourceWnd")
+         pRequest_->sourceWindow.swap(*pValue);
+      else if (field_ == "clientId")
+         pRequest_->clientId.swap(*pValue);
+      else if (field_ == "clientVersion")
+         pRequest_->clientVersion.swap(*pValue);
+      else if (field_ == "version")
+         pRequest_->version = 0;
+      else if (field_ == "params")
+         return fail(errc::ParamTypeMismatch, ERROR_LOCATION);
+      else if (field_ == "kwparams")
+         return fail(errc::ParamTypeMismatch, ERROR_LOCATION);
+
+      return true;
+   }
+
+   virtual bool onStartObject()
+   {
+      if (++depth_ == 1)
+         return true;
+      else if (pBuilder_)
+         return pBuilder_->onStartObject();
+      else if (depth_ != 2)
+         return true;
+
+      if (field_ == "kwparams")
+         return beginMaterialize(&kwparams_, &ValueBuilder::onStartObject);
+      else if (field_ == "params")
+         return fail(errc::ParamTypeMismatch, ERROR_LOCATION);
+      else
+         return onCompoundField();
+   }
+
+   virtual bool onKey(std::string* pKey)
+   {
+      if (pBuilder_)
+         return pBuilder_->onKey(pKey);
+      else if (depth_ == 1)
+         field_.swap(*pKey);
+
+      return true;
+   }
+
+   virtual bool onEndObject()
+   {
+      return onEndCompound(&ValueBuilder::onEndObject);
+   }
+
+   virtual bool onStartArray()
+   {
+      // top level must be an object
+      if (++depth_ == 1)
+         return fail(errc::InvalidRequest, ERROR_LOCATION);
+      else if (pBuilder_)
+         return pBuilder_->onStartArray();
+      else if (depth_ != 2)
+         return true;
+
+      if (field_ == "params")
+         return beginMaterialize(&params_, &ValueBuilder::onStartArray);
+      else if (field_ == "kwparams")
+         return fail(errc::ParamTypeMismatch, ERROR_LOCATION);
+      else
+         return onCompoundField();
+   }
+
+   virtual bool onEndArray()
+   {
+      return onEndCompound(&ValueBuilder::onEndArray);
+   }
+
+private:
+   bool onScalar(const Value& value)
    {
-      // parse data and verify it contains an object
-      json::Value var;
-      if ( !json::parse(input, &var) || 
-           (var.type() != json::ObjectType) )
+      if (pBuilder_)
+         return addToBuilder(value);
+      else if (depth_ == 0)
+         return fail(errc::InvalidRequest, ERROR_LOCATION);
+      else if (depth_ != 1)
+         return true;
+
+      if (field_ == "method" || field_ == "sourceWnd" || field_ == "clientId")
+         return fail(errc::InvalidRequest, ERROR_LOCATION);
+      else if (field_ == "params" || field_ == "kwparams")
+         return fail(errc::ParamTypeMismatch, ERROR_LOCATION);
+      else if (field_ == "version")
+         pRequest_->version = isType<double>(value) ? value.get_value<double>() : 0;
+      else if (field_ == "clientVersion")
+         pRequest_->clientVersion = std::string();
+
+      return true;
+   }
+
+   bool addToBuilder(const Value& value)
+   {
+      switch (value.type())
       {
-         return Error(errc::InvalidRequest, ERROR_LOCATION) ;
+         case json_spirit::bool_type:
+            return pBuilder_->onBool(value.get_bool());
+         case json_spirit::int_type:
+            return value.is_uint64() ? pBuilder_->onUnsigned(value.get_uint64())
+                                     : pBuilder_->onInteger(value.get_int64());
+         case json_spirit::real_type:
+            return pBuilder_->onReal(value.get_real());
+         default:
+            return pBuilder_->onNull();
+      }
+   }
+
+   // objects and arrays are never valid for scalar fields
+   bool onCompoundField()
+   {
+      if (field_ == "method" || field_ == "sourceWnd" || field_ == "clientId")
+         return fail(errc::InvalidRequest, ERROR_LOCATION);
+      else if (field_ == "version")
+         pRequest_->version = 0;
+      else if (field_ == "clientVersion")
+         pRequest_->clientVersion = std::string();
+
+      return true;
+   }
+
+   bool beginMaterialize(Value* pValue, bool (ValueBuilder::*start)())
+   {
+      pBuilder_.reset(new ValueBuilder(pValue));
+      return ((*pBuilder_).*start)();
+   }
+
+   bool onEndCompound(bool (ValueBuilder::*end)())
+   {
+      --depth_;
+      if (!pBuilder_)
+         return true;
+
+      if (!((*pBuilder_).*end)())
+         return false;
+
+      // move the completed value into the request
+      if (pBuilder_->complete())
+      {
+         pBuilder_.reset();
+         if (field_ == "params")
+            pRequest_->params.swap(params_.get_array());
+         else
+            pRequest_->kwparams.swap(kwparams_.get_obj());
       }
 
-      // extract the fields
-      json::Object& requestObject = var.get_obj();
-      for (json::Object::const_iterator it = 
-            requestObject.begin(); it != requestObject.end(); ++it)
+      return true;
+   }
+
+   bool fail(errc::errc_t code, const ErrorLocation& location)
+   {
+      error_ = Error(code, location);
+      return false;
+   }
+
+private:
+   JsonRpcRequest* pRequest_;
+   int depth_;
+   std::string field_;
+   Value params_;
+   Value kwparams_;
+   boost::scoped_ptr<ValueBuilder> pBuilder_;
+   Error error_;
+};
+
+} // anonymous namespace
+
+Error parseJsonRpcRequest(const std::string& input, JsonRpcRequest* pRequest) 
+{
+   // surround the parse with an exception handling block just to be
+   // defensive (e.g. against allocation failures on huge requests)
+   try
+   {
+      // parse the request, extracting the fields as we go
+      JsonRpcRequestHandler handler(pRequest);
+      if (!parseEvents(input, &handler))
       {
-         std::string fieldName = it->first ;
-         json::Value fieldValue = it->second ;
-
-         if ( fieldName == "method" )
-         {
-            if (fieldValue.type() != json::StringType)
-               return Error(errc::InvalidRequest, ERROR_LOCATION) ;
-
-            pRequest->method = fieldValue.get_str() ;
-         }
-         else if ( fieldName == "params" )
-         {
-            if (fieldValue.type() != json::ArrayType)
-               return Error(errc::ParamTypeMismatch, ERROR_LOCATION) ;
-
-            pRequest->params = fieldValue.get_array();
-         }
-         else if ( fieldName == "kwparams" )
-         {
-            if (fieldValue.type() != json::ObjectType)
-               return Error(errc::ParamTypeMismatch, ERROR_LOCATION) ;
-
-            pRequest->kwparams = fieldValue.get_obj();
-         }
-         else if (fieldName == "sourceWnd")
-         {
-            if (fieldValue.type() != json::StringType)
-               return Error(errc::InvalidRequest, ERROR_LOCATION);
-
-            pRequest->sourceWindow = fieldValue.get_str();
-         }
-         else if (fieldName == "clientId" )
-         {
-            if (fieldValue.type() != json::StringType)
-               return Error(errc::InvalidRequest, ERROR_LOCATION);
-            
-            pRequest->clientId = fieldValue.get_str();
-         }
-         // legacy version field
-         else if (fieldName == "version" )
-         {
-            if (json::isType<double>(fieldValue))
-               pRequest->version = fieldValue.get_value<double>();
-            else
-               pRequest->version = 0;
-         }
-         // new version field
-         else if (fieldName == "clientVersion")
-         {
-            if (fieldValue.type() == json::StringType)
-               pRequest->clientVersion = fieldValue.get_str();
-            else
-               pRequest->clientVersion = std::string();
-         }
+         if (handler.error())
+            return handler.error();
+         else
+            return Error(errc::InvalidRequest, ERROR_LOCATION);
       }
 
       // method is required
@@ -185,6 +347,11 @@ void JsonRpcResponse::write(std::ostream& os) const
 {
    json::write(response_, os);
 }
+
+void JsonRpcResponse::write(std::string* pOutput) const
+{
+   json::write(response_, pOutput);
+}
    
 void JsonRpcResponse::setError(const Error& error, const json::Value& clientInfo)
 {
@@ -272,10 +439,10 @@ void setJsonRpcResponse(const core::json::JsonRpcResponse& jsonRpcResponse,
    if (pResponse->contentType().empty())
        pResponse->setContentType(kJsonContentType) ; 
    
-   // set body 
-   std::stringstream responseStream ;
-   jsonRpcResponse.write(responseStream);
-   Error error = pResponse->setBody(responseStream);
+   // set body (serialized directly into the buffer which becomes the body)
+   std::string body;
+   jsonRpcResponse.write(&body);
+   Error error = pResponse->setBodyFromBuffer(&body);
    
    // report error to client if one occurred
    if (error)
@@ -0,0 +1,196 @@
+/*
+ * JsonTests.cpp
+ *
+ * Copyright (C) 2009-17 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <tests/TestThat.hpp>
+
+#include <limits>
+#include <sstream>
+
+#include <boost/cstdint.hpp>
+
+#include <core/json/Json.hpp>
+#include <core/json/JsonRpc.hpp>
+
+#include "spirit/json_spirit_reader.h"
+
+namespace rstudio {
+namespace core {
+namespace json {
+
+namespace {
+
+std::string streamWrite(const Value& value)
+{
+   std::ostringstream ostr;
+   write(value, ostr);
+   return ostr.str();
+}
+
+std::string bufferWrite(const Value& value)
+{
+   std::string output;
+   write(value, &output);
+   return output;
+}
+
+bool parsesLikeSpirit(const std::string& input)
+{
+   Value expected;
+   if (!json_spirit::read(input, expected))
+      return false;
+
+   Value actual;
+   if (!parse(input, &actual))
+      return false;
+
+   return actual == expected;
+}
+
+} // anonymous namespace
+
+context("Json Writing")
+{
+   test_that("Scalars are written identically by the buffer writer")
+   {
+      expect_true(bufferWrite(Value()) == streamWrite(Value()));
+      expect_true(bufferWrite(Value(true)) == streamWrite(Value(true)));
+      expect_true(bufferWrite(Value(false)) == streamWrite(Value(false)));
+      expect_true(bufferWrite(Value(0)) == streamWrite(Value(0)));
+      expect_true(bufferWrite(Value(-42)) == streamWrite(Value(-42)));
+      expect_true(bufferWrite(Value(1.5)) == streamWrite(Value(1.5)));
+      expect_true(bufferWrite(Value(-0.1)) == streamWrite(Value(-0.1)));
+      expect_true(bufferWrite(Value(1e300)) == streamWrite(Value(1e300)));
+
+      boost::int64_t minInt = std::numeric_limits<boost::int64_t>::min();
+      expect_true(bufferWrite(Value(minInt)) == streamWrite(Value(minInt)));
+
+      boost::uint64_t maxUInt = std::numeric_limits<boost::uint64_t>::max();
+      expect_true(bufferWrite(Value(maxUInt)) == streamWrite(Value(maxUInt)));
+   }
+
+   test_that("Strings are escaped identically by the buffer writer")
+   {
+      std::string str = "plain \"quoted\" back\\slash \b\f\n\r\t caf\xc3\xa9";
+      expect_true(bufferWrite(Value(str)) == streamWrite(Value(str)));
+      expect_true(bufferWrite(Value(std::string())) ==
+                  streamWrite(Value(std::string())));
+   }
+
+   test_that("Nested collections are written identically by the buffer writer")
+   {
+      Array inner;
+      inner.push_back(1);
+      inner.push_back("two");
+      inner.push_back(Value());
+      inner.push_back(Array());
+
+      Object object;
+      object["b"] = inner;
+      object["a"] = Object();
+      object["c\n"] = 3.25;
+
+      Array outer;
+      outer.push_back(object);
+      outer.push_back(inner);
+
+      expect_true(bufferWrite(outer) == streamWrite(outer));
+   }
+
+   test_that("The buffer writer appends to existing output")
+   {
+      std::string output = "prefix:";
+      write(Value(1), &output);
+      expect_true(output == "prefix:1");
+   }
+}
+
+context("Json Parsing")
+{
+   test_that("Values are parsed identically to json_spirit")
+   {
+      expect_true(parsesLikeSpirit("null"));
+      expect_true(parsesLikeSpirit("  true "));
+      expect_true(parsesLikeSpirit("false"));
+      expect_true(parsesLikeSpirit("0"));
+      expect_true(parsesLikeSpirit("-17"));
+      expect_true(parsesLikeSpirit("9223372036854775807"));
+      expect_true(parsesLikeSpirit("-9223372036854775808"));
+      expect_true(parsesLikeSpirit("18446744073709551615"));
+      expect_true(parsesLikeSpirit("1.5"));
+      expect_true(parsesLikeSpirit("-2.5e-3"));
+      expect_true(parsesLikeSpirit("1E10"));
+      expect_true(parsesLikeSpirit("\"a \\\"quoted\\\" \\n\\t\\/ string\""));
+      expect_true(parsesLikeSpirit("[]"));
+      expect_true(parsesLikeSpirit("{}"));
+      expect_true(parsesLikeSpirit(
+         "{ \"b\" : [1, 2.5, \"three\", null, {\"x\": []}],\n"
+         "  \"a\" : { \"nested\" : { \"deeper\" : [[], [true]] } } }"));
+   }
+
+   test_that("Unicode escapes are decoded to UTF-8")
+   {
+      Value value;
+      expect_true(parse("\"caf\\u00e9 \\ud83d\\ude00\"", &value));
+      expect_true(value.get_str() == "caf\xc3\xa9 \xf0\x9f\x98\x80");
+   }
+
+   test_that("Invalid json is rejected")
+   {
+      Value value;
+      expect_false(parse("", &value));
+      expect_false(parse("{", &value));
+      expect_false(parse("[1,]", &value));
+      expect_false(parse("{\"a\" 1}", &value));
+      expect_false(parse("\"unterminated", &value));
+      expect_false(parse("tru", &value));
+      expect_false(parse("-", &value));
+      expect_false(parse("1.", &value));
+      expect_false(parse(std::string(1024, '['), &value));
+   }
+
+   test_that("Json-rpc requests are parsed")
+   {
+      JsonRpcRequest request;
+      Error error = parseJsonRpcRequest(
+         "{\"method\": \"save_document\", \"params\": [\"id\", [1, {\"a\": 2}]],"
+         " \"kwparams\": {\"k\": \"v\"}, \"ignored\": {\"method\": 1},"
+         " \"clientId\": \"abc\", \"version\": 2, \"clientVersion\": \"1.1\"}",
+         &request);
+      expect_true(!error);
+      expect_true(request.method == "save_document");
+      expect_true(request.clientId == "abc");
+      expect_true(request.version == 2);
+      expect_true(request.clientVersion == "1.1");
+      expect_true(request.params.size() == 2);
+      expect_true(request.params[0].get_str() == "id");
+      expect_true(request.params[1].get_array()[1].get_obj().size() == 1);
+      expect_true(request.kwparams.size() == 1);
+   }
+
+   test_that("Malformed json-rpc requests are rejected")
+   {
+      JsonRpcRequest request;
+      expect_true(parseJsonRpcRequest("[]", &request).code() == errc::InvalidRequest);
+      expect_true(parseJsonRpcRequest("{}", &request).code() == errc::InvalidRequest);
+      expect_true(parseJsonRpcRequest("{\"method\": 1}", &request).code() ==
+                  errc::InvalidRequest);
+      expect_true(parseJsonRpcRequest("{\"method\": \"m\", \"params\": {}}",
+                                      &request).code() == errc::ParamTypeMismatch);
+   }
+}
+
+} // namespace json
+} // namespace core
+} // namespace rstudio
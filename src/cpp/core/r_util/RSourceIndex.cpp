@@ -446,8 +446,10 @@ std::vector<Indexer> makeIndexers()
 
 }  // anonymous namespace
 
-RSourceIndex::RSourceIndex(const std::string& context, const std::string& code)
-   : context_(context)
+RSourceIndex::RSourceIndex(const std::string& context,
+                           const std::string& code,
+                           bool registerPackages)
+   : context_(context), registerPackages_(registerPackages)
 {
    static std::vector<Indexer> indexers = makeIndexers();
    
@@ -476,6 +478,19 @@ RSourceIndex::RSourceIndex(const std::string& context, const std::string& code)
    
 }
 
+RSourceIndex::RSourceIndex(const std::string& context,
+                           const std::vector<RSourceItem>& items,
+                           const std::vector<std::string>& inferredPkgNames,
+                           bool registerPackages)
+   : context_(context),
+     items_(items),
+     inferredPkgNames_(inferredPkgNames),
+     registerPackages_(registerPackages)
+{
+   if (registerPackages)
+      registerInferredPackages();
+}
+
 } // namespace r_util
 } // namespace core 
 } // namespace rstudio
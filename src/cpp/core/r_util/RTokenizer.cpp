@@ -13,24 +13,8 @@
  *
  */
 
-// A very low level assertion (line 595 of cpp_regex_traits.hpp) is firing
-// on WindowsXP when we create a boost::wregex within R session. This code
-// is part of boost attempting to detect the sort syntax, and the assertion
-// is that there are no nulls in a buffer after a call to locale->transform.
-// Within the same method there are workarounds for both borland c++ and
-// dinkumware c++ std library to strip embedded nulls, so it seems as if
-// there is some variation in whether nulls come out of the call to transforn.
-// Note also that boost has a macro titled BOOST_REGEX_NO_WIN32 which we are
-// not using, which means that boost regex does call into native windows APIs
-// for locale oriented functions (thus explaining a difference in runtime
-// behavior across platforms). Tokenization appears to continue to work
-// correctly in the presence of the assertion (with the annoying side effect
-// of logging an assertion every time the product starts up)
-
 #include <core/r_util/RTokenizer.hpp>
 
-#include <boost/regex.hpp>
-
 #include <iostream>
 #include <sstream>
 
@@ -45,35 +29,124 @@ namespace r_util {
 
 namespace {
 
-class TokenPatterns
-{
-private:
-   friend TokenPatterns& tokenPatterns();
-   TokenPatterns()
-      : NUMBER(L"[0-9]*(\\.[0-9]*)?([eE][+-]?[0-9]*)?[Li]?"),
-        HEX_NUMBER(L"0x[0-9a-fA-F]*L?"),
-        USER_OPERATOR(L"%[^%]*%"),
-        QUOTED_IDENTIFIER(L"`[^`]*`"),
-        UNTIL_END_QUOTE(L"[\\\\\'\"]"),
-        WHITESPACE(L"[\\s\x00A0\x3000]+"),
-        COMMENT(L"#[^\\n]*$")
+typedef std::wstring::const_iterator const_iterator;
+
+bool isDigit(wchar_t c)
+{
+   return c >= L'0' && c <= L'9';
+}
+
+bool isHexDigit(wchar_t c)
+{
+   return isDigit(c) || (c >= L'a' && c <= L'f') || (c >= L'A' && c <= L'F');
+}
+
+bool isIdentifierChar(wchar_t c)
+{
+   if (c < 0x80)
+   {
+      return (c >= L'a' && c <= L'z') || (c >= L'A' && c <= L'Z') ||
+             isDigit(c) || c == L'.' || c == L'_';
+   }
+   return string_utils::isalnum(c);
+}
+
+bool isWhitespace(wchar_t c)
+{
+   switch (c)
+   {
+   case L' ': case L'\t': case L'\n': case L'\v': case L'\f': case L'\r':
+   case L'\x0085': case L'\x00A0': case L'\x1680': case L'\x2028':
+   case L'\x2029': case L'\x202F': case L'\x205F': case L'\x3000':
+      return true;
+   default:
+      return c >= L'\x2000' && c <= L'\x200A';
+   }
+}
+
+// The token scanners below each return the length of the token starting at
+// pos (or 0 if there isn't one). They're hand-written equivalents of the
+// regular expressions given in their comments.
+
+// 0x[0-9a-fA-F]*L?
+std::size_t hexNumberLength(const_iterator pos, const_iterator end)
+{
+   const_iterator it = pos;
+   if (end - it < 2 || it[0] != L'0' || it[1] != L'x')
+      return 0;
+
+   it += 2;
+   while (it != end && isHexDigit(*it))
+      ++it;
+   if (it != end && *it == L'L')
+      ++it;
+   return it - pos;
+}
+
+// [0-9]*(\.[0-9]*)?([eE][+-]?[0-9]*)?[Li]?
+std::size_t numberLength(const_iterator pos, const_iterator end)
+{
+   const_iterator it = pos;
+   while (it != end && isDigit(*it))
+      ++it;
+
+   if (it != end && *it == L'.')
    {
+      ++it;
+      while (it != end && isDigit(*it))
+         ++it;
    }
 
-public:
-   const boost::wregex NUMBER;
-   const boost::wregex HEX_NUMBER;
-   const boost::wregex USER_OPERATOR;
-   const boost::wregex QUOTED_IDENTIFIER;
-   const boost::wregex UNTIL_END_QUOTE;
-   const boost::wregex WHITESPACE;
-   const boost::wregex COMMENT;
-};
+   if (it != end && (*it == L'e' || *it == L'E'))
+   {
+      ++it;
+      if (it != end && (*it == L'+' || *it == L'-'))
+         ++it;
+      while (it != end && isDigit(*it))
+         ++it;
+   }
+
+   if (it != end && (*it == L'L' || *it == L'i'))
+      ++it;
+
+   return it - pos;
+}
+
+// %[^%]*% and `[^`]*`
+std::size_t delimitedLength(const_iterator pos, const_iterator end)
+{
+   const_iterator it = std::find(pos + 1, end, *pos);
+   return it == end ? 0 : (it + 1) - pos;
+}
+
+// [\s\x00A0\x3000]+
+std::size_t whitespaceLength(const_iterator pos, const_iterator end)
+{
+   const_iterator it = pos;
+   while (it != end && isWhitespace(*it))
+      ++it;
+   return it - pos;
+}
+
+// #[^\n]*$ -- that is, the rest of the line, excluding the \r of a \r\n
+std::size_t commentLength(const_iterator pos, const_iterator end)
+{
+   const_iterator it = std::find(pos, end, L'\n');
+   if (it != end && it - pos > 1 && *(it - 1) == L'\r')
+      --it;
+   return it - pos;
+}
 
-TokenPatterns& tokenPatterns()
+// the next \\, ' or " (or the end)
+const_iterator findQuoteOrEscape(const_iterator pos, const_iterator end)
 {
-   static TokenPatterns instance;
-   return instance;
+   for (; pos != end; ++pos)
+   {
+      wchar_t c = *pos;
+      if (c == L'\\' || c == L'\'' || c == L'"')
+         break;
+   }
+   return pos;
 }
 
 void updatePosition(std::wstring::const_iterator pos,
@@ -81,6 +154,13 @@ void updatePosition(std::wstring::const_iterator pos,
                     std::size_t* pRow,
                     std::size_t* pColumn)
 {
+   // most tokens don't span lines
+   if (std::find(pos, pos + length, L'\n') == pos + length)
+   {
+      *pColumn += length;
+      return;
+   }
+
    std::size_t newlineCount;
    std::wstring::const_iterator it =
          string_utils::countNewlines(pos, pos + length, &newlineCount);
@@ -214,7 +294,7 @@ RToken RTokenizer::nextToken()
 
 RToken RTokenizer::matchWhitespace()
 {
-   return consumeToken(RToken::WHITESPACE, tokenLength(tokenPatterns().WHITESPACE));
+   return consumeToken(RToken::WHITESPACE, whitespaceLength(pos_, end_));
 }
 
 RToken RTokenizer::matchStringLiteral()
@@ -224,7 +304,7 @@ RToken RTokenizer::matchStringLiteral()
 
    while (!eol())
    {
-      eatUntil(tokenPatterns().UNTIL_END_QUOTE);
+      pos_ = findQuoteOrEscape(pos_, end_);
 
       if (eol())
          break ;
@@ -268,9 +348,9 @@ RToken RTokenizer::matchStringLiteral()
 
 RToken RTokenizer::matchNumber()
 {
-   std::size_t length = tokenLength(tokenPatterns().HEX_NUMBER);
+   std::size_t length = hexNumberLength(pos_, end_);
    if (length == 0)
-      length = tokenLength(tokenPatterns().NUMBER);
+      length = numberLength(pos_, end_);
 
    return consumeToken(RToken::NUMBER, length);
 }
@@ -279,7 +359,7 @@ RToken RTokenizer::matchIdentifier()
 {
    std::wstring::const_iterator start = pos_ ;
    eat();
-   while (string_utils::isalnum(peek()) || peek() == L'.' || peek() == L'_')
+   while (!eol() && isIdentifierChar(*pos_))
       eat();
    
    std::size_t row = row_;
@@ -296,7 +376,7 @@ RToken RTokenizer::matchIdentifier()
 
 RToken RTokenizer::matchQuotedIdentifier()
 {
-   std::size_t length = tokenLength(tokenPatterns().QUOTED_IDENTIFIER);
+   std::size_t length = delimitedLength(pos_, end_);
    if (length == 0)
       return consumeToken(RToken::ERR, 1);
    else
@@ -305,12 +385,12 @@ RToken RTokenizer::matchQuotedIdentifier()
 
 RToken RTokenizer::matchComment()
 {
-   return consumeToken(RToken::COMMENT, tokenLength(tokenPatterns().COMMENT));
+   return consumeToken(RToken::COMMENT, commentLength(pos_, end_));
 }
 
 RToken RTokenizer::matchUserOperator()
 {
-   std::size_t length = tokenLength(tokenPatterns().USER_OPERATOR);
+   std::size_t length = delimitedLength(pos_, end_);
    if (length == 0)
       return consumeToken(RToken::ERR, 1);
    else
@@ -402,33 +482,6 @@ wchar_t RTokenizer::eat()
    return result ;
 }
 
-std::size_t RTokenizer::tokenLength(const boost::wregex& regex)
-{
-   boost::wsmatch match;
-   std::wstring::const_iterator end = data_.end();
-   boost::match_flag_type flg = boost::match_default | boost::match_continuous;
-   if (regex_utils::search(pos_, end, match, regex, flg))
-      return match.length();
-   else
-      return 0;
-}
-
-void RTokenizer::eatUntil(const boost::wregex& regex)
-{
-   boost::wsmatch match;
-   std::wstring::const_iterator end = data_.end();
-   if (regex_utils::search(pos_, end, match, regex))
-   {
-      pos_ = match[0].first;
-   }
-   else
-   {
-      // eat all on failure to match
-      pos_ = data_.end();
-   }
-}
-
-
 RToken RTokenizer::consumeToken(RToken::TokenType tokenType,
                                 std::size_t length)
 {
@@ -460,54 +513,172 @@ RToken RTokenizer::consumeToken(RToken::TokenType tokenType,
                  column);
 }
 
-class ConversionCache
+std::string RToken::contentAsUtf8() const
 {
-public:
-   
-   typedef std::wstring key_type;
-   typedef std::string mapped_type;
-   
-   bool contains(const RToken& token) const
-   {
-      return database_.count(token.content());
-   }
-   
-   std::string& get(const RToken& token)
+   // most tokens are ASCII, which needn't go through the general conversion
+   std::string result;
+   result.reserve(length_);
+   for (std::wstring::const_iterator it = begin_, end = this->end();
+        it != end;
+        ++it)
    {
-      return database_[token.content()];
+      if (*it >= 0x80)
+         return string_utils::wideToUtf8(content());
+      result.push_back(static_cast<char>(*it));
    }
-   
-   void put(const RToken& token, const mapped_type& value)
+   return result;
+}
+
+std::string RToken::asString() const
+{
+   std::stringstream ss;
+   ss << "('" << contentAsUtf8() << "', " << row_ << ", " << column_ << ")";
+   return ss.str();
+}
+
+namespace {
+
+// follow the '[' / '[[' nesting tracked by RTokenizer::nextToken
+void updateBracketDepth(const RToken& token, std::size_t* pDepth)
+{
+   switch (token.type())
    {
-      database_[token.content()] = value;
+   case RToken::LBRACKET:
+   case RToken::LDBRACKET:
+      ++*pDepth;
+      break;
+   case RToken::RBRACKET:
+   case RToken::RDBRACKET:
+      if (*pDepth > 0)
+         --*pDepth;
+      break;
+   default:
+      break;
    }
-   
-private:
-   std::map<key_type, mapped_type> database_;
-};
+}
+
+// a '%' or '`' without a match later on (which the tokenizer looks for
+// across lines, to the end of the document)
+bool isUnmatchedDelimiter(const RToken& token)
+{
+   return token.isType(RToken::ERR) &&
+          (token.contentEquals(L'%') || token.contentEquals(L'`'));
+}
 
-ConversionCache& conversionCache()
+RToken movedToken(const RToken& token,
+                  const std::wstring& data,
+                  std::size_t offset,
+                  std::size_t row)
 {
-   static ConversionCache instance;
-   return instance;
+   return RToken(token.type(),
+                 data.begin() + offset,
+                 data.begin() + offset + token.length(),
+                 offset,
+                 row,
+                 token.column());
 }
 
-const std::string& RToken::contentAsUtf8() const
+} // anonymous namespace
+
+RTokens::RTokens(const std::wstring& code,
+                 const RTokens& previous,
+                 std::size_t offset,
+                 std::size_t removed,
+                 std::size_t inserted)
+   : tokenizer_(code),
+     dummyToken_(RToken::ERR),
+     flags_(previous.flags_),
+     reusedPrefixEnd_(0),
+     reusedSuffixBegin_(0)
 {
-   ConversionCache& cache = conversionCache();
-   if (cache.contains(*this))
-      return cache.get(*this);
+   const std::wstring& data = tokenizer_.data();
+   const Tokens& tokens = previous.tokens_;
+   std::size_t n = tokens.size();
+   tokens_.reserve(n + 2 * inserted + 16);
+   
+   // the tokenizer's only state is the '[' nesting, so we can restart it at
+   // the last line before the edit which begins outside of any brackets (and
+   // before any unmatched '%' or '`', as the edit could add its match)
+   std::size_t begin = 0;
+   std::size_t beginOffset = 0;
+   std::size_t beginRow = 0;
+   std::size_t depth = 0;
+   bool unmatched = false;
+   for (std::size_t i = 0; i < n && tokens[i].offset() < offset; ++i)
+   {
+      if (!unmatched && depth == 0 && tokens[i].column() == 0)
+      {
+         begin = i;
+         beginOffset = tokens[i].offset();
+         beginRow = tokens[i].row();
+      }
+      unmatched = unmatched || isUnmatchedDelimiter(tokens[i]);
+      updateBracketDepth(tokens[i], &depth);
+   }
+   
+   for (std::size_t i = 0; i < begin; ++i)
+      tokens_.push_back(movedToken(tokens[i], data, tokens[i].offset(), tokens[i].row()));
+   reusedPrefixEnd_ = begin;
+   
+   // re-scan until we reach a line after the edit which the previous tokens
+   // also started at (outside of brackets) -- from there on they're the same
+   tokenizer_.seekToLine(beginOffset, beginRow);
+   std::size_t editEnd = offset + inserted;
+   std::size_t next = begin;
+   depth = 0;
+   
+   RToken token;
+   do
+   {
+      std::size_t position = tokenizer_.offset();
+      if (position < editEnd ||
+          tokenizer_.isWithinBrackets() ||
+          (position > 0 && data[position - 1] != L'\n'))
+      {
+         continue;
+      }
+      
+      std::size_t previousPosition = position + removed - inserted;
+      while (next < n && tokens[next].offset() < previousPosition)
+         updateBracketDepth(tokens[next++], &depth);
+      
+      if (next < n &&
+          depth == 0 &&
+          tokens[next].offset() == previousPosition &&
+          tokens[next].column() == 0)
+      {
+         reusedSuffixBegin_ = tokens_.size();
+         std::size_t row = tokenizer_.row();
+         std::size_t previousRow = tokens[next].row();
+         for (std::size_t i = next; i < n; ++i)
+         {
+            tokens_.push_back(movedToken(tokens[i],
+                                         data,
+                                         tokens[i].offset() + inserted - removed,
+                                         tokens[i].row() + row - previousRow));
+         }
+         return;
+      }
+   }
+   while ((token = tokenizeNext()));
    
-   std::string result = string_utils::wideToUtf8(content());
-   cache.put(*this, result);
-   return cache.get(*this);
+   reusedSuffixBegin_ = tokens_.size();
 }
 
-std::string RToken::asString() const
+RToken RTokens::tokenizeNext()
 {
-   std::stringstream ss;
-   ss << "('" << contentAsUtf8() << "', " << row_ << ", " << column_ << ")";
-   return ss.str();
+   RToken token = tokenizer_.nextToken();
+   if (!token)
+      return token;
+   
+   if ((flags_ & StripWhitespace) && token.type() == RToken::WHITESPACE)
+      return token;
+   
+   if ((flags_ & StripComments) && token.type() == RToken::COMMENT)
+      return token;
+   
+   push_back(token);
+   return token;
 }
 
 } // namespace r_util
@@ -0,0 +1,194 @@
+/*
+ * RTokenizerBenchmark.cpp
+ *
+ * Copyright (C) 2009-17 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+// Measures R tokenizer throughput (in MB/s of UTF-8 source) over a set of R
+// source files, e.g. those of the base package:
+//
+//    rstudio-core-tokenizer-benchmark ~/R-3.4.0/src/library/base/R
+//
+// Each argument is either an R source file or a directory which is searched
+// (recursively) for them.
+
+#include <iostream>
+#include <iomanip>
+
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/function.hpp>
+
+#include <core/Error.hpp>
+#include <core/FilePath.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/Log.hpp>
+#include <core/StringUtils.hpp>
+#include <core/system/System.hpp>
+
+#include <core/r_util/RTokenizer.hpp>
+
+using namespace rstudio;
+using namespace rstudio::core;
+
+namespace {
+
+// each benchmark is repeated for at least this long
+const long kMinDurationMs = 2000;
+
+bool isRSourceFile(const FilePath& filePath)
+{
+   std::string ext = filePath.extensionLowerCase();
+   return !filePath.isDirectory() && (ext == ".r" || ext == ".q");
+}
+
+bool addSourceFile(int, const FilePath& filePath, std::vector<FilePath>* pFiles)
+{
+   if (isRSourceFile(filePath))
+      pFiles->push_back(filePath);
+   return true;
+}
+
+std::size_t convert(const std::vector<std::string>& sources)
+{
+   std::size_t count = 0;
+   for (std::size_t i = 0; i < sources.size(); i++)
+      count += string_utils::utf8ToWide(sources[i]).size();
+   return count;
+}
+
+std::size_t tokenize(const std::vector<std::wstring>& sources)
+{
+   std::size_t count = 0;
+   for (std::size_t i = 0; i < sources.size(); i++)
+   {
+      r_util::RTokenizer tokenizer(sources[i]);
+      while (tokenizer.nextToken())
+         count++;
+   }
+   return count;
+}
+
+std::size_t tokens(const std::vector<std::string>& sources)
+{
+   std::size_t count = 0;
+   for (std::size_t i = 0; i < sources.size(); i++)
+   {
+      r_util::RTokens rTokens(string_utils::utf8ToWide(sources[i]),
+                              r_util::RTokens::StripWhitespace |
+                              r_util::RTokens::StripComments);
+      count += rTokens.size();
+   }
+   return count;
+}
+
+void run(const std::string& name,
+         const boost::function<std::size_t()>& benchmark,
+         std::size_t bytes)
+{
+   using namespace boost::posix_time;
+
+   // warm up
+   std::size_t count = benchmark();
+
+   int iterations = 0;
+   ptime start = microsec_clock::universal_time();
+   time_duration elapsed;
+   do
+   {
+      benchmark();
+      iterations++;
+      elapsed = microsec_clock::universal_time() - start;
+   } while (elapsed.total_milliseconds() < kMinDurationMs);
+
+   double seconds = elapsed.total_microseconds() / 1000000.0 / iterations;
+   std::cout << std::left << std::setw(10) << name << std::right
+             << std::fixed << std::setprecision(1)
+             << std::setw(10) << (bytes / seconds / (1024 * 1024)) << " MB/s"
+             << std::setw(12) << (seconds * 1000) << " ms"
+             << std::setw(12) << count << std::endl;
+}
+
+} // anonymous namespace
+
+int main(int argc, char * argv[])
+{
+   try
+   {
+      initializeStderrLog("rstudio-core-tokenizer-benchmark",
+                          core::system::kLogLevelWarning);
+
+      if (argc < 2)
+      {
+         std::cerr << "usage: " << argv[0] << " <file or directory>..."
+                   << std::endl;
+         return EXIT_FAILURE;
+      }
+
+      std::vector<FilePath> files;
+      for (int i = 1; i < argc; i++)
+      {
+         FilePath path(argv[i]);
+         if (path.isDirectory())
+         {
+            Error error = path.childrenRecursive(
+                     boost::bind(addSourceFile, _1, _2, &files));
+            if (error)
+               LOG_ERROR(error);
+         }
+         else if (path.exists())
+         {
+            files.push_back(path);
+         }
+      }
+
+      std::vector<std::string> sources;
+      std::vector<std::wstring> wideSources;
+      std::size_t bytes = 0;
+      for (std::size_t i = 0; i < files.size(); i++)
+      {
+         std::string source;
+         Error error = readStringFromFile(files[i], &source);
+         if (error)
+         {
+            LOG_ERROR(error);
+            continue;
+         }
+         bytes += source.size();
+         sources.push_back(source);
+         wideSources.push_back(string_utils::utf8ToWide(source));
+      }
+
+      if (bytes == 0)
+      {
+         std::cerr << "no R source files found" << std::endl;
+         return EXIT_FAILURE;
+      }
+
+      std::cout << sources.size() << " files, " << bytes << " bytes"
+                << std::endl << std::endl;
+
+      // convert:  UTF-8 to wide conversion (count is characters)
+      // tokenize: RTokenizer over wide source (count is tokens)
+      // tokens:   RTokens from UTF-8 source, as used by the source index
+      //           and diagnostics (count is tokens kept)
+      run("convert", boost::bind(convert, boost::cref(sources)), bytes);
+      run("tokenize", boost::bind(tokenize, boost::cref(wideSources)), bytes);
+      run("tokens", boost::bind(tokens, boost::cref(sources)), bytes);
+
+      return EXIT_SUCCESS;
+   }
+   CATCH_UNEXPECTED_EXCEPTION
+
+   // if we got this far we had an unexpected exception
+   return EXIT_FAILURE;
+}
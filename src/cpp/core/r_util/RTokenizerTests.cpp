@@ -231,6 +231,44 @@ void testWhitespace()
 }
 
 
+bool sameTokens(const RTokens& lhs, const RTokens& rhs)
+{
+   if (lhs.size() != rhs.size())
+      return false;
+   
+   for (std::size_t i = 0; i < lhs.size(); ++i)
+   {
+      const RToken& l = lhs.at(i);
+      const RToken& r = rhs.at(i);
+      if (l.type() != r.type() ||
+          l.offset() != r.offset() ||
+          l.row() != r.row() ||
+          l.column() != r.column() ||
+          l.content() != r.content())
+      {
+         return false;
+      }
+   }
+   
+   return true;
+}
+
+// apply an edit to 'code' and check that re-tokenizing it incrementally
+// gives the same tokens as tokenizing it from scratch
+bool verifyEdit(const std::wstring& code,
+                std::size_t offset,
+                std::size_t removed,
+                const std::wstring& inserted,
+                int flags = RTokens::None)
+{
+   std::wstring edited = code;
+   edited.replace(offset, removed, inserted);
+   
+   RTokens previous(code, flags);
+   RTokens incremental(edited, previous, offset, removed, inserted.length());
+   return sameTokens(incremental, RTokens(edited, flags));
+}
+
 } // anonymous namespace
 
 
@@ -269,6 +307,45 @@ context("RTokenizer")
       expect_true(rTokens.at(2).isType(RToken::OPER));
       expect_true(rTokens.at(2).contentEquals(L"**"));
    }
+   
+   test_that("Edited code is re-tokenized incrementally")
+   {
+      std::wstring code =
+            L"x <- list(a = 1)\n"
+            L"y <- x[[\"a\"]]\n"
+            L"m <- x %in% y %o\n"
+            L"n <- `q\n"
+            L"# a comment\n"
+            L"f <- function(a, b = 2) {\n"
+            L"   a + b\n"
+            L"}\n"
+            L"z <- x[\n"
+            L"1]\n"
+            L"s <- 'a\nb'\n"
+            L"f(y, z)\n";
+      
+      // edits within a line, across lines, and which open or close
+      // strings, brackets, and user operators
+      expect_true(verifyEdit(code, 0, 0, L"w <- 1\n"));
+      expect_true(verifyEdit(code, code.find(L"<-"), 2, L"="));
+      expect_true(verifyEdit(code, code.find(L"y <-"), 0, L"\n\n"));
+      expect_true(verifyEdit(code, code.find(L"# a"), 1, L"# b\n"));
+      expect_true(verifyEdit(code, code.find(L"a + b"), 0, L"'"));
+      expect_true(verifyEdit(code, code.find(L"x[\n"), 2, L"x[["));
+      expect_true(verifyEdit(code, code.find(L"'a"), 1, L""));
+      expect_true(verifyEdit(code, code.length(), 0, L"x <- c(\n1, 2)\n"));
+      expect_true(verifyEdit(code, 0, code.length(), L""));
+      
+      // every single character deletion and insertion
+      for (std::size_t i = 0; i < code.length(); ++i)
+      {
+         expect_true(verifyEdit(code, i, 1, L"", RTokens::StripComments));
+         expect_true(verifyEdit(code, i, 0, L"\"", RTokens::StripComments));
+         expect_true(verifyEdit(code, i, 0, L"]\n", RTokens::StripWhitespace));
+         expect_true(verifyEdit(code, i, 0, L"%"));
+         expect_true(verifyEdit(code, i, 0, L"`"));
+      }
+   }
 }
 
 } // namespace r_util
@@ -0,0 +1,277 @@
+/*
+ * FileTreeSnapshot.cpp
+ *
+ * Copyright (C) 2009-17 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <core/system/FileTreeSnapshot.hpp>
+
+#include <algorithm>
+
+#include <boost/unordered_map.hpp>
+
+namespace rstudio {
+namespace core {
+namespace system {
+
+namespace {
+
+const boost::uint32_t kNoParent = static_cast<boost::uint32_t>(-1);
+
+bool nodePathLessThan(const tree<FileInfo>::sibling_iterator& a,
+                      const tree<FileInfo>::sibling_iterator& b)
+{
+   return fileInfoPathLessThan(*a, *b);
+}
+
+// the name of a file within its parent directory
+std::string fileName(const std::string& path)
+{
+   std::size_t pos = path.find_last_of('/');
+   return pos == std::string::npos ? path : path.substr(pos + 1);
+}
+
+void addEvents(const FileTreeSnapshot& snapshot,
+               std::size_t index,
+               FileChangeEvent::Type type,
+               const boost::function<bool(const FileInfo&)>& filter,
+               std::vector<FileChangeEvent>* pEvents)
+{
+   for (std::size_t i = index; i < snapshot.subtreeEnd(index); i++)
+   {
+      FileInfo fileInfo = snapshot.fileInfo(i);
+      if (!filter || filter(fileInfo))
+         pEvents->push_back(FileChangeEvent(type, fileInfo));
+   }
+}
+
+// diff two entries with the same path
+void collectChanges(const FileTreeSnapshot& prev,
+                    std::size_t prevIndex,
+                    const FileTreeSnapshot& curr,
+                    std::size_t currIndex,
+                    const boost::function<bool(const FileInfo&)>& filter,
+                    std::vector<FileChangeEvent>* pEvents)
+{
+   if (prev.lastWriteTime(prevIndex) != curr.lastWriteTime(currIndex))
+   {
+      FileInfo fileInfo = curr.fileInfo(currIndex);
+      if (!filter || filter(fileInfo))
+      {
+         pEvents->push_back(FileChangeEvent(FileChangeEvent::FileModified,
+                                            fileInfo));
+      }
+   }
+
+   // merge the (sorted) children
+   std::size_t prevChild = prevIndex + 1;
+   std::size_t prevEnd = prev.subtreeEnd(prevIndex);
+   std::size_t currChild = currIndex + 1;
+   std::size_t currEnd = curr.subtreeEnd(currIndex);
+   while (prevChild < prevEnd || currChild < currEnd)
+   {
+      int comp;
+      if (prevChild == prevEnd)
+         comp = 1;
+      else if (currChild == currEnd)
+         comp = -1;
+      else
+         comp = prev.compare(prevChild, curr, currChild);
+
+      if (comp == 0)
+      {
+         collectChanges(prev, prevChild, curr, currChild, filter, pEvents);
+         prevChild = prev.subtreeEnd(prevChild);
+         currChild = curr.subtreeEnd(currChild);
+      }
+      else if (comp < 0)
+      {
+         addEvents(prev, prevChild, FileChangeEvent::FileRemoved, filter,
+                   pEvents);
+         prevChild = prev.subtreeEnd(prevChild);
+      }
+      else
+      {
+         addEvents(curr, currChild, FileChangeEvent::FileAdded, filter,
+                   pEvents);
+         currChild = curr.subtreeEnd(currChild);
+      }
+   }
+}
+
+} // anonymous namespace
+
+struct FileTreeSnapshot::Builder
+{
+   explicit Builder(FileTreeSnapshot* pSnapshot)
+      : pSnapshot_(pSnapshot)
+   {
+   }
+
+   void add(const tree<FileInfo>::iterator_base& node,
+            boost::uint32_t parent)
+   {
+      const FileInfo& fileInfo = *node;
+      std::string path = fileInfo.absolutePath();
+
+      Entry entry;
+      entry.parent = parent;
+      entry.end = 0;
+      entry.size = fileInfo.size();
+      entry.lastWriteTime = fileInfo.lastWriteTime();
+      entry.isDirectory = fileInfo.isDirectory();
+      entry.isSymlink = fileInfo.isSymlink();
+      intern(parent == kNoParent ? path : fileName(path), &entry);
+
+      boost::uint32_t index =
+            static_cast<boost::uint32_t>(pSnapshot_->entries_.size());
+      pSnapshot_->entries_.push_back(entry);
+
+      // children are kept in path order so that snapshots can be merged
+      std::vector<tree<FileInfo>::sibling_iterator> children;
+      for (tree<FileInfo>::sibling_iterator it = node.begin();
+           it != node.end();
+           ++it)
+      {
+         children.push_back(it);
+      }
+      std::sort(children.begin(), children.end(), nodePathLessThan);
+      for (std::size_t i = 0; i < children.size(); i++)
+         add(children[i], index);
+
+      pSnapshot_->entries_[index].end =
+            static_cast<boost::uint32_t>(pSnapshot_->entries_.size());
+   }
+
+   void intern(const std::string& name, Entry* pEntry)
+   {
+      std::pair<NameIndex::iterator, bool> result = index_.insert(
+               std::make_pair(name, pSnapshot_->names_.size()));
+      if (result.second)
+         pSnapshot_->names_.append(name);
+
+      pEntry->nameOffset = result.first->second;
+      pEntry->nameLength = static_cast<boost::uint32_t>(name.length());
+   }
+
+   typedef boost::unordered_map<std::string, boost::uint32_t> NameIndex;
+
+   FileTreeSnapshot* pSnapshot_;
+   NameIndex index_;
+};
+
+FileTreeSnapshot::FileTreeSnapshot(const tree<FileInfo>::iterator_base& root)
+{
+   Builder builder(this);
+   builder.add(root, kNoParent);
+
+   // trim the slack from growing
+   std::vector<Entry>(entries_).swap(entries_);
+}
+
+FileInfo FileTreeSnapshot::fileInfo(std::size_t index) const
+{
+   const Entry& entry = entries_[index];
+   return FileInfo(absolutePath(index),
+                   entry.isDirectory,
+                   entry.size,
+                   entry.lastWriteTime,
+                   entry.isSymlink);
+}
+
+std::string FileTreeSnapshot::absolutePath(std::size_t index) const
+{
+   // collect the names from the root down
+   std::vector<const Entry*> ancestors;
+   for (boost::uint32_t i = static_cast<boost::uint32_t>(index);
+        i != kNoParent;
+        i = entries_[i].parent)
+   {
+      ancestors.push_back(&entries_[i]);
+   }
+
+   std::string path;
+   for (std::vector<const Entry*>::reverse_iterator it = ancestors.rbegin();
+        it != ancestors.rend();
+        ++it)
+   {
+      if (!path.empty() && path[path.length() - 1] != '/')
+         path.push_back('/');
+      path.append(names_, (*it)->nameOffset, (*it)->nameLength);
+   }
+   return path;
+}
+
+int FileTreeSnapshot::compare(std::size_t index,
+                              const FileTreeSnapshot& other,
+                              std::size_t otherIndex) const
+{
+   const Entry& entry = entries_[index];
+   const Entry& otherEntry = other.entries_[otherIndex];
+
+   // as with strcmp on the full paths (which share the parent's path)
+   int result = names_.compare(entry.nameOffset,
+                               entry.nameLength,
+                               other.names_,
+                               otherEntry.nameOffset,
+                               otherEntry.nameLength);
+   if (result != 0)
+      return result;
+
+   if (entry.isDirectory == otherEntry.isDirectory)
+      return 0;
+
+   return entry.isDirectory ? -1 : 1;
+}
+
+std::size_t FileTreeSnapshot::memoryUsage() const
+{
+   return sizeof(FileTreeSnapshot) +
+          entries_.capacity() * sizeof(Entry) +
+          names_.capacity();
+}
+
+void FileTreeSnapshot::toTree(tree<FileInfo>* pTree) const
+{
+   pTree->clear();
+   if (empty())
+      return;
+
+   std::vector<tree<FileInfo>::iterator> nodes;
+   nodes.reserve(entries_.size());
+   nodes.push_back(pTree->set_head(fileInfo(0)));
+   for (std::size_t i = 1; i < entries_.size(); i++)
+      nodes.push_back(pTree->append_child(nodes[entries_[i].parent],
+                                          fileInfo(i)));
+}
+
+void collectFileChangeEvents(
+                     const FileTreeSnapshot& prev,
+                     const FileTreeSnapshot& curr,
+                     const boost::function<bool(const FileInfo&)>& filter,
+                     std::vector<FileChangeEvent>* pEvents)
+{
+   if (prev.empty() || curr.empty() || prev.compare(0, curr, 0) != 0)
+   {
+      if (!prev.empty())
+         addEvents(prev, 0, FileChangeEvent::FileRemoved, filter, pEvents);
+      if (!curr.empty())
+         addEvents(curr, 0, FileChangeEvent::FileAdded, filter, pEvents);
+      return;
+   }
+
+   collectChanges(prev, 0, curr, 0, filter, pEvents);
+}
+
+} // namespace system
+} // namespace core
+} // namespace rstudio
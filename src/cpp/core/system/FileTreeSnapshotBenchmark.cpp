@@ -0,0 +1,200 @@
+/*
+ * FileTreeSnapshotBenchmark.cpp
+ *
+ * Copyright (C) 2009-17 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+// Compares the memory held by a scanned file tree with that of its
+// snapshot, and the time taken to diff two scans of it in each form, e.g.
+// for a large project:
+//
+//    rstudio-core-snapshot-benchmark ~/projects/rstudio
+//
+// The second scan is simulated by touching every 50th file of the first.
+
+#include <iostream>
+#include <iomanip>
+
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/function.hpp>
+
+#include <core/Error.hpp>
+#include <core/FilePath.hpp>
+#include <core/Log.hpp>
+#include <core/system/System.hpp>
+#include <core/system/FileScanner.hpp>
+#include <core/system/FileTreeSnapshot.hpp>
+
+using namespace rstudio;
+using namespace rstudio::core;
+
+namespace {
+
+// each benchmark is repeated for at least this long
+const long kMinDurationMs = 2000;
+
+// every this many files is modified between the scans
+const std::size_t kModifiedInterval = 50;
+
+std::size_t stringMemoryUsage(const std::string& str)
+{
+   // strings within the small string buffer don't allocate
+   std::string empty;
+   return str.capacity() > empty.capacity() ? str.capacity() + 1 : 0;
+}
+
+std::size_t treeMemoryUsage(const tree<FileInfo>& fileTree)
+{
+   std::size_t bytes = sizeof(tree<FileInfo>);
+   for (tree<FileInfo>::iterator it = fileTree.begin();
+        it != fileTree.end();
+        ++it)
+   {
+      bytes += sizeof(tree_node_<FileInfo>) +
+               stringMemoryUsage(it->absolutePath());
+   }
+   return bytes;
+}
+
+void touchFiles(tree<FileInfo>* pTree)
+{
+   std::size_t count = 0;
+   for (tree<FileInfo>::iterator it = pTree->begin(); it != pTree->end(); ++it)
+   {
+      if (it->isDirectory() || (count++ % kModifiedInterval) != 0)
+         continue;
+
+      *it = FileInfo(it->absolutePath(),
+                     false,
+                     it->size(),
+                     it->lastWriteTime() + 1,
+                     it->isSymlink());
+   }
+}
+
+std::size_t snapshot(const tree<FileInfo>& fileTree)
+{
+   system::FileTreeSnapshot snapshot(fileTree.begin());
+   return snapshot.size();
+}
+
+std::size_t diffTrees(const tree<FileInfo>& prev, const tree<FileInfo>& curr)
+{
+   std::vector<system::FileChangeEvent> events;
+   system::collectFileChangeEvents(prev.begin(), prev.end(),
+                                   curr.begin(), curr.end(),
+                                   &events);
+   return events.size();
+}
+
+std::size_t diffSnapshots(const system::FileTreeSnapshot& prev,
+                          const system::FileTreeSnapshot& curr)
+{
+   std::vector<system::FileChangeEvent> events;
+   system::collectFileChangeEvents(prev, curr, &events);
+   return events.size();
+}
+
+void run(const std::string& name,
+         const boost::function<std::size_t()>& benchmark)
+{
+   using namespace boost::posix_time;
+
+   // warm up
+   std::size_t count = benchmark();
+
+   int iterations = 0;
+   ptime start = microsec_clock::universal_time();
+   time_duration elapsed;
+   do
+   {
+      benchmark();
+      iterations++;
+      elapsed = microsec_clock::universal_time() - start;
+   } while (elapsed.total_milliseconds() < kMinDurationMs);
+
+   double seconds = elapsed.total_microseconds() / 1000000.0 / iterations;
+   std::cout << std::left << std::setw(16) << name << std::right
+             << std::fixed << std::setprecision(2)
+             << std::setw(12) << (seconds * 1000) << " ms"
+             << std::setw(12) << count << std::endl;
+}
+
+void printMemory(const std::string& name, std::size_t bytes, std::size_t files)
+{
+   std::cout << std::left << std::setw(16) << name << std::right
+             << std::fixed << std::setprecision(1)
+             << std::setw(12) << (bytes / (1024.0 * 1024)) << " MB"
+             << std::setw(12) << (static_cast<double>(bytes) / files)
+             << " bytes/file" << std::endl;
+}
+
+} // anonymous namespace
+
+int main(int argc, char * argv[])
+{
+   try
+   {
+      initializeStderrLog("rstudio-core-snapshot-benchmark",
+                          core::system::kLogLevelWarning);
+
+      if (argc != 2 || !FilePath(argv[1]).isDirectory())
+      {
+         std::cerr << "usage: " << argv[0] << " <directory>" << std::endl;
+         return EXIT_FAILURE;
+      }
+
+      tree<FileInfo> prevTree;
+      system::FileScannerOptions options;
+      options.recursive = true;
+      Error error = system::scanFiles(FileInfo(FilePath(argv[1])),
+                                      options,
+                                      &prevTree);
+      if (error)
+      {
+         LOG_ERROR(error);
+         return EXIT_FAILURE;
+      }
+
+      tree<FileInfo> currTree = prevTree;
+      touchFiles(&currTree);
+
+      system::FileTreeSnapshot prevSnapshot(prevTree.begin());
+      system::FileTreeSnapshot currSnapshot(currTree.begin());
+
+      std::size_t files = prevSnapshot.size();
+      std::cout << files << " files" << std::endl << std::endl;
+
+      // memory held by the tree a monitor would otherwise keep between scans
+      printMemory("tree", treeMemoryUsage(prevTree), files);
+      printMemory("snapshot", prevSnapshot.memoryUsage(), files);
+      std::cout << std::endl;
+
+      // snapshot:       building a snapshot from a scan (count is entries)
+      // diff-tree:      diffing two scanned trees (count is events)
+      // diff-snapshot:  diffing their snapshots (count is events)
+      run("snapshot", boost::bind(snapshot, boost::cref(currTree)));
+      run("diff-tree", boost::bind(diffTrees,
+                                   boost::cref(prevTree),
+                                   boost::cref(currTree)));
+      run("diff-snapshot", boost::bind(diffSnapshots,
+                                       boost::cref(prevSnapshot),
+                                       boost::cref(currSnapshot)));
+
+      return EXIT_SUCCESS;
+   }
+   CATCH_UNEXPECTED_EXCEPTION
+
+   // if we got this far we had an unexpected exception
+   return EXIT_FAILURE;
+}
@@ -0,0 +1,141 @@
+/*
+ * FileTreeSnapshotTests.cpp
+ *
+ * Copyright (C) 2009-17 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <core/system/FileTreeSnapshot.hpp>
+
+#include <set>
+#include <sstream>
+
+#define RSTUDIO_NO_TESTTHAT_ALIASES
+#include <tests/TestThat.hpp>
+
+namespace rstudio {
+namespace core {
+namespace tests {
+
+namespace {
+
+FileInfo file(const std::string& path, std::time_t lastWriteTime = 1)
+{
+   return FileInfo(path, false, 10, lastWriteTime);
+}
+
+FileInfo dir(const std::string& path)
+{
+   return FileInfo(path, true);
+}
+
+// /project
+//    R/
+//       a.R, b.R
+//    R-old/
+//       a.R
+//    DESCRIPTION
+void buildTree(tree<FileInfo>* pTree)
+{
+   tree<FileInfo>::iterator root = pTree->set_head(dir("/project"));
+   tree<FileInfo>::iterator r = pTree->append_child(root, dir("/project/R"));
+   pTree->append_child(r, file("/project/R/a.R"));
+   pTree->append_child(r, file("/project/R/b.R"));
+   tree<FileInfo>::iterator old = pTree->append_child(root,
+                                                      dir("/project/R-old"));
+   pTree->append_child(old, file("/project/R-old/a.R"));
+   pTree->append_child(root, file("/project/DESCRIPTION"));
+}
+
+std::set<std::string> eventSet(
+                     const std::vector<system::FileChangeEvent>& events)
+{
+   std::set<std::string> result;
+   for (std::size_t i = 0; i < events.size(); i++)
+   {
+      std::ostringstream ostr;
+      ostr << events[i];
+      result.insert(ostr.str());
+   }
+   return result;
+}
+
+} // anonymous namespace
+
+TEST_CASE("File Tree Snapshots")
+{
+   tree<FileInfo> prevTree;
+   buildTree(&prevTree);
+   system::FileTreeSnapshot prev(prevTree.begin());
+
+   SECTION("Snapshots reproduce their tree")
+   {
+      CHECK(prev.size() == prevTree.size());
+      CHECK(prev.fileInfo(0) == dir("/project"));
+
+      tree<FileInfo> rebuilt;
+      prev.toTree(&rebuilt);
+      std::vector<FileInfo> expected(prevTree.begin(), prevTree.end());
+      std::vector<FileInfo> actual(rebuilt.begin(), rebuilt.end());
+      std::sort(expected.begin(), expected.end(), fileInfoPathLessThan);
+      std::sort(actual.begin(), actual.end(), fileInfoPathLessThan);
+      CHECK(actual == expected);
+   }
+
+   SECTION("Identical snapshots have no changes")
+   {
+      std::vector<system::FileChangeEvent> events;
+      system::collectFileChangeEvents(prev, prev, &events);
+      CHECK(events.empty());
+   }
+
+   SECTION("Changes match those found by sorting the trees")
+   {
+      tree<FileInfo> currTree;
+      buildTree(&currTree);
+      tree<FileInfo>::iterator root = currTree.begin();
+
+      // modify a.R, remove R-old (and its contents), add NEWS and R/c.R
+      tree<FileInfo>::sibling_iterator r = currTree.begin(root);
+      currTree.replace(currTree.begin(r), file("/project/R/a.R", 2));
+      currTree.append_child(r, file("/project/R/c.R"));
+      tree<FileInfo>::sibling_iterator old = r;
+      ++old;
+      currTree.erase(old);
+      currTree.append_child(root, file("/project/NEWS"));
+
+      std::vector<system::FileChangeEvent> expected;
+      system::collectFileChangeEvents(prevTree.begin(),
+                                      prevTree.end(),
+                                      currTree.begin(),
+                                      currTree.end(),
+                                      &expected);
+
+      std::vector<system::FileChangeEvent> actual;
+      system::FileTreeSnapshot curr(currTree.begin());
+      system::collectFileChangeEvents(prev, curr, &actual);
+
+      CHECK(actual.size() == 5);
+      CHECK(eventSet(actual) == eventSet(expected));
+   }
+
+   SECTION("Entries are in sorted pre-order")
+   {
+      CHECK(prev.absolutePath(1) == "/project/DESCRIPTION");
+      CHECK(prev.absolutePath(2) == "/project/R");
+      CHECK(prev.subtreeEnd(2) == 5);
+      CHECK(prev.absolutePath(6) == "/project/R-old/a.R");
+   }
+}
+
+} // namespace tests
+} // namespace core
+} // namespace rstudio
@@ -16,127 +16,116 @@
 #include <core/system/FileScanner.hpp>
 
 #include <dirent.h>
+#include <fcntl.h>
 #include <sys/stat.h>
 
+#include <algorithm>
+#include <deque>
+
+#include <boost/bind.hpp>
 #include <boost/foreach.hpp>
 
 #include <core/Error.hpp>
 #include <core/Log.hpp>
+#include <core/Thread.hpp>
 #include <core/FilePath.hpp>
 #include <core/BoostThread.hpp>
 
-#include "config.h"
-
 namespace rstudio {
 namespace core {
 namespace system {
 
 namespace {
 
-#if defined(__APPLE__) && !defined(HAVE_SCANDIR_POSIX)
-int entryFilter(struct dirent *entry)
-#else
-int entryFilter(const struct dirent *entry)
-#endif
-{
-   if (::strcmp(entry->d_name, ".") == 0 || ::strcmp(entry->d_name, "..") == 0)
-      return 0;
-   else
-      return 1;
-}
+// threads used for parallel scans. scanning is dominated by waiting on the
+// file system (particularly network file systems) rather than cpu so this
+// is independent of the number of cores
+const int kParallelScanThreads = 8;
 
-// note: because R may change LC_COLLATE, we cannot
-// use strcoll (otherwise we run into race issues where
-// the file monitor attempts to access LC_COLLATE just as
-// R is replacing it). to avoid this, we use strcmp and
-// don't sort according to locale.
-#if !defined(HAVE_SCANDIR_POSIX)
-int alphasort(const void* voidlhs, const void* voidrhs)
-{
-   const dirent** lhs = (const dirent**)voidlhs;
-   const dirent** rhs = (const dirent**)voidrhs;
-#else
-int alphasort(const dirent** lhs, const dirent** rhs)
+// directories which must be waiting to be scanned before threads are started
+// (a rescan of a single directory, e.g. one the file monitor saw change, is
+// typically only a handful of directories, which one thread gets through
+// faster than it could start the others)
+const std::size_t kParallelScanMinDirs = 16;
+
+struct DirEntry
 {
-#endif
-   return strcmp((*lhs)->d_name, (*rhs)->d_name);
-}
+   // note: because R may change LC_COLLATE, we cannot
+   // use strcoll (otherwise we run into race issues where
+   // the file monitor attempts to access LC_COLLATE just as
+   // R is replacing it). to avoid this, we compare bytes and
+   // don't sort according to locale.
+   bool operator<(const DirEntry& other) const
+   {
+      return name < other.name;
+   }
 
-// wrapper for scandir api
-Error scanDir(const std::string& dirPath, std::vector<std::string>* pNames)
+   std::string name;
+   bool isDirectory;
+};
+
+// read the entries of a directory (sorted by name) along with their
+// attributes. where readdir reports the type of an entry we don't stat
+// subdirectories, and other entries are stat-ed relative to the open
+// directory, which saves path lookups (round trips on network drives)
+Error readDirectory(const std::string& dirPath, std::vector<FileInfo>* pFiles)
 {
-   // read directory contents into namelist
-   struct dirent **namelist;
-   int entries = ::scandir(dirPath.c_str(),
-                           &namelist,
-                           entryFilter,
-                           alphasort);
-   if (entries == -1)
+   DIR* pDir = ::opendir(dirPath.c_str());
+   if (pDir == NULL)
    {
       Error error = systemError(errno, ERROR_LOCATION);
       error.addProperty("path", dirPath);
       return error;
    }
 
-   // extract the namelist then free it
-   for(int i=0; i<entries; i++)
+   std::vector<DirEntry> entries;
+   while (true)
    {
-      // get the name (then free it)
-      std::string name(namelist[i]->d_name,
-#ifdef __APPLE__
-                       namelist[i]->d_namlen);
+      errno = 0;
+      struct dirent* pEntry = ::readdir(pDir);
+      if (pEntry == NULL)
+         break;
+
+      if (::strcmp(pEntry->d_name, ".") == 0 ||
+          ::strcmp(pEntry->d_name, "..") == 0)
+         continue;
+
+      DirEntry entry;
+      entry.name = pEntry->d_name;
+#ifdef DT_DIR
+      entry.isDirectory = pEntry->d_type == DT_DIR;
 #else
-                       namelist[i]->d_reclen);
+      entry.isDirectory = false;
 #endif
-      ::free(namelist[i]);
-
-      // add to the vector
-      pNames->push_back(name);
+      entries.push_back(entry);
    }
-   ::free(namelist);
 
-   return Success();
-}
-
-} // anonymous namespace
-
-Error scanFiles(const tree<FileInfo>::iterator_base& fromNode,
-                const FileScannerOptions& options,
-                tree<FileInfo>* pTree)
-{
-   // clear all existing
-   pTree->erase_children(fromNode);
-
-   // create FilePath for root
-   FilePath rootPath(fromNode->absolutePath());
-
-   // yield if requested (only applies to recursive scans)
-   if (options.recursive && options.yield)
-      boost::this_thread::yield();
-
-   // call onBeforeScanDir hook
-   if (options.onBeforeScanDir)
+   if (errno != 0)
    {
-      Error error = options.onBeforeScanDir(*fromNode);
-      if (error)
-         return error;
+      Error error = systemError(errno, ERROR_LOCATION);
+      error.addProperty("path", dirPath);
+      ::closedir(pDir);
+      return error;
    }
 
-   // read directory contents
-   std::vector<std::string> names;
-   Error error = scanDir(fromNode->absolutePath(), &names);
-   if (error)
-      return error;
+   std::sort(entries.begin(), entries.end());
 
-   // iterate over the names
-   BOOST_FOREACH(const std::string& name, names)
+   FilePath rootPath(dirPath);
+   int dirFd = ::dirfd(pDir);
+   BOOST_FOREACH(const DirEntry& entry, entries)
    {
       // compute the path
-      std::string path = rootPath.childPath(name).absolutePath();
+      std::string path = rootPath.childPath(entry.name).absolutePath();
+
+      if (entry.isDirectory)
+      {
+         pFiles->push_back(FileInfo(path, true, false));
+         continue;
+      }
 
       // get the attributes
       struct stat st;
-      int res = ::lstat(path.c_str(), &st);
+      int res = ::fstatat(dirFd, entry.name.c_str(), &st, AT_SYMLINK_NOFOLLOW);
       if (res == -1)
       {
          if (errno != ENOENT && errno != EACCES)
@@ -149,25 +138,235 @@ Error scanFiles(const tree<FileInfo>::iterator_base& fromNode,
       }
 
       // create the FileInfo
-      FileInfo fileInfo;
       bool isSymlink = S_ISLNK(st.st_mode);
       if (S_ISDIR(st.st_mode))
       {
-         fileInfo = FileInfo(path, true, isSymlink);
+         pFiles->push_back(FileInfo(path, true, isSymlink));
       }
       else
       {
-         fileInfo = FileInfo(path,
-                             false,
-                             st.st_size,
+         pFiles->push_back(FileInfo(path,
+                                    false,
+                                    st.st_size,
 #ifdef __APPLE__
-                             st.st_mtimespec.tv_sec,
+                                    st.st_mtimespec.tv_sec,
 #else
-                             st.st_mtime,
+                                    st.st_mtime,
 #endif
-                             isSymlink);
+                                    isSymlink));
+      }
+   }
+
+   ::closedir(pDir);
+   return Success();
+}
+
+// recursive scan in which subdirectories are read concurrently (once there
+// are enough of them queued). the callbacks are still invoked one at a time
+// (though from the scanning threads and in no particular order) and the
+// children of each directory are added to the tree together, in order
+class ParallelScan : boost::noncopyable
+{
+public:
+   ParallelScan(const FileScannerOptions& options, tree<FileInfo>* pTree)
+      : options_(options), pTree_(pTree), pending_(0), stopped_(false)
+   {
+   }
+
+   void run(const std::vector<tree<FileInfo>::iterator_base>& dirs)
+   {
+      // no other threads are running yet so the queue needn't be locked
+      queue_.insert(queue_.end(), dirs.begin(), dirs.end());
+      pending_ = queue_.size();
+
+      // scan on this thread alone until the queue has grown large enough to
+      // be worth sharing out (small scans never start any threads)
+      while (pending_ > 0 && pending_ < kParallelScanMinDirs)
+      {
+         tree<FileInfo>::iterator_base dir = queue_.front();
+         queue_.pop_front();
+         scanQueued(dir);
+      }
+
+      if (pending_ == 0)
+         return;
+
+      boost::thread_group threads;
+      for (int i = 1; i < kParallelScanThreads; i++)
+      {
+         try
+         {
+            threads.create_thread(boost::bind(&ParallelScan::work, this));
+         }
+         catch(const boost::thread_resource_error& e)
+         {
+            // we can still scan with fewer threads
+            LOG_ERROR(Error(boost::thread_error::ec_from_exception(e),
+                            ERROR_LOCATION));
+            break;
+         }
+      }
+
+      // the scanning threads reference this object and the tree, so they
+      // must finish before we return. if the calling thread is interrupted
+      // while it waits for work (or a callback throws) then stop them
+      // before unwinding
+      try
+      {
+         work();
+      }
+      catch(...)
+      {
+         stop();
+         joinAll(&threads);
+         throw;
+      }
+
+      joinAll(&threads);
+   }
+
+private:
+   void stop()
+   {
+      {
+         boost::lock_guard<boost::mutex> lock(queueMutex_);
+         stopped_ = true;
+      }
+      queueCondition_.notify_all();
+   }
+
+   static void joinAll(boost::thread_group* pThreads)
+   {
+      // an interruption requested while we join is deferred until after
+      // the threads have finished
+      boost::this_thread::disable_interruption interruptionDisabled;
+      pThreads->join_all();
+   }
+
+   void work()
+   {
+      while (true)
+      {
+         tree<FileInfo>::iterator_base dir;
+         {
+            boost::unique_lock<boost::mutex> lock(queueMutex_);
+            while (queue_.empty() && pending_ > 0 && !stopped_)
+               queueCondition_.wait(lock);
+            if (pending_ == 0 || stopped_)
+               return;
+
+            dir = queue_.front();
+            queue_.pop_front();
+         }
+
+         scanQueued(dir);
+      }
+   }
+
+   // scan a directory taken from the queue, queueing its subdirectories
+   void scanQueued(const tree<FileInfo>::iterator_base& dir)
+   {
+      // as with a serial scan we don't want one "bad" directory to
+      // cause us to abort the entire scan
+      std::vector<tree<FileInfo>::iterator_base> subdirs;
+      Error error = scan(dir, &subdirs);
+      if (error)
+         LOG_ERROR(error);
+
+      {
+         boost::lock_guard<boost::mutex> lock(queueMutex_);
+         queue_.insert(queue_.end(), subdirs.begin(), subdirs.end());
+         pending_ += subdirs.size();
+         pending_--;
+      }
+      queueCondition_.notify_all();
+   }
+
+   Error scan(const tree<FileInfo>::iterator_base& dir,
+              std::vector<tree<FileInfo>::iterator_base>* pSubdirs)
+   {
+      if (options_.yield)
+         boost::this_thread::yield();
+
+      if (options_.onBeforeScanDir)
+      {
+         boost::lock_guard<boost::mutex> lock(callbackMutex_);
+         Error error = options_.onBeforeScanDir(*dir);
+         if (error)
+            return error;
+      }
+
+      std::vector<FileInfo> files;
+      Error error = readDirectory(dir->absolutePath(), &files);
+      if (error)
+         return error;
+
+      if (options_.filter)
+      {
+         boost::lock_guard<boost::mutex> lock(callbackMutex_);
+         files.erase(std::remove_if(files.begin(),
+                                    files.end(),
+                                    !boost::bind(options_.filter, _1)),
+                     files.end());
       }
 
+      boost::lock_guard<boost::mutex> lock(treeMutex_);
+      BOOST_FOREACH(const FileInfo& fileInfo, files)
+      {
+         tree<FileInfo>::iterator_base child = pTree_->append_child(dir,
+                                                                    fileInfo);
+         if (fileInfo.isDirectory() && !fileInfo.isSymlink())
+            pSubdirs->push_back(child);
+      }
+
+      return Success();
+   }
+
+private:
+   const FileScannerOptions& options_;
+   tree<FileInfo>* pTree_;
+
+   boost::mutex queueMutex_;
+   boost::condition_variable queueCondition_;
+   std::deque<tree<FileInfo>::iterator_base> queue_;
+   std::size_t pending_;
+   bool stopped_;
+
+   boost::mutex callbackMutex_;
+   boost::mutex treeMutex_;
+};
+
+} // anonymous namespace
+
+Error scanFiles(const tree<FileInfo>::iterator_base& fromNode,
+                const FileScannerOptions& options,
+                tree<FileInfo>* pTree)
+{
+   // clear all existing
+   pTree->erase_children(fromNode);
+
+   // yield if requested (only applies to recursive scans)
+   if (options.recursive && options.yield)
+      boost::this_thread::yield();
+
+   // call onBeforeScanDir hook
+   if (options.onBeforeScanDir)
+   {
+      Error error = options.onBeforeScanDir(*fromNode);
+      if (error)
+         return error;
+   }
+
+   // read directory contents
+   std::vector<FileInfo> files;
+   Error error = readDirectory(fromNode->absolutePath(), &files);
+   if (error)
+      return error;
+
+   // iterate over the files
+   std::vector<tree<FileInfo>::iterator_base> subdirs;
+   BOOST_FOREACH(const FileInfo& fileInfo, files)
+   {
       // apply the filter (if any)
       if (!options.filter || options.filter(fileInfo))
       {
@@ -179,6 +378,12 @@ Error scanFiles(const tree<FileInfo>::iterator_base& fromNode,
             // recurse if requested and this isn't a link
             if (options.recursive && !fileInfo.isSymlink())
             {
+               if (options.parallel)
+               {
+                  subdirs.push_back(child);
+                  continue;
+               }
+
                // try to scan the files in the subdirectory -- if we fail
                // we continue because we don't want one "bad" directory
                // to cause us to abort the entire scan. yes the tree
@@ -196,6 +401,13 @@ Error scanFiles(const tree<FileInfo>::iterator_base& fromNode,
       }
    }
 
+   // scan subdirectories concurrently if requested
+   if (!subdirs.empty())
+   {
+      ParallelScan scan(options, pTree);
+      scan.run(subdirs);
+   }
+
    // return success
    return Success();
 }
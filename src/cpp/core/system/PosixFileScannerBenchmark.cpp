@@ -0,0 +1,117 @@
+/*
+ * PosixFileScannerBenchmark.cpp
+ *
+ * Copyright (C) 2009-17 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+// Compares serial and parallel recursive scans of a directory, as done by
+// the file monitor when it registers a project, e.g.
+//
+//    rstudio-core-scanner-benchmark ~/projects/rstudio
+//
+// Scans are repeated, so after the first they're served from the kernel's
+// caches; to measure the effect of network latency scan a directory on an
+// NFS mount (with attribute caching disabled via the noac mount option, or
+// with latency added to its interface via tc's netem).
+
+#include <iostream>
+#include <iomanip>
+
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/function.hpp>
+
+#include <core/Error.hpp>
+#include <core/FilePath.hpp>
+#include <core/Log.hpp>
+#include <core/system/System.hpp>
+#include <core/system/FileScanner.hpp>
+
+using namespace rstudio;
+using namespace rstudio::core;
+
+namespace {
+
+// each benchmark is repeated for at least this long
+const long kMinDurationMs = 2000;
+
+std::size_t scan(const FilePath& dir, bool parallel)
+{
+   tree<FileInfo> files;
+   system::FileScannerOptions options;
+   options.recursive = true;
+   options.parallel = parallel;
+   Error error = system::scanFiles(FileInfo(dir), options, &files);
+   if (error)
+      LOG_ERROR(error);
+   return files.size();
+}
+
+void run(const std::string& name,
+         const boost::function<std::size_t()>& benchmark)
+{
+   using namespace boost::posix_time;
+
+   // the first scan is timed separately since it may need to go to disk
+   ptime start = microsec_clock::universal_time();
+   std::size_t count = benchmark();
+   time_duration first = microsec_clock::universal_time() - start;
+
+   int iterations = 0;
+   start = microsec_clock::universal_time();
+   time_duration elapsed;
+   do
+   {
+      benchmark();
+      iterations++;
+      elapsed = microsec_clock::universal_time() - start;
+   } while (elapsed.total_milliseconds() < kMinDurationMs);
+
+   double seconds = elapsed.total_microseconds() / 1000000.0 / iterations;
+   std::cout << std::left << std::setw(10) << name << std::right
+             << std::fixed << std::setprecision(1)
+             << std::setw(12) << (first.total_microseconds() / 1000.0)
+             << " ms first"
+             << std::setw(12) << (seconds * 1000) << " ms"
+             << std::setw(12) << count << std::endl;
+}
+
+} // anonymous namespace
+
+int main(int argc, char * argv[])
+{
+   try
+   {
+      initializeStderrLog("rstudio-core-scanner-benchmark",
+                          core::system::kLogLevelWarning);
+
+      if (argc != 2 || !FilePath(argv[1]).isDirectory())
+      {
+         std::cerr << "usage: " << argv[0] << " <directory>" << std::endl;
+         return EXIT_FAILURE;
+      }
+
+      FilePath dir(argv[1]);
+
+      // serial:   one directory at a time on the calling thread
+      // parallel: directories read concurrently (as the file monitors do)
+      // (count is files and directories found)
+      run("serial", boost::bind(scan, boost::cref(dir), false));
+      run("parallel", boost::bind(scan, boost::cref(dir), true));
+
+      return EXIT_SUCCESS;
+   }
+   CATCH_UNEXPECTED_EXCEPTION
+
+   // if we got this far we had an unexpected exception
+   return EXIT_FAILURE;
+}
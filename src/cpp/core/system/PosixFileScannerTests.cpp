@@ -0,0 +1,191 @@
+/*
+ * PosixFileScannerTests.cpp
+ *
+ * Copyright (C) 2009-17 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef _WIN32
+
+#include <core/system/FileScanner.hpp>
+
+#include <set>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+
+#include <core/FilePath.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/SafeConvert.hpp>
+
+#define RSTUDIO_NO_TESTTHAT_ALIASES
+#include <tests/TestThat.hpp>
+
+namespace rstudio {
+namespace core {
+namespace tests {
+
+namespace {
+
+void createTree(const FilePath& dir, int depth)
+{
+   for (int i = 0; i < 5; i++)
+   {
+      std::string name = safe_convert::numberToString(i);
+      writeStringToFile(dir.childPath("file" + name + ".R"), name);
+      if (depth > 0)
+      {
+         FilePath subdir = dir.childPath("dir" + name);
+         subdir.ensureDirectory();
+         createTree(subdir, depth - 1);
+      }
+   }
+   dir.childPath("skip").ensureDirectory();
+   writeStringToFile(dir.childPath("skip/ignored.R"), "");
+}
+
+std::vector<std::string> treePaths(const tree<FileInfo>& files)
+{
+   std::vector<std::string> paths;
+   for (tree<FileInfo>::iterator it = files.begin(); it != files.end(); ++it)
+      paths.push_back(it->absolutePath() + (it->isDirectory() ? "/" : ""));
+   return paths;
+}
+
+bool skipFilter(const FileInfo& fileInfo)
+{
+   return !boost::algorithm::ends_with(fileInfo.absolutePath(), "/skip");
+}
+
+Error countDir(const FileInfo& fileInfo, int* pCount)
+{
+   (*pCount)++;
+   return Success();
+}
+
+Error slowCountDir(const FileInfo& fileInfo, int* pCount)
+{
+   boost::this_thread::sleep(boost::posix_time::milliseconds(5));
+   (*pCount)++;
+   return Success();
+}
+
+Error recordThread(const FileInfo& fileInfo,
+                   std::set<boost::thread::id>* pThreads)
+{
+   pThreads->insert(boost::this_thread::get_id());
+   return Success();
+}
+
+void scanUntilInterrupted(const FilePath& root,
+                          const system::FileScannerOptions& options,
+                          bool* pInterrupted)
+{
+   tree<FileInfo> files;
+   try
+   {
+      system::scanFiles(FileInfo(root), options, &files);
+   }
+   catch(const boost::thread_interrupted&)
+   {
+      *pInterrupted = true;
+   }
+}
+
+} // anonymous namespace
+
+TEST_CASE("File Scanning")
+{
+   FilePath root;
+   FilePath::tempFilePath(&root);
+   REQUIRE(!root.ensureDirectory());
+   createTree(root, 3);
+
+   system::FileScannerOptions options;
+   options.recursive = true;
+   options.filter = skipFilter;
+
+   tree<FileInfo> serialTree;
+   int serialDirs = 0;
+   options.onBeforeScanDir = boost::bind(countDir, _1, &serialDirs);
+   REQUIRE(!system::scanFiles(FileInfo(root), options, &serialTree));
+
+   SECTION("Serial scans are complete and filtered")
+   {
+      // 5 + 25 + 125 directories below the root
+      CHECK(serialDirs == 1 + 155);
+      CHECK(serialTree.size() == 1 + 155 + 5 * (1 + 155));
+   }
+
+   SECTION("Parallel scans match serial scans")
+   {
+      tree<FileInfo> parallelTree;
+      int parallelDirs = 0;
+      options.parallel = true;
+      options.onBeforeScanDir = boost::bind(countDir, _1, &parallelDirs);
+      REQUIRE(!system::scanFiles(FileInfo(root), options, &parallelTree));
+
+      CHECK(parallelDirs == serialDirs);
+      CHECK(treePaths(parallelTree) == treePaths(serialTree));
+   }
+
+   SECTION("Small parallel scans stay on the calling thread")
+   {
+      // the 5 directories directly below the root, with nothing below them
+      FilePath small;
+      FilePath::tempFilePath(&small);
+      REQUIRE(!small.ensureDirectory());
+      createTree(small, 1);
+
+      std::set<boost::thread::id> threads;
+      tree<FileInfo> smallTree;
+      options.parallel = true;
+      options.onBeforeScanDir = boost::bind(recordThread, _1, &threads);
+      REQUIRE(!system::scanFiles(FileInfo(small), options, &smallTree));
+
+      CHECK(threads.size() == 1);
+      CHECK(threads.count(boost::this_thread::get_id()) == 1);
+      CHECK(smallTree.size() == 1 + 5 + 5 * (1 + 5));
+
+      small.removeIfExists();
+   }
+
+   SECTION("Interrupted parallel scans stop their threads")
+   {
+      int dirs = 0;
+      bool interrupted = false;
+      options.parallel = true;
+      options.onBeforeScanDir = boost::bind(slowCountDir, _1, &dirs);
+      boost::thread scanThread(boost::bind(scanUntilInterrupted,
+                                           root,
+                                           boost::cref(options),
+                                           &interrupted));
+      boost::this_thread::sleep(boost::posix_time::milliseconds(50));
+      scanThread.interrupt();
+      scanThread.join();
+      REQUIRE(interrupted);
+
+      // no scanning threads are left behind once the scan has unwound
+      int dirsAfterInterrupt = dirs;
+      CHECK(dirsAfterInterrupt < serialDirs);
+      boost::this_thread::sleep(boost::posix_time::milliseconds(50));
+      CHECK(dirs == dirsAfterInterrupt);
+   }
+
+   root.removeIfExists();
+}
+
+} // namespace tests
+} // namespace core
+} // namespace rstudio
+
+#endif // _WIN32
@@ -20,6 +20,7 @@
 
 #include <boost/bind.hpp>
 #include <boost/foreach.hpp>
+#include <boost/unordered_map.hpp>
 #include <boost/algorithm/string.hpp>
 
 #include <core/Log.hpp>
@@ -29,6 +30,7 @@
 
 #include <core/system/System.hpp>
 #include <core/system/FileScanner.hpp>
+#include <core/system/FileTreeSnapshot.hpp>
 
 #include "FileMonitorImpl.hpp"
 
@@ -303,11 +305,8 @@ Error discoverAndProcessFileChanges(
    {
       // check for changes on full subtree
       std::vector<FileChangeEvent> fileChanges;
-      tree<FileInfo> existingSubtree(it);
-      collectFileChangeEvents(existingSubtree.begin(),
-                              existingSubtree.end(),
-                              subdirTree.begin(),
-                              subdirTree.end(),
+      collectFileChangeEvents(FileTreeSnapshot(it),
+                              FileTreeSnapshot(subdirTree.begin()),
                               &fileChanges);
 
       // fire events
@@ -372,6 +371,114 @@ Error discoverAndProcessFileChanges(
    return Success();
 }
 
+tree<FileInfo>::iterator findPath(tree<FileInfo>* pTree,
+                                  const std::string& path)
+{
+   tree<FileInfo>::iterator it = pTree->begin();
+   if (it == pTree->end())
+      return pTree->end();
+
+   std::string rootPath = it->absolutePath();
+   if (path == rootPath)
+      return it;
+   if (!boost::algorithm::starts_with(path, rootPath) || rootPath.empty())
+      return pTree->end();
+
+   // position of the separator preceding the next component
+   std::size_t pos = rootPath.length();
+   if (rootPath[pos - 1] == '/')
+      pos--;
+   else if (path[pos] != '/')
+      return pTree->end();
+
+   while (true)
+   {
+      std::size_t next = path.find('/', pos + 1);
+      std::string childPath = path.substr(0, next);
+
+      tree<FileInfo>::sibling_iterator child = pTree->begin(it);
+      for (; child != pTree->end(it); ++child)
+      {
+         if (child->absolutePath() == childPath)
+            break;
+      }
+      if (child == pTree->end(it))
+         return pTree->end();
+
+      it = child;
+      if (next == std::string::npos)
+         return it;
+      pos = next;
+   }
+}
+
+void coalesceFileChangeEvents(std::vector<FileChangeEvent>* pEvents)
+{
+   // the position of the latest event for each path
+   boost::unordered_map<std::string, std::size_t> latest;
+
+   std::vector<FileChangeEvent> coalesced;
+   BOOST_FOREACH(const FileChangeEvent& event, *pEvents)
+   {
+      std::string path = event.fileInfo().absolutePath();
+      boost::unordered_map<std::string, std::size_t>::iterator it =
+                                                         latest.find(path);
+      if (it == latest.end() ||
+          coalesced[it->second].type() == FileChangeEvent::None)
+      {
+         latest[path] = coalesced.size();
+         coalesced.push_back(event);
+         continue;
+      }
+
+      FileChangeEvent& previous = coalesced[it->second];
+      FileChangeEvent::Type type = event.type();
+      switch (previous.type())
+      {
+      case FileChangeEvent::FileAdded:
+         // added then removed is no change at all, and added then modified
+         // is still an addition
+         if (event.type() == FileChangeEvent::FileRemoved)
+            type = FileChangeEvent::None;
+         else
+            type = FileChangeEvent::FileAdded;
+         break;
+
+      case FileChangeEvent::FileRemoved:
+         // a file which is replaced has been modified, however we report
+         // directories (or changes of type) as removed and then added
+         if (event.type() == FileChangeEvent::FileAdded &&
+             (event.fileInfo().isDirectory() ||
+              previous.fileInfo().isDirectory()))
+         {
+            latest[path] = coalesced.size();
+            coalesced.push_back(event);
+            continue;
+         }
+         if (event.type() == FileChangeEvent::FileAdded)
+            type = FileChangeEvent::FileModified;
+         break;
+
+      case FileChangeEvent::FileModified:
+         if (event.type() == FileChangeEvent::FileAdded)
+            type = FileChangeEvent::FileModified;
+         break;
+
+      default:
+         break;
+      }
+
+      previous = FileChangeEvent(type, event.fileInfo());
+   }
+
+   pEvents->clear();
+   BOOST_FOREACH(const FileChangeEvent& event, coalesced)
+   {
+      if (event.type() != FileChangeEvent::None)
+         pEvents->push_back(event);
+   }
+}
+
 std::list<void*> activeEventContexts()
 {
    std::list<void*> contexts;
@@ -112,6 +112,16 @@ Iterator findFile(Iterator begin, Iterator end, const FileInfo& fileInfo)
    return findFile(begin, end, fileInfo.absolutePath());
 }
 
+// find the node for a path by descending from the root of the tree (rather
+// than searching the whole tree)
+tree<FileInfo>::iterator findPath(tree<FileInfo>* pTree,
+                                  const std::string& path);
+
+// collapse successive events for the same path into the one event with the
+// same net effect (e.g. a file which is created, written and then removed
+// generates no event at all)
+void coalesceFileChangeEvents(std::vector<FileChangeEvent>* pEvents);
+
 std::list<void*> activeEventContexts();
 
 
@@ -0,0 +1,105 @@
+/*
+ * FileMonitorTests.cpp
+ *
+ * Copyright (C) 2009-17 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "FileMonitorImpl.hpp"
+
+#define RSTUDIO_NO_TESTTHAT_ALIASES
+#include <tests/TestThat.hpp>
+
+namespace rstudio {
+namespace core {
+namespace tests {
+
+namespace {
+
+using system::FileChangeEvent;
+
+FileChangeEvent event(FileChangeEvent::Type type,
+                      const std::string& path,
+                      std::time_t lastWriteTime = 1,
+                      bool isDirectory = false)
+{
+   return FileChangeEvent(type, FileInfo(path, isDirectory, 0, lastWriteTime));
+}
+
+} // anonymous namespace
+
+TEST_CASE("File Monitor Events")
+{
+   std::vector<FileChangeEvent> events;
+
+   SECTION("Files created and removed generate no events")
+   {
+      events.push_back(event(FileChangeEvent::FileAdded, "/p/tmp.o"));
+      events.push_back(event(FileChangeEvent::FileModified, "/p/tmp.o", 2));
+      events.push_back(event(FileChangeEvent::FileRemoved, "/p/tmp.o"));
+      system::file_monitor::impl::coalesceFileChangeEvents(&events);
+
+      CHECK(events.empty());
+   }
+
+   SECTION("Repeated modifications are delivered once")
+   {
+      events.push_back(event(FileChangeEvent::FileAdded, "/p/a.R"));
+      events.push_back(event(FileChangeEvent::FileModified, "/p/b.R", 1));
+      events.push_back(event(FileChangeEvent::FileModified, "/p/a.R", 2));
+      events.push_back(event(FileChangeEvent::FileModified, "/p/b.R", 3));
+      system::file_monitor::impl::coalesceFileChangeEvents(&events);
+
+      REQUIRE(events.size() == 2);
+      CHECK(events[0].type() == FileChangeEvent::FileAdded);
+      CHECK(events[0].fileInfo().lastWriteTime() == 2);
+      CHECK(events[1].type() == FileChangeEvent::FileModified);
+      CHECK(events[1].fileInfo().lastWriteTime() == 3);
+   }
+
+   SECTION("Replaced files are modified")
+   {
+      events.push_back(event(FileChangeEvent::FileRemoved, "/p/a.R"));
+      events.push_back(event(FileChangeEvent::FileAdded, "/p/a.R", 2));
+      events.push_back(event(FileChangeEvent::FileRemoved, "/p/d", 0, true));
+      events.push_back(event(FileChangeEvent::FileAdded, "/p/d", 0, true));
+      system::file_monitor::impl::coalesceFileChangeEvents(&events);
+
+      REQUIRE(events.size() == 3);
+      CHECK(events[0].type() == FileChangeEvent::FileModified);
+      CHECK(events[1].type() == FileChangeEvent::FileRemoved);
+      CHECK(events[2].type() == FileChangeEvent::FileAdded);
+   }
+}
+
+TEST_CASE("File Monitor Tree Lookup")
+{
+   tree<FileInfo> files;
+   tree<FileInfo>::iterator root = files.set_head(FileInfo("/p", true));
+   tree<FileInfo>::iterator r = files.append_child(root,
+                                                   FileInfo("/p/R", true));
+   files.append_child(r, FileInfo("/p/R/a.R", false));
+   tree<FileInfo>::iterator rOld = files.append_child(root,
+                                                      FileInfo("/p/R-old", true));
+
+   using system::file_monitor::impl::findPath;
+   CHECK(findPath(&files, "/p") == root);
+   CHECK(findPath(&files, "/p/R") == r);
+   CHECK(findPath(&files, "/p/R-old") == rOld);
+   CHECK(findPath(&files, "/p/R/a.R")->absolutePath() == "/p/R/a.R");
+   CHECK(findPath(&files, "/p/R/b.R") == files.end());
+   CHECK(findPath(&files, "/other/R") == files.end());
+   CHECK(findPath(&files, "/pR") == files.end());
+}
+
+} // namespace tests
+} // namespace core
+} // namespace rstudio
@@ -26,6 +26,7 @@
 #include <boost/utility.hpp>
 #include <boost/foreach.hpp>
 #include <boost/algorithm/string/predicate.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
 
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/hashed_index.hpp>
@@ -49,6 +50,12 @@ namespace file_monitor {
 
 namespace {
 
+// changes are delivered once no more have arrived in a cycle of the monitor
+// loop, or after this long if they keep arriving (e.g. during a checkout or
+// build), so that storms of events reach subscribers as a few batches
+const boost::posix_time::time_duration kMaxChangeDelay =
+                                       boost::posix_time::milliseconds(1000);
+
 struct Watch
 {
    Watch()
@@ -177,6 +184,8 @@ public:
    boost::function<bool(const FileInfo&)> filter;
    tree<FileInfo> fileTree;
    Callbacks callbacks;
+   std::vector<FileChangeEvent> pendingChanges;
+   boost::posix_time::ptime pendingSince;
 };
 
 void terminateWithMonitoringError(FileEventContext* pContext,
@@ -313,10 +322,8 @@ Error processEvent(FileEventContext* pContext,
          return Success();
 
       // get an iterator to the parent dir
-      tree<FileInfo>::iterator parentIt = impl::findFile(
-                                                   pContext->fileTree.begin(),
-                                                   pContext->fileTree.end(),
-                                                   watch.path);
+      tree<FileInfo>::iterator parentIt = impl::findPath(&pContext->fileTree,
+                                                         watch.path);
 
       // if we can't find a parent then return (this directory may have
       // been excluded from scanning due to a filter)
@@ -420,6 +427,18 @@ Error processEvent(FileEventContext* pContext,
 }
 
 
+void firePendingChanges(FileEventContext* pContext)
+{
+   if (pContext->pendingChanges.empty())
+      return;
+
+   std::vector<FileChangeEvent> fileChanges;
+   fileChanges.swap(pContext->pendingChanges);
+   impl::coalesceFileChangeEvents(&fileChanges);
+   if (!fileChanges.empty())
+      pContext->callbacks.onFilesChanged(fileChanges);
+}
+
 Handle registrationFailure(int errorNumber,
                            FileEventContext* pContext,
                            const Callbacks& callbacks,
@@ -479,6 +498,7 @@ Handle registerMonitor(const core::FilePath& filePath,
    FileScannerOptions options;
    options.recursive = recursive;
    options.yield = true;
+   options.parallel = true;
    options.filter = filter;
    options.onBeforeScanDir = addWatchFunction(pContext, true);
    Error error = scanFiles(FileInfo(filePath), options, &pContext->fileTree);
@@ -589,6 +609,14 @@ void run(const boost::function<void()>& checkForInput)
                // we start over because we missed events
                if (pEvent->mask & IN_Q_OVERFLOW)
                {
+                  // deliver what we have so far (the tree reflects it)
+                  pContext->pendingChanges.insert(
+                                             pContext->pendingChanges.end(),
+                                             fileChanges.begin(),
+                                             fileChanges.end());
+                  fileChanges.clear();
+                  firePendingChanges(pContext);
+
                   // remove all watches
                   removeAllWatches(pContext);
 
@@ -622,9 +650,22 @@ void run(const boost::function<void()>& checkForInput)
             }
          }
 
-         // fire any events we got
+         // queue any events we got, firing them once they settle
+         using namespace boost::posix_time;
+         ptime now = microsec_clock::universal_time();
          if (!fileChanges.empty())
-            pContext->callbacks.onFilesChanged(fileChanges);
+         {
+            if (pContext->pendingChanges.empty())
+               pContext->pendingSince = now;
+            pContext->pendingChanges.insert(pContext->pendingChanges.end(),
+                                            fileChanges.begin(),
+                                            fileChanges.end());
+         }
+         if (fileChanges.empty() ||
+             (now - pContext->pendingSince) >= kMaxChangeDelay)
+         {
+            firePendingChanges(pContext);
+         }
       }
 
       // check for input (register/unregister of monitors)
@@ -249,6 +249,7 @@ Handle registerMonitor(const FilePath& filePath,
    core::system::FileScannerOptions options;
    options.recursive = recursive;
    options.yield = true;
+   options.parallel = true;
    options.filter = filter;
    Error error = scanFiles(FileInfo(filePath), options, &pContext->fileTree);
    if (error)
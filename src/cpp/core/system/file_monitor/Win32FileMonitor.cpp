@@ -168,10 +168,9 @@ void processFileChange(DWORD action,
    }
 
    // get an iterator to this file's parent
-   FileInfo parentFileInfo = FileInfo(filePath.parent());
-   tree<FileInfo>::iterator parentIt = impl::findFile(pTree->begin(),
-                                                      pTree->end(),
-                                                      parentFileInfo);
+   tree<FileInfo>::iterator parentIt = impl::findPath(
+                                       pTree,
+                                       filePath.parent().absolutePath());
 
    // if we can't find a parent then return (this directory may have
    // been excluded from scanning due to a filter)
@@ -15,171 +15,80 @@
 
 #include <core/text/TermBufferParser.hpp>
 
+#include <cstring>
+
 namespace rstudio {
 namespace core {
 namespace text {
 
 namespace {
 
-enum ParseState {
-   NORMAL,			// parsing regular text
-   HAVE_ESC,      // found an ESC
-   HAVE_BRACKET,  // found a [ after an ESC
-   HAVE_QM,       // found a ? after ESC[
-   HAVE_INT,      // finding one or more digits after ESC[?
-   HAVE_TERM      // found 'h' or 'l' after ESC[?nnnn
-};
+const char kEscape = '\033';
 
-struct ParseMetadata
+bool isDigit(char ch)
 {
-   ParseMetadata(bool altActive /*initial buffer state*/)
-      :
-        state(NORMAL),
-        haveSupportedSeq(false),
-        currentCh('\0'),
-        startCount(0)
-   {
-      if (altActive) // in alt-buffer mode from the start
-         startCount = 1;
-   }
-
-   void setNewState(ParseState newState, size_t index, char ch)
-   {
-      if (newState == state)
-         return;
-
-      state = newState;
-      currentCh = ch;
-
-      switch(newState)
-      {
-      case NORMAL:
-         haveSupportedSeq = false;
-         break;
-
-      case HAVE_ESC:
-         escSequence.push_back(ch);
-         break;
+   return ch >= '0' && ch <= '9';
+}
 
-      case HAVE_BRACKET:
-      case HAVE_QM:
-         escSequence.push_back(ch);
-         break;
+// XTerm.js supported alt-buffer modes (ESC[?nnnnh to start, ESC[?nnnnl to end)
+bool isAltBufferSequence(const ControlSequence& sequence)
+{
+   return sequence.status == ControlSequence::Complete &&
+          sequence.isPrivate &&
+          (sequence.final == 'h' || sequence.final == 'l') &&
+          (sequence.params == "1049" ||
+           sequence.params == "1047" ||
+           sequence.params == "47");
+}
 
-      case HAVE_INT:
-         // start accumulating ints until we get a non-int
-         numberStr.clear();
-         numberStr.push_back(ch);
-         escSequence.push_back(ch);
-         break;
+} // anonymous namespace
 
-      case HAVE_TERM:
-         escSequence.push_back(ch);
-         if (ch == 'h' || ch == 'l')
-         {
-            if (!numberStr.compare("1049") ||
-                 !numberStr.compare("1047") ||
-                 !numberStr.compare("47"))
-             {
-               // found a valid alt-buffer sequence
-               haveSupportedSeq = true;
-             }
-         }
-         break;
+const char* findEscape(const char* begin, const char* end)
+{
+   const void* pEscape = std::memchr(begin, kEscape, end - begin);
+   return pEscape ? static_cast<const char*>(pEscape) : end;
+}
 
-      default:
-         break;
-      }
-   }
+ControlSequence parseControlSequence(const char* begin, const char* end)
+{
+   ControlSequence sequence;
+   sequence.status = ControlSequence::Invalid;
+   sequence.isPrivate = false;
+   sequence.final = '\0';
 
-   void continueState(size_t index, char ch)
+   const char* pos = begin + 1;
+   if (pos != end && *pos == '[')
    {
-      currentCh = ch;
-
-      switch (state)
+      pos++;
+      if (pos != end && *pos == '?')
       {
-      case HAVE_INT:
-         numberStr.push_back(ch);
-         escSequence.push_back(ch);
-         break;
-
-      default:
-         break;
+         sequence.isPrivate = true;
+         pos++;
       }
-   }
-
-   void processState(bool lastCall)
-   {
-      switch (state)
-      {
-      case HAVE_TERM:
-         if (!haveSupportedSeq)
-         {
-            // write out unknown sequence if we're not already inside
-            // alternate buffer
-            if (startCount == 0)
-               output.append(escSequence); // pass through ESC sequence
-         }
-         else
-         {
-            if (currentCh == 'h') // start alt-buffer
-               startCount++;
-            else
-               startCount = 0;
-         }
 
-         escSequence.clear();
-         state = NORMAL;
-         break;
+      const char* params = pos;
+      while (pos != end && isDigit(*pos))
+         pos++;
 
-      case NORMAL:
-         if (startCount == 0 && !lastCall)
-         {
-            if (!escSequence.empty())
-            {
-               output.append(escSequence);
-               escSequence.clear();
-            }
-            output.push_back(currentCh);
-         }
-         break;
-
-      default:
-         break;
+      if (pos == end)
+      {
+         sequence.status = ControlSequence::Incomplete;
       }
-
-      if (lastCall)
+      else if (*pos != kEscape)
       {
-         if (startCount == 0 && !escSequence.empty())
-         {
-            output.append(escSequence);
-         }
+         sequence.status = ControlSequence::Complete;
+         sequence.params.assign(params, pos);
+         sequence.final = *pos++;
       }
    }
+   else if (pos == end)
+   {
+      sequence.status = ControlSequence::Incomplete;
+   }
 
-   ParseState state;
-
-   // output buffer
-   std::string output;
-
-   // escape sequence buffer
-   std::string escSequence;
-
-   // was a supported escape sequence found?
-   bool haveSupportedSeq;
-
-   // number string as it is extraced from sequence
-   std::string numberStr;
-
-   // current character
-   char currentCh;
-
-   // number of start-alt-buffer sequences encountered with an end sequence
-   int startCount;
-};
-
-
-} // anonymous namespace
+   sequence.length = pos - begin;
+   return sequence;
+}
 
 std::string stripSecondaryBuffer(const std::string& strInput, bool* pAltBufferActive)
 {
@@ -204,67 +113,40 @@ std::string stripSecondaryBuffer(const std::string& strInput, bool* pAltBufferAc
 
    // initial state
    bool altActive = pAltBufferActive ? *pAltBufferActive : false;
-   size_t origLength = strInput.length();
 
-   ParseMetadata parse(altActive);
+   std::string output;
+   output.reserve(strInput.length());
 
-   // Single pass through the original string. Look for the escape sequences,
-   // and when we have a confirmed run of text that isn't between them,
-   // append it to the output.
-   for (size_t i = 0; i < origLength; i++)
+   // Single pass through the original string, copying (or, inside the
+   // alt-buffer, skipping) the runs of text between escapes in bulk.
+   const char* pos = strInput.data();
+   const char* end = pos + strInput.length();
+   while (pos != end)
    {
-      char ch = strInput[i];
-      switch (parse.state)
-      {
-      case NORMAL:
-         if (ch == '\033')
-            parse.setNewState(HAVE_ESC, i, ch);
-         else
-            parse.continueState(i, ch);
-         break;
-
-      case HAVE_ESC:
-         if (ch == '[')
-            parse.setNewState(HAVE_BRACKET, i, ch);
-         else
-            parse.setNewState(NORMAL, i, ch);
-         break;
-
-      case HAVE_BRACKET:
-         if (ch == '?')
-            parse.setNewState(HAVE_QM, i, ch);
-         else
-            parse.setNewState(NORMAL, i, ch);
-         break;
-
-      case HAVE_QM:
-         if (::isdigit(ch))
-            parse.setNewState(HAVE_INT, i, ch);
-         else
-            parse.setNewState(NORMAL, i, ch);
+      const char* pEscape = findEscape(pos, end);
+      if (!altActive)
+         output.append(pos, pEscape);
+      if (pEscape == end)
          break;
 
-      case HAVE_INT:
-         if (::isdigit(ch))
-            parse.continueState(i, ch);
-         else
-            parse.setNewState(HAVE_TERM, i, ch);
-         break;
-
-      default:
-         break;
+      ControlSequence sequence = parseControlSequence(pEscape, end);
+      if (isAltBufferSequence(sequence))
+      {
+         altActive = sequence.final == 'h';
       }
-
-      parse.processState(false);
+      else if (!altActive)
+      {
+         // pass through other (and incomplete) sequences
+         output.append(pEscape, sequence.length);
+      }
+      pos = pEscape + sequence.length;
    }
 
-   parse.processState(true);
-
    // set output mode
    if (pAltBufferActive)
-      *pAltBufferActive = parse.startCount > 0;;
+      *pAltBufferActive = altActive;
 
-   return parse.output;
+   return output;
 }
 
 } // namespace text
@@ -0,0 +1,187 @@
+/*
+ * TermBufferParserBenchmark.cpp
+ *
+ * Copyright (C) 2009-17 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+// Measures terminal escape processing throughput (in MB/s of output) over a
+// set of captured terminal logs, e.g. one recorded with script(1) while
+// building with colored output and using a full-screen program:
+//
+//    rstudio-core-terminal-benchmark ~/typescript
+//
+// Each argument is a log file, which is processed both as a single buffer
+// and in 4K chunks (as output arrives from a terminal's process).
+
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/function.hpp>
+
+#include <core/Error.hpp>
+#include <core/FilePath.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/Log.hpp>
+#include <core/system/System.hpp>
+
+#include <core/text/TermBufferParser.hpp>
+
+using namespace rstudio;
+using namespace rstudio::core;
+
+namespace {
+
+// each benchmark is repeated for at least this long
+const long kMinDurationMs = 2000;
+
+// size of the chunks output is fed in
+const std::size_t kChunkSize = 4096;
+
+std::size_t strip(const std::vector<std::string>& logs)
+{
+   std::size_t count = 0;
+   for (std::size_t i = 0; i < logs.size(); i++)
+   {
+      bool altModeActive = false;
+      count += text::stripSecondaryBuffer(logs[i], &altModeActive).size();
+   }
+   return count;
+}
+
+std::size_t stripChunks(const std::vector<std::vector<std::string> >& logs)
+{
+   std::size_t count = 0;
+   for (std::size_t i = 0; i < logs.size(); i++)
+   {
+      bool altModeActive = false;
+      for (std::size_t j = 0; j < logs[i].size(); j++)
+      {
+         count += text::stripSecondaryBuffer(logs[i][j],
+                                             &altModeActive).size();
+      }
+   }
+   return count;
+}
+
+std::size_t escapes(const std::vector<std::string>& logs)
+{
+   std::size_t count = 0;
+   for (std::size_t i = 0; i < logs.size(); i++)
+   {
+      const char* pos = logs[i].data();
+      const char* end = pos + logs[i].size();
+      while ((pos = text::findEscape(pos, end)) != end)
+      {
+         text::ControlSequence sequence =
+                                    text::parseControlSequence(pos, end);
+         if (sequence.status == text::ControlSequence::Complete)
+            count++;
+         pos += std::max(sequence.length, static_cast<std::size_t>(1));
+      }
+   }
+   return count;
+}
+
+void run(const std::string& name,
+         const boost::function<std::size_t()>& benchmark,
+         std::size_t bytes)
+{
+   using namespace boost::posix_time;
+
+   // warm up
+   std::size_t count = benchmark();
+
+   int iterations = 0;
+   ptime start = microsec_clock::universal_time();
+   time_duration elapsed;
+   do
+   {
+      benchmark();
+      iterations++;
+      elapsed = microsec_clock::universal_time() - start;
+   } while (elapsed.total_milliseconds() < kMinDurationMs);
+
+   double seconds = elapsed.total_microseconds() / 1000000.0 / iterations;
+   std::cout << std::left << std::setw(14) << name << std::right
+             << std::fixed << std::setprecision(1)
+             << std::setw(10) << (bytes / seconds / (1024 * 1024)) << " MB/s"
+             << std::setw(12) << (seconds * 1000) << " ms"
+             << std::setw(12) << count << std::endl;
+}
+
+} // anonymous namespace
+
+int main(int argc, char * argv[])
+{
+   try
+   {
+      initializeStderrLog("rstudio-core-terminal-benchmark",
+                          core::system::kLogLevelWarning);
+
+      if (argc < 2)
+      {
+         std::cerr << "usage: " << argv[0] << " <file>..." << std::endl;
+         return EXIT_FAILURE;
+      }
+
+      std::vector<std::string> logs;
+      std::vector<std::vector<std::string> > chunkedLogs;
+      std::size_t bytes = 0;
+      for (int i = 1; i < argc; i++)
+      {
+         std::string log;
+         Error error = readStringFromFile(FilePath(argv[i]), &log);
+         if (error)
+         {
+            LOG_ERROR(error);
+            continue;
+         }
+
+         std::vector<std::string> chunks;
+         for (std::size_t offset = 0; offset < log.size(); offset += kChunkSize)
+            chunks.push_back(log.substr(offset, kChunkSize));
+
+         bytes += log.size();
+         logs.push_back(log);
+         chunkedLogs.push_back(chunks);
+      }
+
+      if (bytes == 0)
+      {
+         std::cerr << "no terminal output found" << std::endl;
+         return EXIT_FAILURE;
+      }
+
+      std::cout << logs.size() << " files, " << bytes << " bytes"
+                << std::endl << std::endl;
+
+      // strip:        stripSecondaryBuffer over whole logs (count is bytes
+      //               kept)
+      // strip-chunks: stripSecondaryBuffer over 4K chunks, carrying the
+      //               alt-buffer state between them (count is bytes kept)
+      // escapes:      findEscape and parseControlSequence alone, as used to
+      //               find grep's match markers (count is sequences)
+      run("strip", boost::bind(strip, boost::cref(logs)), bytes);
+      run("strip-chunks", boost::bind(stripChunks, boost::cref(chunkedLogs)),
+          bytes);
+      run("escapes", boost::bind(escapes, boost::cref(logs)), bytes);
+
+      return EXIT_SUCCESS;
+   }
+   CATCH_UNEXPECTED_EXCEPTION
+
+   // if we got this far we had an unexpected exception
+   return EXIT_FAILURE;
+}
@@ -296,6 +296,94 @@ TEST_CASE("Terminal Buffer Mode Parsing")
       CHECK(expect.compare(newStr) == 0);
       CHECK(altMode == false);
    }
+
+   SECTION("Escape inside a sequence starts a new sequence")
+   {
+      std::string input = "Once upon \033[12";
+      input.append(pStart1);
+      input.append("a bunch of random stuff");
+      input.append(pEnd1);
+      input.append("a time.");
+      std::string expect("Once upon \033[12a time.");
+
+      bool altMode = false;
+      std::string newStr = core::text::stripSecondaryBuffer(input, &altMode);
+      CHECK(expect.compare(newStr) == 0);
+      CHECK(altMode == false);
+   }
+
+   SECTION("Long runs of text between sequences")
+   {
+      std::string text(100000, 'x');
+      std::string input = text;
+      input.append(pStart1);
+      input.append(text);
+      input.append(pEnd1);
+      input.append(text);
+
+      bool altMode = false;
+      std::string newStr = core::text::stripSecondaryBuffer(input, &altMode);
+      CHECK(newStr == text + text);
+      CHECK(altMode == false);
+   }
+}
+
+TEST_CASE("Terminal Control Sequence Parsing")
+{
+   using core::text::ControlSequence;
+   using core::text::parseControlSequence;
+
+   SECTION("Complete sequences")
+   {
+      std::string input = "\033[?1049hello";
+      ControlSequence sequence = parseControlSequence(
+               input.data(), input.data() + input.length());
+      CHECK(sequence.status == ControlSequence::Complete);
+      CHECK(sequence.length == 8);
+      CHECK(sequence.isPrivate);
+      CHECK(sequence.params == "1049");
+      CHECK(sequence.final == 'h');
+
+      input = "\033[01m";
+      sequence = parseControlSequence(input.data(),
+                                      input.data() + input.length());
+      CHECK(sequence.status == ControlSequence::Complete);
+      CHECK(!sequence.isPrivate);
+      CHECK(sequence.params == "01");
+      CHECK(sequence.final == 'm');
+   }
+
+   SECTION("Incomplete and invalid sequences")
+   {
+      std::string input = "\033[?10";
+      ControlSequence sequence = parseControlSequence(
+               input.data(), input.data() + input.length());
+      CHECK(sequence.status == ControlSequence::Incomplete);
+      CHECK(sequence.length == input.length());
+
+      input = "\033x";
+      sequence = parseControlSequence(input.data(),
+                                      input.data() + input.length());
+      CHECK(sequence.status == ControlSequence::Invalid);
+      CHECK(sequence.length == 1);
+
+      input = "\033[1\033[m";
+      sequence = parseControlSequence(input.data(),
+                                      input.data() + input.length());
+      CHECK(sequence.status == ControlSequence::Invalid);
+      CHECK(sequence.length == 3);
+   }
+
+   SECTION("Finding escapes")
+   {
+      std::string input = "no escapes here";
+      const char* end = input.data() + input.length();
+      CHECK(core::text::findEscape(input.data(), end) == end);
+
+      input = "one \033 here";
+      end = input.data() + input.length();
+      CHECK(core::text::findEscape(input.data(), end) == input.data() + 4);
+   }
 }
 
 } // end namespace tests
@@ -0,0 +1,431 @@
+/*
+ * TrigramIndex.cpp
+ *
+ * Copyright (C) 2009-17 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <core/text/TrigramIndex.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <iterator>
+
+#include <boost/foreach.hpp>
+
+namespace rstudio {
+namespace core {
+namespace text {
+
+namespace {
+
+// compact once at least this many removed files are lingering in the index
+// (and they outnumber the live files)
+const std::size_t kCompactThreshold = 1024;
+
+const boost::uint32_t kInvalidId = static_cast<boost::uint32_t>(-1);
+
+inline boost::uint32_t fold(char ch)
+{
+   unsigned char uch = static_cast<unsigned char>(ch);
+   if (uch >= 'A' && uch <= 'Z')
+      uch += 'a' - 'A';
+   return uch;
+}
+
+void appendTrigrams(const std::string& text, std::vector<boost::uint32_t>* pTrigrams)
+{
+   if (text.size() < 3)
+      return;
+
+   for (std::size_t i = 0; i + 2 < text.size(); i++)
+   {
+      // skip trigrams which span lines
+      if (text[i + 2] == '\n')
+      {
+         i += 2;
+         continue;
+      }
+      if (text[i] == '\n' || text[i + 1] == '\n')
+         continue;
+
+      pTrigrams->push_back(
+         (fold(text[i]) << 16) | (fold(text[i + 1]) << 8) | fold(text[i + 2]));
+   }
+}
+
+bool compareSize(const std::vector<boost::uint32_t>* pLhs,
+                 const std::vector<boost::uint32_t>* pRhs)
+{
+   return pLhs->size() < pRhs->size();
+}
+
+class LiteralCollector
+{
+public:
+   LiteralCollector(bool ignoreCase, std::vector<std::string>* pLiterals)
+      : ignoreCase_(ignoreCase), depth_(0), pLiterals_(pLiterals)
+   {
+   }
+
+   void append(char ch)
+   {
+      // text within groups may be optional (repeated zero times)
+      if (depth_ > 0)
+         return;
+
+      // case folding of non-ascii characters is beyond the index
+      if (ignoreCase_ && static_cast<unsigned char>(ch) >= 0x80)
+      {
+         flush();
+         return;
+      }
+
+      current_.push_back(ch);
+   }
+
+   // the last character appended is optional (e.g. followed by '*')
+   void dropLast()
+   {
+      if (!current_.empty())
+         current_.erase(current_.size() - 1);
+   }
+
+   void beginGroup() { flush(); depth_++; }
+   void endGroup() { flush(); if (depth_ > 0) depth_--; }
+
+   void flush()
+   {
+      if (current_.size() >= 3)
+         pLiterals_->push_back(current_);
+      current_.clear();
+   }
+
+private:
+   bool ignoreCase_;
+   int depth_;
+   std::string current_;
+   std::vector<std::string>* pLiterals_;
+};
+
+// returns the index of the closing ']' of the bracket expression which
+// starts at pos (or npos if it is unterminated)
+std::size_t endOfBracketExpression(const std::string& pattern, std::size_t pos)
+{
+   std::size_t i = pos + 1;
+   if (i < pattern.size() && pattern[i] == '^')
+      i++;
+   if (i < pattern.size() && pattern[i] == ']')
+      i++;
+
+   while (i < pattern.size())
+   {
+      char ch = pattern[i];
+      if (ch == ']')
+         return i;
+
+      // character classes, equivalence classes and collating symbols
+      // (e.g. [:alpha:]) may contain a ']'
+      if (ch == '[' && i + 1 < pattern.size() &&
+          std::strchr(":=.", pattern[i + 1]) != NULL)
+      {
+         char delim[] = { pattern[i + 1], ']', '\0' };
+         std::size_t end = pattern.find(delim, i + 2);
+         if (end == std::string::npos)
+            return std::string::npos;
+         i = end + 2;
+         continue;
+      }
+
+      i++;
+   }
+
+   return std::string::npos;
+}
+
+} // anonymous namespace
+
+void TrigramIndex::add(const std::string& path, const std::string& contents)
+{
+   remove(path);
+
+   boost::uint32_t id = static_cast<boost::uint32_t>(paths_.size());
+   paths_.push_back(path);
+   ids_[path] = id;
+
+   std::vector<boost::uint32_t> trigrams;
+   trigrams.reserve(contents.size());
+   appendTrigrams(contents, &trigrams);
+   std::sort(trigrams.begin(), trigrams.end());
+   trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+
+   // ids are allocated in increasing order so posting lists stay sorted
+   BOOST_FOREACH(boost::uint32_t trigram, trigrams)
+   {
+      postings_[trigram].push_back(id);
+   }
+}
+
+void TrigramIndex::remove(const std::string& path)
+{
+   std::map<std::string, boost::uint32_t>::iterator it = ids_.find(path);
+   if (it == ids_.end())
+      return;
+
+   // leave the id in the posting lists until we next compact
+   paths_[it->second].clear();
+   ids_.erase(it);
+   deadCount_++;
+
+   if (deadCount_ >= kCompactThreshold && deadCount_ > ids_.size())
+      compact();
+}
+
+void TrigramIndex::removeDirectory(const std::string& path)
+{
+   std::string prefix = path;
+   if (prefix.empty() || prefix[prefix.size() - 1] != '/')
+      prefix.push_back('/');
+
+   std::vector<std::string> removed;
+   for (std::map<std::string, boost::uint32_t>::const_iterator it =
+           ids_.lower_bound(prefix);
+        it != ids_.end() && it->first.compare(0, prefix.size(), prefix) == 0;
+        ++it)
+   {
+      removed.push_back(it->first);
+   }
+
+   BOOST_FOREACH(const std::string& file, removed)
+   {
+      remove(file);
+   }
+}
+
+void TrigramIndex::clear()
+{
+   paths_.clear();
+   ids_.clear();
+   postings_.clear();
+   deadCount_ = 0;
+}
+
+bool TrigramIndex::contains(const std::string& path) const
+{
+   return ids_.find(path) != ids_.end();
+}
+
+void TrigramIndex::candidates(const std::vector<std::string>& literals,
+                              std::vector<std::string>* pPaths) const
+{
+   pPaths->clear();
+
+   std::vector<boost::uint32_t> trigrams;
+   BOOST_FOREACH(const std::string& literal, literals)
+   {
+      appendTrigrams(literal, &trigrams);
+   }
+   std::sort(trigrams.begin(), trigrams.end());
+   trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+
+   // nothing to filter on
+   if (trigrams.empty())
+   {
+      pPaths->reserve(ids_.size());
+      for (std::map<std::string, boost::uint32_t>::const_iterator it = ids_.begin();
+           it != ids_.end();
+           ++it)
+      {
+         pPaths->push_back(it->first);
+      }
+      return;
+   }
+
+   // collect the posting lists (any missing trigram rules out every file)
+   std::vector<const std::vector<boost::uint32_t>*> lists;
+   BOOST_FOREACH(boost::uint32_t trigram, trigrams)
+   {
+      boost::unordered_map<boost::uint32_t, std::vector<boost::uint32_t> >
+                                    ::const_iterator it = postings_.find(trigram);
+      if (it == postings_.end())
+         return;
+      lists.push_back(&(it->second));
+   }
+
+   // intersect, starting with the most selective lists
+   std::sort(lists.begin(), lists.end(), compareSize);
+   std::vector<boost::uint32_t> ids(*lists[0]);
+   for (std::size_t i = 1; i < lists.size() && !ids.empty(); i++)
+   {
+      std::vector<boost::uint32_t> intersection;
+      std::set_intersection(ids.begin(), ids.end(),
+                            lists[i]->begin(), lists[i]->end(),
+                            std::back_inserter(intersection));
+      ids.swap(intersection);
+   }
+
+   BOOST_FOREACH(boost::uint32_t id, ids)
+   {
+      if (!paths_[id].empty())
+         pPaths->push_back(paths_[id]);
+   }
+   std::sort(pPaths->begin(), pPaths->end());
+}
+
+void TrigramIndex::compact()
+{
+   // assign new (dense) ids; the mapping preserves order so posting
+   // lists remain sorted
+   std::vector<boost::uint32_t> remap(paths_.size(), kInvalidId);
+   std::vector<std::string> paths;
+   paths.reserve(ids_.size());
+   for (std::size_t id = 0; id < paths_.size(); id++)
+   {
+      if (!paths_[id].empty())
+      {
+         remap[id] = static_cast<boost::uint32_t>(paths.size());
+         paths.push_back(paths_[id]);
+      }
+   }
+   paths_.swap(paths);
+
+   for (std::map<std::string, boost::uint32_t>::iterator it = ids_.begin();
+        it != ids_.end();
+        ++it)
+   {
+      it->second = remap[it->second];
+   }
+
+   boost::unordered_map<boost::uint32_t, std::vector<boost::uint32_t> >::iterator
+                                                   it = postings_.begin();
+   while (it != postings_.end())
+   {
+      std::vector<boost::uint32_t>& list = it->second;
+      std::size_t count = 0;
+      for (std::size_t i = 0; i < list.size(); i++)
+      {
+         boost::uint32_t id = remap[list[i]];
+         if (id != kInvalidId)
+            list[count++] = id;
+      }
+
+      if (count == 0)
+      {
+         it = postings_.erase(it);
+      }
+      else
+      {
+         list.resize(count);
+         ++it;
+      }
+   }
+
+   deadCount_ = 0;
+}
+
+bool requiredLiterals(const std::string& pattern,
+                      bool isRegex,
+                      bool ignoreCase,
+                      std::vector<std::string>* pLiterals)
+{
+   pLiterals->clear();
+
+   // each line of the pattern is an alternative
+   if (pattern.find('\n') != std::string::npos)
+      return false;
+
+   LiteralCollector collector(ignoreCase, pLiterals);
+
+   if (!isRegex)
+   {
+      BOOST_FOREACH(char ch, pattern)
+      {
+         collector.append(ch);
+      }
+      collector.flush();
+      return !pLiterals->empty();
+   }
+
+   for (std::size_t i = 0; i < pattern.size(); i++)
+   {
+      char ch = pattern[i];
+      if (ch == '\\' && i + 1 < pattern.size())
+      {
+         char next = pattern[++i];
+         if (next == '|')
+         {
+            pLiterals->clear();
+            return false;
+         }
+         else if (next == '(')
+         {
+            collector.beginGroup();
+         }
+         else if (next == ')')
+         {
+            collector.endGroup();
+         }
+         else if (next == '?')
+         {
+            collector.dropLast();
+            collector.flush();
+         }
+         else if (next == '{')
+         {
+            collector.dropLast();
+            collector.flush();
+            std::size_t end = pattern.find("\\}", i + 1);
+            if (end == std::string::npos)
+               break;
+            i = end + 1;
+         }
+         else if (next == '+' ||
+                  std::isalnum(static_cast<unsigned char>(next)) ||
+                  std::strchr("<>`'", next) != NULL)
+         {
+            // repetition, character classes, anchors and back references
+            collector.flush();
+         }
+         else
+         {
+            collector.append(next);
+         }
+      }
+      else if (ch == '*')
+      {
+         collector.dropLast();
+         collector.flush();
+      }
+      else if (ch == '.' || ch == '^' || ch == '$' || ch == '\\')
+      {
+         collector.flush();
+      }
+      else if (ch == '[')
+      {
+         collector.flush();
+         i = endOfBracketExpression(pattern, i);
+         if (i == std::string::npos)
+            break;
+      }
+      else
+      {
+         collector.append(ch);
+      }
+   }
+   collector.flush();
+
+   return !pLiterals->empty();
+}
+
+} // namespace text
+} // namespace core
+} // namespace rstudio
@@ -0,0 +1,180 @@
+/*
+ * TrigramIndexTests.cpp
+ *
+ * Copyright (C) 2009-17 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include <core/text/TrigramIndex.hpp>
+
+#include <core/SafeConvert.hpp>
+
+#define RSTUDIO_NO_TESTTHAT_ALIASES
+#include <tests/TestThat.hpp>
+
+namespace rstudio {
+namespace core {
+namespace tests {
+
+namespace {
+
+std::vector<std::string> candidatesFor(const text::TrigramIndex& index,
+                                       const std::string& literal)
+{
+   std::vector<std::string> literals;
+   literals.push_back(literal);
+   std::vector<std::string> paths;
+   index.candidates(literals, &paths);
+   return paths;
+}
+
+std::vector<std::string> literalsFor(const std::string& pattern,
+                                     bool isRegex = true,
+                                     bool ignoreCase = false)
+{
+   std::vector<std::string> literals;
+   text::requiredLiterals(pattern, isRegex, ignoreCase, &literals);
+   return literals;
+}
+
+} // anonymous namespace
+
+TEST_CASE("Trigram Index")
+{
+   text::TrigramIndex index;
+   index.add("/project/a.R", "foo <- function(x)\n{\n   bar(x)\n}\n");
+   index.add("/project/b.R", "baz <- FOO_CONSTANT\n");
+   index.add("/project/sub/c.R", "qux <- 1\nfo\no\n");
+
+   SECTION("Candidates contain the literal")
+   {
+      std::vector<std::string> paths = candidatesFor(index, "function");
+      REQUIRE(paths.size() == 1);
+      CHECK(paths[0] == "/project/a.R");
+      CHECK(candidatesFor(index, "nowhere").empty());
+   }
+
+   SECTION("Candidates are case insensitive and in path order")
+   {
+      std::vector<std::string> paths = candidatesFor(index, "Foo");
+      REQUIRE(paths.size() == 2);
+      CHECK(paths[0] == "/project/a.R");
+      CHECK(paths[1] == "/project/b.R");
+   }
+
+   SECTION("Trigrams don't span lines")
+   {
+      CHECK(candidatesFor(index, "foo").size() == 2);
+      CHECK(candidatesFor(index, "qux").size() == 1);
+   }
+
+   SECTION("Short literals match every file")
+   {
+      CHECK(candidatesFor(index, "zz").size() == 3);
+      CHECK(candidatesFor(index, "").size() == 3);
+   }
+
+   SECTION("Files can be replaced and removed")
+   {
+      index.add("/project/b.R", "nothing to see here\n");
+      CHECK(candidatesFor(index, "foo").size() == 1);
+      CHECK(candidatesFor(index, "see").size() == 1);
+
+      index.remove("/project/a.R");
+      CHECK(candidatesFor(index, "foo").empty());
+      CHECK(!index.contains("/project/a.R"));
+      CHECK(index.size() == 2);
+
+      index.removeDirectory("/project/sub");
+      CHECK(candidatesFor(index, "qux").empty());
+      CHECK(index.size() == 1);
+   }
+
+   SECTION("Removed files are compacted away")
+   {
+      for (int i = 0; i < 5000; i++)
+      {
+         std::string path = "/scratch/" + safe_convert::numberToString(i);
+         index.add(path, "scratch " + path);
+         if (i % 4 != 0)
+            index.remove(path);
+      }
+
+      CHECK(index.size() == 1253);
+      CHECK(candidatesFor(index, "scratch").size() == 1250);
+      CHECK(candidatesFor(index, "/scratch/4996").size() == 1);
+      CHECK(candidatesFor(index, "/scratch/4999").empty());
+      CHECK(candidatesFor(index, "function").size() == 1);
+   }
+}
+
+TEST_CASE("Trigram Index Required Literals")
+{
+   SECTION("Fixed strings are required as is")
+   {
+      std::vector<std::string> literals = literalsFor("a.b*c", false);
+      REQUIRE(literals.size() == 1);
+      CHECK(literals[0] == "a.b*c");
+      CHECK(literalsFor("ab", false).empty());
+      CHECK(literalsFor("abc\ndef", false).empty());
+   }
+
+   SECTION("Regex metacharacters split literals")
+   {
+      std::vector<std::string> literals = literalsFor("^library(.*)$");
+      REQUIRE(literals.size() == 1);
+      CHECK(literals[0] == "library(");
+
+      literals = literalsFor("foo[a-z]*bar\\.R");
+      REQUIRE(literals.size() == 2);
+      CHECK(literals[0] == "foo");
+      CHECK(literals[1] == "bar.R");
+
+      literals = literalsFor("func[[:alpha:]]tion");
+      REQUIRE(literals.size() == 2);
+      CHECK(literals[0] == "func");
+      CHECK(literals[1] == "tion");
+   }
+
+   SECTION("Optional characters are dropped")
+   {
+      std::vector<std::string> literals = literalsFor("colou*r");
+      REQUIRE(literals.size() == 1);
+      CHECK(literals[0] == "colo");
+
+      literals = literalsFor("abcd\\?efg\\{0,1\\}hij");
+      REQUIRE(literals.size() == 2);
+      CHECK(literals[0] == "abc");
+      CHECK(literals[1] == "hij");
+   }
+
+   SECTION("Groups and alternation are not required")
+   {
+      std::vector<std::string> literals = literalsFor("abc\\(def\\)*ghi");
+      REQUIRE(literals.size() == 2);
+      CHECK(literals[0] == "abc");
+      CHECK(literals[1] == "ghi");
+      CHECK(literalsFor("foo\\|bar").empty());
+      CHECK(literalsFor("\\w\\+").empty());
+   }
+
+   SECTION("Non-ascii characters split case insensitive literals")
+   {
+      std::vector<std::string> literals = literalsFor("caf\xc3\xa9 au lait", false, true);
+      REQUIRE(literals.size() == 2);
+      CHECK(literals[0] == "caf");
+      CHECK(literals[1] == " au lait");
+   }
+}
+
+} // namespace tests
+} // namespace core
+} // namespace rstudio
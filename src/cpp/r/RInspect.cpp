@@ -0,0 +1,448 @@
+/*
+ * RInspect.cpp
+ *
+ * Copyright (C) 2009-17 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#define R_INTERNAL_FUNCTIONS
+#include <r/RInspect.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <core/Error.hpp>
+
+#include <r/RErrorCategory.hpp>
+#include <r/RExec.hpp>
+#include <r/RInternal.hpp>
+#include <r/RSexp.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace r {
+namespace inspect {
+
+namespace {
+
+// limits on the size of a summary (in bytes of UTF-8)
+const std::size_t kMaxNameLength = 256;
+const std::size_t kMaxValueLength = 100;
+
+// the most elements of a vector included in its value
+const R_xlen_t kMaxValueElements = 10;
+
+void truncate(std::string* pString, std::size_t maxLength)
+{
+   if (pString->size() <= maxLength)
+      return;
+
+   // don't split a multibyte character
+   std::size_t length = maxLength;
+   while (length > 0 && ((*pString)[length] & 0xC0) == 0x80)
+      --length;
+
+   pString->resize(length);
+   pString->append("...");
+}
+
+// the value of a (forced) promise, or the object itself. unforced promises
+// are left alone, since forcing them would evaluate R code
+SEXP valueOf(SEXP objectSEXP)
+{
+   if (TYPEOF(objectSEXP) == PROMSXP)
+      return PRVALUE(objectSEXP);
+   else
+      return objectSEXP;
+}
+
+// read an attribute directly from the object's attribute list (unlike
+// Rf_getAttrib this never allocates, which it would do e.g. to expand
+// compact row names)
+SEXP attrib(SEXP objectSEXP, SEXP symbolSEXP)
+{
+   for (SEXP nodeSEXP = ATTRIB(objectSEXP);
+        nodeSEXP != R_NilValue;
+        nodeSEXP = CDR(nodeSEXP))
+   {
+      if (TAG(nodeSEXP) == symbolSEXP)
+         return CAR(nodeSEXP);
+   }
+   return R_NilValue;
+}
+
+std::string stringElement(SEXP stringSEXP, R_xlen_t i)
+{
+   SEXP charSEXP = STRING_ELT(stringSEXP, i);
+   if (charSEXP == NA_STRING)
+      return "NA";
+   else
+      return r::sexp::utf8String(charSEXP);
+}
+
+std::string firstString(SEXP stringSEXP)
+{
+   if (TYPEOF(stringSEXP) == STRSXP && Rf_xlength(stringSEXP) > 0)
+      return stringElement(stringSEXP, 0);
+   else
+      return std::string();
+}
+
+bool inherits(SEXP objectSEXP, const char* className)
+{
+   SEXP classSEXP = attrib(objectSEXP, R_ClassSymbol);
+   if (TYPEOF(classSEXP) != STRSXP)
+      return false;
+
+   for (R_xlen_t i = 0, n = Rf_xlength(classSEXP); i < n; i++)
+   {
+      if (std::strcmp(CHAR(STRING_ELT(classSEXP, i)), className) == 0)
+         return true;
+   }
+   return false;
+}
+
+std::string formatReal(double value)
+{
+   if (ISNA(value))
+      return "NA";
+   else if (ISNAN(value))
+      return "NaN";
+   else if (!R_FINITE(value))
+      return value > 0 ? "Inf" : "-Inf";
+
+   char buffer[32];
+   std::snprintf(buffer, sizeof(buffer), "%.7g", value);
+   return buffer;
+}
+
+std::string formatElement(SEXP vectorSEXP, R_xlen_t i, SEXP levelsSEXP)
+{
+   switch (TYPEOF(vectorSEXP))
+   {
+   case LGLSXP:
+   {
+      int value = LOGICAL(vectorSEXP)[i];
+      if (value == NA_LOGICAL)
+         return "NA";
+      return value ? "TRUE" : "FALSE";
+   }
+   case INTSXP:
+   {
+      int value = INTEGER(vectorSEXP)[i];
+      if (value == NA_INTEGER)
+         return "NA";
+
+      // show the levels of factors rather than their codes
+      if (levelsSEXP != R_NilValue &&
+          value > 0 && value <= Rf_xlength(levelsSEXP))
+      {
+         return "\"" + stringElement(levelsSEXP, value - 1) + "\"";
+      }
+      return boost::lexical_cast<std::string>(value);
+   }
+   case REALSXP:
+      return formatReal(REAL(vectorSEXP)[i]);
+   case CPLXSXP:
+   {
+      Rcomplex value = COMPLEX(vectorSEXP)[i];
+      std::string imaginary = formatReal(value.i);
+      if (imaginary[0] != '-')
+         imaginary = "+" + imaginary;
+      return formatReal(value.r) + imaginary + "i";
+   }
+   case STRSXP:
+   {
+      if (STRING_ELT(vectorSEXP, i) == NA_STRING)
+         return "NA";
+      std::string value = stringElement(vectorSEXP, i);
+      truncate(&value, kMaxValueLength);
+      return "\"" + value + "\"";
+   }
+   case RAWSXP:
+   {
+      char buffer[3];
+      std::snprintf(buffer, sizeof(buffer), "%02x", RAW(vectorSEXP)[i]);
+      return buffer;
+   }
+   default:
+      return std::string();
+   }
+}
+
+// the first few elements of an atomic vector
+std::string formatElements(SEXP vectorSEXP, SEXP levelsSEXP)
+{
+   std::string value;
+   for (R_xlen_t i = 0, n = Rf_xlength(vectorSEXP); i < n; i++)
+   {
+      if (i == kMaxValueElements || value.size() >= kMaxValueLength)
+      {
+         value.append(" ...");
+         break;
+      }
+
+      if (i > 0)
+         value.push_back(' ');
+      value.append(formatElement(vectorSEXP, i, levelsSEXP));
+   }
+
+   truncate(&value, kMaxValueLength);
+   return value;
+}
+
+// the number of rows in a data frame, read from its row names (which are
+// stored compactly as c(NA, -n) when they're just the row numbers)
+R_xlen_t dataFrameRows(SEXP frameSEXP)
+{
+   SEXP rowNamesSEXP = attrib(frameSEXP, R_RowNamesSymbol);
+   if (TYPEOF(rowNamesSEXP) == INTSXP &&
+       Rf_xlength(rowNamesSEXP) == 2 &&
+       INTEGER(rowNamesSEXP)[0] == NA_INTEGER)
+   {
+      return std::abs(INTEGER(rowNamesSEXP)[1]);
+   }
+   return Rf_xlength(rowNamesSEXP);
+}
+
+std::string describeValue(SEXP valueSEXP, const std::string& className)
+{
+   std::string count;
+   switch (TYPEOF(valueSEXP))
+   {
+   case NILSXP:
+      return "NULL";
+
+   case LGLSXP:
+   case REALSXP:
+   case CPLXSXP:
+   case STRSXP:
+   case RAWSXP:
+      return formatElements(valueSEXP, R_NilValue);
+
+   case INTSXP:
+   {
+      SEXP levelsSEXP = attrib(valueSEXP, R_LevelsSymbol);
+      if (TYPEOF(levelsSEXP) != STRSXP || !inherits(valueSEXP, "factor"))
+         return formatElements(valueSEXP, R_NilValue);
+
+      count = boost::lexical_cast<std::string>(Rf_xlength(levelsSEXP));
+      return "Factor w/ " + count + " levels: " +
+             formatElements(valueSEXP, levelsSEXP);
+   }
+
+   case VECSXP:
+      count = boost::lexical_cast<std::string>(Rf_xlength(valueSEXP));
+      if (inherits(valueSEXP, "data.frame"))
+      {
+         return boost::lexical_cast<std::string>(dataFrameRows(valueSEXP)) +
+                " obs. of " + count + " variables";
+      }
+      return "List of " + count;
+
+   case EXPRSXP:
+      count = boost::lexical_cast<std::string>(Rf_xlength(valueSEXP));
+      return "Expression of length " + count;
+
+   case S4SXP:
+      return "Formal class '" + className + "'";
+
+   case CLOSXP:
+   case BUILTINSXP:
+   case SPECIALSXP:
+      return "function";
+
+   case SYMSXP:
+      return CHAR(PRINTNAME(valueSEXP));
+
+   default:
+      return "<" + std::string(Rf_type2char(TYPEOF(valueSEXP))) + ">";
+   }
+}
+
+} // anonymous namespace
+
+Error findObject(const std::string& name, SEXP envSEXP, SEXP* pObjectSEXP)
+{
+   if (envSEXP == NULL || TYPEOF(envSEXP) != ENVSXP)
+      return Error(errc::UnexpectedDataTypeError, ERROR_LOCATION);
+
+   // only the environment's own frame is searched: looking in its enclosures
+   // with Rf_findVar could fire active bindings there
+   SEXP objectSEXP = r::sexp::findVarInFrame(Rf_install(name.c_str()),
+                                             envSEXP);
+   if (objectSEXP == R_UnboundValue)
+   {
+      Error error(errc::SymbolNotFoundError, ERROR_LOCATION);
+      error.addProperty("symbol", name);
+      return error;
+   }
+
+   *pObjectSEXP = objectSEXP;
+   return Success();
+}
+
+int childCount(SEXP objectSEXP)
+{
+   SEXP valueSEXP = valueOf(objectSEXP);
+   switch (TYPEOF(valueSEXP))
+   {
+   case VECSXP:
+   case EXPRSXP:
+   {
+      R_xlen_t length = Rf_xlength(valueSEXP);
+      if (length > std::numeric_limits<int>::max())
+         return std::numeric_limits<int>::max();
+      return static_cast<int>(length);
+   }
+
+   // the slots of an S4 object are its attributes (other than its class)
+   case S4SXP:
+   {
+      int count = 0;
+      for (SEXP nodeSEXP = ATTRIB(valueSEXP);
+           nodeSEXP != R_NilValue;
+           nodeSEXP = CDR(nodeSEXP))
+      {
+         if (TAG(nodeSEXP) != R_ClassSymbol)
+            count++;
+      }
+      return count;
+   }
+
+   default:
+      return 0;
+   }
+}
+
+SEXP childAt(SEXP objectSEXP, int index, std::string* pName)
+{
+   pName->clear();
+
+   SEXP valueSEXP = valueOf(objectSEXP);
+   switch (TYPEOF(valueSEXP))
+   {
+   case VECSXP:
+   case EXPRSXP:
+   {
+      if (index < 0 || index >= Rf_xlength(valueSEXP))
+         break;
+
+      SEXP namesSEXP = attrib(valueSEXP, R_NamesSymbol);
+      if (TYPEOF(namesSEXP) == STRSXP &&
+          index < Rf_xlength(namesSEXP) &&
+          STRING_ELT(namesSEXP, index) != NA_STRING)
+      {
+         *pName = r::sexp::utf8String(STRING_ELT(namesSEXP, index));
+      }
+      if (pName->empty())
+         *pName = "[[" + boost::lexical_cast<std::string>(index + 1) + "]]";
+
+      return VECTOR_ELT(valueSEXP, index);
+   }
+
+   case S4SXP:
+   {
+      int i = 0;
+      for (SEXP nodeSEXP = ATTRIB(valueSEXP);
+           nodeSEXP != R_NilValue;
+           nodeSEXP = CDR(nodeSEXP))
+      {
+         if (TAG(nodeSEXP) == R_ClassSymbol)
+            continue;
+
+         if (i++ == index)
+         {
+            *pName = CHAR(PRINTNAME(TAG(nodeSEXP)));
+            return CAR(nodeSEXP);
+         }
+      }
+      break;
+   }
+
+   default:
+      break;
+   }
+
+   return R_NilValue;
+}
+
+json::Object summarize(const std::string& name, SEXP objectSEXP)
+{
+   json::Object summary;
+
+   std::string truncatedName = name;
+   truncate(&truncatedName, kMaxNameLength);
+   summary["name"] = truncatedName;
+
+   // describe unforced promises without forcing them
+   SEXP valueSEXP = valueOf(objectSEXP);
+   if (valueSEXP == R_UnboundValue)
+   {
+      summary["type"] = "promise";
+      summary["class"] = "promise";
+      summary["value"] = "<promise>";
+      summary["child_count"] = 0;
+      return summary;
+   }
+
+   std::string type = Rf_type2char(TYPEOF(valueSEXP));
+   std::string className = firstString(attrib(valueSEXP, R_ClassSymbol));
+   if (className.empty())
+      className = type;
+   truncate(&className, kMaxNameLength);
+
+   summary["type"] = type;
+   summary["class"] = className;
+
+   if (Rf_isVector(valueSEXP))
+      summary["length"] = static_cast<double>(Rf_xlength(valueSEXP));
+
+   SEXP dimSEXP = attrib(valueSEXP, R_DimSymbol);
+   if (TYPEOF(dimSEXP) == INTSXP)
+   {
+      json::Array dim;
+      for (R_xlen_t i = 0, n = Rf_xlength(dimSEXP); i < n; i++)
+         dim.push_back(INTEGER(dimSEXP)[i]);
+      summary["dim"] = dim;
+   }
+
+   summary["value"] = describeValue(valueSEXP, className);
+   summary["child_count"] = childCount(valueSEXP);
+
+   return summary;
+}
+
+json::Array inspectChildren(SEXP objectSEXP, int offset, int count)
+{
+   json::Array children;
+
+   int n = childCount(objectSEXP);
+   for (int i = std::max(offset, 0); i < n && count > 0; i++, count--)
+   {
+      std::string name;
+      SEXP childSEXP = childAt(objectSEXP, i, &name);
+      children.push_back(summarize(name, childSEXP));
+   }
+
+   return children;
+}
+
+} // namespace inspect
+} // namespace r
+} // namespace rstudio
@@ -20,6 +20,8 @@
 #include <r/RSexp.hpp>
 #include <r/RInternal.hpp>
 
+#include <cstdio>
+
 #include <core/Algorithm.hpp>
 
 #include <boost/bind.hpp>
@@ -53,6 +55,37 @@ using namespace core::r_util;
 
 namespace {
 
+bool isAscii(const char* str)
+{
+   for (; *str; ++str)
+   {
+      if (static_cast<unsigned char>(*str) > 0x7F)
+         return false;
+   }
+   return true;
+}
+
+// the string with its non-ASCII bytes escaped (as R prints them)
+std::string escapeBytes(const char* str)
+{
+   std::string escaped;
+   for (; *str; ++str)
+   {
+      unsigned char ch = static_cast<unsigned char>(*str);
+      if (ch > 0x7F)
+      {
+         char buffer[8];
+         std::snprintf(buffer, sizeof(buffer), "\\x%02x", ch);
+         escaped.append(buffer);
+      }
+      else
+      {
+         escaped.push_back(*str);
+      }
+   }
+   return escaped;
+}
+
 struct LexicalComparator
 {
    inline bool operator()(const char* lhs, const char* rhs) const
@@ -125,6 +158,34 @@ std::string asString(SEXP object)
     return std::string(Rf_translateChar(Rf_asChar(object)));
 }
    
+std::string utf8String(SEXP charSEXP)
+{
+   const char* str = CHAR(charSEXP);
+   cetype_t encoding = Rf_getCharCE(charSEXP);
+   if (encoding == CE_UTF8 || isAscii(str))
+      return str;
+
+   if (encoding != CE_BYTES)
+   {
+      // Rf_translateCharUTF8 allocates its result with R_alloc, so release
+      // it once we've copied it
+      const void* vmax = vmaxget();
+      const char* translated = NULL;
+      Error error = r::exec::executeSafely<const char*>(
+               boost::bind(Rf_translateCharUTF8, charSEXP),
+               &translated);
+      if (!error && translated != NULL)
+      {
+         std::string result(translated);
+         vmaxset(vmax);
+         return result;
+      }
+      vmaxset(vmax);
+   }
+
+   return escapeBytes(str);
+}
+
 std::string safeAsString(SEXP object, const std::string& defValue)
 {
    if (object != R_NilValue)
@@ -304,6 +365,68 @@ void listEnvironment(SEXP env,
    }
 }
 
+ObjectFingerprint::ObjectFingerprint()
+   : object(NULL),
+     type(NILSXP),
+     length(0),
+     attributes(NULL),
+     unevaluatedPromise(false)
+{
+}
+
+ObjectFingerprint::ObjectFingerprint(SEXP object)
+   : object(object),
+     type(TYPEOF(object)),
+     length(Rf_isVector(object) ? Rf_xlength(object) : 0),
+     attributes(ATTRIB(object)),
+     unevaluatedPromise(TYPEOF(object) == PROMSXP &&
+                        PRVALUE(object) == R_UnboundValue)
+{
+}
+
+bool ObjectFingerprint::operator==(const ObjectFingerprint& other) const
+{
+   return object == other.object &&
+          type == other.type &&
+          length == other.length &&
+          attributes == other.attributes &&
+          unevaluatedPromise == other.unevaluatedPromise;
+}
+
+void listEnvironmentBindings(SEXP env,
+                             bool includeLastDotValue,
+                             std::vector<Binding>* pBindings)
+{
+   pBindings->clear();
+
+   SEXP namesSEXP;
+   Protect rProtect(namesSEXP = R_lsInternal(env, FALSE));
+
+   int n = Rf_length(namesSEXP);
+   pBindings->reserve(n + 1);
+   for (int i = 0; i < n; i++)
+   {
+      SEXP symbolSEXP = Rf_install(CHAR(STRING_ELT(namesSEXP, i)));
+      bool active = R_BindingIsActive(symbolSEXP, env);
+
+      SEXP valueSEXP = R_NilValue;
+      if (!active)
+         valueSEXP = Rf_findVarInFrame(env, symbolSEXP);
+
+      if (valueSEXP != R_UnboundValue) // should never be unbound
+         pBindings->push_back(Binding(symbolSEXP, valueSEXP, active));
+   }
+
+   // add in .Last.value if it exists (it's bound in the base environment)
+   if (includeLastDotValue)
+   {
+      SEXP symbolSEXP = Rf_install(".Last.value");
+      SEXP valueSEXP = findVarInFrame(symbolSEXP, R_BaseEnv);
+      if (valueSEXP != R_UnboundValue)
+         pBindings->push_back(Binding(symbolSEXP, valueSEXP, false));
+   }
+}
+
 namespace {
 
 Error asPrimitiveEnvironment(SEXP envirSEXP,
@@ -440,6 +563,23 @@ SEXP findVar(const std::string &name, const SEXP env)
    return Rf_findVar(Rf_install(name.c_str()), env);
 }
 
+SEXP findVarInFrame(SEXP symbolSEXP, SEXP envSEXP)
+{
+   if (TYPEOF(envSEXP) != ENVSXP)
+      return R_UnboundValue;
+
+   // R_BindingIsActive throws an error for symbols which aren't bound in
+   // the frame, so check for that first
+   if (!R_existsVarInFrame(envSEXP, symbolSEXP))
+      return R_UnboundValue;
+
+   // looking up an active binding would fire it
+   if (R_BindingIsActive(symbolSEXP, envSEXP))
+      return R_NilValue;
+
+   return Rf_findVarInFrame(envSEXP, symbolSEXP);
+}
+
 SEXP findVar(const std::string& name, const std::string& ns)
 {
    if (name.empty())
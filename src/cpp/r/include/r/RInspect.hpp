@@ -0,0 +1,77 @@
+/*
+ * RInspect.hpp
+ *
+ * Copyright (C) 2009-17 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef R_R_INSPECT_HPP
+#define R_R_INSPECT_HPP
+
+#include <string>
+
+#include <core/json/Json.hpp>
+
+typedef struct SEXPREC *SEXP;
+
+namespace rstudio {
+namespace core {
+   class Error;
+}
+}
+
+// Inspects the children of list-like objects (the elements of lists, data
+// frames and expression vectors, and the slots of S4 objects) a page at a
+// time. Summaries are read from the objects themselves without evaluating any
+// R code, and are truncated to a fixed size, so the cost of inspecting a page
+// depends on neither the size of the object nor the size of its children.
+
+// IMPORTANT NOTE: all code in r::inspect must provide "no jump" guarantee.
+// See comment in RInternal.hpp for more info on this
+
+namespace rstudio {
+namespace r {
+namespace inspect {
+
+// find the named object in an environment's own frame (its enclosures aren't
+// searched). active bindings aren't fired (so are returned as nil) and
+// promises aren't forced
+core::Error findObject(const std::string& name,
+                       SEXP envSEXP,
+                       SEXP* pObjectSEXP);
+
+// the number of children the object has (zero for objects which can't be
+// inspected further, such as atomic vectors, functions and environments)
+int childCount(SEXP objectSEXP);
+
+// the child at the given index (which must be less than childCount)
+SEXP childAt(SEXP objectSEXP, int index, std::string* pName);
+
+// a summary of the object, with fields:
+//
+//    name         - the name the object was found under
+//    type         - the object's type (e.g. "list", "double")
+//    class        - the object's first class (or its type, if it has none)
+//    length       - the object's length (for vectors)
+//    dim          - the object's dimensions (if it has any)
+//    value        - a short description of the object's value
+//    child_count  - the number of children which can be inspected
+//
+core::json::Object summarize(const std::string& name, SEXP objectSEXP);
+
+// summaries of up to count children of the object, starting at offset
+core::json::Array inspectChildren(SEXP objectSEXP, int offset, int count);
+
+} // namespace inspect
+} // namespace r
+} // namespace rstudio
+
+#endif // R_R_INSPECT_HPP
@@ -61,12 +61,56 @@ void listEnvironment(SEXP env,
                      bool includeLastDotValue,
                      Protect* pProtect,
                      std::vector<Variable>* pVariables);
+
+// A cheap summary of an object which differs whenever the object is replaced
+// (or modified in a way that changes its type, length or attributes, or, for
+// a promise, when it's evaluated)
+struct ObjectFingerprint
+{
+   ObjectFingerprint();
+   explicit ObjectFingerprint(SEXP object);
+   bool operator==(const ObjectFingerprint& other) const;
+   bool operator!=(const ObjectFingerprint& other) const
+   {
+      return !(*this == other);
+   }
+
+   SEXP object;
+   int type;
+   R_xlen_t length;
+   SEXP attributes;
+   bool unevaluatedPromise;
+};
+
+// bindings within an environment (as listed by listEnvironment, but keyed by
+// symbol, so they can be compared without converting names to strings). the
+// value of an active binding isn't looked up (doing so would fire it) so is
+// left as nil
+struct Binding
+{
+   Binding(SEXP symbol, SEXP value, bool active)
+      : symbol(symbol), value(value), active(active)
+   {
+   }
+
+   SEXP symbol;
+   SEXP value;
+   bool active;
+};
+void listEnvironmentBindings(SEXP env,
+                             bool includeLastDotValue,
+                             std::vector<Binding>* pBindings);
       
 // object info
 SEXP findVar(const std::string& name,
              const std::string& ns = std::string()); 
 SEXP findVar(const std::string& name,
              const SEXP env);
+
+// the value bound to the symbol in the environment's own frame (its
+// enclosures aren't searched), or R_UnboundValue if there's none. active
+// bindings aren't fired (so are returned as nil) and promises aren't forced
+SEXP findVarInFrame(SEXP symbolSEXP, SEXP envSEXP);
 SEXP findFunction(const std::string& name,
                   const std::string& ns = std::string());
 std::string typeAsString(SEXP object);
@@ -95,6 +139,11 @@ bool isPrimitiveEnvironment(SEXP object);
 
 // type coercions
 std::string asString(SEXP object);
+
+// the contents of a CHARSXP as UTF-8. Rf_translateCharUTF8 errors for
+// strings with "bytes" encoding (and can for strings it can't convert), so
+// those have their non-ASCII bytes escaped (as R prints them) instead
+std::string utf8String(SEXP charSEXP);
 std::string safeAsString(SEXP object, 
                          const std::string& defValue = std::string());
 int asInteger(SEXP object);
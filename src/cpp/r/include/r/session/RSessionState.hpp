@@ -23,6 +23,8 @@
 #include <core/Error.hpp>
 #include <core/Version.hpp>
 
+typedef struct SEXPREC *SEXP;
+
 namespace rstudio {
 namespace core {
    class FilePath;
@@ -53,13 +55,23 @@ bool rProfileOnRestore(const core::FilePath& statePath);
 
 bool packratModeEnabled(const core::FilePath& statePath);
 
+// when restoring the global environment lazily, objects are read from the
+// state path when first accessed (so it must not be removed after restoring)
 bool restore(const core::FilePath& statePath, 
              bool serverMode,
+             bool lazyGlobalEnvironment,
              boost::function<core::Error()>* pDeferredRestoreAction,
              std::string* pErrorMessages); 
    
 bool destroy(const core::FilePath& statePath);
 
+// objects in the global environment which were restored lazily (and haven't
+// yet been read) are bound to promises. for those this provides a list
+// describing the object (its class, length, size, whether it's a data frame
+// and if so its number of rows) as recorded when it was saved, so that it
+// can be listed without being read. returns R_NilValue for other objects
+SEXP lazyObjectInfo(SEXP objectSEXP);
+
 SessionStateInfo getSessionStateInfo();
      
 } // namespace state
@@ -42,6 +42,8 @@
 #include <r/RExec.hpp>
 #include <r/RInterface.hpp>
 
+#include "RStateChunks.hpp"
+
 using namespace rstudio::core ;
 
 namespace rstudio {
@@ -55,6 +57,7 @@ namespace search_path {
 namespace {   
 
 const char * const kEnvironmentFile = "environment";
+const char * const kEnvironmentStateDir = "environment_state";
 const char * const kSearchPathDir = "search_path";
    
 const char * const kSearchPathElementsDir = "search_path_elements";
@@ -80,16 +83,26 @@ void reportRestoreError(const std::string& context,
    REprintf(report.c_str());
 }   
    
-Error saveGlobalEnvironmentToFile(const FilePath& environmentFile)
+Error saveGlobalEnvironmentState(const FilePath& statePath, bool compress)
 {
-   std::string envPath =
-            string_utils::utf8ToSystem(environmentFile.absolutePath());
-   return executeSafely(boost::bind(R_SaveGlobalEnvToFile, envPath.c_str()));
+   Error error = state_chunks::save(R_GlobalEnv,
+                                    statePath.complete(kEnvironmentStateDir),
+                                    compress);
+   if (error)
+      return error;
+
+   // remove any environment saved by earlier versions
+   return statePath.complete(kEnvironmentFile).removeIfExists();
 }
-   
-Error restoreGlobalEnvironment(const core::FilePath& environmentFile)
+
+Error restoreGlobalEnvironment(const core::FilePath& statePath, bool lazy)
 {
+   FilePath environmentStateDir = statePath.complete(kEnvironmentStateDir);
+   if (state_chunks::hasState(environmentStateDir))
+      return state_chunks::restore(environmentStateDir, R_GlobalEnv, lazy);
+
    // tolerate no environment saved
+   FilePath environmentFile = statePath.complete(kEnvironmentFile);
    if (!environmentFile.exists())
       return Success();
    
@@ -226,11 +239,10 @@ void attachEnvironmentData(const FilePath& dataFilePath,
 } // anonymous namespace
    
 
-Error save(const FilePath& statePath)
+Error save(const FilePath& statePath, bool compress)
 {
    // save the global environment
-   FilePath environmentFile = statePath.complete(kEnvironmentFile);
-   Error error = saveGlobalEnvironmentToFile(environmentFile);
+   Error error = saveGlobalEnvironmentState(statePath, compress);
    if (error)
       return error;
    
@@ -320,10 +332,9 @@ Error save(const FilePath& statePath)
 }
 
 
-Error saveGlobalEnvironment(const FilePath& statePath)
+Error saveGlobalEnvironment(const FilePath& statePath, bool compress)
 {
-   FilePath environmentFile = statePath.complete(kEnvironmentFile);
-   return saveGlobalEnvironmentToFile(environmentFile);
+   return saveGlobalEnvironmentState(statePath, compress);
 }
 
 Error restoreSearchPath(const FilePath& statePath)
@@ -399,11 +410,12 @@ Error restoreSearchPath(const FilePath& statePath)
    return Success();
 }
 
-Error restore(const FilePath& statePath, bool isCompatibleSessionState)
+Error restore(const FilePath& statePath,
+              bool isCompatibleSessionState,
+              bool lazyGlobalEnvironment)
 {
    // restore global environment
-   FilePath environmentFile = statePath.complete(kEnvironmentFile);
-   Error error = restoreGlobalEnvironment(environmentFile);
+   Error error = restoreGlobalEnvironment(statePath, lazyGlobalEnvironment);
    if (error)
       return error;
    
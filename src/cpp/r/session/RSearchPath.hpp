@@ -28,9 +28,12 @@ namespace r {
 namespace session {
 namespace search_path {
 
-core::Error save(const core::FilePath& statePath);
-core::Error saveGlobalEnvironment(const core::FilePath& statePath);
-core::Error restore(const core::FilePath& statePath, bool isCompatibleSessionState = true);
+core::Error save(const core::FilePath& statePath, bool compress);
+core::Error saveGlobalEnvironment(const core::FilePath& statePath,
+                                  bool compress);
+core::Error restore(const core::FilePath& statePath,
+                    bool isCompatibleSessionState = true,
+                    bool lazyGlobalEnvironment = false);
    
 } // namespace search_path
 } // namespace session
@@ -52,6 +52,7 @@
 #include "RClientMetrics.hpp"
 #include "RRestartContext.hpp"
 #include "REmbedded.hpp"
+#include "RStateChunks.hpp"
 
 #include "graphics/RGraphicsDevDesc.hpp"
 #include "graphics/RGraphicsUtils.hpp"
@@ -366,6 +367,7 @@ const int kSerializationActionResumeSession = 4;
 const int kSerializationActionCompleted = 5;
 
 void restoreSession(const FilePath& suspendedSessionPath,
+                    bool lazyGlobalEnvironment,
                     std::string* pErrorMessages)
 {
    // don't show output during deserialization (packages loaded
@@ -380,6 +382,7 @@ void restoreSession(const FilePath& suspendedSessionPath,
    boost::function<Error()> deferredRestoreAction;
    r::session::state::restore(suspendedSessionPath,
                               s_options.serverMode,
+                              lazyGlobalEnvironment,
                               &deferredRestoreAction,
                               pErrorMessages);
 
@@ -465,9 +468,12 @@ Error initialize()
    // first check for a pending restart
    if (restartContext().hasSessionState())
    {
-      // restore session
+      // restore session (the restart context is removed once restored, so
+      // nothing can be restored lazily from it)
       std::string errorMessages ;
-      restoreSession(restartContext().sessionStatePath(), &errorMessages);
+      restoreSession(restartContext().sessionStatePath(),
+                     false,
+                     &errorMessages);
 
       // show any error messages
       if (!errorMessages.empty())
@@ -480,7 +486,7 @@ Error initialize()
    {  
       // restore session
       std::string errorMessages ;
-      restoreSession(s_suspendedSessionPath, &errorMessages);
+      restoreSession(s_suspendedSessionPath, true, &errorMessages);
       
       // show any error messages
       if (!errorMessages.empty())
@@ -1488,6 +1494,9 @@ Error run(const ROptions& options, const RCallbacks& callbacks)
    RS_REGISTER_CALL_METHOD(rs_GEcopyDisplayList, 1);
    RS_REGISTER_CALL_METHOD(rs_GEplayDisplayList, 0);
 
+   // register session state methods
+   state_chunks::initialize();
+
    // run R
 
    // should we run .Rprofile?
@@ -38,6 +38,7 @@
 
 #include "RClientMetrics.hpp"
 #include "RSearchPath.hpp"
+#include "RStateChunks.hpp"
 #include "graphics/RGraphicsPlotManager.hpp"
 
 using namespace rstudio::core ;
@@ -404,7 +405,7 @@ bool save(const FilePath& statePath,
 
    if (!excludePackages)
    {
-      error = search_path::save(statePath);
+      error = search_path::save(statePath, !disableSaveCompression);
       if (error)
       {
          reportError(kSaving, kSearchPath, error, ERROR_LOCATION);
@@ -413,7 +414,8 @@ bool save(const FilePath& statePath,
    }
    else
    {
-      error = search_path::saveGlobalEnvironment(statePath);
+      error = search_path::saveGlobalEnvironment(statePath,
+                                                 !disableSaveCompression);
       if (error)
       {
          reportError(kSaving, kGlobalEnvironment, error, ERROR_LOCATION);
@@ -454,7 +456,7 @@ bool saveMinimal(const core::FilePath& statePath,
       if (error)
          LOG_ERROR(error);
 
-      error = search_path::saveGlobalEnvironment(statePath);
+      error = search_path::saveGlobalEnvironment(statePath, false);
       if (error)
       {
          reportError(kSaving, kGlobalEnvironment, error, ERROR_LOCATION);
@@ -497,10 +499,14 @@ bool packratModeEnabled(const core::FilePath& statePath)
    return getBoolSetting(statePath, kPackratModeOn, false);
 }
 
-Error deferredRestore(const FilePath& statePath, bool serverMode)
+Error deferredRestore(const FilePath& statePath,
+                      bool serverMode,
+                      bool lazyGlobalEnvironment)
 {
    // search path
-   Error error = search_path::restore(statePath, s_isCompatibleSessionState);
+   Error error = search_path::restore(statePath,
+                                      s_isCompatibleSessionState,
+                                      lazyGlobalEnvironment);
    if (error)
       return error;
    
@@ -562,6 +568,7 @@ bool validateRestoredRVersion(const FilePath& filePath)
    
 bool restore(const FilePath& statePath,
              bool serverMode,
+             bool lazyGlobalEnvironment,
              boost::function<Error()>* pDeferredRestoreAction,
              std::string* pErrorMessages)
 {
@@ -640,7 +647,10 @@ bool restore(const FilePath& statePath,
    // process that are potentially highly latent. this allows clients
    // to bring their UI up and then receive an event indicating that the
    // latent deserialization actions are taking place
-   *pDeferredRestoreAction = boost::bind(deferredRestore, statePath, serverMode);
+   *pDeferredRestoreAction = boost::bind(deferredRestore,
+                                         statePath,
+                                         serverMode,
+                                         lazyGlobalEnvironment);
    
    // return true if there were no error messages
    return pErrorMessages->empty();
@@ -660,6 +670,11 @@ bool destroy(const FilePath& statePath)
    }
 }
 
+SEXP lazyObjectInfo(SEXP objectSEXP)
+{
+   return state_chunks::lazyObjectInfo(objectSEXP);
+}
+
 SessionStateInfo getSessionStateInfo()
 {
    SessionStateInfo info;
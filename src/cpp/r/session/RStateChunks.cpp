@@ -0,0 +1,1217 @@
+/*
+ * RStateChunks.cpp
+ *
+ * Copyright (C) 2009-17 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "RStateChunks.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <set>
+#include <sstream>
+
+#include <boost/bind.hpp>
+#include <boost/crc.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/foreach.hpp>
+#include <boost/shared_ptr.hpp>
+
+#ifndef _WIN32
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#endif
+
+#include <core/Error.hpp>
+#include <core/FilePath.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/Log.hpp>
+#include <core/StringUtils.hpp>
+#include <core/Thread.hpp>
+#include <core/json/JsonRpc.hpp>
+
+#define R_INTERNAL_FUNCTIONS
+#include <r/RInternal.hpp>
+#include <r/RExec.hpp>
+#include <r/RRoutines.hpp>
+#include <r/RSexp.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace r {
+namespace session {
+namespace state_chunks {
+
+namespace {
+
+const char * const kIndexFile = "index";
+const char * const kChunksDir = "chunks";
+const char * const kSharedFile = "shared";
+const char * const kTempChunkFile = "chunk.tmp";
+
+const char * const kObjects = "objects";
+const char * const kChunks = "chunks";
+const char * const kBlocks = "blocks";
+const char * const kInfo = "info";
+
+// identifies (and versions) the chunk file format
+const char kChunkMagic[] = { 'R', 'S', 'C', '1' };
+
+// serialized objects are split into blocks which are hashed and compressed
+// independently (and therefore concurrently)
+const std::size_t kBlockSize = 4 * 1024 * 1024;
+const unsigned int kMaxThreads = 8;
+
+boost::uint64_t fnv1aHash(const char* data,
+                          std::size_t size,
+                          boost::uint64_t hash = 14695981039346656037ULL)
+{
+   for (std::size_t i = 0; i < size; i++)
+   {
+      hash ^= static_cast<unsigned char>(data[i]);
+      hash *= 1099511628211ULL;
+   }
+   return hash;
+}
+
+struct Block
+{
+   Block()
+      : rawSize(0), crc(0), hash(0), compress(false), compressed(false),
+        matched(false), done(false)
+   {
+   }
+
+   // the raw contents, replaced by the compressed contents if smaller
+   std::string data;
+   boost::uint32_t rawSize;
+   boost::uint32_t crc;
+   boost::uint64_t hash;
+   bool compress;
+   bool compressed;
+
+   // the digest of the block in the same position of the previous chunk for
+   // the object (if any), and whether this block matched it
+   std::string prevDigest;
+   bool matched;
+
+   bool done;
+};
+
+// identifies the raw contents of a block (these are recorded in the index
+// so that unchanged blocks can be recognized when the object is next saved)
+std::string blockDigest(const Block& block)
+{
+   std::ostringstream ostr;
+   ostr << std::hex << std::setfill('0')
+        << std::setw(16) << block.hash
+        << std::setw(8) << block.crc
+        << std::setw(8) << block.rawSize;
+   return ostr.str();
+}
+
+void compressBlock(Block* pBlock)
+{
+#ifndef _WIN32
+   if (pBlock->compress && !pBlock->compressed)
+   {
+      try
+      {
+         std::string compressed;
+         boost::iostreams::filtering_ostream filteringStream;
+         filteringStream.push(boost::iostreams::zlib_compressor(
+                                 boost::iostreams::zlib::best_speed));
+         filteringStream.push(boost::iostreams::back_inserter(compressed));
+         filteringStream.write(pBlock->data.data(), pBlock->data.size());
+         filteringStream.reset();
+
+         if (compressed.size() < pBlock->data.size())
+         {
+            pBlock->data.swap(compressed);
+            pBlock->compressed = true;
+         }
+      }
+      catch(const std::exception& e)
+      {
+         // the block is still stored (uncompressed)
+         LOG_ERROR_MESSAGE(std::string("Error compressing chunk: ") +
+                           e.what());
+      }
+   }
+#endif
+}
+
+void processBlock(Block* pBlock)
+{
+   boost::crc_32_type crc;
+   crc.process_bytes(pBlock->data.data(), pBlock->data.size());
+   pBlock->crc = crc.checksum();
+   pBlock->hash = fnv1aHash(pBlock->data.data(), pBlock->data.size());
+
+   // blocks which are unchanged from the previous chunk are only written if
+   // a later block differs, and are then copied from the previous chunk
+   // (so needn't be compressed)
+   pBlock->matched = !pBlock->prevDigest.empty() &&
+                     blockDigest(*pBlock) == pBlock->prevDigest;
+   if (!pBlock->matched)
+      compressBlock(pBlock);
+}
+
+Error decompressBlock(const std::string& compressed, std::string* pData)
+{
+#ifndef _WIN32
+   try
+   {
+      boost::iostreams::filtering_ostream filteringStream;
+      filteringStream.push(boost::iostreams::zlib_decompressor());
+      filteringStream.push(boost::iostreams::back_inserter(*pData));
+      filteringStream.write(compressed.data(), compressed.size());
+      filteringStream.reset();
+      return Success();
+   }
+   catch(const std::exception& e)
+   {
+      Error error = systemError(boost::system::errc::io_error,
+                                ERROR_LOCATION);
+      error.addProperty("what", e.what());
+      return error;
+   }
+#else
+   return systemError(boost::system::errc::not_supported, ERROR_LOCATION);
+#endif
+}
+
+template <typename T>
+void writeValue(std::ostream& os, T value)
+{
+   os.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+bool readValue(std::istream& is, T* pValue)
+{
+   is.read(reinterpret_cast<char*>(pValue), sizeof(T));
+   return is.good();
+}
+
+// Accepts the stream of bytes from serializing an object, hashing it and
+// writing it to a chunk file as a sequence of blocks. Blocks are hashed and
+// compressed by worker threads while R serializes the next, and are then
+// written in order. When the object was saved before, leading blocks which
+// match those of its previous chunk aren't compressed or written unless a
+// later block differs, so an unchanged object is serialized and hashed once
+// but never compressed or written.
+class ChunkWriter : boost::noncopyable
+{
+public:
+   ChunkWriter()
+      : threadCount_(0), stopping_(false), compress_(false), pOutput_(NULL),
+        failed_(false), blockIndex_(0), deferred_(0), diverged_(false),
+        hash_(0), size_(0)
+   {
+   }
+
+   ~ChunkWriter()
+   {
+      try
+      {
+         {
+            boost::lock_guard<boost::mutex> lock(mutex_);
+            stopping_ = true;
+         }
+         queueCondition_.notify_all();
+         threads_.join_all();
+      }
+      catch(...)
+      {
+      }
+   }
+
+   void start()
+   {
+      unsigned int threads = std::min(boost::thread::hardware_concurrency(),
+                                      kMaxThreads);
+      for (unsigned int i = 0; i < threads; i++)
+      {
+         try
+         {
+            threads_.create_thread(boost::bind(&ChunkWriter::work, this));
+            threadCount_++;
+         }
+         catch(const boost::thread_resource_error& e)
+         {
+            // blocks are processed inline if we have no threads
+            LOG_ERROR(Error(boost::thread_error::ec_from_exception(e),
+                            ERROR_LOCATION));
+            break;
+         }
+      }
+   }
+
+   // begin a chunk (given the previous chunk for the object and the
+   // digests of its blocks, if there is one)
+   void begin(bool compress,
+              std::ostream* pOutput,
+              const FilePath& prevChunk,
+              const std::vector<std::string>& prevBlocks)
+   {
+      compress_ = compress;
+      pOutput_ = pOutput;
+      failed_ = false;
+      prevChunk_ = prevChunk;
+      prevBlocks_ = prevBlocks;
+      blockIndex_ = 0;
+      deferred_ = 0;
+      diverged_ = false;
+      blocks_.clear();
+      hash_ = fnv1aHash(NULL, 0);
+      crc_.reset();
+      size_ = 0;
+
+      pOutput_->write(kChunkMagic, sizeof(kChunkMagic));
+   }
+
+   // called back from serialization (so must not throw)
+   void write(const char* data, std::size_t size)
+   {
+      try
+      {
+         while (size > 0)
+         {
+            if (!pCurrent_)
+            {
+               pCurrent_.reset(new Block());
+               pCurrent_->data.reserve(kBlockSize);
+            }
+
+            std::size_t count = std::min(size,
+                                         kBlockSize - pCurrent_->data.size());
+            pCurrent_->data.append(data, count);
+            data += count;
+            size -= count;
+
+            if (pCurrent_->data.size() == kBlockSize)
+               submitCurrent();
+         }
+      }
+      catch(...)
+      {
+         failed_ = true;
+      }
+   }
+
+   // complete the chunk, returning its id (a hash of its contents), the
+   // digests of its blocks and whether it is the same as the previous chunk
+   // (in which case nothing after the header has been written)
+   Error end(std::string* pId,
+             std::vector<std::string>* pBlocks,
+             bool* pUnchanged)
+   {
+      try
+      {
+         if (pCurrent_ && !pCurrent_->data.empty())
+            submitCurrent();
+         while (!inFlight_.empty())
+            completeFront();
+
+         // a prefix of the previous chunk isn't the same chunk
+         if (!diverged_ && blocks_.size() != prevBlocks_.size())
+            copyDeferred();
+      }
+      catch(...)
+      {
+         failed_ = true;
+      }
+
+      pCurrent_.reset();
+      inFlight_.clear();
+
+      if (failed_ || !pOutput_->good())
+         return systemError(boost::system::errc::io_error, ERROR_LOCATION);
+
+      pBlocks->swap(blocks_);
+      *pUnchanged = !diverged_;
+
+      // a non-cryptographic (but wide enough for our purposes) hash of the
+      // block hashes, along with the length of the contents
+      std::ostringstream ostr;
+      ostr << std::hex << std::setfill('0')
+           << std::setw(16) << hash_
+           << std::setw(8) << crc_.checksum()
+           << "-" << size_;
+      *pId = ostr.str();
+      return Success();
+   }
+
+private:
+   void submitCurrent()
+   {
+      pCurrent_->rawSize = static_cast<boost::uint32_t>(
+                                                pCurrent_->data.size());
+      pCurrent_->compress = compress_;
+      if (blockIndex_ < prevBlocks_.size())
+         pCurrent_->prevDigest = prevBlocks_[blockIndex_];
+      blockIndex_++;
+
+      // bound the memory held by blocks in flight
+      while (inFlight_.size() >= std::max(2 * threadCount_, 1U))
+         completeFront();
+
+      inFlight_.push_back(pCurrent_);
+      if (threadCount_ > 0)
+      {
+         {
+            boost::lock_guard<boost::mutex> lock(mutex_);
+            queue_.push_back(pCurrent_);
+         }
+         queueCondition_.notify_one();
+      }
+      else
+      {
+         processBlock(pCurrent_.get());
+         pCurrent_->done = true;
+      }
+
+      pCurrent_.reset();
+   }
+
+   void completeFront()
+   {
+      boost::shared_ptr<Block> pBlock = inFlight_.front();
+      {
+         boost::unique_lock<boost::mutex> lock(mutex_);
+         while (!pBlock->done)
+            doneCondition_.wait(lock);
+      }
+      inFlight_.pop_front();
+
+      // fold the block's hashes into the chunk's
+      boost::uint32_t storedSize = static_cast<boost::uint32_t>(
+                                                      pBlock->data.size());
+      char digest[sizeof(pBlock->hash) + sizeof(pBlock->crc) +
+                  sizeof(pBlock->rawSize)];
+      std::memcpy(digest, &pBlock->hash, sizeof(pBlock->hash));
+      std::memcpy(digest + sizeof(pBlock->hash),
+                  &pBlock->crc,
+                  sizeof(pBlock->crc));
+      std::memcpy(digest + sizeof(pBlock->hash) + sizeof(pBlock->crc),
+                  &pBlock->rawSize,
+                  sizeof(pBlock->rawSize));
+      hash_ = fnv1aHash(digest, sizeof(digest), hash_);
+      crc_.process_bytes(digest, sizeof(digest));
+      size_ += pBlock->rawSize;
+      blocks_.push_back(blockDigest(*pBlock));
+
+      // defer writing blocks while they match the previous chunk
+      if (!diverged_ && pBlock->matched)
+      {
+         deferred_++;
+         return;
+      }
+      if (!diverged_)
+         copyDeferred();
+
+      // matching blocks after the chunk diverged weren't compressed
+      if (pBlock->matched)
+      {
+         compressBlock(pBlock.get());
+         storedSize = static_cast<boost::uint32_t>(pBlock->data.size());
+      }
+
+      writeValue(*pOutput_, pBlock->rawSize);
+      writeValue(*pOutput_, storedSize);
+      writeValue(*pOutput_, static_cast<boost::uint8_t>(pBlock->compressed));
+      pOutput_->write(pBlock->data.data(), storedSize);
+   }
+
+   // write the deferred blocks (those which matched the start of the
+   // previous chunk) by copying them from the previous chunk
+   void copyDeferred()
+   {
+      diverged_ = true;
+      if (deferred_ == 0)
+         return;
+
+      boost::shared_ptr<std::istream> pInput;
+      Error error = prevChunk_.open_r(&pInput);
+      if (error)
+      {
+         LOG_ERROR(error);
+         failed_ = true;
+         return;
+      }
+
+      pInput->seekg(sizeof(kChunkMagic));
+      for (std::size_t i = 0; i < deferred_; i++)
+      {
+         boost::uint32_t rawSize, storedSize;
+         boost::uint8_t compressed;
+         if (!readValue(*pInput, &rawSize) ||
+             !readValue(*pInput, &storedSize) ||
+             !readValue(*pInput, &compressed))
+         {
+            failed_ = true;
+            return;
+         }
+
+         std::string stored(storedSize, '\0');
+         pInput->read(&stored[0], storedSize);
+         if (pInput->gcount() != static_cast<std::streamsize>(storedSize))
+         {
+            failed_ = true;
+            return;
+         }
+
+         writeValue(*pOutput_, rawSize);
+         writeValue(*pOutput_, storedSize);
+         writeValue(*pOutput_, compressed);
+         pOutput_->write(stored.data(), storedSize);
+      }
+      deferred_ = 0;
+   }
+
+   void work()
+   {
+      while (true)
+      {
+         boost::shared_ptr<Block> pBlock;
+         {
+            boost::unique_lock<boost::mutex> lock(mutex_);
+            while (queue_.empty() && !stopping_)
+               queueCondition_.wait(lock);
+            if (stopping_)
+               return;
+
+            pBlock = queue_.front();
+            queue_.pop_front();
+         }
+
+         processBlock(pBlock.get());
+
+         {
+            boost::lock_guard<boost::mutex> lock(mutex_);
+            pBlock->done = true;
+         }
+         doneCondition_.notify_all();
+      }
+   }
+
+private:
+   boost::thread_group threads_;
+   unsigned int threadCount_;
+   boost::mutex mutex_;
+   boost::condition_variable queueCondition_;
+   boost::condition_variable doneCondition_;
+   std::deque<boost::shared_ptr<Block> > queue_;
+   bool stopping_;
+
+   // state of the current chunk (only touched by the serializing thread)
+   bool compress_;
+   std::ostream* pOutput_;
+   bool failed_;
+   FilePath prevChunk_;
+   std::vector<std::string> prevBlocks_;
+   std::size_t blockIndex_;
+   std::size_t deferred_;
+   bool diverged_;
+   std::vector<std::string> blocks_;
+   boost::shared_ptr<Block> pCurrent_;
+   std::deque<boost::shared_ptr<Block> > inFlight_;
+   boost::uint64_t hash_;
+   boost::crc_32_type crc_;
+   boost::uint64_t size_;
+};
+
+// Reads the serialized contents of a chunk back, a block at a time
+class ChunkReader : boost::noncopyable
+{
+public:
+   ChunkReader()
+      : pos_(0)
+   {
+   }
+
+   Error open(const FilePath& chunkPath)
+   {
+      Error error = chunkPath.open_r(&pInput_);
+      if (error)
+         return error;
+
+      char magic[sizeof(kChunkMagic)];
+      pInput_->read(magic, sizeof(magic));
+      if (!pInput_->good() ||
+          !std::equal(magic, magic + sizeof(magic), kChunkMagic))
+      {
+         error = systemError(boost::system::errc::illegal_byte_sequence,
+                             ERROR_LOCATION);
+         error.addProperty("path", chunkPath);
+         return error;
+      }
+
+      return Success();
+   }
+
+   // returns false if the chunk is truncated or corrupt
+   bool read(char* buffer, std::size_t size)
+   {
+      while (size > 0)
+      {
+         if (pos_ == block_.size() && !nextBlock())
+            return false;
+
+         std::size_t count = std::min(size, block_.size() - pos_);
+         std::memcpy(buffer, block_.data() + pos_, count);
+         pos_ += count;
+         buffer += count;
+         size -= count;
+      }
+      return true;
+   }
+
+private:
+   bool nextBlock()
+   {
+      boost::uint32_t rawSize, storedSize;
+      boost::uint8_t compressed;
+      if (!readValue(*pInput_, &rawSize) ||
+          !readValue(*pInput_, &storedSize) ||
+          !readValue(*pInput_, &compressed))
+      {
+         return false;
+      }
+
+      std::string stored(storedSize, '\0');
+      pInput_->read(&stored[0], storedSize);
+      if (pInput_->gcount() != static_cast<std::streamsize>(storedSize))
+         return false;
+
+      block_.clear();
+      pos_ = 0;
+      if (compressed)
+      {
+         block_.reserve(rawSize);
+         Error error = decompressBlock(stored, &block_);
+         if (error)
+         {
+            LOG_ERROR(error);
+            return false;
+         }
+      }
+      else
+      {
+         block_.swap(stored);
+      }
+
+      return block_.size() == rawSize;
+   }
+
+private:
+   boost::shared_ptr<std::istream> pInput_;
+   std::string block_;
+   std::size_t pos_;
+};
+
+// set when the object being serialized refers to an environment (or other
+// reference object) which can't be saved independently
+bool s_hasReferences = false;
+
+void outBytes(R_outpstream_t stream, void* buffer, int length)
+{
+   // the rest of the object won't be used
+   if (s_hasReferences)
+      return;
+
+   ChunkWriter* pWriter = static_cast<ChunkWriter*>(stream->data);
+   pWriter->write(static_cast<const char*>(buffer), length);
+}
+
+void outChar(R_outpstream_t stream, int c)
+{
+   char ch = static_cast<char>(c);
+   outBytes(stream, &ch, 1);
+}
+
+SEXP referenceHook(SEXP objectSEXP, SEXP dataSEXP)
+{
+   s_hasReferences = true;
+
+   // serialize as normal
+   return R_NilValue;
+}
+
+void serialize(SEXP objectSEXP, ChunkWriter* pWriter)
+{
+   struct R_outpstream_st stream;
+   R_InitOutPStream(&stream,
+                    pWriter,
+                    R_pstream_binary_format,
+                    2,
+                    outChar,
+                    outBytes,
+                    referenceHook,
+                    R_NilValue);
+   R_Serialize(objectSEXP, &stream);
+}
+
+void inBytes(R_inpstream_t stream, void* buffer, int length)
+{
+   ChunkReader* pReader = static_cast<ChunkReader*>(stream->data);
+   if (!pReader->read(static_cast<char*>(buffer), length))
+      r::exec::error("Unexpected end of saved object");
+}
+
+int inChar(R_inpstream_t stream)
+{
+   char ch;
+   inBytes(stream, &ch, 1);
+   return static_cast<unsigned char>(ch);
+}
+
+SEXP unserialize(ChunkReader* pReader)
+{
+   struct R_inpstream_st stream;
+   R_InitInPStream(&stream,
+                   pReader,
+                   R_pstream_binary_format,
+                   inChar,
+                   inBytes,
+                   NULL,
+                   R_NilValue);
+   return R_Unserialize(&stream);
+}
+
+Error readChunk(const FilePath& chunkPath,
+                r::sexp::Protect* pProtect,
+                SEXP* pObjectSEXP)
+{
+   ChunkReader reader;
+   Error error = reader.open(chunkPath);
+   if (error)
+      return error;
+
+   error = r::exec::executeSafely<SEXP>(boost::bind(unserialize, &reader),
+                                        pObjectSEXP);
+   if (error)
+      return error;
+
+   pProtect->add(*pObjectSEXP);
+   return Success();
+}
+
+SEXP rs_readStateChunk(SEXP chunkPathSEXP)
+{
+   FilePath chunkPath(string_utils::systemToUtf8(
+                                    r::sexp::asString(chunkPathSEXP)));
+
+   r::sexp::Protect protect;
+   SEXP objectSEXP = R_NilValue;
+   Error error = readChunk(chunkPath, &protect, &objectSEXP);
+   if (error)
+   {
+      LOG_ERROR(error);
+      r::exec::error("Unable to restore object from " +
+                     chunkPath.absolutePath());
+   }
+
+   return objectSEXP;
+}
+
+// serialize an object to a chunk file
+Error serializeObject(SEXP valueSEXP,
+                      ChunkWriter* pWriter,
+                      std::ostream* pOutput,
+                      bool compress,
+                      const FilePath& prevChunk,
+                      const std::vector<std::string>& prevBlocks,
+                      std::string* pId,
+                      std::vector<std::string>* pBlocks,
+                      bool* pUnchanged,
+                      bool* pHasReferences)
+{
+   s_hasReferences = false;
+   pWriter->begin(compress, pOutput, prevChunk, prevBlocks);
+   Error serializeError = r::exec::executeSafely(boost::bind(serialize,
+                                                             valueSEXP,
+                                                             pWriter));
+   Error error = pWriter->end(pId, pBlocks, pUnchanged);
+   *pHasReferences = s_hasReferences;
+   return serializeError ? serializeError : error;
+}
+
+// is this a promise to read a chunk (from a lazy restore)? if so provides
+// the path to the chunk and the description of the object it was bound with
+bool isChunkPromise(SEXP promiseSEXP,
+                    std::string* pChunkPath,
+                    SEXP* pInfoSEXP = NULL)
+{
+   SEXP codeSEXP = PRCODE(promiseSEXP);
+   if (TYPEOF(codeSEXP) != LANGSXP ||
+       CAR(codeSEXP) != Rf_install(".rs.readStateChunk"))
+   {
+      return false;
+   }
+
+   SEXP pathSEXP = CADR(codeSEXP);
+   if (TYPEOF(pathSEXP) != STRSXP || Rf_length(pathSEXP) != 1)
+      return false;
+
+   *pChunkPath = string_utils::systemToUtf8(r::sexp::asString(pathSEXP));
+   if (pInfoSEXP)
+   {
+      SEXP argsSEXP = CDDR(codeSEXP);
+      *pInfoSEXP = argsSEXP != R_NilValue ? CAR(argsSEXP) : R_NilValue;
+   }
+   return true;
+}
+
+// read a number from a list (which may have been stored as an integer if
+// it has been through the index)
+Error getNumber(SEXP listSEXP, const std::string& name, double* pValue)
+{
+   SEXP valueSEXP;
+   Error error = r::sexp::getNamedListSEXP(listSEXP, name, &valueSEXP);
+   if (error)
+      return error;
+
+   if ((TYPEOF(valueSEXP) != REALSXP && TYPEOF(valueSEXP) != INTSXP) ||
+       Rf_length(valueSEXP) < 1)
+   {
+      return Error(r::errc::UnexpectedDataTypeError, ERROR_LOCATION);
+   }
+
+   *pValue = TYPEOF(valueSEXP) == REALSXP ? REAL(valueSEXP)[0] :
+                                            INTEGER(valueSEXP)[0];
+   return Success();
+}
+
+// the description of an object (a list with its class, length, size and,
+// for data frames, the number of rows) as an index entry
+json::Object infoFromList(SEXP infoSEXP)
+{
+   json::Object info;
+   if (TYPEOF(infoSEXP) != VECSXP)
+      return info;
+
+   std::string objectClass;
+   double length = 0, size = 0, rows = 0;
+   bool isData = false;
+   Error error = r::sexp::getNamedListElement(infoSEXP, "class", &objectClass);
+   if (!error)
+      error = getNumber(infoSEXP, "length", &length);
+   if (!error)
+      error = getNumber(infoSEXP, "size", &size);
+   if (!error)
+      error = r::sexp::getNamedListElement(infoSEXP, "is_data", &isData);
+   if (!error)
+      error = getNumber(infoSEXP, "rows", &rows);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return info;
+   }
+
+   info["class"] = objectClass;
+   info["length"] = length;
+   info["size"] = size;
+   info["is_data"] = isData;
+   info["rows"] = rows;
+   return info;
+}
+
+json::Object objectInfo(SEXP valueSEXP)
+{
+   r::sexp::Protect protect;
+   SEXP infoSEXP = R_NilValue;
+   Error error = r::exec::RFunction(".rs.stateChunkInfo", valueSEXP)
+                                                   .call(&infoSEXP, &protect);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return json::Object();
+   }
+
+   return infoFromList(infoSEXP);
+}
+
+// the digests of the blocks of a chunk from the last save (or an empty
+// vector if they weren't recorded)
+std::vector<std::string> chunkBlocks(const json::Object& chunkJson)
+{
+   std::vector<std::string> blocks;
+   json::Object::const_iterator it = chunkJson.find(kBlocks);
+   if (it == chunkJson.end() || !json::isType<json::Array>(it->second))
+      return blocks;
+
+   BOOST_FOREACH(const json::Value& blockJson, it->second.get_array())
+   {
+      if (!json::isType<std::string>(blockJson))
+         return std::vector<std::string>();
+      blocks.push_back(blockJson.get_str());
+   }
+   return blocks;
+}
+
+const json::Object& chunkEntry(const json::Object& chunksJson,
+                               const std::string& id)
+{
+   static const json::Object empty;
+   json::Object::const_iterator it = chunksJson.find(id);
+   if (it == chunksJson.end() || !json::isType<json::Object>(it->second))
+      return empty;
+   return it->second.get_obj();
+}
+
+// save an object as a chunk, providing its id (or an empty id if the object
+// has to be saved along with the shared objects) and its index entry
+Error saveObject(const r::sexp::Variable& object,
+                 SEXP envSEXP,
+                 const FilePath& chunksDir,
+                 bool compress,
+                 const std::string& prevId,
+                 const json::Object& prevChunks,
+                 ChunkWriter* pWriter,
+                 std::set<std::string>* pChunks,
+                 std::string* pId,
+                 json::Object* pChunkJson)
+{
+   pId->clear();
+   pChunkJson->clear();
+
+   // active bindings are saved (by value) by save()
+   if (r::sexp::isActiveBinding(object.first, envSEXP))
+      return Success();
+
+   SEXP valueSEXP = object.second;
+   if (TYPEOF(valueSEXP) == PROMSXP)
+   {
+      // promises other than our own are evaluated by save()
+      std::string chunkPath;
+      SEXP infoSEXP = R_NilValue;
+      if (!isChunkPromise(valueSEXP, &chunkPath, &infoSEXP))
+         return Success();
+
+      // objects restored lazily and never accessed are unchanged, and so
+      // are just kept (or copied over when saving to another directory)
+      if (PRVALUE(valueSEXP) == R_UnboundValue)
+      {
+         FilePath chunk(chunkPath);
+         std::string id = chunk.filename();
+         if (pChunks->find(id) == pChunks->end())
+         {
+            Error error = chunk.copy(chunksDir.complete(id));
+            if (error)
+               return error;
+            pChunks->insert(id);
+         }
+
+         *pId = id;
+         *pChunkJson = chunkEntry(prevChunks, id);
+         if (pChunkJson->find(kInfo) == pChunkJson->end())
+            (*pChunkJson)[kInfo] = infoFromList(infoSEXP);
+         return Success();
+      }
+
+      valueSEXP = PRVALUE(valueSEXP);
+   }
+
+   // compare with the object's chunk from the last save (if we have it), so
+   // that we only compress and write objects which have changed
+   const json::Object& prevChunkJson = chunkEntry(prevChunks, prevId);
+   std::vector<std::string> prevBlocks;
+   if (!prevId.empty() && pChunks->find(prevId) != pChunks->end())
+      prevBlocks = chunkBlocks(prevChunkJson);
+
+   FilePath tempPath = chunksDir.complete(kTempChunkFile);
+   boost::shared_ptr<std::ostream> pOutput;
+   Error error = tempPath.open_w(&pOutput);
+   if (error)
+      return error;
+
+   std::vector<std::string> blocks;
+   bool unchanged = false, hasReferences = false;
+   error = serializeObject(valueSEXP, pWriter, pOutput.get(), compress,
+                           chunksDir.complete(prevId), prevBlocks,
+                           pId, &blocks, &unchanged, &hasReferences);
+   pOutput.reset();
+
+   // an unchanged object's chunk must still be there (otherwise the index
+   // of the last save was inconsistent with its chunks)
+   if (!error && !hasReferences && unchanged &&
+       pChunks->find(*pId) == pChunks->end())
+   {
+      error = systemError(boost::system::errc::invalid_argument,
+                          ERROR_LOCATION);
+   }
+
+   if (error || hasReferences || pChunks->find(*pId) != pChunks->end())
+   {
+      if (error || hasReferences)
+         pId->clear();
+
+      Error removeError = tempPath.remove();
+      if (removeError)
+         LOG_ERROR(removeError);
+
+      if (error || hasReferences)
+         return error;
+   }
+   else
+   {
+      error = tempPath.move(chunksDir.complete(*pId));
+      if (error)
+      {
+         pId->clear();
+         return error;
+      }
+
+      pChunks->insert(*pId);
+   }
+
+   // record the chunk's blocks (to compare with next time) and a description
+   // of the object (shown when it is restored lazily, until it is read)
+   json::Array blocksJson;
+   std::copy(blocks.begin(), blocks.end(), std::back_inserter(blocksJson));
+   (*pChunkJson)[kBlocks] = blocksJson;
+
+   json::Object::const_iterator infoIt = prevChunkJson.find(kInfo);
+   if (*pId == prevId && infoIt != prevChunkJson.end())
+      (*pChunkJson)[kInfo] = infoIt->second;
+   else
+      (*pChunkJson)[kInfo] = objectInfo(valueSEXP);
+
+   return Success();
+}
+
+Error readIndex(const FilePath& stateDir,
+                json::Object* pObjects,
+                json::Object* pChunks)
+{
+   std::string contents;
+   Error error = readStringFromFile(stateDir.complete(kIndexFile), &contents);
+   if (error)
+      return error;
+
+   json::Value indexJson;
+   if (!json::parse(contents, &indexJson) ||
+       !json::isType<json::Object>(indexJson))
+   {
+      return systemError(boost::system::errc::invalid_argument,
+                         ERROR_LOCATION);
+   }
+
+   // the chunks are only recorded by newer versions
+   const json::Object& index = indexJson.get_obj();
+   json::Object::const_iterator it = index.find(kChunks);
+   if (it != index.end() && json::isType<json::Object>(it->second))
+      *pChunks = it->second.get_obj();
+
+   return json::readObject(index, kObjects, pObjects);
+}
+
+} // anonymous namespace
+
+Error save(SEXP envSEXP, const FilePath& stateDir, bool compress)
+{
+   FilePath chunksDir = stateDir.complete(kChunksDir);
+   Error error = chunksDir.ensureDirectory();
+   if (error)
+      return error;
+
+   // note the chunks (and objects) we have from the last save
+   std::vector<FilePath> chunkFiles;
+   error = chunksDir.children(&chunkFiles);
+   if (error)
+      return error;
+   std::set<std::string> chunks;
+   BOOST_FOREACH(const FilePath& chunkFile, chunkFiles)
+   {
+      chunks.insert(chunkFile.filename());
+   }
+
+   json::Object prevObjects, prevChunks;
+   if (hasState(stateDir))
+   {
+      error = readIndex(stateDir, &prevObjects, &prevChunks);
+      if (error)
+         LOG_ERROR(error);
+   }
+
+   r::sexp::Protect protect;
+   std::vector<r::sexp::Variable> objects;
+   r::sexp::listEnvironment(envSEXP, true, false, &protect, &objects);
+
+   // save objects as chunks (when we can)
+   ChunkWriter writer;
+   writer.start();
+   json::Object objectsJson, chunksJson;
+   std::vector<std::string> sharedObjects;
+   BOOST_FOREACH(const r::sexp::Variable& object, objects)
+   {
+      std::string prevId;
+      json::Object::const_iterator it = prevObjects.find(object.first);
+      if (it != prevObjects.end() && json::isType<std::string>(it->second))
+         prevId = it->second.get_str();
+
+      std::string id;
+      json::Object chunkJson;
+      error = saveObject(object, envSEXP, chunksDir, compress, prevId,
+                         prevChunks, &writer, &chunks, &id, &chunkJson);
+      if (error)
+      {
+         // fall back to saving it with the shared objects
+         error.addProperty("object", object.first);
+         LOG_ERROR(error);
+      }
+
+      if (!id.empty())
+      {
+         objectsJson[object.first] = id;
+         chunksJson[id] = chunkJson;
+      }
+      else
+      {
+         sharedObjects.push_back(object.first);
+      }
+   }
+
+   // save the objects which must be saved together
+   FilePath sharedPath = stateDir.complete(kSharedFile);
+   error = sharedPath.removeIfExists();
+   if (error)
+      return error;
+   if (!sharedObjects.empty())
+   {
+      std::string sharedFile = string_utils::utf8ToSystem(
+                                                sharedPath.absolutePath());
+      error = r::exec::RFunction(".rs.saveEnvironment",
+                                 envSEXP,
+                                 sharedFile,
+                                 sharedObjects).call();
+      if (error)
+         return error;
+   }
+
+   // write the index
+   json::Object indexJson;
+   indexJson[kObjects] = objectsJson;
+   indexJson[kChunks] = chunksJson;
+   error = writeStringToFile(stateDir.complete(kIndexFile),
+                             json::write(indexJson));
+   if (error)
+      return error;
+
+   // remove chunks which are no longer referenced (including those of
+   // objects which were lazily restored and then removed or changed)
+   std::set<std::string> referenced;
+   BOOST_FOREACH(const json::Member& member, objectsJson)
+   {
+      referenced.insert(member.second.get_str());
+   }
+   BOOST_FOREACH(const std::string& chunk, chunks)
+   {
+      if (referenced.find(chunk) == referenced.end())
+      {
+         Error error = chunksDir.complete(chunk).removeIfExists();
+         if (error)
+            LOG_ERROR(error);
+      }
+   }
+
+   return Success();
+}
+
+bool hasState(const FilePath& stateDir)
+{
+   return stateDir.complete(kIndexFile).exists();
+}
+
+Error restore(const FilePath& stateDir, SEXP envSEXP, bool lazy)
+{
+   json::Object objectsJson, chunksJson;
+   Error error = readIndex(stateDir, &objectsJson, &chunksJson);
+   if (error)
+      return error;
+
+   // restore the shared objects
+   FilePath sharedPath = stateDir.complete(kSharedFile);
+   if (sharedPath.exists())
+   {
+      std::string sharedFile = string_utils::utf8ToSystem(
+                                                sharedPath.absolutePath());
+      error = r::exec::RFunction("load", sharedFile, envSEXP).call();
+      if (error)
+         return error;
+   }
+
+   // restore the chunks
+   FilePath chunksDir = stateDir.complete(kChunksDir);
+   std::vector<std::string> names, chunkFiles;
+   json::Array infos;
+   BOOST_FOREACH(const json::Member& member, objectsJson)
+   {
+      if (!json::isType<std::string>(member.second))
+         continue;
+
+      const std::string& id = member.second.get_str();
+      names.push_back(member.first);
+      chunkFiles.push_back(string_utils::utf8ToSystem(
+               chunksDir.complete(id).absolutePath()));
+
+      const json::Object& chunkJson = chunkEntry(chunksJson, id);
+      json::Object::const_iterator it = chunkJson.find(kInfo);
+      if (it != chunkJson.end() && json::isType<json::Object>(it->second) &&
+          !it->second.get_obj().empty())
+      {
+         infos.push_back(it->second);
+      }
+      else
+      {
+         infos.push_back(json::Value());
+      }
+   }
+
+   r::exec::RFunction restoreChunks(".rs.restoreStateChunks");
+   restoreChunks.addParam(names);
+   restoreChunks.addParam(chunkFiles);
+   restoreChunks.addParam(infos);
+   restoreChunks.addParam(envSEXP);
+   restoreChunks.addParam(lazy);
+   return restoreChunks.call();
+}
+
+SEXP lazyObjectInfo(SEXP objectSEXP)
+{
+   std::string chunkPath;
+   SEXP infoSEXP = R_NilValue;
+   if (TYPEOF(objectSEXP) != PROMSXP ||
+       PRVALUE(objectSEXP) != R_UnboundValue ||
+       !isChunkPromise(objectSEXP, &chunkPath, &infoSEXP))
+   {
+      return R_NilValue;
+   }
+
+   return infoSEXP;
+}
+
+void initialize()
+{
+   RS_REGISTER_CALL_METHOD(rs_readStateChunk, 1);
+}
+
+} // namespace state_chunks
+} // namespace session
+} // namespace r
+} // namespace rstudio
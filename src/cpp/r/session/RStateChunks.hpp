@@ -0,0 +1,62 @@
+/*
+ * RStateChunks.hpp
+ *
+ * Copyright (C) 2009-17 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef R_SESSION_STATE_CHUNKS_HPP
+#define R_SESSION_STATE_CHUNKS_HPP
+
+typedef struct SEXPREC *SEXP;
+
+namespace rstudio {
+namespace core {
+   class Error;
+   class FilePath;
+}
+}
+
+// Saves the objects in an environment as a directory of chunks, one per
+// object, named by the hash of the object's serialized contents. Chunks which
+// are already in the directory (i.e. objects which haven't changed since the
+// last save) are neither compressed nor written again, and the blocks of new
+// chunks are compressed on several threads while R serializes the next one.
+//
+// Objects which refer to environments (or external pointers) can't be
+// serialized independently without losing the sharing between them, so those
+// are saved together in a single file in the format used by save().
+
+namespace rstudio {
+namespace r {
+namespace session {
+namespace state_chunks {
+
+core::Error save(SEXP envSEXP, const core::FilePath& stateDir, bool compress);
+
+bool hasState(const core::FilePath& stateDir);
+
+// when restoring lazily objects are bound to promises which read their chunk
+// when first accessed (so the directory must outlive the restored objects)
+core::Error restore(const core::FilePath& stateDir, SEXP envSEXP, bool lazy);
+
+// the description recorded when the object was saved, if it's a promise to
+// read a chunk which hasn't yet been read (or R_NilValue)
+SEXP lazyObjectInfo(SEXP objectSEXP);
+
+void initialize();
+
+} // namespace state_chunks
+} // namespace session
+} // namespace r
+} // namespace rstudio
+
+#endif // R_SESSION_STATE_CHUNKS_HPP
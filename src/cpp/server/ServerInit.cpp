@@ -35,7 +35,9 @@ Error httpServerInit(http::AsyncServer* pAsyncServer)
 {
    Options& options = server::options();
    return dynamic_cast<http::TcpIpAsyncServer*>(pAsyncServer)->init(
-                                 options.wwwAddress(), options.wwwPort());
+                                 options.wwwAddress(),
+                                 options.wwwPort(),
+                                 options.wwwReusePort());
 }
 
 } // namespace server
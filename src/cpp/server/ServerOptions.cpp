@@ -226,6 +226,9 @@ ProgramStatus Options::read(int argc,
       ("www-thread-pool-size",
          value<int>(&wwwThreadPoolSize_)->default_value(2),
          "thread pool size")
+      ("www-reuse-port",
+         value<bool>(&wwwReusePort_)->default_value(false),
+         "give each thread its own io service and SO_REUSEPORT listener")
       ("www-proxy-localhost",
          value<bool>(&wwwProxyLocalhost_)->default_value(true),
          "proxy requests to localhost ports over main server port")
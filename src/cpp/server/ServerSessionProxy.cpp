@@ -20,6 +20,7 @@
 #include <map>
 
 #include <boost/regex.hpp>
+#include <boost/weak_ptr.hpp>
 #include <boost/algorithm/string/join.hpp>
 
 #include <boost/date_time/posix_time/posix_time.hpp>
@@ -35,6 +36,7 @@
 #include <core/Log.hpp>
 #include <core/Thread.hpp>
 #include <core/WaitUtils.hpp>
+#include <core/PeriodicCommand.hpp>
 #include <core/RegexUtils.hpp>
 
 #include <core/http/SocketUtils.hpp>
@@ -61,6 +63,7 @@
 #include <server/ServerOptions.hpp>
 #include <server/ServerErrorCategory.hpp>
 #include <server/ServerSessionManager.hpp>
+#include <server/ServerScheduler.hpp>
 
 #include <server/ServerConstants.hpp>
 
@@ -551,6 +554,179 @@ Error userIdForUsername(const std::string& username, UidType* pUID)
    return Success();
 }
 
+// pool of idle keep-alive connections to sessions (keyed by stream path).
+// connections are only reused on the io_service they were created on so
+// that all work for a request stays on the thread that owns it
+class SessionConnectionPool : boost::noncopyable
+{
+public:
+   boost::shared_ptr<http::LocalStreamAsyncClient> checkout(
+                                       const FilePath& streamPath,
+                                       boost::asio::io_service& ioService)
+   {
+      boost::shared_ptr<http::LocalStreamAsyncClient> pClient;
+      std::vector<boost::shared_ptr<http::LocalStreamAsyncClient> > expired;
+
+      LOCK_MUTEX(mutex_)
+      {
+         Connections::iterator it = idle_.find(streamPath.absolutePath());
+         if (it != idle_.end())
+         {
+            // evict connections that have been idle too long (the session
+            // may have gone away or been suspended in the meantime)
+            removeExpired(&(it->second), &expired);
+
+            // take the most recently used connection for this io_service
+            std::vector<IdleConnection>& connections = it->second;
+            for (std::size_t i = connections.size(); i > 0; --i)
+            {
+               if (connections[i - 1].pIoService == &ioService)
+               {
+                  pClient = connections[i - 1].pClient;
+                  connections.erase(connections.begin() + (i - 1));
+                  break;
+               }
+            }
+
+            if (connections.empty())
+               idle_.erase(it);
+         }
+      }
+      END_LOCK_MUTEX
+
+      closeAll(expired);
+      return pClient;
+   }
+
+   void checkin(const FilePath& streamPath,
+                boost::asio::io_service& ioService,
+                boost::shared_ptr<http::LocalStreamAsyncClient> pClient)
+   {
+      // release the retry profile (its recovery function references the
+      // browser connection of the last request)
+      pClient->setConnectionRetryProfile(http::ConnectionRetryProfile());
+
+      std::vector<boost::shared_ptr<http::LocalStreamAsyncClient> > expired;
+      LOCK_MUTEX(mutex_)
+      {
+         std::vector<IdleConnection>& connections =
+                                          idle_[streamPath.absolutePath()];
+         removeExpired(&connections, &expired);
+
+         IdleConnection connection;
+         connection.pClient = pClient;
+         connection.pIoService = &ioService;
+         connection.idleSince = boost::posix_time::second_clock::universal_time();
+         connections.push_back(connection);
+
+         // cap the number of idle connections held for each session
+         if (connections.size() > kMaxIdleConnections)
+         {
+            expired.push_back(connections.front().pClient);
+            connections.erase(connections.begin());
+         }
+      }
+      END_LOCK_MUTEX
+
+      closeAll(expired);
+   }
+
+   // close connections which have been idle too long (so that connections
+   // to sessions which aren't used again don't linger)
+   void removeExpired()
+   {
+      std::vector<boost::shared_ptr<http::LocalStreamAsyncClient> > expired;
+      LOCK_MUTEX(mutex_)
+      {
+         for (Connections::iterator it = idle_.begin(); it != idle_.end(); )
+         {
+            removeExpired(&(it->second), &expired);
+            if (it->second.empty())
+               idle_.erase(it++);
+            else
+               ++it;
+         }
+      }
+      END_LOCK_MUTEX
+
+      closeAll(expired);
+   }
+
+private:
+   struct IdleConnection
+   {
+      boost::shared_ptr<http::LocalStreamAsyncClient> pClient;
+      boost::asio::io_service* pIoService;
+      boost::posix_time::ptime idleSince;
+   };
+
+   typedef std::map<std::string, std::vector<IdleConnection> > Connections;
+
+   static const std::size_t kMaxIdleConnections = 8;
+
+   // note that this must be well under the time after which sessions close
+   // idle keep-alive connections, since requests written to a connection
+   // the session has just closed are not retried
+   static const int kMaxIdleSeconds = 60;
+
+   void removeExpired(
+         std::vector<IdleConnection>* pConnections,
+         std::vector<boost::shared_ptr<http::LocalStreamAsyncClient> >* pExpired)
+   {
+      using namespace boost::posix_time;
+      ptime expireTime = second_clock::universal_time() -
+                         seconds(kMaxIdleSeconds);
+      while (!pConnections->empty() &&
+             pConnections->front().idleSince < expireTime)
+      {
+         pExpired->push_back(pConnections->front().pClient);
+         pConnections->erase(pConnections->begin());
+      }
+   }
+
+   void closeAll(
+      const std::vector<boost::shared_ptr<http::LocalStreamAsyncClient> >& clients)
+   {
+      for (std::size_t i = 0; i < clients.size(); i++)
+         clients[i]->close();
+   }
+
+private:
+   boost::mutex mutex_;
+   Connections idle_;
+};
+
+SessionConnectionPool& sessionConnectionPool()
+{
+   static SessionConnectionPool instance;
+   return instance;
+}
+
+bool removeExpiredSessionConnections()
+{
+   sessionConnectionPool().removeExpired();
+   return true;
+}
+
+void handlePooledProxyResponse(
+      boost::shared_ptr<core::http::AsyncConnection> ptrConnection,
+      const r_util::SessionContext& context,
+      const FilePath& streamPath,
+      boost::weak_ptr<http::LocalStreamAsyncClient> pWeakClient,
+      const http::Response& response)
+{
+   handleProxyResponse(ptrConnection, context, response);
+
+   // return the connection to the pool if it can be reused
+   boost::shared_ptr<http::LocalStreamAsyncClient> pClient = pWeakClient.lock();
+   if (pClient && pClient->connectionReusable())
+   {
+      sessionConnectionPool().checkin(streamPath,
+                                      ptrConnection->ioService(),
+                                      pClient);
+   }
+}
+
 void proxyRequest(
       const r_util::SessionContext& context,
       boost::shared_ptr<core::http::AsyncConnection> ptrConnection,
@@ -579,9 +755,26 @@ void proxyRequest(
       return;
    }
 
-   // create client
-   boost::shared_ptr<http::LocalStreamAsyncClient> pClient(
-    new http::LocalStreamAsyncClient(ptrConnection->ioService(), streamPath, false, uid));
+   // websocket upgrades take over their connection so are never pooled
+   bool pooled = !boost::algorithm::iequals(
+            ptrConnection->request().headerValue("Connection"), "Upgrade");
+
+   // use an idle connection to the session if we have one, otherwise
+   // create a new client
+   boost::shared_ptr<http::LocalStreamAsyncClient> pClient;
+   if (pooled)
+   {
+      pClient = sessionConnectionPool().checkout(streamPath,
+                                                 ptrConnection->ioService());
+   }
+   if (!pClient)
+   {
+      pClient.reset(new http::LocalStreamAsyncClient(ptrConnection->ioService(),
+                                                     streamPath,
+                                                     false,
+                                                     uid));
+      pClient->setKeepAlive(pooled);
+   }
 
    // setup retry context
    if (!connectionRetryProfile.empty())
@@ -595,9 +788,23 @@ void proxyRequest(
       s_proxyRequestFilter(&(pClient->request()));
 
    // execute
-   pClient->execute(
-         boost::bind(handleProxyResponse, ptrConnection, context, _1),
-         errorHandler);
+   if (pooled)
+   {
+      pClient->execute(
+            boost::bind(handlePooledProxyResponse,
+                        ptrConnection,
+                        context,
+                        streamPath,
+                        boost::weak_ptr<http::LocalStreamAsyncClient>(pClient),
+                        _1),
+            errorHandler);
+   }
+   else
+   {
+      pClient->execute(
+            boost::bind(handleProxyResponse, ptrConnection, context, _1),
+            errorHandler);
+   }
 }
 
 // function used to periodically validate that the user is valid (has an
@@ -634,6 +841,14 @@ bool validateUser(boost::shared_ptr<http::AsyncConnection> ptrConnection,
 
 Error initialize()
 { 
+   // periodically close idle connections to sessions
+   scheduler::addCommand(
+      boost::shared_ptr<ScheduledCommand>(new PeriodicCommand(
+         boost::posix_time::seconds(30),
+         removeExpiredSessionConnections,
+         false))
+   );
+
    return session::local_streams::ensureStreamsDir();
 }
 
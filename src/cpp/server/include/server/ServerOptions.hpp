@@ -124,6 +124,11 @@ public:
       return wwwThreadPoolSize_;
    }
 
+   bool wwwReusePort() const
+   {
+      return wwwReusePort_;
+   }
+
    bool wwwProxyLocalhost() const
    {
       return wwwProxyLocalhost_;
@@ -265,6 +270,7 @@ private:
    std::string wwwFrameOrigin_;
    bool wwwUseEmulatedStack_;
    int wwwThreadPoolSize_;
+   bool wwwReusePort_;
    bool wwwProxyLocalhost_;
    bool wwwVerifyUserAgent_;
    bool authNone_;
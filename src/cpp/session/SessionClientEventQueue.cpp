@@ -17,12 +17,15 @@
 
 #include "modules/SessionConsole.hpp"
 
+#include <algorithm>
+
 #include <boost/foreach.hpp>
 
 
 #include <core/BoostThread.hpp>
 #include <core/Thread.hpp>
 #include <core/json/Json.hpp>
+#include <core/SafeConvert.hpp>
 #include <core/StringUtils.hpp>
 
 #include <r/session/RConsoleActions.hpp>
@@ -33,9 +36,39 @@ namespace rstudio {
 namespace session {
  
 namespace {
+
 ClientEventQueue* s_pClientEventQueue = NULL;
+
+// maximum amount of console output buffered between removals (both pending
+// and already queued as events). when a script writes output faster than
+// the client drains it we discard the oldest output (reporting how many
+// lines were elided) rather than growing without bound
+const std::size_t kMaxPendingConsoleOutput = 1024 * 1024;
+
+// amount of the most recent output retained when the limit is exceeded
+// (so that elision happens in chunks rather than on every write)
+const std::size_t kRetainedConsoleOutput = kMaxPendingConsoleOutput / 2;
+
+// the text of a console output (or error) event, or NULL for other events
+const std::string* consoleOutputText(const ClientEvent& event)
+{
+   if (event.type() != client_events::kConsoleWriteOutput &&
+       event.type() != client_events::kConsoleWriteError)
+      return NULL;
+
+   if (event.data().type() != json::ObjectType)
+      return NULL;
+
+   const json::Object& output = event.data().get_obj();
+   json::Object::const_iterator it = output.find(kConsoleText);
+   if (it == output.end() || it->second.type() != json::StringType)
+      return NULL;
+
+   return &it->second.get_str();
 }
 
+} // anonymous namespace
+
 void initializeClientEventQueue()
 {
    BOOST_ASSERT(s_pClientEventQueue == NULL);
@@ -50,7 +83,9 @@ ClientEventQueue& clientEventQueue()
 ClientEventQueue::ClientEventQueue()
    :  pMutex_(new boost::mutex()),
       pWaitForEventCondition_(new boost::condition()),
-      lastEventAddTime_(boost::posix_time::not_a_date_time)
+      lastEventAddTime_(boost::posix_time::not_a_date_time),
+      elidedConsoleLines_(0),
+      queuedConsoleOutput_(0)
 {
 }
 
@@ -75,13 +110,22 @@ bool ClientEventQueue::setActiveConsole(const std::string& console)
 
 void ClientEventQueue::add(const ClientEvent& event)
 { 
+   // read the clock before acquiring the lock to keep the critical
+   // section (contended by the R thread and the events thread) short
+   boost::posix_time::ptime now =
+                     boost::posix_time::microsec_clock::universal_time();
+
    LOCK_MUTEX(*pMutex_)
    {
       // console output is batched up for compactness/efficiency.
       if (event.type() == client_events::kConsoleWriteOutput)
       {
          if (event.data().type() == json::StringType)
+         {
             pendingConsoleOutput_ += event.data().get_str();
+            if (pendingConsoleOutput_.length() > kMaxPendingConsoleOutput)
+               elidePendingConsoleOutput();
+         }
       }
       else if (event.type() == client_events::kConsoleWriteError &&
                event.data().type() == json::StringType)
@@ -99,7 +143,7 @@ void ClientEventQueue::add(const ClientEvent& event)
          pendingEvents_.push_back(event) ;
       }
       
-      lastEventAddTime_ = boost::posix_time::microsec_clock::universal_time();
+      lastEventAddTime_ = now;
    }
    END_LOCK_MUTEX
    
@@ -126,13 +170,38 @@ void ClientEventQueue::remove(std::vector<ClientEvent>* pEvents)
       // flush any pending output
       flushPendingConsoleOutput();
       
-      // copy the events to the caller
-      pEvents->insert(pEvents->begin(), 
-                      pendingEvents_.begin(), 
-                      pendingEvents_.end());
-   
+      // move the events to the caller (a swap when the caller's vector is
+      // empty, which is the common case, so we don't copy event payloads
+      // while holding the lock)
+      if (pEvents->empty())
+      {
+         pEvents->swap(pendingEvents_);
+      }
+      else
+      {
+         pEvents->insert(pEvents->begin(),
+                         pendingEvents_.begin(),
+                         pendingEvents_.end());
+      }
+
       // clear pending events
       pendingEvents_.clear();
+      queuedConsoleOutput_ = 0;
+
+      // let the user know if output was discarded due to the buffer limit
+      // (the discarded output is always the oldest, so the notice leads)
+      if (elidedConsoleLines_ > 0)
+      {
+         json::Object output;
+         output[kConsoleText] = "[... " +
+               safe_convert::numberToString(elidedConsoleLines_) +
+               " lines elided ...]\n";
+         output[kConsoleId] = activeConsole_;
+         pEvents->insert(pEvents->begin(),
+                         ClientEvent(client_events::kConsoleWriteOutput,
+                                     output));
+         elidedConsoleLines_ = 0;
+      }
    } 
    END_LOCK_MUTEX
 }
@@ -142,7 +211,9 @@ void ClientEventQueue::clear()
    LOCK_MUTEX(*pMutex_)
    {
       pendingConsoleOutput_.clear();
+      elidedConsoleLines_ = 0;
       pendingEvents_.clear();
+      queuedConsoleOutput_ = 0;
    }
    END_LOCK_MUTEX
 }
@@ -194,7 +265,15 @@ void ClientEventQueue::flushPendingConsoleOutput()
       // truncate it to the amount that the client can show. Too much output
       // can overwhelm the client, causing it to become unresponsive.
       int limit = r::session::consoleActions().capacity() + 1;
-      string_utils::trimLeadingLines(limit, &pendingConsoleOutput_);
+      std::size_t lines = std::count(pendingConsoleOutput_.begin(),
+                                     pendingConsoleOutput_.end(),
+                                     '\n');
+      if (string_utils::trimLeadingLines(limit, &pendingConsoleOutput_))
+      {
+         elidedConsoleLines_ += lines - std::count(pendingConsoleOutput_.begin(),
+                                                   pendingConsoleOutput_.end(),
+                                                   '\n');
+      }
 
       enqueueClientOutputEvent(client_events::kConsoleWriteOutput, 
             pendingConsoleOutput_);
@@ -202,6 +281,62 @@ void ClientEventQueue::flushPendingConsoleOutput()
    }
 }
 
+void ClientEventQueue::elidePendingConsoleOutput()
+{
+   // NOTE: private helper so no lock required (mutex is not recursive)
+
+   // discard up to the start of a line within the retained output (or,
+   // for very long lines, the start of a UTF-8 character)
+   std::string::size_type cut =
+               pendingConsoleOutput_.length() - kRetainedConsoleOutput;
+   std::string::size_type newline = pendingConsoleOutput_.find('\n', cut);
+   if (newline != std::string::npos)
+   {
+      cut = newline + 1;
+   }
+   else
+   {
+      while (cut < pendingConsoleOutput_.length() &&
+             (pendingConsoleOutput_[cut] & 0xC0) == 0x80)
+      {
+         ++cut;
+      }
+   }
+
+   elidedConsoleLines_ += std::count(pendingConsoleOutput_.begin(),
+                                     pendingConsoleOutput_.begin() + cut,
+                                     '\n');
+   pendingConsoleOutput_.erase(0, cut);
+}
+
+void ClientEventQueue::elideQueuedConsoleOutput()
+{
+   // NOTE: private helper so no lock required (mutex is not recursive)
+
+   // discard the oldest console output events (keeping all other events,
+   // and always the most recent event) until we're back within our budget
+   std::vector<ClientEvent> events;
+   events.reserve(pendingEvents_.size());
+   for (std::size_t i = 0; i < pendingEvents_.size(); i++)
+   {
+      const ClientEvent& event = pendingEvents_[i];
+      const std::string* pText = consoleOutputText(event);
+      if (pText != NULL &&
+          queuedConsoleOutput_ > kRetainedConsoleOutput &&
+          i + 1 < pendingEvents_.size())
+      {
+         elidedConsoleLines_ += std::count(pText->begin(), pText->end(), '\n');
+         queuedConsoleOutput_ -= std::min(queuedConsoleOutput_,
+                                          pText->length());
+      }
+      else
+      {
+         events.push_back(event);
+      }
+   }
+   pendingEvents_.swap(events);
+}
+
 void ClientEventQueue::enqueueClientOutputEvent(
       int event, const std::string& text)
 {
@@ -209,6 +344,10 @@ void ClientEventQueue::enqueueClientOutputEvent(
    output[kConsoleText] = text;
    output[kConsoleId]   = activeConsole_;
    pendingEvents_.push_back(ClientEvent(event, output)); 
+
+   queuedConsoleOutput_ += text.length();
+   if (queuedConsoleOutput_ > kMaxPendingConsoleOutput)
+      elideQueuedConsoleOutput();
 }
 
 } // namespace session
@@ -70,6 +70,8 @@ public:
       
 private:   
    void flushPendingConsoleOutput();
+   void elidePendingConsoleOutput();
+   void elideQueuedConsoleOutput();
 
    void enqueueClientOutputEvent(int event, const std::string& text);
  
@@ -87,6 +89,10 @@ private:
    std::string activeConsole_;
    std::vector<ClientEvent> pendingEvents_ ; 
    boost::posix_time::ptime lastEventAddTime_;
+   std::size_t elidedConsoleLines_;
+
+   // size of the text of the console output events in pendingEvents_
+   std::size_t queuedConsoleOutput_;
    
 
 };
@@ -31,6 +31,7 @@
 #include <session/SessionOptions.hpp>
 #include <session/SessionHttpConnectionListener.hpp>
 #include <session/SessionClientEventService.hpp>
+#include <session/SessionConsoleProcessSocket.hpp>
 
 #include "SessionClientEventQueue.hpp"
 
@@ -43,11 +44,28 @@ namespace {
 
 const int kLastChanceWaitSeconds = 4;
 
-bool hasEventIdLessThanOrEqualTo(const json::Value& event, int targetId)
+// connection handle for the event socket (i.e. clients connect to /events/)
+const char * const kEventSocketHandle = "events";
+
+// isolated events are pushed over the event socket immediately; events
+// which follow a push within the burst interval are coalesced (waiting up
+// to the batch delay for each further event, up to the max batch delay)
+const boost::posix_time::time_duration kSocketBurstInterval =
+                                    boost::posix_time::milliseconds(50);
+const boost::posix_time::time_duration kSocketBatchDelay =
+                                    boost::posix_time::milliseconds(2);
+const boost::posix_time::time_duration kSocketMaxBatchDelay =
+                                    boost::posix_time::milliseconds(20);
+
+int eventId(const json::Value& event)
 {
    const json::Object& eventJSON = event.get_obj();
-   int eventId = eventJSON.find("id")->second.get_int();
-   return eventId <= targetId;
+   return eventJSON.find("id")->second.get_int();
+}
+
+bool hasEventIdLessThanOrEqualTo(const json::Value& event, int targetId)
+{
+   return eventId(event) <= targetId;
 }
          
 } // anonymous namespace
@@ -58,6 +76,14 @@ ClientEventService& clientEventService()
    return instance ;
 }
 
+ClientEventService::ClientEventService()
+   : nextEventId_(0),
+     eventSocketConnected_(false),
+     eventSocketHandshake_(false),
+     eventSocketPushedThrough_(-1)
+{
+}
+
 Error ClientEventService::start(const std::string& clientId)
 {
    // set our clientid
@@ -69,6 +95,15 @@ Error ClientEventService::start(const std::string& clientId)
    Error error = signalBlocker.blockAll();
    if (error)
       return error ;
+
+   // start the event socket if requested (failure isn't fatal -- clients
+   // can always fall back to get_events)
+   if (options().useEventWebsockets())
+   {
+      Error error = startEventSocket();
+      if (error)
+         LOG_ERROR(error);
+   }
    
    // launch the service thread
    try
@@ -102,6 +137,17 @@ void ClientEventService::stop()
 
          serviceThread_.detach();
       }
+
+      // stop pushing events only once the service thread has stopped (so
+      // that events queued while stopping, e.g. the quit event, reach a
+      // client which is connected to the event socket)
+      if (eventSocketThread_.joinable())
+      {
+         eventSocketThread_.interrupt();
+         if (!eventSocketThread_.timed_join(boost::posix_time::seconds(2)))
+            LOG_WARNING_MESSAGE("Event socket thread didn't stop on its own");
+         eventSocketThread_.detach();
+      }
    }
    catch(const boost::thread_interrupted& e)
    {
@@ -148,6 +194,12 @@ void ClientEventService::erasePreviouslyDeliveredEvents(int lastClientEventIdSee
                                           _1,
                                           lastClientEventIdSeen)),
                clientEvents_.end());
+
+      // sync next event id to client (required so that when we resume
+      // from a suspend we provide client event ids in line with the
+      // client's expectations -- if we started with zero then the client
+      // would never see any events!)
+      nextEventId_ = std::max(nextEventId_, lastClientEventIdSeen + 1);
    }
    END_LOCK_MUTEX
 }
@@ -164,15 +216,6 @@ bool ClientEventService::havePendingClientEvents()
    return false;
 }
 
-void ClientEventService::addClientEvent(const json::Object& eventObject)
-{
-   LOCK_MUTEX(mutex_)
-   {
-      clientEvents_.push_back(eventObject);
-   }
-   END_LOCK_MUTEX
-}
-
 void ClientEventService::setClientEventResult(
                                        core::json::JsonRpcResponse* pResponse)
 {
@@ -204,9 +247,6 @@ void ClientEventService::run()
       // get alias to client event queue
       ClientEventQueue& clientEventQueue = session::clientEventQueue();
       
-      // initialize state
-      int nextEventId = 0;
-      
       // accept loop
       bool stopServer = false ;
       while (!stopServer || clientEventQueue.hasEvents())
@@ -245,110 +285,367 @@ void ClientEventService::run()
             continue;
          }
 
-         // parse the json rpc request
-         json::JsonRpcRequest request;
-         Error error = json::parseJsonRpcRequest(ptrConnection->request().body(),
-                                                 &request);
-         if (error)
+         // while the client is connected to the event socket events are
+         // pushed to it as they arrive (by the event socket thread), so
+         // get_events requests are answered immediately rather than held open
+         if (eventSocketReady())
          {
-            ptrConnection->sendJsonRpcError(error);
-            continue;
+            handleEventsRequest(ptrConnection,
+                                seconds(0),
+                                batchDelay,
+                                seconds(0),
+                                &stopServer);
          }
-
-         // send an error back if this request came from the wrong client
-         if (request.clientId != clientId())
+         else
          {
-            Error error = Error(json::errc::InvalidClientId,
-                                             ERROR_LOCATION);
-            ptrConnection->sendJsonRpcError(error);
-            continue;
+            handleEventsRequest(ptrConnection,
+                                maxRequestSec,
+                                batchDelay,
+                                maxTotalBatchDelay,
+                                &stopServer);
          }
+      }
+   }
+   CATCH_UNEXPECTED_EXCEPTION
+}
+
+void ClientEventService::handleEventsRequest(
+                  boost::shared_ptr<HttpConnection> ptrConnection,
+                  const boost::posix_time::time_duration& maxRequest,
+                  const boost::posix_time::time_duration& batchDelay,
+                  const boost::posix_time::time_duration& maxBatchDelay,
+                  bool* pStopServer)
+{
+   ClientEventQueue& clientEventQueue = session::clientEventQueue();
+
+   // parse the json rpc request
+   json::JsonRpcRequest request;
+   Error error = json::parseJsonRpcRequest(ptrConnection->request().body(),
+                                           &request);
+   if (error)
+   {
+      ptrConnection->sendJsonRpcError(error);
+      return;
+   }
+
+   // send an error back if this request came from the wrong client
+   if (request.clientId != clientId())
+   {
+      Error error = Error(json::errc::InvalidClientId,
+                                       ERROR_LOCATION);
+      ptrConnection->sendJsonRpcError(error);
+      return;
+   }
+
+   // get the last event id seen by the client
+   int lastClientEventIdSeen = -1;
+   Error paramError = json::readParam(request.params, 
+                                      0, 
+                                      &lastClientEventIdSeen);
+   if (paramError)
+   {
+      ptrConnection->sendJsonRpcError(paramError);
+      return;
+   }
+     
+   // remove all events already seen by the client from our internal list
+   // and sync our next event id to it
+   erasePreviouslyDeliveredEvents(lastClientEventIdSeen);
 
-         // get the last event id seen by the client
-         int lastClientEventIdSeen = -1;
-         Error paramError = json::readParam(request.params, 
-                                            0, 
-                                            &lastClientEventIdSeen);
-         if (paramError)
+   // check for events (and wait a specified internal if there are none)
+   try
+   {
+      // wait for the specified maximum time
+      if (havePendingClientEvents() || clientEventQueue.hasEvents() ||
+          clientEventQueue.waitForEvent(maxRequest))
+      {
+         // ...got at least one event
+         
+         // wait for additional events that occur in rapid succession 
+         // but don't wait for more than the specified maximum seconds
+         boost::system_time maxBatchDelayTime = 
+                        boost::get_system_time() + maxBatchDelay;
+         
+         while ( clientEventQueue.waitForEvent(batchDelay) &&
+                 (boost::get_system_time() < maxBatchDelayTime) )
          {
-            ptrConnection->sendJsonRpcError(paramError);
-            continue;
          }
-           
-         // remove all events already seen by the client from our internal list
-         erasePreviouslyDeliveredEvents(lastClientEventIdSeen);
+     }
+   }
+   catch(const boost::thread_interrupted& e)
+   {
+      // set flag so we terminate on the next accept loop iteration
+      *pStopServer = true ;
+      
+      // NOTE: even if we are interrupted we still want to allow the
+      // response to be sent (e.g. need to send the client either
+      // an empty list of events back or perhaps even the quit event!)
+   }
+   
+   // if this is the correct client then remove events from the 
+   // queue and send them. otherwise, send an InvalidClientId error
+   // to this client. the currently active client will then pickup the
+   // events on the next iteration of the accept loop
+   if (request.clientId == clientId())
+   {
+      // deque the events
+      takeQueuedEvents();
+
+      // send them (pass false for kEventsPending b/c responses from the
+      // event service shouldn't interact with automatic event service
+      // starting/re-starting)
+      json::JsonRpcResponse response;
+      setClientEventResult(&response);
+      response.setField(kEventsPending, "false");
+      ptrConnection->sendJsonRpcResponse(response);
+   }
+   else
+   {
+      Error error(json::errc::InvalidClientId, ERROR_LOCATION);
+      ptrConnection->sendJsonRpcError(error);
+   }
+}
 
-         // sync next event id to client (required so that when we resume
-         // from a suspend we provide client event ids in line with the 
-         // client's expectations -- if we started with zero then the client
-         // would never see any events!)
-         nextEventId = std::max(nextEventId, lastClientEventIdSeen + 1);
+void ClientEventService::takeQueuedEvents()
+{
+   // remove the events from the queue and assign their ids (under our
+   // mutex so that events taken by the service and event socket threads
+   // are numbered in the order they were queued)
+   LOCK_MUTEX(mutex_)
+   {
+      std::vector<ClientEvent> events;
+      clientEventQueue().remove(&events);
 
-         // check for events (and wait a specified internal if there are none)
-         try
+      for (std::vector<ClientEvent>::const_iterator
+           it = events.begin(); it != events.end(); ++it)
+      {
+         json::Object event ;
+         it->asJsonObject(nextEventId_++, &event);
+         clientEvents_.push_back(event);
+      }
+   }
+   END_LOCK_MUTEX
+}
+
+int ClientEventService::eventSocketPort() const
+{
+   return pEventSocket_ ? pEventSocket_->port() : 0;
+}
+
+Error ClientEventService::startEventSocket()
+{
+   using namespace console_process;
+
+   boost::shared_ptr<ConsoleProcessSocket> pSocket(new ConsoleProcessSocket());
+   Error error = pSocket->ensureServerRunning();
+   if (error)
+      return error;
+
+   ConsoleProcessSocketConnectionCallbacks callbacks;
+   callbacks.onReceivedInput =
+         boost::bind(&ClientEventService::onEventSocketInput, this, _1);
+   callbacks.onConnectionOpened =
+         boost::bind(&ClientEventService::onEventSocketOpened, this);
+   callbacks.onConnectionClosed =
+         boost::bind(&ClientEventService::onEventSocketClosed, this);
+   error = pSocket->listen(kEventSocketHandle, callbacks);
+   if (error)
+      return error;
+
+   // push events from a thread of their own so that waiting for events to
+   // push never delays get_events requests (and vice versa)
+   try
+   {
+      boost::thread eventSocketThread(
+               boost::bind(&ClientEventService::runEventSocket, this));
+      eventSocketThread_ = MOVE_THREAD(eventSocketThread);
+   }
+   catch(const boost::thread_resource_error& e)
+   {
+      pSocket->stopListening(kEventSocketHandle);
+      return Error(boost::thread_error::ec_from_exception(e), ERROR_LOCATION);
+   }
+
+   pEventSocket_ = pSocket;
+   return Success();
+}
+
+void ClientEventService::runEventSocket()
+{
+   try
+   {
+      while (true)
+      {
+         // wait for a client to connect and send its handshake
          {
-            // wait for the specified maximum time
-            if (havePendingClientEvents() || clientEventQueue.hasEvents() ||
-                clientEventQueue.waitForEvent(maxRequestSec))
-            {
-               // ...got at least one event
-               
-               // wait for additional events that occur in rapid succession 
-               // but don't wait for more than the specified maximum seconds
-               boost::system_time maxBatchDelayTime = 
-                              boost::get_system_time() + maxTotalBatchDelay;
-               
-               while ( clientEventQueue.waitForEvent(batchDelay) &&
-                       (boost::get_system_time() < maxBatchDelayTime) )
-               {
-               }
-           }
+            boost::unique_lock<boost::mutex> lock(mutex_);
+            while (!(eventSocketConnected_ && eventSocketHandshake_))
+               eventSocketCondition_.wait(lock);
          }
-         catch(const boost::thread_interrupted& e)
+
+         pushEventSocketEvents();
+      }
+   }
+   catch(const boost::thread_interrupted&)
+   {
+   }
+   CATCH_UNEXPECTED_EXCEPTION
+}
+
+void ClientEventService::pushEventSocketEvents()
+{
+   using namespace boost::posix_time;
+   ClientEventQueue& clientEventQueue = session::clientEventQueue();
+
+   // events which are pending but not yet pushed (e.g. after a reconnect)
+   // are sent right away; otherwise wait for up to 1 second for an event
+   // (so that we notice the client disconnecting)
+   std::string payload;
+   if (!takeUnpushedSocketEvents(&payload))
+   {
+      if (!clientEventQueue.hasEvents() &&
+          !clientEventQueue.waitForEvent(seconds(1)))
+      {
+         return;
+      }
+
+      // if we pushed very recently then events are arriving in rapid
+      // succession (e.g. console output from a loop) so coalesce them;
+      // otherwise push right away for minimal latency
+      ptime now = microsec_clock::universal_time();
+      if (!lastEventSocketPush_.is_not_a_date_time() &&
+          (now - lastEventSocketPush_) < kSocketBurstInterval)
+      {
+         ptime maxBatchDelayTime = now + kSocketMaxBatchDelay;
+         while (clientEventQueue.waitForEvent(kSocketBatchDelay) &&
+                microsec_clock::universal_time() < maxBatchDelayTime)
          {
-            // set flag so we terminate on the next accept loop iteration
-            stopServer = true ;
-            
-            // NOTE: even if we are interrupted we still want to allow the
-            // response to be sent (e.g. need to send the client either
-            // an empty list of events back or perhaps even the quit event!)
          }
-         
-         // if this is the correct client then remove events from the 
-         // queue and send them. otherwise, send an InvalidClientId error
-         // to this client. the currently active client will then pickup the
-         // events on the next iteration of the accept loop
-         if (request.clientId == clientId())
-         {
-            // deque the events
-            std::vector<ClientEvent> events;
-            clientEventQueue.remove(&events);
-            
-            // convert to json and add event id
-            for (std::vector<ClientEvent>::const_iterator 
-                 it = events.begin(); it != events.end(); ++it)
-            {
-               json::Object event ;
-               it->asJsonObject(nextEventId++, &event);
-               addClientEvent(event);
-            }
+      }
 
-            // send them (pass false for kEventsPending b/c responses from the
-            // event service shouldn't interact with automatic event service
-            // starting/re-starting)
-            json::JsonRpcResponse response;
-            setClientEventResult(&response);
-            response.setField(kEventsPending, "false");
-            ptrConnection->sendJsonRpcResponse(response);
-         }
-         else
+      takeQueuedEvents();
+      if (!takeUnpushedSocketEvents(&payload))
+         return;
+   }
+
+   Error error = pEventSocket_->sendText(kEventSocketHandle, payload);
+   if (error)
+   {
+      // events remain pending so will be delivered by get_events
+      LOG_ERROR(error);
+      onEventSocketClosed();
+      return;
+   }
+
+   lastEventSocketPush_ = microsec_clock::universal_time();
+}
+
+bool ClientEventService::eventSocketReady()
+{
+   LOCK_MUTEX(mutex_)
+   {
+      return eventSocketConnected_ && eventSocketHandshake_;
+   }
+   END_LOCK_MUTEX
+
+   // keep compiler happy
+   return false;
+}
+
+bool ClientEventService::takeUnpushedSocketEvents(std::string* pPayload)
+{
+   LOCK_MUTEX(mutex_)
+   {
+      // the connection may have closed since the caller checked
+      if (!eventSocketConnected_ || !eventSocketHandshake_)
+         return false;
+
+      json::Array unpushed;
+      for (json::Array::const_iterator it = clientEvents_.begin();
+           it != clientEvents_.end(); ++it)
+      {
+         int id = eventId(*it);
+         if (id > eventSocketPushedThrough_)
          {
-            Error error(json::errc::InvalidClientId, ERROR_LOCATION);
-            ptrConnection->sendJsonRpcError(error);
+            unpushed.push_back(*it);
+            eventSocketPushedThrough_ = id;
          }
       }
+
+      if (unpushed.empty())
+         return false;
+
+      pPayload->clear();
+      json::write(unpushed, pPayload);
+      return true;
    }
-   CATCH_UNEXPECTED_EXCEPTION
+   END_LOCK_MUTEX
+
+   // keep compiler happy
+   return false;
+}
+
+void ClientEventService::onEventSocketInput(const std::string& input)
+{
+   // the client reports the last event id it has seen (both as its
+   // handshake and as acknowledgement of pushed events)
+   json::Value inputJson;
+   if (!json::parse(input, &inputJson) || !json::isType<json::Object>(inputJson))
+   {
+      LOG_ERROR_MESSAGE("Invalid event socket message: " + input);
+      return;
+   }
+
+   std::string inputClientId;
+   int lastEventIdSeen = -1;
+   Error error = json::readObject(inputJson.get_obj(),
+                                  "clientId", &inputClientId,
+                                  "lastEventId", &lastEventIdSeen);
+   if (error)
+   {
+      LOG_ERROR(error);
+      return;
+   }
+
+   // ignore clients other than the active one (they'll receive an
+   // InvalidClientId error when they fall back to get_events)
+   if (inputClientId != clientId())
+      return;
+
+   erasePreviouslyDeliveredEvents(lastEventIdSeen);
+
+   LOCK_MUTEX(mutex_)
+   {
+      if (eventSocketConnected_ && !eventSocketHandshake_)
+      {
+         eventSocketHandshake_ = true;
+         eventSocketCondition_.notify_all();
+      }
+   }
+   END_LOCK_MUTEX
+}
+
+void ClientEventService::onEventSocketOpened()
+{
+   LOCK_MUTEX(mutex_)
+   {
+      // nothing is pushed until the client sends its handshake, and then
+      // all events which are still pending are (re)sent
+      eventSocketConnected_ = true;
+      eventSocketHandshake_ = false;
+      eventSocketPushedThrough_ = -1;
+   }
+   END_LOCK_MUTEX
+}
+
+void ClientEventService::onEventSocketClosed()
+{
+   LOCK_MUTEX(mutex_)
+   {
+      eventSocketConnected_ = false;
+      eventSocketHandshake_ = false;
+   }
+   END_LOCK_MUTEX
 }
       
 } // namespace session
@@ -108,6 +108,10 @@ void handleClientInit(const boost::function<void()>& initFunction,
    json::Object sessionInfo ;
    sessionInfo["clientId"] = clientId;
    sessionInfo["mode"] = options.programMode();
+
+   // port for the client event websocket (0 if events are only
+   // available via get_events)
+   sessionInfo["event_socket_port"] = clientEventService().eventSocketPort();
    
    sessionInfo["userIdentity"] = options.userIdentity();
 
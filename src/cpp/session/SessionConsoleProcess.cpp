@@ -398,7 +398,7 @@ void ConsoleProcess::enqueOutputEvent(const std::string &output)
 
    if (procInfo_->getChannelMode() == Websocket)
    {
-      s_terminalSocket.sendText(procInfo_->getHandle(), output);
+      s_terminalSocket.sendOutput(procInfo_->getHandle(), output);
       return;
    }
 
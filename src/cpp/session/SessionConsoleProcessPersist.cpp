@@ -15,7 +15,15 @@
 
 #include <session/SessionConsoleProcessPersist.hpp>
 
+#include <deque>
+#include <iostream>
+#include <map>
+
+#include <boost/cstdint.hpp>
 #include <boost/foreach.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
 
 #include <core/FileSerializer.hpp>
 
@@ -43,7 +51,10 @@ namespace console_persist {
 // 2017/03/21 - console02 -> console03
 //                Added channel type and channel ID to allow distinction of
 //                using non-RPC-based communication channel back to client
-#define kConsoleDir "console03"
+// 2026/10/16 - console03 -> console04
+//                Saved buffers are fixed-size ring buffers rather than
+//                plain (ever-growing) log files
+#define kConsoleDir "console04"
 
 namespace {
 
@@ -91,6 +102,288 @@ Error getLogFilePath(const std::string& handle, FilePath* pFile)
    return Success();
 }
 
+// The saved buffer for each process is a fixed-size ring: a header holding
+// the (logical) offsets of the oldest and next bytes of output, followed by
+// kRingCapacity bytes of data where the byte at offset n is stored at
+// n % kRingCapacity. Appending overwrites the oldest output when the ring is
+// full, and trimming only moves the start offset.
+const char kRingMagic[] = { 'R', 'S', 'R', 'I', 'N', 'G', '0', '1' };
+const boost::uint64_t kRingCapacity = 2 * 1024 * 1024;
+const std::streamoff kRingHeaderSize =
+      sizeof(kRingMagic) + 2 * sizeof(boost::uint64_t);
+
+// The most recent output (and the offsets of its newlines) is also kept in
+// memory so that the usual reads, of the last screenful or so of lines,
+// don't go to disk.
+const std::size_t kTailCacheSize = 256 * 1024;
+const std::size_t kMaxIndexedNewlines = 10000;
+
+class OutputRing : boost::noncopyable
+{
+public:
+   OutputRing()
+      : start_(0), end_(0), indexedFrom_(0)
+   {
+   }
+
+   Error open(const FilePath& path)
+   {
+      bool existed = path.exists();
+      Error error = path.open_rw(&pFile_);
+      if (error)
+         return error;
+
+      if (existed && readHeader())
+      {
+         // index the saved output, read once up front
+         std::string output;
+         error = readRange(start_, end_, &output);
+         if (!error)
+         {
+            indexedFrom_ = start_;
+            for (std::size_t i = 0; i < output.length(); i++)
+            {
+               if (output[i] == '\n')
+                  addNewline(start_ + i);
+            }
+            std::size_t tailSize = std::min(output.length(), kTailCacheSize);
+            tail_.assign(output, output.length() - tailSize, tailSize);
+            return Success();
+         }
+         LOG_ERROR(error);
+      }
+
+      // unreadable or not yet a ring; start over
+      start_ = end_ = indexedFrom_ = 0;
+      return writeHeader();
+   }
+
+   Error append(const std::string& output)
+   {
+      if (output.empty())
+         return Success();
+
+      boost::uint64_t newEnd = end_ + output.length();
+      boost::uint64_t newStart = start_;
+      if (newEnd - newStart > kRingCapacity)
+         newStart = newEnd - kRingCapacity;
+
+      // only what will fit in the ring needs writing
+      boost::uint64_t offset = std::max(end_, newStart);
+      const char* pData = output.data() + (offset - end_);
+      while (offset < newEnd)
+      {
+         boost::uint64_t pos = offset % kRingCapacity;
+         boost::uint64_t count = std::min(newEnd - offset, kRingCapacity - pos);
+         pFile_->seekp(kRingHeaderSize + static_cast<std::streamoff>(pos));
+         pFile_->write(pData, static_cast<std::streamsize>(count));
+         offset += count;
+         pData += count;
+      }
+
+      for (std::size_t i = 0; i < output.length(); i++)
+      {
+         if (output[i] == '\n')
+            addNewline(end_ + i);
+      }
+
+      // let the tail grow to twice its size between trims so that trimming
+      // is amortized over the appends
+      tail_.append(output);
+      if (tail_.length() > 2 * kTailCacheSize)
+         tail_.erase(0, tail_.length() - kTailCacheSize);
+
+      end_ = newEnd;
+      setStart(newStart);
+      return writeHeader();
+   }
+
+   Error read(int maxLines, std::string* pOutput)
+   {
+      // trim as string_utils::trimLeadingLines would, keeping the last
+      // maxLines lines along with the newline which precedes them
+      if (maxLines > 0 &&
+          end_ - start_ > static_cast<boost::uint64_t>(maxLines) * 2)
+      {
+         std::size_t lines = static_cast<std::size_t>(maxLines);
+         if (newlines_.size() > lines)
+         {
+            setStart(newlines_[newlines_.size() - lines - 1]);
+            Error error = writeHeader();
+            if (error)
+               return error;
+         }
+         else if (indexedFrom_ > start_)
+         {
+            // more lines requested than are indexed; search the older output
+            std::string output;
+            Error error = readRange(start_, indexedFrom_, &output);
+            if (error)
+               return error;
+
+            std::size_t remaining = lines - newlines_.size();
+            std::size_t pos = output.length();
+            while (pos > 0)
+            {
+               if (output[--pos] == '\n' && remaining-- == 0)
+               {
+                  setStart(start_ + pos);
+                  error = writeHeader();
+                  if (error)
+                     return error;
+                  break;
+               }
+            }
+         }
+      }
+
+      return readRange(start_, end_, pOutput);
+   }
+
+private:
+   void addNewline(boost::uint64_t offset)
+   {
+      newlines_.push_back(offset);
+      if (newlines_.size() > kMaxIndexedNewlines)
+      {
+         indexedFrom_ = newlines_.front() + 1;
+         newlines_.pop_front();
+      }
+   }
+
+   void setStart(boost::uint64_t start)
+   {
+      start_ = start;
+      while (!newlines_.empty() && newlines_.front() < start_)
+         newlines_.pop_front();
+      indexedFrom_ = std::max(indexedFrom_, start_);
+   }
+
+   Error readRange(boost::uint64_t begin,
+                   boost::uint64_t end,
+                   std::string* pOutput)
+   {
+      pOutput->clear();
+      pOutput->reserve(static_cast<std::size_t>(end - begin));
+
+      // whatever is in the tail cache comes from memory
+      boost::uint64_t tailStart = end_ - tail_.length();
+      boost::uint64_t diskEnd = std::min(end, std::max(begin, tailStart));
+
+      boost::uint64_t offset = begin;
+      while (offset < diskEnd)
+      {
+         boost::uint64_t pos = offset % kRingCapacity;
+         boost::uint64_t count = std::min(diskEnd - offset, kRingCapacity - pos);
+         std::size_t size = pOutput->size();
+         pOutput->resize(size + static_cast<std::size_t>(count));
+         pFile_->seekg(kRingHeaderSize + static_cast<std::streamoff>(pos));
+         pFile_->read(&(*pOutput)[size], static_cast<std::streamsize>(count));
+         if (!(*pFile_))
+         {
+            pFile_->clear();
+            return systemError(boost::system::errc::io_error, ERROR_LOCATION);
+         }
+         offset += count;
+      }
+
+      if (offset < end)
+      {
+         pOutput->append(tail_,
+                         static_cast<std::size_t>(offset - tailStart),
+                         static_cast<std::size_t>(end - offset));
+      }
+
+      return Success();
+   }
+
+   bool readHeader()
+   {
+      char magic[sizeof(kRingMagic)];
+      boost::uint64_t start, end;
+      pFile_->seekg(0);
+      pFile_->read(magic, sizeof(magic));
+      pFile_->read(reinterpret_cast<char*>(&start), sizeof(start));
+      pFile_->read(reinterpret_cast<char*>(&end), sizeof(end));
+      if (!(*pFile_))
+      {
+         pFile_->clear();
+         return false;
+      }
+
+      if (!std::equal(magic, magic + sizeof(magic), kRingMagic) ||
+          start > end || end - start > kRingCapacity)
+      {
+         return false;
+      }
+
+      start_ = start;
+      end_ = end;
+      return true;
+   }
+
+   Error writeHeader()
+   {
+      pFile_->seekp(0);
+      pFile_->write(kRingMagic, sizeof(kRingMagic));
+      pFile_->write(reinterpret_cast<const char*>(&start_), sizeof(start_));
+      pFile_->write(reinterpret_cast<const char*>(&end_), sizeof(end_));
+      pFile_->flush();
+      if (!(*pFile_))
+      {
+         pFile_->clear();
+         return systemError(boost::system::errc::io_error, ERROR_LOCATION);
+      }
+      return Success();
+   }
+
+   boost::shared_ptr<std::iostream> pFile_;
+   boost::uint64_t start_;
+   boost::uint64_t end_;
+
+   // offsets of the most recent newlines; all those at or after indexedFrom_
+   std::deque<boost::uint64_t> newlines_;
+   boost::uint64_t indexedFrom_;
+
+   // the output in [end_ - tail_.length(), end_)
+   std::string tail_;
+};
+
+std::map<std::string, boost::shared_ptr<OutputRing> > s_outputRings;
+
+Error getOutputRing(const std::string& handle,
+                    bool create,
+                    boost::shared_ptr<OutputRing>* pRing)
+{
+   std::map<std::string, boost::shared_ptr<OutputRing> >::const_iterator it =
+         s_outputRings.find(handle);
+   if (it != s_outputRings.end())
+   {
+      *pRing = it->second;
+      return Success();
+   }
+
+   FilePath log;
+   Error error = getLogFilePath(handle, &log);
+   if (error)
+      return error;
+
+   if (!create && !log.exists())
+   {
+      pRing->reset();
+      return Success();
+   }
+
+   boost::shared_ptr<OutputRing> pNewRing = boost::make_shared<OutputRing>();
+   error = pNewRing->open(log);
+   if (error)
+      return error;
+
+   s_outputRings[handle] = pNewRing;
+   *pRing = pNewRing;
+   return Success();
+}
+
 } // anonymous namespace
 
 std::string loadConsoleProcessMetadata()
@@ -119,57 +412,42 @@ void saveConsoleProcesses(const std::string& metadata)
 
 std::string getSavedBuffer(const std::string& handle, int maxLines)
 {
-   std::string content;
-   FilePath log;
-
-   Error error = getLogFilePath(handle, &log);
+   boost::shared_ptr<OutputRing> pRing;
+   Error error = getOutputRing(handle, false, &pRing);
    if (error)
    {
       LOG_ERROR(error);
-      return content;
+      return "";
    }
 
-   if (!log.exists())
+   if (!pRing)
    {
       return "";
    }
 
-   error = core::readStringFromFile(log, &content);
+   // Trim the buffer based on maxLines. Otherwise it holds as much output
+   // as fits in the ring until the terminal is closed or cleared.
+   std::string content;
+   error = pRing->read(maxLines, &content);
    if (error)
    {
       LOG_ERROR(error);
-      return content;
-   }
-
-   if (maxLines < 1)
-      return content;
-
-   // Trim the buffer based on maxLines. Otherwise it can grow without
-   // bound until the terminal is closed or cleared.
-   std::string trimmedOutput = content;
-   if (string_utils::trimLeadingLines(maxLines, &trimmedOutput))
-   {
-      error = core::writeStringToFile(log, trimmedOutput);
-      if (error)
-      {
-          LOG_ERROR(error);
-          return content;
-      }
+      return "";
    }
-   return trimmedOutput;
+   return content;
 }
 
 void appendToOutputBuffer(const std::string& handle, const std::string& buffer)
 {
-   FilePath log;
-   Error error = getLogFilePath(handle, &log);
+   boost::shared_ptr<OutputRing> pRing;
+   Error error = getOutputRing(handle, true, &pRing);
    if (error)
    {
       LOG_ERROR(error);
       return;
    }
 
-   error = rstudio::core::appendToFile(log, buffer);
+   error = pRing->append(buffer);
    if (error)
    {
       LOG_ERROR(error);
@@ -178,6 +456,8 @@ void appendToOutputBuffer(const std::string& handle, const std::string& buffer)
 
 void deleteLogFile(const std::string &handle)
 {
+   s_outputRings.erase(handle);
+
    FilePath log;
    Error error = getLogFilePath(handle, &log);
    if (error)
@@ -216,6 +496,7 @@ void deleteOrphanedLogs(bool (*validHandle)(const std::string&))
 
       if (!validHandle(child.filename()))
       {
+         s_outputRings.erase(child.filename());
          error = child.remove();
          if (error)
             LOG_ERROR(error);
@@ -164,6 +164,32 @@ TEST_CASE("ConsoleProcess Persistence")
       CHECK(loaded.compare(expect) == 0);
    }
 
+   SECTION("Write more output than the buffer holds then read it")
+   {
+      // several megabytes of output, in chunks like a running build's
+      std::string chunk;
+      for (size_t i = 0; i < 1000; i++)
+         chunk.append("all work and no play makes jack a dull boy\n");
+
+      const size_t chunks = 100;
+      for (size_t i = 0; i < chunks; i++)
+      {
+         std::stringstream ss;
+         ss << "chunk " << i << '\n';
+         console_persist::appendToOutputBuffer(handle2, ss.str() + chunk);
+      }
+
+      std::string loaded = console_persist::getSavedBuffer(handle2, 0);
+      CHECK(loaded.length() < chunks * chunk.length());
+      CHECK(loaded.substr(loaded.length() - chunk.length()) == chunk);
+
+      std::string expect = "\nchunk 99\n" + chunk;
+      loaded = console_persist::getSavedBuffer(handle2, 1001);
+      CHECK(loaded.compare(expect) == 0);
+      loaded = console_persist::getSavedBuffer(handle2, 0);
+      CHECK(loaded.compare(expect) == 0);
+   }
+
    SECTION("Delete unknown log files")
    {
       std::string orig1("hello how are you?\nthat is good\nhave a nice day");
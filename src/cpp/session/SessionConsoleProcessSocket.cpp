@@ -15,7 +15,10 @@
 
 #include <session/SessionConsoleProcessSocket.hpp>
 
+#include <algorithm>
+
 #include <boost/make_shared.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
 
 #include <core/FilePath.hpp>
 #include <core/json/Json.hpp>
@@ -33,8 +36,161 @@ namespace {
 // returned by rand; only an issue for unit tests, really
 bool s_didSeedRand = false;
 
+// output arriving within this long of the last send is batched, so bursts
+// of output (e.g. cat of a large file) are sent as a few large messages
+// while a lone echoed keystroke still goes out right away
+const long kOutputBatchDelayMs = 10;
+
+// while more than this is buffered for sending to the client, output is
+// held back; and at most kMaxPendingOutput is held back, after which the
+// oldest output is dropped (the complete output is in the saved buffer)
+const std::size_t kMaxBufferedOutput = 256 * 1024;
+const std::size_t kMaxPendingOutput = 1024 * 1024;
+const long kFlowControlDelayMs = 50;
+
+// how far past the trim point we'll look for a safe place to resume output
+const std::size_t kMaxTrimSearch = 64 * 1024;
+
+bool isUtf8Continuation(char ch)
+{
+   return (static_cast<unsigned char>(ch) & 0xC0) == 0x80;
+}
+
 } // anonymous namespace
 
+std::size_t safeTrimOffset(const std::string& output, std::size_t pos)
+{
+   std::size_t safe = output.find_first_of("\n\x1b", pos);
+   if (safe != std::string::npos && safe - pos < kMaxTrimSearch)
+      return output[safe] == '\n' ? safe + 1 : safe;
+
+   while (pos < output.length() && isUtf8Continuation(output[pos]))
+      pos++;
+   return pos;
+}
+
+std::size_t completeUtf8Length(const std::string& output)
+{
+   std::size_t length = output.length();
+   std::size_t pos = length;
+   while (pos > 0 && length - pos < 4)
+   {
+      unsigned char ch = static_cast<unsigned char>(output[--pos]);
+      if (isUtf8Continuation(ch))
+         continue;
+
+      std::size_t charLength = 1;
+      if (ch >= 0xF0)
+         charLength = 4;
+      else if (ch >= 0xE0)
+         charLength = 3;
+      else if (ch >= 0xC0)
+         charLength = 2;
+      return (length - pos < charLength) ? pos : length;
+   }
+   return length;
+}
+
+ConsoleProcessSocketOutput::ConsoleProcessSocketOutput()
+   : maxPendingOutput_(kMaxPendingOutput),
+     batchDelayMs_(kOutputBatchDelayMs),
+     binary_(false),
+     flushScheduled_(false)
+{
+}
+
+ConsoleProcessSocketOutput::ConsoleProcessSocketOutput(
+                                             std::size_t maxPendingOutput,
+                                             long batchDelayMs)
+   : maxPendingOutput_(maxPendingOutput),
+     batchDelayMs_(batchDelayMs),
+     binary_(false),
+     flushScheduled_(false)
+{
+}
+
+void ConsoleProcessSocketOutput::setBinary(bool binary)
+{
+   LOCK_MUTEX(mutex_)
+   {
+      binary_ = binary;
+   }
+   END_LOCK_MUTEX
+}
+
+bool ConsoleProcessSocketOutput::append(const std::string& output,
+                                        const boost::posix_time::ptime& now,
+                                        long* pDelayMs)
+{
+   using namespace boost::posix_time;
+
+   LOCK_MUTEX(mutex_)
+   {
+      pending_.append(output);
+      if (pending_.length() > maxPendingOutput_)
+      {
+         // drop the oldest output, starting again at a safe boundary
+         pending_.erase(0, safeTrimOffset(pending_,
+                                          pending_.length() - maxPendingOutput_));
+      }
+
+      if (flushScheduled_)
+         return false;
+
+      flushScheduled_ = true;
+      *pDelayMs = 0;
+      if (!lastFlush_.is_not_a_date_time() &&
+          now - lastFlush_ < milliseconds(batchDelayMs_))
+      {
+         *pDelayMs = batchDelayMs_;
+      }
+      return true;
+   }
+   END_LOCK_MUTEX
+
+   return false;
+}
+
+std::string ConsoleProcessSocketOutput::take(
+                                       const boost::posix_time::ptime& now,
+                                       bool* pBinary)
+{
+   std::string output;
+   LOCK_MUTEX(mutex_)
+   {
+      // text messages must be valid UTF-8 so hold back a partial character
+      // until the rest of it arrives
+      *pBinary = binary_;
+      std::size_t length = binary_ ? pending_.length() :
+                                     completeUtf8Length(pending_);
+      if (length == pending_.length())
+      {
+         output.swap(pending_);
+      }
+      else
+      {
+         output = pending_.substr(0, length);
+         pending_.erase(0, length);
+      }
+
+      flushScheduled_ = false;
+      lastFlush_ = now;
+   }
+   END_LOCK_MUTEX
+
+   return output;
+}
+
+void ConsoleProcessSocketOutput::clear()
+{
+   LOCK_MUTEX(mutex_)
+   {
+      pending_.clear();
+      flushScheduled_ = false;
+   }
+   END_LOCK_MUTEX
+}
+
 ConsoleProcessSocket::ConsoleProcessSocket()
    :
      port_(0),
@@ -85,6 +241,8 @@ Error ConsoleProcessSocket::ensureServerRunning()
                boost::bind(&ConsoleProcessSocket::onClose, this, &*pwsServer_, _1));
       pwsServer_->set_open_handler(
                boost::bind(&ConsoleProcessSocket::onOpen, this, &*pwsServer_, _1));
+      pwsServer_->set_validate_handler(
+               boost::bind(&ConsoleProcessSocket::onValidate, this, &*pwsServer_, _1));
 
       // try to bind to the given port
       do
@@ -189,6 +347,8 @@ Error ConsoleProcessSocket::listen(
    ConsoleProcessSocketConnectionDetails details = connections_.get(terminalHandle);
    details.handle_ = terminalHandle;
    details.connectionCallbacks_ = connectionCallbacks;
+   if (!details.pOutput_)
+      details.pOutput_ = boost::make_shared<ConsoleProcessSocketOutput>();
    connections_.set(terminalHandle, details);
    return Success();
 }
@@ -237,6 +397,87 @@ Error ConsoleProcessSocket::sendText(const std::string& terminalHandle,
    return Success();
 }
 
+Error ConsoleProcessSocket::sendOutput(const std::string& terminalHandle,
+                                       const std::string& output)
+{
+   ConsoleProcessSocketConnectionDetails details = connections_.get(terminalHandle);
+   if (details.handle_.compare(terminalHandle) || !details.pOutput_)
+   {
+      std::string msg = "Unknown handle: \"" + terminalHandle + "\"";
+      return systemError(boost::system::errc::not_connected, msg, ERROR_LOCATION);
+   }
+
+   websocketpp::lib::error_code ec;
+   pwsServer_->get_con_from_hdl(details.hdl_, ec);
+   if (ec.value() > 0)
+   {
+      return systemError(boost::system::errc::not_connected,
+                         ec.message(), ERROR_LOCATION);
+   }
+
+   long delayMs = 0;
+   bool schedule = details.pOutput_->append(
+                     output,
+                     boost::posix_time::microsec_clock::universal_time(),
+                     &delayMs);
+
+   if (schedule)
+      scheduleFlush(terminalHandle, delayMs);
+   return Success();
+}
+
+void ConsoleProcessSocket::scheduleFlush(const std::string& terminalHandle,
+                                         long delayMs)
+{
+   // the flush runs on the websocket thread
+   pwsServer_->set_timer(delayMs,
+                         boost::bind(&ConsoleProcessSocket::onFlushOutput,
+                                     this, terminalHandle, _1));
+}
+
+void ConsoleProcessSocket::onFlushOutput(const std::string& terminalHandle,
+                                         const websocketpp::lib::error_code& ec)
+{
+   if (ec)
+      return;
+
+   ConsoleProcessSocketConnectionDetails details = connections_.get(terminalHandle);
+   if (details.handle_.compare(terminalHandle) || !details.pOutput_)
+      return;
+
+   websocketpp::lib::error_code conEc;
+   terminalServer::connection_ptr con =
+         pwsServer_->get_con_from_hdl(details.hdl_, conEc);
+   if (conEc)
+   {
+      details.pOutput_->clear();
+      return;
+   }
+
+   // if the client isn't keeping up then let it catch up before sending more
+   if (con->get_buffered_amount() > kMaxBufferedOutput)
+   {
+      scheduleFlush(terminalHandle, kFlowControlDelayMs);
+      return;
+   }
+
+   bool binary = false;
+   std::string output = details.pOutput_->take(
+                     boost::posix_time::microsec_clock::universal_time(),
+                     &binary);
+
+   if (output.empty())
+      return;
+
+   conEc = con->send(output, binary ? websocketpp::frame::opcode::binary :
+                                      websocketpp::frame::opcode::text);
+   if (conEc)
+   {
+      LOG_ERROR(systemError(boost::system::errc::bad_message,
+                            conEc.message(), ERROR_LOCATION));
+   }
+}
+
 void ConsoleProcessSocket::releaseAllConnections()
 {
    connections_.clear();
@@ -292,8 +533,14 @@ void ConsoleProcessSocket::onOpen(terminalServer* s, websocketpp::connection_hdl
    ConsoleProcessSocketConnectionDetails details = connections_.get(handle);
    details.handle_ = handle;
    details.hdl_ = hdl;
+   if (!details.pOutput_)
+      details.pOutput_ = boost::make_shared<ConsoleProcessSocketOutput>();
    connections_.set(handle, details);
 
+   bool binary = s->get_con_from_hdl(hdl)->get_subprotocol() ==
+                                                         kBinaryOutputProtocol;
+   details.pOutput_->setBinary(binary);
+
    // notify the specific connection, if available
    if (details.connectionCallbacks_.onConnectionOpened)
       details.connectionCallbacks_.onConnectionOpened();
@@ -306,6 +553,19 @@ void ConsoleProcessSocket::onHttp(terminalServer* s, websocketpp::connection_hdl
    con->set_status(websocketpp::http::status_code::not_found);
 }
 
+bool ConsoleProcessSocket::onValidate(terminalServer* s, websocketpp::connection_hdl hdl)
+{
+   // accept binary output if the client asks for it
+   terminalServer::connection_ptr con = s->get_con_from_hdl(hdl);
+   const std::vector<std::string>& protocols = con->get_requested_subprotocols();
+   if (std::find(protocols.begin(), protocols.end(), kBinaryOutputProtocol) !=
+       protocols.end())
+   {
+      con->select_subprotocol(kBinaryOutputProtocol);
+   }
+   return true;
+}
+
 std::string ConsoleProcessSocket::getHandle(terminalServer* s, websocketpp::connection_hdl hdl)
 {
    // determine handle from last part of url, e.g. xxxxx from "terminal/xxxxx/"
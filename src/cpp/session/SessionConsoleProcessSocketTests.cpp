@@ -302,6 +302,112 @@ context("websocket for interactive terminals")
 //   }
 }
 
+context("batching terminal output for interactive terminals")
+{
+   using namespace boost::posix_time;
+   const ptime start = microsec_clock::universal_time();
+
+   test_that("complete UTF-8 length excludes a trailing partial character")
+   {
+      expect_true(completeUtf8Length("") == 0);
+      expect_true(completeUtf8Length("abc") == 3);
+      expect_true(completeUtf8Length("a\xC3\xA9") == 3);
+      expect_true(completeUtf8Length("a\xC3") == 1);
+      expect_true(completeUtf8Length("a\xE2\x82") == 1);
+      expect_true(completeUtf8Length("a\xE2\x82\xAC") == 4);
+      expect_true(completeUtf8Length("\xF0\x9F\x98") == 0);
+      expect_true(completeUtf8Length("\xF0\x9F\x98\x80") == 4);
+   }
+
+   test_that("trimmed output resumes after a newline or at an escape")
+   {
+      expect_true(safeTrimOffset("abc\ndef", 1) == 4);
+      expect_true(safeTrimOffset("abc\x1b[31mdef", 1) == 3);
+      expect_true(safeTrimOffset("abc\ndef", 4) == 4);
+   }
+
+   test_that("trimmed output otherwise resumes at a character boundary")
+   {
+      expect_true(safeTrimOffset("a\xC3\xA9" "b", 2) == 3);
+      expect_true(safeTrimOffset("a\xC3\xA9" "b", 1) == 1);
+
+      // a newline too far past the trim point isn't looked for
+      std::string output;
+      for (int i = 0; i < 40000; i++)
+         output.append("\xC3\xA9");
+      output.append("\n");
+      expect_true(safeTrimOffset(output, 1) == 2);
+   }
+
+   test_that("output is flushed right away unless there was a recent flush")
+   {
+      ConsoleProcessSocketOutput output(1024, 10);
+      long delayMs = -1;
+      bool binary = true;
+      expect_true(output.append("a", start, &delayMs));
+      expect_true(delayMs == 0);
+
+      // further output joins the scheduled flush
+      expect_false(output.append("b", start, &delayMs));
+      expect_true(output.take(start, &binary) == "ab");
+      expect_false(binary);
+
+      // output soon after a flush is batched
+      expect_true(output.append("c", start + milliseconds(5), &delayMs));
+      expect_true(delayMs == 10);
+      expect_true(output.take(start + milliseconds(15), &binary) == "c");
+
+      // but not once things have been quiet for a while
+      expect_true(output.append("d", start + milliseconds(100), &delayMs));
+      expect_true(delayMs == 0);
+   }
+
+   test_that("pending output is capped by dropping the oldest lines")
+   {
+      ConsoleProcessSocketOutput output(16, 10);
+      long delayMs = 0;
+      bool binary = false;
+      output.append("line one\nline two\n", start, &delayMs);
+      output.append("line three\n", start, &delayMs);
+      expect_true(output.take(start, &binary) == "line three\n");
+   }
+
+   test_that("text output holds back a partial UTF-8 character")
+   {
+      ConsoleProcessSocketOutput output(1024, 10);
+      long delayMs = 0;
+      bool binary = true;
+      output.append("ab\xE2\x82", start, &delayMs);
+      expect_true(output.take(start, &binary) == "ab");
+      expect_false(binary);
+
+      output.append("\xAC", start, &delayMs);
+      expect_true(output.take(start, &binary) == "\xE2\x82\xAC");
+   }
+
+   test_that("binary output is taken whole")
+   {
+      ConsoleProcessSocketOutput output(1024, 10);
+      long delayMs = 0;
+      bool binary = false;
+      output.setBinary(true);
+      output.append("ab\xE2\x82", start, &delayMs);
+      expect_true(output.take(start, &binary) == "ab\xE2\x82");
+      expect_true(binary);
+   }
+
+   test_that("cleared output is discarded and can be scheduled again")
+   {
+      ConsoleProcessSocketOutput output(1024, 10);
+      long delayMs = 0;
+      bool binary = false;
+      expect_true(output.append("a", start, &delayMs));
+      output.clear();
+      expect_true(output.append("b", start, &delayMs));
+      expect_true(output.take(start, &binary) == "b");
+   }
+}
+
 } // namespace console_process
 } // namespace session
 } // namespace rstudio
@@ -108,29 +108,12 @@ bool parseAndValidateJsonRpcConnection(
       return false;
    }
 
-   // check for invalid client id
-   if (pJsonRpcRequest->clientId != persistentState().activeClientId())
-   {
-      Error error(json::errc::InvalidClientId, ERROR_LOCATION);
-      ptrConnection->sendJsonRpcError(error);
-      return false;
-   }
-
-   // check for legacy client version (need to invalidate any client using
-   // the old version field)
-   if ( (pJsonRpcRequest->version > 0) &&
-        (s_version > pJsonRpcRequest->version) )
-   {
-      Error error(json::errc::InvalidClientVersion, ERROR_LOCATION);
-      ptrConnection->sendJsonRpcError(error);
-      return false;
-   }
-
-   // check for client version
-   if (!pJsonRpcRequest->clientVersion.empty() &&
-       http_methods::clientVersion() != pJsonRpcRequest->clientVersion)
+   // validate the client
+   error = http_methods::validateJsonRpcRequest(
+                                    *pJsonRpcRequest,
+                                    persistentState().activeClientId());
+   if (error)
    {
-      Error error(json::errc::InvalidClientVersion, ERROR_LOCATION);
       ptrConnection->sendJsonRpcError(error);
       return false;
    }
@@ -139,6 +122,25 @@ bool parseAndValidateJsonRpcConnection(
    return true;
 }
 
+// requests served by the rpc worker threads count as activity (so a client
+// which is only issuing those doesn't look idle)
+void extendTimeoutForWorkerRequests(boost::posix_time::ptime* pTimeoutTime)
+{
+   using namespace boost::posix_time;
+   if (pTimeoutTime->is_not_a_date_time())
+      return;
+
+   ptime lastWorkerConnection =
+         httpConnectionListener().workerConnectionQueue().lastConnectionTime();
+   if (lastWorkerConnection.is_not_a_date_time())
+      return;
+
+   ptime workerTimeoutTime =
+         lastWorkerConnection + minutes(options().timeoutMinutes());
+   if (workerTimeoutTime > *pTimeoutTime)
+      *pTimeoutTime = workerTimeoutTime;
+}
+
 void endHandleConnection(boost::shared_ptr<HttpConnection> ptrConnection,
                          http_methods::ConnectionType connectionType,
                          core::http::Response* pResponse)
@@ -333,6 +335,28 @@ std::string clientVersion()
    return RSTUDIO_GIT_REVISION_HASH;
 }
 
+Error validateJsonRpcRequest(const json::JsonRpcRequest& request,
+                             const std::string& activeClientId)
+{
+   // check for invalid client id
+   if (request.clientId != activeClientId)
+      return Error(json::errc::InvalidClientId, ERROR_LOCATION);
+
+   // check for legacy client version (need to invalidate any client using
+   // the old version field)
+   if ( (request.version > 0) && (s_version > request.version) )
+      return Error(json::errc::InvalidClientVersion, ERROR_LOCATION);
+
+   // check for client version
+   if (!request.clientVersion.empty() &&
+       http_methods::clientVersion() != request.clientVersion)
+   {
+      return Error(json::errc::InvalidClientVersion, ERROR_LOCATION);
+   }
+
+   return Success();
+}
+
 void waitForMethodInitFunction(const ClientEvent& initEvent)
 {
    module_context::enqueClientEvent(initEvent);
@@ -376,6 +400,7 @@ bool waitForMethod(const std::string& method,
       suspend::suspendIfRequested(allowSuspend);
 
       // check for timeout
+      extendTimeoutForWorkerRequests(&timeoutTime);
       if ( isTimedOut(timeoutTime) )
       {
          if (allowSuspend())
@@ -50,6 +50,10 @@ void handleConnection(boost::shared_ptr<HttpConnection> ptrConnection,
 core::WaitResult startHttpConnectionListenerWithTimeout();
 void registerGwtHandlers();
 std::string clientVersion();
+
+// validate the client and client version of a json-rpc request
+core::Error validateJsonRpcRequest(const core::json::JsonRpcRequest& request,
+                                   const std::string& activeClientId);
 std::string nextSessionUrl();
 
 } // namespace http_methods
@@ -15,6 +15,9 @@
 
 #include "SessionInit.hpp"
 
+#include <core/BoostThread.hpp>
+#include <core/Thread.hpp>
+
 #include <r/session/RSession.hpp>
 
 #include <session/SessionModuleContext.hpp>
@@ -28,7 +31,9 @@ namespace init {
 namespace {
 
 // have we fully initialized? used by rConsoleRead and clientInit to
-// tweak their behavior when the process is first starting
+// tweak their behavior when the process is first starting (and by the rpc
+// worker threads, so it's synchronized)
+boost::mutex s_sessionInitializedMutex;
 bool s_sessionInitialized = false;
 
 } // anonymous namespace
@@ -40,7 +45,11 @@ void ensureSessionInitialized()
    // note that we are now fully initialized. we defer setting this
    // flag so that consoleRead and handleClientInit know that we have just
    // started up and can act accordingly
-   s_sessionInitialized = true;
+   LOCK_MUTEX(s_sessionInitializedMutex)
+   {
+      s_sessionInitialized = true;
+   }
+   END_LOCK_MUTEX
 
    // ensure the session is fully deserialized (deferred deserialization
    // is supported so that the workbench UI can load without having to wait
@@ -50,7 +59,14 @@ void ensureSessionInitialized()
 
 bool isSessionInitialized()
 {
-   return s_sessionInitialized;
+   LOCK_MUTEX(s_sessionInitializedMutex)
+   {
+      return s_sessionInitialized;
+   }
+   END_LOCK_MUTEX
+
+   // keep compiler happy
+   return false;
 }
 
 } // namespace init
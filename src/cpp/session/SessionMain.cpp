@@ -105,6 +105,7 @@
 #include "SessionHttpMethods.hpp"
 #include "SessionInit.hpp"
 #include "SessionMainProcess.hpp"
+#include "SessionRpc.hpp"
 #include "SessionSuspend.hpp"
 
 #include <session/SessionRUtil.hpp>
@@ -360,6 +361,9 @@ Error rInit(const rstudio::r::session::RInitInfo& rInitInfo)
       // client event service
       (startClientEventService)
 
+      // rpc worker threads
+      (rpc::initialize)
+
       // json-rpc listeners
       (bind(registerRpcMethod, kConsoleInput, bufferConsoleInput))
       (bind(registerRpcMethod, "suspend_for_restart", suspendForRestart))
@@ -19,6 +19,7 @@
 
 #include <boost/assert.hpp>
 #include <boost/utility.hpp>
+#include <boost/make_shared.hpp>
 #include <boost/signal.hpp>
 #include <boost/format.hpp>
 #include <boost/numeric/conversion/cast.hpp>
@@ -35,6 +36,7 @@
 #include <core/FileSerializer.hpp>
 #include <core/markdown/Markdown.hpp>
 #include <core/system/FileScanner.hpp>
+#include <core/system/FileTreeSnapshot.hpp>
 #include <core/IncrementalCommand.hpp>
 #include <core/PeriodicCommand.hpp>
 #include <core/collection/Tree.hpp>
@@ -450,37 +452,38 @@ void onFilesChanged(const std::vector<core::system::FileChangeEvent>& changes)
    }
 }
 
-boost::shared_ptr<tree<FileInfo> > monitoredPathTree()
+boost::shared_ptr<core::system::FileTreeSnapshot> monitoredPathSnapshot()
 {
-   boost::shared_ptr<tree<FileInfo> > pMonitoredTree(new tree<FileInfo>());
+   tree<FileInfo> monitoredTree;
    core::system::FileScannerOptions options;
    options.recursive = true;
    options.filter = monitoredScratchFilter;
    Error scanError = scanFiles(FileInfo(monitoredParentPath()),
                                options,
-                               pMonitoredTree.get());
+                               &monitoredTree);
    if (scanError)
       LOG_ERROR(scanError);
 
-   return pMonitoredTree;
+   return boost::make_shared<core::system::FileTreeSnapshot>(
+                                                      monitoredTree.begin());
 }
 
-bool scanForMonitoredPathChanges(boost::shared_ptr<tree<FileInfo> > pPrevTree)
+bool scanForMonitoredPathChanges(
+               boost::shared_ptr<core::system::FileTreeSnapshot> pPrevSnapshot)
 {
    // check for changes
    std::vector<core::system::FileChangeEvent> changes;
-   boost::shared_ptr<tree<FileInfo> > pCurrentTree = monitoredPathTree();
-   core::system::collectFileChangeEvents(pPrevTree->begin(),
-                                         pPrevTree->end(),
-                                         pCurrentTree->begin(),
-                                         pCurrentTree->end(),
+   boost::shared_ptr<core::system::FileTreeSnapshot> pCurrentSnapshot =
+                                                      monitoredPathSnapshot();
+   core::system::collectFileChangeEvents(*pPrevSnapshot,
+                                         *pCurrentSnapshot,
                                          &changes);
 
    // fire events
    onFilesChanged(changes);
 
-   // reset the tree
-   *pPrevTree = *pCurrentTree;
+   // reset the snapshot
+   *pPrevSnapshot = *pCurrentSnapshot;
 
    // scan again after interval
    return true;
@@ -497,7 +500,7 @@ void onMonitoringError(const Error& error)
       s_monitorByScanning = true;
       module_context::schedulePeriodicWork(
          boost::posix_time::seconds(3),
-         boost::bind(scanForMonitoredPathChanges, monitoredPathTree()),
+         boost::bind(scanForMonitoredPathChanges, monitoredPathSnapshot()),
          true);
    }
 }
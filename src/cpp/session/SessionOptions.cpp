@@ -207,7 +207,10 @@ core::ProgramStatus Options::read(int argc, char * const argv[])
          "show help home page at startup")
       ("session-use-terminal-websockets",
           value<bool>(&useTerminalWebsockets_)->default_value(true),
-          "try to communicate with terminal using websockets");
+          "try to communicate with terminal using websockets")
+      ("session-use-event-websockets",
+          value<bool>(&useEventWebsockets_)->default_value(false),
+          "push client events to the browser using a websocket");
 
    // allow options
    options_description allow("allow");
@@ -16,10 +16,22 @@
 #include "SessionRpc.hpp"
 #include "SessionHttpMethods.hpp"
 #include "SessionClientEventQueue.hpp"
+#include "SessionInit.hpp"
 
+#include <map>
+
+#include <boost/format.hpp>
+
+#include <core/Thread.hpp>
 #include <core/json/Json.hpp>
 #include <core/json/JsonRpc.hpp>
 
+#include <r/RSexp.hpp>
+#include <r/RRoutines.hpp>
+
+#include <session/SessionClientEventService.hpp>
+#include <session/SessionHttpConnectionListener.hpp>
+
 using namespace rstudio::core;
 
 namespace rstudio {
@@ -28,12 +40,183 @@ namespace {
 
 // json rpc methods
 core::json::JsonRpcAsyncMethods s_jsonRpcMethods;
+
+// worker-safe json rpc methods (these are looked up by the connection
+// listener thread as requests arrive so are synchronized)
+boost::mutex s_workerSafeMethodsMutex;
+core::json::JsonRpcMethods s_workerSafeMethods;
+
+// number of threads serving worker-safe methods
+const int kRpcWorkerThreads = 2;
+
+// upper bounds (in milliseconds) of the rpc latency histogram buckets
+// (there is a final unbounded bucket for slower requests)
+const int kLatencyBuckets[] = { 1, 4, 16, 64, 256, 1024, 4096 };
+const std::size_t kLatencyBucketCount =
+                     sizeof(kLatencyBuckets) / sizeof(kLatencyBuckets[0]);
+
+// rpc latency histograms (by method)
+boost::mutex s_latencyMutex;
+std::map<std::string, std::vector<int> > s_latencyHistograms;
+
+void recordLatency(const std::string& method,
+                   const boost::posix_time::ptime& startTime)
+{
+   using namespace boost::posix_time;
+   long elapsedMs = (microsec_clock::universal_time() - startTime)
+                                                      .total_milliseconds();
+
+   std::size_t bucket = 0;
+   while (bucket < kLatencyBucketCount && elapsedMs >= kLatencyBuckets[bucket])
+      ++bucket;
+
+   LOCK_MUTEX(s_latencyMutex)
+   {
+      std::vector<int>& histogram = s_latencyHistograms[method];
+      if (histogram.empty())
+         histogram.resize(kLatencyBucketCount + 1);
+      ++histogram[bucket];
+   }
+   END_LOCK_MUTEX
+}
+
+json::Object latencyHistogramsAsJson()
+{
+   json::Object histogramsJson;
+   LOCK_MUTEX(s_latencyMutex)
+   {
+      for (std::map<std::string, std::vector<int> >::const_iterator it =
+              s_latencyHistograms.begin(); it != s_latencyHistograms.end(); ++it)
+      {
+         json::Object histogramJson;
+         for (std::size_t i = 0; i < it->second.size(); i++)
+         {
+            std::string label = i < kLatencyBucketCount ?
+               boost::str(boost::format("<%1%ms") % kLatencyBuckets[i]) :
+               boost::str(boost::format(">=%1%ms") % kLatencyBuckets[i - 1]);
+            histogramJson[label] = it->second[i];
+         }
+         histogramsJson[it->first] = histogramJson;
+      }
+   }
+   END_LOCK_MUTEX
+   return histogramsJson;
+}
+
+SEXP rs_rpcLatencyHistograms()
+{
+   r::sexp::Protect rProtect;
+   return r::sexp::create(latencyHistogramsAsJson(), &rProtect);
+}
+
+bool lookupWorkerSafeMethod(const std::string& method,
+                            json::JsonRpcFunction* pFunction)
+{
+   LOCK_MUTEX(s_workerSafeMethodsMutex)
+   {
+      json::JsonRpcMethods::const_iterator it = s_workerSafeMethods.find(method);
+      if (it == s_workerSafeMethods.end())
+         return false;
+
+      *pFunction = it->second;
+      return true;
+   }
+   END_LOCK_MUTEX
+
+   // keep compiler happy
+   return false;
+}
+
+void handleWorkerConnection(boost::shared_ptr<HttpConnection> ptrConnection)
+{
+   // until the session has been initialized (which must happen on the main
+   // thread, since it may execute R code) leave requests to the main thread
+   if (!init::isSessionInitialized())
+   {
+      httpConnectionListener().mainConnectionQueue().enqueConnection(
+                                                            ptrConnection);
+      return;
+   }
+
+   using namespace boost::posix_time;
+   ptime executeStartTime = microsec_clock::universal_time();
+
+   json::JsonRpcRequest request;
+   Error error = json::parseJsonRpcRequest(ptrConnection->request().body(),
+                                           &request);
+   if (error)
+   {
+      ptrConnection->sendJsonRpcError(error);
+      return;
+   }
+
+   // validate the client the same way as requests served on the main
+   // thread, however we compare with the client id held by the event service
+   // since persistent state may only be read from the main thread
+   error = http_methods::validateJsonRpcRequest(
+                                    request,
+                                    clientEventService().clientId());
+   if (error)
+   {
+      ptrConnection->sendJsonRpcError(error);
+      return;
+   }
+
+   json::JsonRpcFunction function;
+   if (!lookupWorkerSafeMethod(request.method, &function))
+   {
+      Error error(json::errc::MethodNotFound, ERROR_LOCATION);
+      error.addProperty("method", request.method);
+      LOG_ERROR(error);
+      ptrConnection->sendJsonRpcError(error);
+      return;
+   }
+
+   json::JsonRpcResponse response;
+   error = function(request, &response);
+   if (error)
+   {
+      ptrConnection->sendJsonRpcError(error);
+   }
+   else
+   {
+      if (!clientEventQueue().eventAddedSince(executeStartTime))
+         response.setField(kEventsPending, "false");
+      ptrConnection->sendJsonRpcResponse(response);
+   }
+
+   recordLatency(request.method, executeStartTime);
+}
+
+void rpcWorkerThreadMain()
+{
+   try
+   {
+      while (true)
+      {
+         boost::shared_ptr<HttpConnection> ptrConnection =
+            httpConnectionListener().workerConnectionQueue().dequeConnection(
+                                             boost::posix_time::seconds(1));
+         if (ptrConnection)
+            handleWorkerConnection(ptrConnection);
+
+         boost::this_thread::interruption_point();
+      }
+   }
+   catch(const boost::thread_interrupted&)
+   {
+   }
+   CATCH_UNEXPECTED_EXCEPTION
+}
    
 void endHandleRpcRequestDirect(boost::shared_ptr<HttpConnection> ptrConnection,
                          boost::posix_time::ptime executeStartTime,
+                         const std::string& method,
                          const core::Error& executeError,
                          json::JsonRpcResponse* pJsonRpcResponse)
 {
+   recordLatency(method, executeStartTime);
+
    // return error or result then continue waiting for requests
    if (executeError)
    {
@@ -120,6 +303,20 @@ void registerRpcMethod(const core::json::JsonRpcAsyncMethod& method)
    s_jsonRpcMethods.insert(method);
 }
 
+Error registerWorkerSafeRpcMethod(const std::string& name,
+                                  const core::json::JsonRpcFunction& function)
+{
+   LOCK_MUTEX(s_workerSafeMethodsMutex)
+   {
+      s_workerSafeMethods.insert(std::make_pair(name, function));
+   }
+   END_LOCK_MUTEX
+
+   // also register as a regular method (used if a request for the method
+   // reaches the main thread, e.g. if it arrived prior to registration)
+   return registerRpcMethod(name, function);
+}
+
 } // namespace module_context
 
 namespace rpc {
@@ -148,6 +345,7 @@ void handleRpcRequest(const core::json::JsonRpcRequest& request,
                          boost::bind(endHandleRpcRequestDirect,
                                      ptrConnection,
                                      executeStartTime,
+                                     request.method,
                                      _1,
                                      _2));
       }
@@ -176,10 +374,36 @@ void handleRpcRequest(const core::json::JsonRpcRequest& request,
       // application states
       LOG_ERROR(executeError);
 
-      endHandleRpcRequestDirect(ptrConnection, executeStartTime, executeError, NULL);
+      endHandleRpcRequestDirect(ptrConnection,
+                                executeStartTime,
+                                request.method,
+                                executeError,
+                                NULL);
    }
 }
 
+bool isWorkerSafeMethod(const std::string& method)
+{
+   LOCK_MUTEX(s_workerSafeMethodsMutex)
+   {
+      return s_workerSafeMethods.find(method) != s_workerSafeMethods.end();
+   }
+   END_LOCK_MUTEX
+
+   // keep compiler happy
+   return false;
+}
+
+Error initialize()
+{
+   RS_REGISTER_CALL_METHOD(rs_rpcLatencyHistograms, 0);
+
+   for (int i = 0; i < kRpcWorkerThreads; i++)
+      core::thread::safeLaunchThread(rpcWorkerThreadMain);
+
+   return Success();
+}
+
 } // namespace rpc
 } // namespace session
 } // namespace rstudio
@@ -31,6 +31,12 @@ void handleRpcRequest(const core::json::JsonRpcRequest& request,
                       boost::shared_ptr<HttpConnection> ptrConnection,
                       http_methods::ConnectionType connectionType);
 
+// is the method registered as worker-safe? (called from the connection
+// listener thread to route requests to the worker connection queue)
+bool isWorkerSafeMethod(const std::string& method);
+
+core::Error initialize();
+
 } // namespace rpc
 } // namespace session
 } // namespace rstudio
@@ -20,9 +20,11 @@
 #include <boost/array.hpp>
 
 #include <boost/utility.hpp>
+#include <boost/algorithm/string/predicate.hpp>
 #include <boost/asio/io_service.hpp>
 #include <boost/asio/write.hpp>
 #include <boost/asio/placeholders.hpp>
+#include <boost/asio/deadline_timer.hpp>
 #include <boost/enable_shared_from_this.hpp>
 
 #include <core/Error.hpp>
@@ -31,6 +33,7 @@
 
 #include <core/http/Request.hpp>
 #include <core/http/Response.hpp>
+#include <core/http/FileStreamer.hpp>
 #include <core/http/RequestParser.hpp>
 #include <core/http/SocketUtils.hpp>
 
@@ -57,7 +60,10 @@ public:
 public:
    HttpConnectionImpl(boost::asio::io_service& ioService,
                       const Handler& handler)
-      : socket_(ioService), handler_(handler)
+      : ioService_(ioService),
+        pSocket_(new typename ProtocolType::socket(ioService)),
+        handedOff_(false),
+        handler_(handler)
    {
    }
 
@@ -80,12 +86,51 @@ public:
 
    virtual void sendResponse(const core::http::Response &response)
    {
+      // keep the connection open for another request if the client asked
+      // for that (rserver does so for its pooled connections) and the
+      // response is delimited by its Content-Length
+      bool keepAlive =
+         boost::algorithm::iequals(request_.headerValue("Connection"),
+                                   "keep-alive") &&
+         !response.headerValue("Content-Length").empty();
+
       try
       {
          // write the response
-         boost::asio::write(socket_,
-                            response.toBuffers(
+         boost::asio::write(*pSocket_,
+                            response.toBuffers(keepAlive ?
+                                  core::http::Header("Connection", "keep-alive") :
                                   core::http::Header::connectionClose()));
+
+         // write the streamed file (if any)
+         if (!response.streamedFile().empty())
+         {
+            core::Error error = core::http::writeStreamedFile(
+                                    *pSocket_, response.streamedFile());
+            if (error)
+            {
+               error.addProperty("request-uri", request_.uri());
+               if (!core::http::isConnectionTerminatedError(error))
+                  LOG_ERROR(error);
+               close();
+               return;
+            }
+         }
+
+         if (keepAlive)
+         {
+            // hand the socket off to a new connection which reads the next
+            // request (this connection and its request may still be
+            // referenced by the handler which is responding)
+            boost::shared_ptr<HttpConnectionImpl<ProtocolType> > pNext(
+                  new HttpConnectionImpl<ProtocolType>(ioService_,
+                                                       pSocket_,
+                                                       handler_));
+            handedOff_ = true;
+            pNext->startIdleTimeout();
+            pNext->startReading();
+            return;
+         }
       }
       catch(const boost::system::system_error& e)
       {
@@ -111,8 +156,12 @@ public:
    // need to be closed in other circumstances
    virtual void close()
    {
+      // nothing to do if the socket was handed off to another connection
+      if (handedOff_)
+         return;
+
       // always close connection
-      core::Error error = core::http::closeSocket(socket_);
+      core::Error error = core::http::closeSocket(*pSocket_);
       if (error)
          LOG_ERROR(error);
    }
@@ -127,12 +176,63 @@ public:
       readSome();
    }
 
-   // get the socket
-   typename ProtocolType::socket& socket() { return socket_; }
+   // get the socket (note that after a keep-alive response this is shared
+   // with the connection which reads the next request)
+   typename ProtocolType::socket& socket() { return *pSocket_; }
 
 
 private:
 
+   // time after which kept-alive connections which haven't started another
+   // request are closed (rserver stops using its idle connections after 60
+   // seconds so this leaves a wide margin for requests already in flight)
+   static const int kKeepAliveIdleSeconds = 120;
+
+   HttpConnectionImpl(
+         boost::asio::io_service& ioService,
+         boost::shared_ptr<typename ProtocolType::socket> pSocket,
+         const Handler& handler)
+      : ioService_(ioService),
+        pSocket_(pSocket),
+        handedOff_(false),
+        handler_(handler)
+   {
+   }
+
+   void startIdleTimeout()
+   {
+      pIdleTimer_.reset(new boost::asio::deadline_timer(ioService_));
+      pIdleTimer_->expires_from_now(
+            boost::posix_time::seconds(kKeepAliveIdleSeconds));
+      pIdleTimer_->async_wait(
+         boost::bind(
+               &HttpConnectionImpl<ProtocolType>::handleIdleTimeout,
+               HttpConnectionImpl<ProtocolType>::shared_from_this(),
+               boost::asio::placeholders::error));
+   }
+
+   void stopIdleTimeout()
+   {
+      if (!pIdleTimer_)
+         return;
+
+      boost::system::error_code ec;
+      pIdleTimer_->cancel(ec);
+      pIdleTimer_.reset();
+   }
+
+   void handleIdleTimeout(const boost::system::error_code& ec)
+   {
+      try
+      {
+         // closing the socket aborts the pending read (and the connection
+         // is then destroyed)
+         if (ec != boost::asio::error::operation_aborted && pIdleTimer_)
+            close();
+      }
+      CATCH_UNEXPECTED_EXCEPTION
+   }
+
    // async request reading interface
    void readSome()
    {
@@ -142,7 +242,7 @@ private:
       // (unless the handler chooses to retain a copy of it e.g. to perform
       // processing in a background thread)
 
-      socket_.async_read_some(
+      pSocket_->async_read_some(
          boost::asio::buffer(buffer_),
          boost::bind(
                &HttpConnectionImpl<ProtocolType>::handleRead,
@@ -158,6 +258,9 @@ private:
       {
          if (!e)
          {
+            // the next request has started so is no longer idle
+            stopIdleTimeout();
+
             // parse next chunk
             core::http::RequestParser::status status = requestParser_.parse(
                                         request_,
@@ -198,10 +301,16 @@ private:
          }
          else // error reading
          {
-            // log the error if it wasn't connection terminated
+            stopIdleTimeout();
+
+            // log the error if it wasn't connection terminated (or the
+            // result of our closing an idle connection)
             core::Error error(e, ERROR_LOCATION);
-            if (!core::http::isConnectionTerminatedError(error))
+            if (e != boost::asio::error::operation_aborted &&
+                !core::http::isConnectionTerminatedError(error))
+            {
                LOG_ERROR(error);
+            }
 
             // close the connection
             close();
@@ -214,7 +323,10 @@ private:
    }
 
 private:
-   typename ProtocolType::socket socket_;
+   boost::asio::io_service& ioService_;
+   boost::shared_ptr<typename ProtocolType::socket> pSocket_;
+   bool handedOff_;
+   boost::shared_ptr<boost::asio::deadline_timer> pIdleTimer_;
    boost::array<char, 8192> buffer_ ;
    core::http::RequestParser requestParser_ ;
    core::http::Request request_;
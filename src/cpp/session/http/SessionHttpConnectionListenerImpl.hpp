@@ -154,6 +154,11 @@ public:
       return eventsConnectionQueue_;
    }
 
+   virtual HttpConnectionQueue& workerConnectionQueue()
+   {
+      return workerConnectionQueue_;
+   }
+
 protected:
 
    virtual bool authenticate(boost::shared_ptr<HttpConnection>)
@@ -274,6 +279,8 @@ private:
       // place the connection on the correct queue
       if (connection::isGetEvents(ptrHttpConnection))
          eventsConnectionQueue_.enqueConnection(ptrHttpConnection);
+      else if (connection::isWorkerSafeRpc(ptrHttpConnection))
+         workerConnectionQueue_.enqueConnection(ptrHttpConnection);
       else
          mainConnectionQueue_.enqueConnection(ptrHttpConnection);
    }
@@ -289,6 +296,7 @@ private:
    // connection queues
    HttpConnectionQueue mainConnectionQueue_;
    HttpConnectionQueue eventsConnectionQueue_;
+   HttpConnectionQueue workerConnectionQueue_;
 
    // listener thread
    boost::thread listenerThread_ ;
@@ -35,6 +35,8 @@
 #include <session/SessionOptions.hpp>
 #include <session/projects/ProjectsSettings.hpp>
 
+#include "../SessionRpc.hpp"
+
 namespace rstudio {
 namespace session {
 
@@ -91,6 +93,16 @@ bool isGetEvents(boost::shared_ptr<HttpConnection> ptrConnection)
                                       "events/get_events");
 }
 
+bool isWorkerSafeRpc(boost::shared_ptr<HttpConnection> ptrConnection)
+{
+   const std::string& uri = ptrConnection->request().uri();
+   std::string::size_type pos = uri.rfind("rpc/");
+   if (pos == std::string::npos)
+      return false;
+
+   return rpc::isWorkerSafeMethod(uri.substr(pos + 4));
+}
+
 void handleAbortNextProjParam(
                boost::shared_ptr<HttpConnection> ptrConnection)
 {
@@ -42,6 +42,8 @@ bool isMethod(boost::shared_ptr<HttpConnection> ptrConnection,
 
 bool isGetEvents(boost::shared_ptr<HttpConnection> ptrConnection);
 
+bool isWorkerSafeRpc(boost::shared_ptr<HttpConnection> ptrConnection);
+
 void handleAbortNextProjParam(
                boost::shared_ptr<HttpConnection> ptrConnection);
 
@@ -31,6 +31,7 @@
 
 #include <core/http/Request.hpp>
 #include <core/http/Response.hpp>
+#include <core/http/FileStreamer.hpp>
 #include <core/http/RequestParser.hpp>
 #include <core/http/SocketUtils.hpp>
 
@@ -160,30 +161,31 @@ public:
                                         core::http::Header::connectionClose());
 
       // write them
-      DWORD bytesWritten;
       for (std::size_t i=0; i<buffers.size(); i++)
       {
-         DWORD bytesToWrite = boost::asio::buffer_size(buffers[i]);
-         BOOL success = ::WriteFile(
-                  hPipe_,
-                  boost::asio::buffer_cast<const unsigned char*>(buffers[i]),
-                  bytesToWrite,
-                  &bytesWritten,
-                  NULL);
-
-         if (!success || (bytesWritten != bytesToWrite))
-         {
-            // establish error
-            Error error = systemError(::GetLastError(), ERROR_LOCATION);
-            error.addProperty("request-uri", request_.uri());
+         if (!write(boost::asio::buffer_cast<const char*>(buffers[i]),
+                    boost::asio::buffer_size(buffers[i])))
+            return;
+      }
 
-            // log the error if it wasn't connection terminated
-            if (!core::http::isConnectionTerminatedError(error))
-               LOG_ERROR(error);
+      // write the streamed file (if any) a chunk at a time
+      if (!response.streamedFile().empty())
+      {
+         core::http::FileStreamer streamer(response.streamedFile());
+         Error error = streamer.open();
+         std::vector<char> buffer;
+         while (!error && !streamer.finished())
+         {
+            error = streamer.read(&buffer);
+            if (!error && !write(&buffer[0], buffer.size()))
+               return;
+         }
 
-            // close and terminate
+         if (error)
+         {
+            error.addProperty("request-uri", request_.uri());
+            LOG_ERROR(error);
             close();
-            break;
          }
       }
    }
@@ -211,6 +213,36 @@ public:
    virtual std::string requestId() const { return requestId_; }
 
 
+private:
+   // write to the pipe (closing it and returning false on failure)
+   bool write(const char* data, std::size_t size)
+   {
+      DWORD bytesWritten;
+      DWORD bytesToWrite = static_cast<DWORD>(size);
+      BOOL success = ::WriteFile(hPipe_,
+                                 data,
+                                 bytesToWrite,
+                                 &bytesWritten,
+                                 NULL);
+
+      if (!success || (bytesWritten != bytesToWrite))
+      {
+         // establish error
+         Error error = systemError(::GetLastError(), ERROR_LOCATION);
+         error.addProperty("request-uri", request_.uri());
+
+         // log the error if it wasn't connection terminated
+         if (!core::http::isConnectionTerminatedError(error))
+            LOG_ERROR(error);
+
+         // close and terminate
+         close();
+         return false;
+      }
+
+      return true;
+   }
+
 private:
    HANDLE hPipe_;
    core::http::Request request_;
@@ -255,6 +287,11 @@ public:
       return eventsConnectionQueue_;
    }
 
+   virtual HttpConnectionQueue& workerConnectionQueue()
+   {
+      return workerConnectionQueue_;
+   }
+
 
 private:
    void listenerThread()
@@ -368,6 +405,8 @@ private:
       // place the connection on the correct queue
       if (connection::isGetEvents(ptrHttpConnection))
          eventsConnectionQueue_.enqueConnection(ptrHttpConnection);
+      else if (connection::isWorkerSafeRpc(ptrHttpConnection))
+         workerConnectionQueue_.enqueConnection(ptrHttpConnection);
       else
          mainConnectionQueue_.enqueConnection(ptrHttpConnection);
    }
@@ -477,6 +516,7 @@ private:
    std::string secret_;
    HttpConnectionQueue mainConnectionQueue_;
    HttpConnectionQueue eventsConnectionQueue_;
+   HttpConnectionQueue workerConnectionQueue_;
 };
 
 } // namespace session
@@ -19,6 +19,8 @@
 #include <string>
 
 #include <boost/utility.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
 
 #include <core/BoostThread.hpp>
 
@@ -34,6 +36,12 @@ namespace core {
 namespace rstudio {
 namespace session {
 
+class HttpConnection;
+
+namespace console_process {
+   class ConsoleProcessSocket;
+}
+
 // singleton
 class ClientEventService;
 ClientEventService& clientEventService();
@@ -41,7 +49,7 @@ ClientEventService& clientEventService();
 class ClientEventService : boost::noncopyable
 {
 private:
-   ClientEventService() {}
+   ClientEventService();
    friend ClientEventService& clientEventService();
 
 public:
@@ -54,14 +62,37 @@ public:
 
    std::string clientId();
 
+   // port of the websocket events are pushed over (0 if not enabled). the
+   // client connects to /events/ and then sends {clientId, lastEventId}
+   // (both on connect and to acknowledge events as they are received).
+   // events are pushed as a json array in the same format as get_events
+   // results and remain pending until acknowledged; unacknowledged events
+   // are re-sent on reconnect and also delivered to get_events requests
+   int eventSocketPort() const;
+
 private:
    void run();
 
+   void handleEventsRequest(boost::shared_ptr<HttpConnection> ptrConnection,
+                            const boost::posix_time::time_duration& maxRequest,
+                            const boost::posix_time::time_duration& batchDelay,
+                            const boost::posix_time::time_duration& maxBatchDelay,
+                            bool* pStopServer);
+
    void erasePreviouslyDeliveredEvents(int lastClientEventIdSeen);
    bool havePendingClientEvents();
-   void addClientEvent(const core::json::Object& eventObject);
+   void takeQueuedEvents();
    void setClientEventResult(core::json::JsonRpcResponse* pResponse);
 
+   // event socket
+   core::Error startEventSocket();
+   void runEventSocket();
+   void pushEventSocketEvents();
+   bool eventSocketReady();
+   bool takeUnpushedSocketEvents(std::string* pPayload);
+   void onEventSocketInput(const std::string& input);
+   void onEventSocketOpened();
+   void onEventSocketClosed();
   
 private:
    boost::mutex mutex_ ;
@@ -69,6 +100,18 @@ private:
 
    std::string clientId_ ;
    core::json::Array clientEvents_ ;
+   int nextEventId_ ;
+
+   // event socket state (synchronized by mutex_ other than the socket
+   // itself and the push time, which is used only by the event socket
+   // thread)
+   boost::shared_ptr<console_process::ConsoleProcessSocket> pEventSocket_;
+   boost::thread eventSocketThread_;
+   boost::condition eventSocketCondition_;
+   bool eventSocketConnected_;
+   bool eventSocketHandshake_;
+   int eventSocketPushedThrough_;
+   boost::posix_time::ptime lastEventSocketPush_;
 };
    
   
@@ -19,7 +19,9 @@
 
 #include <boost/function.hpp>
 #include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/asio.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
 
 #include <core/Error.hpp>
 #include <core/Thread.hpp>
@@ -46,8 +48,17 @@ namespace console_process {
 // the terminal handle string used elsewhere in the codebase. This uniqueId
 // is used to dispatch callbacks, and to send output to the right connection.
 //
+// Terminal output (sendOutput) is treated as a stream: output arriving in
+// quick succession is batched into fewer, larger messages, and sending is
+// deferred while the client is slow to receive what was already sent. A
+// client which requests the kBinaryOutputProtocol subprotocol receives the
+// output as raw bytes in binary messages; otherwise output is sent as text
+// messages which are never split within a UTF-8 character.
+//
 // IMPORTANT: Callbacks are dispatched on a background thread.
 
+#define kBinaryOutputProtocol "rstudio-terminal-binary"
+
 struct ConsoleProcessSocketConnectionCallbacks
 {
    // invoked when input arrives on the socket
@@ -63,11 +74,59 @@ struct ConsoleProcessSocketConnectionCallbacks
 typedef websocketpp::server<websocketpp::config::asio> terminalServer;
 typedef terminalServer::message_ptr terminalMessage_ptr;
 
+// where to resume terminal output when dropping everything before pos:
+// just after a newline or at the start of an escape sequence (neither of
+// which can be part way into an escape sequence or a UTF-8 character), or
+// failing that at the next character boundary
+std::size_t safeTrimOffset(const std::string& output, std::size_t pos);
+
+// the length of output excluding any UTF-8 character it ends part way into
+std::size_t completeUtf8Length(const std::string& output);
+
+// output waiting to be sent on a connection. output is appended as it
+// arrives and taken by a flush (which append asks to have scheduled, later
+// if a flush happened recently so that bursts are batched). if the client
+// falls behind, at most maxPendingOutput is kept, dropping the oldest.
+// thread safe
+class ConsoleProcessSocketOutput : boost::noncopyable
+{
+public:
+   ConsoleProcessSocketOutput();
+   ConsoleProcessSocketOutput(std::size_t maxPendingOutput, long batchDelayMs);
+
+   // send output as raw bytes rather than as (valid UTF-8) text
+   void setBinary(bool binary);
+
+   // queue output; returns true if a flush should be scheduled, to run
+   // after *pDelayMs
+   bool append(const std::string& output,
+               const boost::posix_time::ptime& now,
+               long* pDelayMs);
+
+   // take the output to send now (text output is taken up to the end of
+   // the last complete UTF-8 character) and allow another flush to be
+   // scheduled
+   std::string take(const boost::posix_time::ptime& now, bool* pBinary);
+
+   // discard all output (e.g. the connection has gone)
+   void clear();
+
+private:
+   boost::mutex mutex_;
+   std::size_t maxPendingOutput_;
+   long batchDelayMs_;
+   std::string pending_;
+   bool binary_;
+   bool flushScheduled_;
+   boost::posix_time::ptime lastFlush_;
+};
+
 struct ConsoleProcessSocketConnectionDetails
 {
    std::string handle_;
    ConsoleProcessSocketConnectionCallbacks connectionCallbacks_;
    websocketpp::connection_hdl hdl_;
+   boost::shared_ptr<ConsoleProcessSocketOutput> pOutput_;
 };
 
 // Manages a websocket that channels input and output from client for
@@ -89,10 +148,14 @@ public:
    // stop listening to given terminal handle
    core::Error stopListening(const std::string& terminalHandle);
 
-   // send text to client
+   // send text to client as a single message
    core::Error sendText(const std::string& terminalHandle,
                         const std::string& message);
 
+   // queue terminal output to be sent to client
+   core::Error sendOutput(const std::string& terminalHandle,
+                          const std::string& output);
+
    // network port for websocket listener; 0 means no port
    int port() const;
 
@@ -107,6 +170,11 @@ private:
    void onClose(terminalServer* s, websocketpp::connection_hdl hdl);
    void onOpen(terminalServer* s, websocketpp::connection_hdl hdl);
    void onHttp(terminalServer* s, websocketpp::connection_hdl hdl);
+   bool onValidate(terminalServer* s, websocketpp::connection_hdl hdl);
+
+   void scheduleFlush(const std::string& terminalHandle, long delayMs);
+   void onFlushOutput(const std::string& terminalHandle,
+                      const websocketpp::lib::error_code& ec);
 
    void onServerTimeout(boost::system::error_code ec);
 
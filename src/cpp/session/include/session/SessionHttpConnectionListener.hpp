@@ -99,6 +99,10 @@ public:
    // connection queues
 	virtual HttpConnectionQueue& mainConnectionQueue() = 0;
 	virtual HttpConnectionQueue& eventsConnectionQueue() = 0;
+
+   // rpcs registered as worker-safe (served on rpc worker threads rather
+   // than waiting for the main thread)
+   virtual HttpConnectionQueue& workerConnectionQueue() = 0;
 };
 
 } // namespace session
@@ -224,6 +224,14 @@ core::Error registerRpcMethod(const std::string& name,
 
 void registerRpcMethod(const core::json::JsonRpcAsyncMethod& method);
 
+// register an rpc method which is safe to execute on a background thread
+// (i.e. doesn't touch R or other state owned by the main thread). these
+// methods are served concurrently by rpc worker threads so they respond
+// even while R is busy
+core::Error registerWorkerSafeRpcMethod(
+                              const std::string& name,
+                              const core::json::JsonRpcFunction& function);
+
 core::Error executeAsync(const core::json::JsonRpcFunction& function,
                          const core::json::JsonRpcRequest& request,
                          core::json::JsonRpcResponse* pResponse);
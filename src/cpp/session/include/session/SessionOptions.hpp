@@ -166,6 +166,8 @@ public:
    
    bool useTerminalWebsockets() const { return useTerminalWebsockets_; }
 
+   bool useEventWebsockets() const { return useEventWebsockets_; }
+
    core::FilePath coreRSourcePath() const 
    { 
       return core::FilePath(coreRSourcePath_.c_str());
@@ -544,6 +546,7 @@ private:
    bool createPublicFolder_;
    bool rProfileOnResumeDefault_;
    bool useTerminalWebsockets_;
+   bool useEventWebsockets_;
    int saveActionDefault_;
    bool standalone_;
    std::string authRequiredUserGroup_;
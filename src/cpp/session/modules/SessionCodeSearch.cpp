@@ -19,6 +19,7 @@
 #include "SessionCodeSearch.hpp"
 
 #include <iostream>
+#include <map>
 #include <vector>
 #include <set>
 
@@ -29,12 +30,15 @@
 #include <boost/regex.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/split.hpp>
+#include <boost/thread.hpp>
 
 #include <core/Error.hpp>
 #include <core/Exec.hpp>
 #include <core/FilePath.hpp>
 #include <core/FileSerializer.hpp>
+#include <core/Hash.hpp>
 #include <core/SafeConvert.hpp>
+#include <core/Thread.hpp>
 #include <core/collection/Tree.hpp>
 
 #include <core/r_util/RSourceIndex.hpp>
@@ -48,6 +52,7 @@
 
 #include <session/SessionUserSettings.hpp>
 #include <session/SessionModuleContext.hpp>
+#include <session/SessionOptions.hpp>
 #include <session/SessionAsyncRProcess.hpp>
 #include <session/SessionRUtil.hpp>
 
@@ -423,11 +428,647 @@ private:
    
 };
 
+// on disk cache of source indexes (keyed by path and validated by the
+// encoding the file was read with and its modification time or content
+// hash) so that unchanged files don't need to be re-indexed when a session
+// restarts. accessed from the indexing threads so all access is synchronized
+class SourceIndexCache : boost::noncopyable
+{
+public:
+   SourceIndexCache() : dirty_(false)
+   {
+   }
+
+   // find a cached index for the file. if hash is empty then a match is
+   // based on the modification time and size alone, otherwise the hash
+   // must match (and the entry is updated with the new modification time)
+   boost::shared_ptr<r_util::RSourceIndex> find(const FileInfo& fileInfo,
+                                                const std::string& context,
+                                                const std::string& encoding,
+                                                const std::string& hash)
+   {
+      LOCK_MUTEX(mutex_)
+      {
+         std::map<std::string, CacheEntry>::iterator it =
+                                       entries_.find(fileInfo.absolutePath());
+         if (it == entries_.end() ||
+             it->second.pIndex->context() != context ||
+             it->second.encoding != encoding)
+         {
+            return boost::shared_ptr<r_util::RSourceIndex>();
+         }
+
+         CacheEntry& entry = it->second;
+         if (hash.empty())
+         {
+            if (entry.lastWriteTime == fileInfo.lastWriteTime() &&
+                entry.size == fileInfo.size())
+               return entry.pIndex;
+         }
+         else if (entry.hash == hash)
+         {
+            entry.lastWriteTime = fileInfo.lastWriteTime();
+            entry.size = fileInfo.size();
+            dirty_ = true;
+            return entry.pIndex;
+         }
+      }
+      END_LOCK_MUTEX
+
+      return boost::shared_ptr<r_util::RSourceIndex>();
+   }
+
+   void update(const FileInfo& fileInfo,
+               const std::string& encoding,
+               const std::string& hash,
+               boost::shared_ptr<r_util::RSourceIndex> pIndex)
+   {
+      CacheEntry entry;
+      entry.lastWriteTime = fileInfo.lastWriteTime();
+      entry.size = fileInfo.size();
+      entry.encoding = encoding;
+      entry.hash = hash;
+      entry.pIndex = pIndex;
+
+      LOCK_MUTEX(mutex_)
+      {
+         entries_[fileInfo.absolutePath()] = entry;
+         dirty_ = true;
+      }
+      END_LOCK_MUTEX
+   }
+
+   void remove(const std::string& path)
+   {
+      LOCK_MUTEX(mutex_)
+      {
+         if (entries_.erase(path))
+            dirty_ = true;
+      }
+      END_LOCK_MUTEX
+   }
+
+   void clear()
+   {
+      LOCK_MUTEX(mutex_)
+      {
+         entries_.clear();
+         dirty_ = false;
+      }
+      END_LOCK_MUTEX
+   }
+
+   bool dirty()
+   {
+      LOCK_MUTEX(mutex_)
+      {
+         return dirty_;
+      }
+      END_LOCK_MUTEX
+
+      // keep compiler happy
+      return false;
+   }
+
+   Error read(const FilePath& cacheFile)
+   {
+      if (!cacheFile.exists())
+         return Success();
+
+      std::string contents;
+      Error error = core::readStringFromFile(cacheFile, &contents);
+      if (error)
+         return error;
+
+      json::Value cacheJson;
+      if (!json::parse(contents, &cacheJson) ||
+          cacheJson.type() != json::ObjectType)
+      {
+         return systemError(boost::system::errc::bad_message, ERROR_LOCATION);
+      }
+
+      int version = 0;
+      json::Array files;
+      error = json::readObject(cacheJson.get_obj(),
+                               "version", &version,
+                               "files", &files);
+      if (error)
+         return error;
+
+      // ignore caches written in another format
+      if (version != kCacheVersion)
+         return Success();
+
+      std::map<std::string, CacheEntry> entries;
+      BOOST_FOREACH(const json::Value& fileJson, files)
+      {
+         if (fileJson.type() != json::ObjectType)
+            continue;
+
+         std::string path, context;
+         double lastWriteTime = 0, size = 0;
+         json::Array packagesJson, itemsJson;
+         CacheEntry entry;
+         error = json::readObject(fileJson.get_obj(),
+                                  "path", &path,
+                                  "context", &context,
+                                  "time", &lastWriteTime,
+                                  "size", &size,
+                                  "encoding", &entry.encoding,
+                                  "hash", &entry.hash,
+                                  "packages", &packagesJson,
+                                  "items", &itemsJson);
+         if (error)
+            continue;
+
+         std::vector<std::string> packages;
+         BOOST_FOREACH(const json::Value& packageJson, packagesJson)
+         {
+            if (packageJson.type() == json::StringType)
+               packages.push_back(packageJson.get_str());
+         }
+
+         std::vector<r_util::RSourceItem> items;
+         BOOST_FOREACH(const json::Value& itemJson, itemsJson)
+         {
+            r_util::RSourceItem item;
+            if (sourceItemFromJson(itemJson, &item))
+               items.push_back(item);
+         }
+
+         entry.lastWriteTime = static_cast<std::time_t>(lastWriteTime);
+         entry.size = static_cast<uintmax_t>(size);
+         entry.pIndex.reset(new r_util::RSourceIndex(context,
+                                                     items,
+                                                     packages,
+                                                     false));
+         entries[path] = entry;
+      }
+
+      LOCK_MUTEX(mutex_)
+      {
+         entries_.swap(entries);
+         dirty_ = false;
+      }
+      END_LOCK_MUTEX
+
+      return Success();
+   }
+
+   Error write(const FilePath& cacheFile)
+   {
+      // take a snapshot of the entries (indexes are immutable once cached)
+      std::map<std::string, CacheEntry> entries;
+      LOCK_MUTEX(mutex_)
+      {
+         entries = entries_;
+         dirty_ = false;
+      }
+      END_LOCK_MUTEX
+
+      json::Array files;
+      for (std::map<std::string, CacheEntry>::const_iterator it = entries.begin();
+           it != entries.end();
+           ++it)
+      {
+         const CacheEntry& entry = it->second;
+
+         json::Array packages;
+         BOOST_FOREACH(const std::string& package,
+                       entry.pIndex->getInferredPackages())
+         {
+            packages.push_back(package);
+         }
+
+         json::Array items;
+         BOOST_FOREACH(const r_util::RSourceItem& item, entry.pIndex->items())
+         {
+            items.push_back(sourceItemAsJson(item));
+         }
+
+         json::Object fileJson;
+         fileJson["path"] = it->first;
+         fileJson["context"] = entry.pIndex->context();
+         fileJson["time"] = static_cast<double>(entry.lastWriteTime);
+         fileJson["size"] = static_cast<double>(entry.size);
+         fileJson["encoding"] = entry.encoding;
+         fileJson["hash"] = entry.hash;
+         fileJson["packages"] = packages;
+         fileJson["items"] = items;
+         files.push_back(fileJson);
+      }
+
+      json::Object cacheJson;
+      cacheJson["version"] = kCacheVersion;
+      cacheJson["files"] = files;
+
+      std::string contents;
+      json::write(cacheJson, &contents);
+
+      LOCK_MUTEX(writeMutex_)
+      {
+         return core::writeStringToFile(cacheFile, contents);
+      }
+      END_LOCK_MUTEX
+
+      // keep compiler happy
+      return Success();
+   }
+
+private:
+   static json::Value sourceItemAsJson(const r_util::RSourceItem& item)
+   {
+      json::Array signature;
+      BOOST_FOREACH(const r_util::RS4MethodParam& param, item.signature())
+      {
+         json::Array paramJson;
+         paramJson.push_back(param.name());
+         paramJson.push_back(param.type());
+         signature.push_back(paramJson);
+      }
+
+      json::Array itemJson;
+      itemJson.push_back(item.type());
+      itemJson.push_back(item.name());
+      itemJson.push_back(item.braceLevel());
+      itemJson.push_back(item.line());
+      itemJson.push_back(item.column());
+      itemJson.push_back(signature);
+      return itemJson;
+   }
+
+   static bool sourceItemFromJson(const json::Value& itemJson,
+                                  r_util::RSourceItem* pItem)
+   {
+      if (itemJson.type() != json::ArrayType)
+         return false;
+
+      const json::Array& fields = itemJson.get_array();
+      if (fields.size() != 6 ||
+          fields[0].type() != json::IntegerType ||
+          fields[1].type() != json::StringType ||
+          fields[2].type() != json::IntegerType ||
+          fields[3].type() != json::IntegerType ||
+          fields[4].type() != json::IntegerType ||
+          fields[5].type() != json::ArrayType)
+      {
+         return false;
+      }
+
+      std::vector<r_util::RS4MethodParam> signature;
+      BOOST_FOREACH(const json::Value& paramJson, fields[5].get_array())
+      {
+         if (paramJson.type() != json::ArrayType ||
+             paramJson.get_array().size() != 2)
+            return false;
+
+         const json::Array& param = paramJson.get_array();
+         if (param[0].type() != json::StringType ||
+             param[1].type() != json::StringType)
+            return false;
+
+         signature.push_back(r_util::RS4MethodParam(param[0].get_str(),
+                                                    param[1].get_str()));
+      }
+
+      *pItem = r_util::RSourceItem(fields[0].get_int(),
+                                   fields[1].get_str(),
+                                   signature,
+                                   fields[2].get_int(),
+                                   fields[3].get_int(),
+                                   fields[4].get_int());
+      return true;
+   }
+
+private:
+   static const int kCacheVersion = 2;
+
+   struct CacheEntry
+   {
+      CacheEntry() : lastWriteTime(0), size(0) {}
+      std::time_t lastWriteTime;
+      uintmax_t size;
+      std::string encoding;
+      std::string hash;
+      boost::shared_ptr<r_util::RSourceIndex> pIndex;
+   };
+
+   boost::mutex mutex_;
+   boost::mutex writeMutex_;
+   std::map<std::string, CacheEntry> entries_;
+   bool dirty_;
+};
+
+// request to index a source file
+struct IndexingJob
+{
+   IndexingJob() : id(0), restore(false) {}
+
+   int id;
+   FileInfo fileInfo;
+   std::string context;
+   std::string encoding;
+
+   // true for files registered when the index is first built, whose cached
+   // index is used if their modification time and size are unchanged.
+   // changes reported by the file monitor are always hashed (a change
+   // within the same second and of the same size would otherwise be missed)
+   bool restore;
+};
+
+// completed index for a source file (pIndex is NULL if the file
+// couldn't be read, or if it needs converting to UTF-8 by the main thread,
+// in which case its contents are returned instead)
+struct IndexingResult
+{
+   IndexingResult() : id(0), needsConversion(false) {}
+
+   int id;
+   FileInfo fileInfo;
+   boost::shared_ptr<r_util::RSourceIndex> pIndex;
+
+   bool needsConversion;
+   std::string context;
+   std::string encoding;
+   std::string hash;
+   std::string contents;
+};
+
+// files in other encodings are converted using R's iconv, which is only
+// called from the main thread
+bool isUtf8Encoding(const std::string& encoding)
+{
+   return encoding.empty() || encoding == "UTF-8";
+}
+
+// Pool of threads which read and tokenize source files. Completed
+// indexes are handed back to the main thread (which owns the entry
+// tree) via the results queue; since the indexes are never modified
+// once built they can then be searched without any locking. Jobs
+// submitted while the on disk cache is still being read are deferred
+// until it has been loaded.
+class IndexingPool : boost::noncopyable
+{
+public:
+   IndexingPool() : started_(false), cacheReady_(true)
+   {
+   }
+
+   void loadCache(const FilePath& cacheFile)
+   {
+      LOCK_MUTEX(mutex_)
+      {
+         cacheReady_ = false;
+      }
+      END_LOCK_MUTEX
+
+      core::thread::safeLaunchThread(
+               boost::bind(&IndexingPool::loadCacheThread, this, cacheFile));
+   }
+
+   void writeCache(const FilePath& cacheFile)
+   {
+      if (cache_.dirty())
+      {
+         core::thread::safeLaunchThread(
+                  boost::bind(&IndexingPool::writeCacheThread, this, cacheFile));
+      }
+   }
+
+   void removeFromCache(const std::string& path)
+   {
+      cache_.remove(path);
+   }
+
+   void clearCache()
+   {
+      cache_.clear();
+   }
+
+   void submit(const IndexingJob& job)
+   {
+      startWorkers();
+
+      LOCK_MUTEX(mutex_)
+      {
+         if (!cacheReady_)
+         {
+            deferredJobs_.push_back(job);
+            return;
+         }
+      }
+      END_LOCK_MUTEX
+
+      jobs_.enque(job);
+   }
+
+   bool takeResult(IndexingResult* pResult)
+   {
+      return results_.deque(pResult);
+   }
+
+   // index a file which the indexing threads couldn't convert to UTF-8
+   // (called on the main thread)
+   boost::shared_ptr<r_util::RSourceIndex> indexConverted(
+                                             const IndexingResult& result)
+   {
+      std::string code;
+      Error error = module_context::convertToUtf8(result.contents,
+                                                  result.encoding,
+                                                  true,
+                                                  &code);
+      if (error)
+      {
+         error.addProperty("src-file", result.fileInfo.absolutePath());
+         LOG_ERROR(error);
+         return boost::shared_ptr<r_util::RSourceIndex>();
+      }
+
+      boost::shared_ptr<r_util::RSourceIndex> pIndex(
+                     new r_util::RSourceIndex(result.context, code, false));
+      cache_.update(result.fileInfo, result.encoding, result.hash, pIndex);
+      return pIndex;
+   }
+
+private:
+   void startWorkers()
+   {
+      if (started_)
+         return;
+      started_ = true;
+
+      // the tokenizer and indexer build their lookup tables (and regexes)
+      // on first use, so index a snippet here to make sure that happens on
+      // the main thread rather than racing on the indexing threads
+      r_util::RSourceIndex primer(std::string(),
+                                  "library(utils); f <- function(x) x",
+                                  false);
+
+      // leave a core for the main thread
+      unsigned int cores = boost::thread::hardware_concurrency();
+      unsigned int workers = cores > 1 ? cores - 1 : 1;
+      workers = std::min(workers, kMaxWorkers);
+      for (unsigned int i = 0; i < workers; i++)
+      {
+         core::thread::safeLaunchThread(
+                  boost::bind(&IndexingPool::workerThread, this));
+      }
+   }
+
+   void workerThread()
+   {
+      try
+      {
+         while (true)
+         {
+            IndexingJob job;
+            if (jobs_.deque(&job, boost::posix_time::seconds(1)))
+               results_.enque(indexFile(job));
+         }
+      }
+      CATCH_UNEXPECTED_EXCEPTION
+   }
+
+   IndexingResult indexFile(const IndexingJob& job)
+   {
+      IndexingResult result;
+      result.id = job.id;
+      result.fileInfo = job.fileInfo;
+
+      // check the cache first (by modification time when restoring, then
+      // by content)
+      if (job.restore)
+      {
+         result.pIndex = cache_.find(job.fileInfo,
+                                     job.context,
+                                     job.encoding,
+                                     std::string());
+         if (result.pIndex)
+            return result;
+      }
+
+      FilePath filePath(job.fileInfo.absolutePath());
+      std::string contents;
+      Error error = readStringFromFile(filePath,
+                                       &contents,
+                                       session::options().sourceLineEnding());
+      if (error)
+      {
+         // log if not path not found error (this can happen if the
+         // file was removed after entering the indexing queue)
+         if (!core::isPathNotFoundError(error))
+         {
+            error.addProperty("src-file", filePath.absolutePath());
+            LOG_ERROR(error);
+         }
+         return result;
+      }
+
+      std::string hash = hash::crc32HexHash(contents);
+      result.pIndex = cache_.find(job.fileInfo,
+                                  job.context,
+                                  job.encoding,
+                                  hash);
+      if (result.pIndex)
+         return result;
+
+      if (!isUtf8Encoding(job.encoding))
+      {
+         result.needsConversion = true;
+         result.context = job.context;
+         result.encoding = job.encoding;
+         result.hash = hash;
+         result.contents.swap(contents);
+         return result;
+      }
+
+      std::string code;
+      error = module_context::convertToUtf8(contents, job.encoding, true, &code);
+      if (error)
+      {
+         error.addProperty("src-file", filePath.absolutePath());
+         LOG_ERROR(error);
+         return result;
+      }
+
+      // the index registers its inferred packages once it reaches the
+      // main thread
+      result.pIndex.reset(new r_util::RSourceIndex(job.context, code, false));
+      cache_.update(job.fileInfo, job.encoding, hash, result.pIndex);
+      return result;
+   }
+
+   void loadCacheThread(const FilePath& cacheFile)
+   {
+      try
+      {
+         Error error = cache_.read(cacheFile);
+         if (error)
+            LOG_ERROR(error);
+
+         std::vector<IndexingJob> deferredJobs;
+         LOCK_MUTEX(mutex_)
+         {
+            cacheReady_ = true;
+            deferredJobs.swap(deferredJobs_);
+         }
+         END_LOCK_MUTEX
+
+         BOOST_FOREACH(const IndexingJob& job, deferredJobs)
+         {
+            jobs_.enque(job);
+         }
+      }
+      CATCH_UNEXPECTED_EXCEPTION
+   }
+
+   void writeCacheThread(const FilePath& cacheFile)
+   {
+      try
+      {
+         Error error = cache_.write(cacheFile);
+         if (error)
+            LOG_ERROR(error);
+      }
+      CATCH_UNEXPECTED_EXCEPTION
+   }
+
+private:
+   static const unsigned int kMaxWorkers = 4;
+
+   bool started_;
+   SourceIndexCache cache_;
+   core::thread::ThreadsafeQueue<IndexingJob> jobs_;
+   core::thread::ThreadsafeQueue<IndexingResult> results_;
+
+   boost::mutex mutex_;
+   bool cacheReady_;
+   std::vector<IndexingJob> deferredJobs_;
+};
+
+IndexingPool& indexingPool()
+{
+   // never destroyed (the indexing threads run for the life of the process)
+   static IndexingPool* s_pPool = new IndexingPool();
+   return *s_pPool;
+}
+
+FilePath sourceIndexCachePath()
+{
+   return projects::projectContext().scratchPath().complete(
+                                                "source_index_cache.json");
+}
+
 class SourceFileIndex : boost::noncopyable
 {
 public:
    SourceFileIndex()
-      : pEntries_(new EntryTree()), indexing_(false)
+      : pEntries_(new EntryTree()),
+        indexing_(false),
+        nextJobId_(0),
+        applyingResults_(false),
+        cacheWriteScheduled_(false),
+        generation_(0)
    {
    }
 
@@ -458,7 +1099,7 @@ public:
       for ( ; begin != end; ++begin)
       {
          FileChangeEvent addEvent(FileChangeEvent::FileAdded, *begin);
-         indexingQueue_.push(addEvent);
+         indexingQueue_.push(std::make_pair(addEvent, true));
       }
 
       // schedule indexing if necessary. perform up to 200ms of work
@@ -479,7 +1120,7 @@ public:
    void enqueFileChange(const core::system::FileChangeEvent& event)
    {
       // add to the queue
-      indexingQueue_.push(event);
+      indexingQueue_.push(std::make_pair(event, false));
 
       // schedule indexing if necessary. don't index anything immediately
       // (this is to defend against large numbers of files being enqued
@@ -771,8 +1412,12 @@ public:
    void clear()
    {
       indexing_ = false;
-      indexingQueue_ = std::queue<core::system::FileChangeEvent>();
+      indexingQueue_ = std::queue<QueuedFileChange>();
       pEntries_->clear();
+      ++generation_;
+
+      // results of any outstanding jobs will be ignored
+      pendingJobs_.clear();
    }
 
 private:
@@ -784,7 +1429,8 @@ private:
       if (!indexingQueue_.empty())
       {
          // remove the event from the queue
-         FileChangeEvent event = indexingQueue_.front();
+         FileChangeEvent event = indexingQueue_.front().first;
+         bool restore = indexingQueue_.front().second;
          indexingQueue_.pop();
 
          // process the change
@@ -792,9 +1438,14 @@ private:
          switch(event.type())
          {
             case FileChangeEvent::FileAdded:
+            {
+               updateIndexEntry(fileInfo, false, restore);
+               break;
+            }
+
             case FileChangeEvent::FileModified:
             {
-               updateIndexEntry(fileInfo);
+               updateIndexEntry(fileInfo, true, restore);
                break;
             }
 
@@ -814,59 +1465,130 @@ private:
       return indexing_;
    }
 
-   void updateIndexEntry(const FileInfo& fileInfo)
+   void updateIndexEntry(const FileInfo& fileInfo, bool modified, bool restore)
    {
-      // index the source if necessary
-      boost::shared_ptr<r_util::RSourceIndex> pIndex;
-
-      // read the file
       FilePath filePath(fileInfo.absolutePath());
 
       // filter certain directories (e.g. those that exist in build directories)
       if (isWithinIgnoredDirectory(filePath))
          return;
 
+      // source files are indexed on the indexing threads. the entry is
+      // added right away (keeping any previous index of a modified file
+      // until the new one is ready) and updated once the index arrives
+      boost::shared_ptr<r_util::RSourceIndex> pIndex;
       if (isIndexableSourceFile(fileInfo))
       {
-         std::string code;
-         Error error = module_context::readAndDecodeFile(
-                                 filePath,
-                                 projects::projectContext().defaultEncoding(),
-                                 true,
-                                 &code);
-         if (error)
-         {
-            // log if not path not found error (this can happen if the
-            // file was removed after entering the indexing queue)
-            if (!core::isPathNotFoundError(error))
-            {
-               error.addProperty("src-file", filePath.absolutePath());
-               LOG_ERROR(error);
-            }
-            return;
-         }
-
-         // add index entry
-         std::string context = module_context::createAliasedPath(filePath);
-         pIndex.reset(new r_util::RSourceIndex(context, code));
+         if (modified)
+            pIndex = get(filePath);
+         submitIndexingJob(fileInfo, filePath, restore);
       }
 
       // attempt to add the entry
       Entry entry(fileInfo, pIndex);
       pEntries_->insertEntry(entry);
+   }
+
+   void submitIndexingJob(const FileInfo& fileInfo,
+                          const FilePath& filePath,
+                          bool restore)
+   {
+      IndexingJob job;
+      job.id = ++nextJobId_;
+      job.fileInfo = fileInfo;
+      job.context = module_context::createAliasedPath(filePath);
+      job.encoding = projects::projectContext().defaultEncoding();
+      job.restore = restore;
+      pendingJobs_[fileInfo.absolutePath()] = job.id;
+      indexingPool().submit(job);
+
+      if (!applyingResults_)
+      {
+         applyingResults_ = true;
+         module_context::schedulePeriodicWork(
+                  boost::posix_time::milliseconds(20),
+                  boost::bind(&SourceFileIndex::applyIndexingResults, this),
+                  false /* apply even when non-idle */);
+      }
+   }
+
+   bool applyIndexingResults()
+   {
+      // apply up to 10ms worth of completed indexes at a time
+      using namespace boost::posix_time;
+      ptime deadline = microsec_clock::universal_time() + milliseconds(10);
+
+      bool indexed = false;
+      IndexingResult result;
+      while (microsec_clock::universal_time() < deadline &&
+             indexingPool().takeResult(&result))
+      {
+         // ignore results for files which have since been changed again
+         // (or removed)
+         std::map<std::string, int>::iterator it =
+                           pendingJobs_.find(result.fileInfo.absolutePath());
+         if (it == pendingJobs_.end() || it->second != result.id)
+            continue;
+         pendingJobs_.erase(it);
+
+         if (result.needsConversion)
+            result.pIndex = indexingPool().indexConverted(result);
+         if (result.pIndex)
+            result.pIndex->registerInferredPackages();
+         pEntries_->insertEntry(Entry(result.fileInfo, result.pIndex));
+         ++generation_;
+         indexed = true;
+      }
 
       // kick off an update
-      r_packages::AsyncPackageInformationProcess::update();
+      if (indexed)
+         r_packages::AsyncPackageInformationProcess::update();
+
+      if (pendingJobs_.empty())
+      {
+         applyingResults_ = false;
+         scheduleCacheWrite();
+         return false;
+      }
+
+      return true;
+   }
+
+   void scheduleCacheWrite()
+   {
+      // coalesce writes (each one rewrites the whole cache)
+      if (cacheWriteScheduled_)
+         return;
+
+      cacheWriteScheduled_ = true;
+      module_context::scheduleDelayedWork(
+               boost::posix_time::seconds(15),
+               boost::bind(&SourceFileIndex::writeCache, this),
+               false);
+   }
+
+   void writeCache()
+   {
+      cacheWriteScheduled_ = false;
+
+      if (projects::projectContext().hasProject())
+         indexingPool().writeCache(sourceIndexCachePath());
    }
 
    void removeIndexEntry(const FileInfo& fileInfo)
    {
+      pendingJobs_.erase(fileInfo.absolutePath());
+      indexingPool().removeFromCache(fileInfo.absolutePath());
+
       // create a fake entry with a null source index to pass to find
       Entry entry(fileInfo, boost::shared_ptr<r_util::RSourceIndex>());
 
       EntryTree::iterator it = pEntries_->find(entry);
       if (it != pEntries_->end())
+      {
          pEntries_->erase(it);
+         ++generation_;
+      }
       else
       {
          DEBUG("Failed to remove index entry for file: '" << fileInfo.absolutePath() << "'");
@@ -929,13 +1651,27 @@ public:
    
    boost::shared_ptr<EntryTree> entries() const { return pEntries_; }
 
+   int generation() const { return generation_; }
+
 private:
    // index entries
    boost::shared_ptr<EntryTree> pEntries_;
 
    // indexing queue
    bool indexing_;
-   std::queue<core::system::FileChangeEvent> indexingQueue_;
+   // file changes to index, flagged true for those registered when the
+   // index is first built (see IndexingJob::restore)
+   typedef std::pair<core::system::FileChangeEvent, bool> QueuedFileChange;
+   std::queue<QueuedFileChange> indexingQueue_;
+
+   // outstanding jobs on the indexing threads (latest job id by path)
+   int nextJobId_;
+   std::map<std::string, int> pendingJobs_;
+   bool applyingResults_;
+   bool cacheWriteScheduled_;
+
+   // incremented whenever indexes are added to or removed from the entries
+   int generation_;
 };
 
 } // anonymous namespace
@@ -2267,6 +3003,10 @@ Error findFunctionInSearchPath(const json::JsonRpcRequest& request,
 
 void onFileMonitorEnabled(const tree<core::FileInfo>& files)
 {
+   // files which haven't changed since they were last indexed are
+   // restored from the cache
+   indexingPool().loadCache(sourceIndexCachePath());
+
    s_projectIndex.enqueFiles(files.begin_leaf(), files.end_leaf());
 }
 
@@ -2282,6 +3022,7 @@ void onFileMonitorDisabled()
 {
    // clear the index so we don't ever get stale results
    s_projectIndex.clear();
+   indexingPool().clearCache();
 }
 
 SEXP rs_scoreMatches(SEXP suggestionsSEXP,
@@ -2482,6 +3223,11 @@ void addAllProjectSymbols(const Entry& entry,
 
 } // namespace callbacks
 
+int projectIndexGeneration()
+{
+   return s_projectIndex.generation();
+}
+
 void addAllProjectSymbols(std::set<std::string>* pSymbols)
 {
    FilePath buildTarget = projects::projectContext().buildTargetPath();
@@ -111,6 +111,10 @@ void searchSource(const std::string& term,
 
 void addAllProjectSymbols(std::set<std::string>* pSymbols);
 
+// changes whenever files are indexed into (or removed from) the project
+// index, so that data derived from it can tell when it's out of date
+int projectIndexGeneration();
+
 core::Error initialize();
    
 } // namespace code_search
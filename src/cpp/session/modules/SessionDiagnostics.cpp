@@ -24,12 +24,14 @@
 #include "SessionAsyncPackageInformation.hpp"
 #include "SessionRParser.hpp"
 
+#include <map>
 #include <set>
 
 #include <core/Debug.hpp>
 #include <core/Exec.hpp>
 #include <core/Error.hpp>
 #include <core/FileSerializer.hpp>
+#include <core/Hash.hpp>
 #include <core/YamlUtil.hpp>
 
 #include <session/SessionRUtil.hpp>
@@ -259,6 +261,11 @@ public:
                symbols.end());
    }
    
+   void clear()
+   {
+      registry_.clear();
+   }
+   
 private:
    Registry registry_;
 };
@@ -319,6 +326,68 @@ void addRcppExportedSymbols(const FilePath& filePath,
    }
 }
 
+// The available symbols are drawn from sources outside of the document being
+// linted: the project index, the package information index, and R itself.
+// Symbols (and lint) computed with these sources in a given state are reused
+// until it changes.
+struct SymbolSourcesState
+{
+   SymbolSourcesState()
+      : generation(-1),
+        projectIndexGeneration(-1),
+        packageInformationCount(0)
+   {}
+   
+   bool operator==(const SymbolSourcesState& other) const
+   {
+      return generation == other.generation &&
+             projectIndexGeneration == other.projectIndexGeneration &&
+             packageInformationCount == other.packageInformationCount;
+   }
+   
+   int generation;
+   int projectIndexGeneration;
+   std::size_t packageInformationCount;
+};
+
+// incremented when the state of R changes in a way which can affect the
+// available symbols (code run at the console, packages loaded or installed)
+// or when the package's NAMESPACE or DESCRIPTION changes
+int s_symbolsGeneration = 0;
+
+void invalidateSymbols()
+{
+   ++s_symbolsGeneration;
+}
+
+SymbolSourcesState symbolSourcesState()
+{
+   SymbolSourcesState state;
+   state.generation = s_symbolsGeneration;
+   state.projectIndexGeneration = code_search::projectIndexGeneration();
+   
+   // package information is only ever added (as it arrives from the
+   // background process which gathers it) so its size tells us when it changes
+   state.packageInformationCount =
+         RSourceIndex::getPackageInformationDatabase().size();
+   
+   return state;
+}
+
+// a set of symbols which is shared by all documents, and the state of the
+// sources it was computed from
+struct CachedSymbols
+{
+   SymbolSourcesState state;
+   std::set<std::string> symbols;
+};
+
+// symbols available within the files of a package project
+CachedSymbols s_packageSymbols;
+
+// symbols available on the search path
+CachedSymbols s_searchPathSymbols;
+
 // For an R package, symbols are looked up in this order:
 //
 // 1) The package's own objects (exported or not),
@@ -332,11 +401,33 @@ Error getAvailableSymbolsForPackage(const FilePath& filePath,
                                     const std::string& documentId,
                                     std::set<std::string>* pSymbols)
 {
-   // Add project symbols (ie, top-level symbols within an R package)
-   code_search::addAllProjectSymbols(pSymbols);
+   SymbolSourcesState state = symbolSourcesState();
+   if (!(s_packageSymbols.state == state))
+   {
+      std::set<std::string>& symbols = s_packageSymbols.symbols;
+      symbols.clear();
+      
+      // Add project symbols (ie, top-level symbols within an R package)
+      code_search::addAllProjectSymbols(&symbols);
+      
+      // Symbols inferred from the NAMESPACE (importFrom, import)
+      addNamespaceSymbols(&symbols);
+      
+      // Symbols that are 'automatically' made available to packages. In other
+      // words, symbols that packages can use without explicitly importing them.
+      // In other words, symbols that `R CMD check` will silently resolve to one
+      // of the base packages. Note that not all `base` packages are allowed here.
+      // These packages appear to be (as of R 3.1.0):
+      //
+      //     base, graphics, grDevices, methods, stats, stats4, utils
+      //
+      addBaseSymbols(&symbols);
+      
+      s_packageSymbols.state = state;
+   }
    
-   // Symbols inferred from the NAMESPACE (importFrom, import)
-   addNamespaceSymbols(pSymbols);
+   pSymbols->insert(s_packageSymbols.symbols.begin(),
+                    s_packageSymbols.symbols.end());
    
    // Add symbols made available by explicit `library()` calls
    // within this document.
@@ -345,16 +436,6 @@ Error getAvailableSymbolsForPackage(const FilePath& filePath,
    // Add in symbols that would be made available by `// [[Rcpp::export]]`
    addRcppExportedSymbols(filePath, documentId, pSymbols);
    
-   // Symbols that are 'automatically' made available to packages. In other
-   // words, symbols that packages can use without explicitly importing them.
-   // In other words, symbols that `R CMD check` will silently resolve to one
-   // of the base packages. Note that not all `base` packages are allowed here.
-   // These packages appear to be (as of R 3.1.0):
-   //
-   //     base, graphics, grDevices, methods, stats, stats4, utils
-   //
-   addBaseSymbols(pSymbols);
-   
    return Success();
 }
 
@@ -366,9 +447,21 @@ Error getAvailableSymbolsForProject(const FilePath& filePath,
                                     std::set<std::string>* pSymbols)
 {
    // Get all available symbols on the search path.
-   Error error = r::exec::RFunction(".rs.availableRSymbols").call(pSymbols);
-   if (error)
-      return error;
+   SymbolSourcesState state = symbolSourcesState();
+   if (!(s_searchPathSymbols.state == state))
+   {
+      std::set<std::string>& symbols = s_searchPathSymbols.symbols;
+      symbols.clear();
+      
+      Error error = r::exec::RFunction(".rs.availableRSymbols").call(&symbols);
+      if (error)
+         return error;
+      
+      s_searchPathSymbols.state = state;
+   }
+   
+   pSymbols->insert(s_searchPathSymbols.symbols.begin(),
+                    s_searchPathSymbols.symbols.end());
    
    // Add in symbols that would be made available by `// [[Rcpp::export]]`
    addRcppExportedSymbols(filePath, documentId, pSymbols);
@@ -633,14 +726,8 @@ void setFileLocalParseOptions(const std::wstring& rCode,
    applyOptions(options, pOptions);
 }
 
-} // end anonymous namespace
-
-ParseResults parse(const std::wstring& rCode,
-                   const FilePath& origin,
-                   const std::string& documentId = std::string(),
-                   bool isExplicit = false)
+ParseOptions lintOptions(bool isExplicit)
 {
-   ParseResults results;
    ParseOptions options;
    
    options.setLintRFunctions(
@@ -658,12 +745,78 @@ ParseResults parse(const std::wstring& rCode,
    options.setRecordStyleLint(
             userSettings().enableStyleDiagnostics());
    
+   return options;
+}
+
+// incremental parsers for the open source documents, by id
+std::map<std::string, boost::shared_ptr<IncrementalParser> > s_parsers;
+
+// the most recent lint of each open source document (by id), along with
+// everything it depends on; it's reused if the document is linted again
+// before any of these change
+struct CachedLint
+{
+   std::string contentHash;
+   FilePath origin;
+   ParseOptions options;
+   SymbolSourcesState state;
+   ParseResults results;
+};
+
+std::map<std::string, CachedLint> s_lintCache;
+
+void onDocRemoved(const std::string& id, const std::string&)
+{
+   s_parsers.erase(id);
+   s_lintCache.erase(id);
+}
+
+void onAllDocsRemoved()
+{
+   s_parsers.clear();
+   s_lintCache.clear();
+}
+
+void onConsoleInput(const std::string&)
+{
+   // code run at the console can change the functions which calls are
+   // checked against, so re-parse documents in full on their next lint
+   s_parsers.clear();
+   invalidateSymbols();
+}
+
+void onPackageLibraryMutated()
+{
+   packageSymbolRegistry().clear();
+   invalidateSymbols();
+}
+
+} // end anonymous namespace
+
+ParseResults parse(const std::wstring& rCode,
+                   const FilePath& origin,
+                   const std::string& documentId = std::string(),
+                   bool isExplicit = false)
+{
+   ParseResults results;
+   ParseOptions options = lintOptions(isExplicit);
+   
    bool noLint = false;
    setFileLocalParseOptions(rCode, &options, &noLint);
    if (noLint)
       return ParseResults();
    
-   results = rparser::parse(origin, rCode, options);
+   if (documentId.empty())
+   {
+      results = rparser::parse(origin, rCode, options);
+   }
+   else
+   {
+      boost::shared_ptr<IncrementalParser>& pParser = s_parsers[documentId];
+      if (!pParser)
+         pParser.reset(new IncrementalParser());
+      results = pParser->parse(origin, rCode, options);
+   }
    
    ParseNode* pRoot = results.parseTree();
    if (!pRoot)
@@ -768,33 +921,17 @@ module_context::SourceMarkerSet asSourceMarkerSet(
    return SourceMarkerSet("Diagnostics", markers);
 }
 
-Error lintRSourceDocument(const json::JsonRpcRequest& request,
-                          json::JsonRpcResponse* pResponse)
+Error lintDocument(const std::string& documentId,
+                   const std::string& documentPath,
+                   bool showMarkersTab,
+                   bool isExplicit,
+                   json::Array* pLint)
 {
    using namespace source_database;
    
-   // Ensure response is always at least an array, even on 'failure'
-   pResponse->setResult(json::Array());
-   
-   std::string documentId;
-   std::string documentPath;
-   bool showMarkersTab = false;
-   bool isExplicit = false;
-   Error error = json::readParams(request.params,
-                                  &documentId,
-                                  &documentPath,
-                                  &showMarkersTab,
-                                  &isExplicit);
-   
-   if (error)
-   {
-      LOG_ERROR(error);
-      return error;
-   }
-   
    // Try to get the contents from the database
    boost::shared_ptr<SourceDocument> pDoc(new SourceDocument());
-   error = get(documentId, pDoc);
+   Error error = get(documentId, pDoc);
    
    // don't log on error here (it's possible that we might attempt to lint a
    // document immediately after a suspend-resume, and so we fail to get the
@@ -814,13 +951,32 @@ Error lintRSourceDocument(const json::JsonRpcRequest& request,
    if (error)
       return error;
    
-   ParseResults results = diagnostics::parse(
-            string_utils::utf8ToWide(content),
-            origin,
-            documentId,
-            isExplicit);
+   // Re-use the previous lint if neither the code nor anything it's
+   // checked against has changed since
+   std::string contentHash = hash::crc32Hash(content);
+   ParseOptions options = lintOptions(isExplicit);
+   SymbolSourcesState state = symbolSourcesState();
+   
+   CachedLint& cached = s_lintCache[documentId];
+   if (cached.contentHash != contentHash ||
+       cached.origin != origin ||
+       !(cached.options == options) ||
+       !(cached.state == state))
+   {
+      cached.results = diagnostics::parse(
+               string_utils::utf8ToWide(content),
+               origin,
+               documentId,
+               isExplicit);
+      
+      cached.contentHash = contentHash;
+      cached.origin = origin;
+      cached.options = options;
+      cached.state = state;
+   }
    
-   pResponse->setResult(lintAsJson(results.lint()));
+   const ParseResults& results = cached.results;
+   *pLint = lintAsJson(results.lint());
    
    if (showMarkersTab)
    {
@@ -833,6 +989,95 @@ Error lintRSourceDocument(const json::JsonRpcRequest& request,
    return Success();
 }
 
+// requests to lint a document which arrive while R is busy wait for it to
+// become idle. a request for a document which is already waiting replaces it
+// (so the document is linted once, in its latest state) and all of them are
+// answered with the result
+struct PendingLint
+{
+   PendingLint()
+      : showMarkersTab(false),
+        isExplicit(false)
+   {}
+   
+   std::string documentPath;
+   bool showMarkersTab;
+   bool isExplicit;
+   std::vector<json::JsonRpcFunctionContinuation> continuations;
+};
+
+std::map<std::string, PendingLint> s_pendingLints;
+
+void performPendingLint(const std::string& documentId)
+{
+   std::map<std::string, PendingLint>::iterator it =
+                                          s_pendingLints.find(documentId);
+   if (it == s_pendingLints.end())
+      return;
+   
+   PendingLint pending = it->second;
+   s_pendingLints.erase(it);
+   
+   json::Array lint;
+   Error error = lintDocument(documentId,
+                              pending.documentPath,
+                              pending.showMarkersTab,
+                              pending.isExplicit,
+                              &lint);
+   
+   BOOST_FOREACH(const json::JsonRpcFunctionContinuation& continuation,
+                 pending.continuations)
+   {
+      // Ensure response is always at least an array, even on 'failure'
+      json::JsonRpcResponse response;
+      response.setResult(lint);
+      continuation(error, &response);
+   }
+}
+
+void lintRSourceDocument(const json::JsonRpcRequest& request,
+                         const json::JsonRpcFunctionContinuation& continuation)
+{
+   std::string documentId;
+   std::string documentPath;
+   bool showMarkersTab = false;
+   bool isExplicit = false;
+   Error error = json::readParams(request.params,
+                                  &documentId,
+                                  &documentPath,
+                                  &showMarkersTab,
+                                  &isExplicit);
+   
+   if (error)
+   {
+      LOG_ERROR(error);
+      json::JsonRpcResponse response;
+      response.setResult(json::Array());
+      continuation(error, &response);
+      return;
+   }
+   
+   bool scheduled = s_pendingLints.count(documentId) > 0;
+   
+   PendingLint& pending = s_pendingLints[documentId];
+   pending.documentPath = documentPath;
+   pending.showMarkersTab = pending.showMarkersTab || showMarkersTab;
+   pending.isExplicit = pending.isExplicit || isExplicit;
+   pending.continuations.push_back(continuation);
+   
+   if (!request.isBackgroundConnection)
+   {
+      performPendingLint(documentId);
+   }
+   else if (!scheduled)
+   {
+      module_context::scheduleDelayedWork(
+               boost::posix_time::milliseconds(100),
+               boost::bind(performPendingLint, documentId),
+               true);
+   }
+}
+
 SEXP rs_lintRFile(SEXP filePathSEXP)
 {
    using namespace r::sexp;
@@ -937,6 +1182,7 @@ void onNAMESPACEchanged()
    
    RSourceIndex::setImportedPackages(importPkgNames);
    RSourceIndex::setImportFromDirectives(importFromSymbols);
+   invalidateSymbols();
    
    // Kick off an update of the cached async completions
    r_packages::AsyncPackageInformationProcess::update();
@@ -946,12 +1192,16 @@ void onFilesChanged(const std::vector<core::system::FileChangeEvent>& events)
 {
    std::string namespacePath =
          projects::projectContext().directory().complete("NAMESPACE").absolutePath();
+   std::string descriptionPath =
+         projects::projectContext().directory().complete("DESCRIPTION").absolutePath();
    
    BOOST_FOREACH(const core::system::FileChangeEvent& event, events)
    {
       std::string eventPath = event.fileInfo().absolutePath();
       if (eventPath == namespacePath)
          onNAMESPACEchanged();
+      else if (eventPath == descriptionPath)
+         invalidateSymbols();
    }
 }
 
@@ -1031,6 +1281,11 @@ core::Error initialize()
    using namespace module_context;
    
    events().afterSessionInitHook.connect(afterSessionInitHook);
+   events().onConsoleInput.connect(onConsoleInput);
+   events().onPackageLoaded.connect(boost::bind(invalidateSymbols));
+   events().onPackageLibraryMutated.connect(onPackageLibraryMutated);
+   source_database::events().onDocRemoved.connect(onDocRemoved);
+   source_database::events().onRemoveAll.connect(onAllDocsRemoved);
    
    session::projects::FileMonitorCallbacks cb;
    cb.onFilesChanged = onFilesChanged;
@@ -1042,7 +1297,7 @@ core::Error initialize()
    ExecBlock initBlock;
    initBlock.addFunctions()
          (bind(sourceModuleRFile, "SessionDiagnostics.R"))
-         (bind(registerRpcMethod, "lint_r_source_document", lintRSourceDocument));
+         (bind(registerAsyncRpcMethod, "lint_r_source_document", lintRSourceDocument));
    
    return initBlock.execute();
 
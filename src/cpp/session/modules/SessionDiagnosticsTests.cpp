@@ -18,6 +18,7 @@
 #include "SessionDiagnostics.hpp"
 
 #include <iostream>
+#include <sstream>
 
 #include <core/collection/Tree.hpp>
 #include <core/FilePath.hpp>
@@ -120,6 +121,35 @@ void lintRStudioRFiles()
    lintRFilesInSubdirectory(options().modulesRSourcePath());
 }
 
+std::string lintAsString(const LintItems& lint)
+{
+   std::stringstream ss;
+   BOOST_FOREACH(const LintItem& item, lint)
+   {
+      ss << item.startRow << ":" << item.startColumn << "-"
+         << item.endRow << ":" << item.endColumn << " "
+         << item.message << "\n";
+   }
+   return ss.str();
+}
+
+// re-parse the document after each edit (removing 'count' characters at
+// 'offset' and inserting 'insert' in their place), and check that the
+// incremental parse finds the same lint as parsing the whole document
+bool incrementalParseMatches(IncrementalParser* pParser,
+                             std::wstring* pCode,
+                             std::size_t offset,
+                             std::size_t count,
+                             const std::wstring& insert)
+{
+   pCode->replace(offset, count, insert);
+   
+   FilePath filePath;
+   ParseResults incremental = pParser->parse(filePath, *pCode, s_parseOptions);
+   ParseResults full = parse(*pCode, s_parseOptions);
+   return lintAsString(incremental.lint()) == lintAsString(full.lint());
+}
+
 context("Diagnostics")
 {
    test_that("valid expressions generate no lint")
@@ -274,6 +304,40 @@ context("Diagnostics")
       EXPECT_NO_LINT("foo(!!! abc)");
    }
    
+   test_that("incremental parses find the same lint as full parses")
+   {
+      std::wstring code =
+            L"f <- function(x, y = 1) {\n"
+            L"   x + y\n"
+            L"}\n"
+            L"\n"
+            L"g <- function(a) {\n"
+            L"   if (a) f(a) else f(a, y = 2)\n"
+            L"}\n"
+            L"\n"
+            L"h <- function() g(1)\n";
+      
+      IncrementalParser parser;
+      std::size_t body = code.find(L"x + y");
+      std::size_t call = code.find(L"f(a)");
+      
+      // edits within a function body
+      expect_true(incrementalParseMatches(&parser, &code, body, 0, L"("));
+      expect_true(incrementalParseMatches(&parser, &code, body, 1, L""));
+      expect_true(incrementalParseMatches(&parser, &code, body, 0, L"z <- 1\n   "));
+      
+      // edits which change a function's signature, or the calls to it
+      expect_true(incrementalParseMatches(&parser, &code, 14, 0, L"z, "));
+      expect_true(incrementalParseMatches(&parser, &code, call + 2, 0, L"1, 2, 3, "));
+      expect_true(incrementalParseMatches(&parser, &code, 0, 1, L"ff"));
+      
+      // edits which open or close brackets and strings
+      expect_true(incrementalParseMatches(&parser, &code, code.size(), 0, L"{"));
+      expect_true(incrementalParseMatches(&parser, &code, 0, 0, L"\"\n"));
+      expect_true(incrementalParseMatches(&parser, &code, 0, 2, L""));
+      expect_true(incrementalParseMatches(&parser, &code, code.size() - 1, 1, L"}"));
+   }
+   
    lintRStudioRFiles();
 }
 
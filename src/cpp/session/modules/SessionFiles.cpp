@@ -36,6 +36,7 @@
 #include <core/Settings.hpp>
 #include <core/Exec.hpp>
 #include <core/DateTime.hpp>
+#include <core/BrowserUtils.hpp>
 
 #include <core/http/Util.hpp>
 #include <core/http/Request.hpp>
@@ -495,9 +496,19 @@ void handleFilesRequest(const http::Request& request,
       return;
    }
 
-
+   // serve files straight from disk, advertising byte range support (e.g.
+   // for seeking within media) on full responses too. html for Qt is padded
+   // on the way out so can't be served that way (ranges don't apply to it)
    pResponse->setNoCacheHeaders();
-   pResponse->setFile(filePath, request);
+   if (browser_utils::isQt(request.headerValue("User-Agent")) &&
+       filePath.mimeContentType() == "text/html")
+   {
+      pResponse->setFile(filePath, request);
+   }
+   else
+   {
+      pResponse->setRangeableFile(filePath, request);
+   }
 }
    
 const char * const kUploadFilename = "filename";
@@ -1019,8 +1030,8 @@ Error initialize()
    using boost::bind;
    ExecBlock initBlock ;
    initBlock.addFunctions()
-      (bind(registerRpcMethod, "stat", stat))
-      (bind(registerRpcMethod, "is_text_file", isTextFile))
+      (bind(registerWorkerSafeRpcMethod, "stat", stat))
+      (bind(registerWorkerSafeRpcMethod, "is_text_file", isTextFile))
       (bind(registerRpcMethod, "get_file_contents", getFileContents))
       (bind(registerRpcMethod, "list_files", listFiles))
       (bind(registerRpcMethod, "create_folder", createFolder))
@@ -1033,7 +1044,7 @@ Error initialize()
       (bind(registerUriHandler, "/export", handleFileExportRequest))
       (bind(registerRpcMethod, "complete_upload", completeUpload))
       (bind(registerRpcMethod, "write_json", writeJSON))
-      (bind(registerRpcMethod, "read_json", readJSON))
+      (bind(registerWorkerSafeRpcMethod, "read_json", readJSON))
       (bind(sourceModuleRFile, "SessionFiles.R"))
       (bind(quotas::initialize));
    return initBlock.execute();
@@ -16,16 +16,24 @@
 #include "SessionFind.hpp"
 
 #include <algorithm>
+#include <cstring>
+#include <queue>
+#include <set>
 
 #include <boost/algorithm/string.hpp>
 #include <boost/bind.hpp>
 #include <boost/enable_shared_from_this.hpp>
 
 #include <core/Exec.hpp>
+#include <core/FileSerializer.hpp>
+#include <core/RegexUtils.hpp>
 #include <core/StringUtils.hpp>
 #include <core/system/Environment.hpp>
 #include <core/system/Process.hpp>
 #include <core/system/ShellUtils.hpp>
+#include <core/system/FileChangeEvent.hpp>
+#include <core/text/TermBufferParser.hpp>
+#include <core/text/TrigramIndex.hpp>
 
 #include <r/RUtil.hpp>
 
@@ -193,30 +201,181 @@ FindInFilesState& findResults()
    return *s_pFindResults;
 }
 
-class GrepOperation : public boost::enable_shared_from_this<GrepOperation>
+// state and helpers shared by find operations (whether they are run by
+// grep or answered from the project index)
+class FindOperation : boost::noncopyable
 {
-public:
-   static boost::shared_ptr<GrepOperation> create(const std::string& encoding,
-                                                  const FilePath& tempFile)
+protected:
+   // operations which continue another (e.g. grep searching the files
+   // which the project index can't) share its handle
+   explicit FindOperation(const std::string& encoding,
+                          const std::string& handle = std::string())
+      : firstDecodeError_(true), encoding_(encoding), handle_(handle)
    {
-      return boost::shared_ptr<GrepOperation>(new GrepOperation(encoding,
-                                                                tempFile));
+      if (handle_.empty())
+         handle_ = core::system::generateUuid(false);
    }
 
-private:
-   GrepOperation(const std::string& encoding,
-                 const FilePath& tempFile)
-      : firstDecodeError_(true), encoding_(encoding), tempFile_(tempFile)
+public:
+   virtual ~FindOperation()
    {
-      handle_ = core::system::generateUuid(false);
    }
 
-public:
    std::string handle() const
    {
       return handle_;
    }
 
+protected:
+   bool isActive() const
+   {
+      return findResults().isRunning() && findResults().handle() == handle();
+   }
+
+   std::string decode(const std::string& encoded)
+   {
+      if (encoded.empty())
+         return encoded;
+
+      std::string decoded;
+      Error error = r::util::iconvstr(encoded, encoding_, "UTF-8", true,
+                                      &decoded);
+
+      // Log error, but only once per find operation
+      if (error && firstDecodeError_)
+      {
+         firstDecodeError_ = false;
+         LOG_ERROR(error);
+      }
+
+      return decoded;
+   }
+
+   // decode and append a segment of a line, tracking the number of UTF-8
+   // characters in the line so far (match positions are reported in
+   // characters rather than bytes)
+   void appendDecoded(const std::string& encoded,
+                      std::string* pLine,
+                      std::size_t* pCharacters)
+   {
+      std::string decoded = decode(encoded);
+      pLine->append(decoded);
+
+      std::size_t charSize;
+      Error error = string_utils::utf8Distance(decoded.begin(),
+                                               decoded.end(),
+                                               &charSize);
+      if (error)
+         charSize = decoded.size();
+      *pCharacters += charSize;
+   }
+
+   static void truncateLine(std::string* pLine)
+   {
+      if (pLine->size() > 300)
+      {
+         pLine->erase(300);
+         pLine->append("...");
+      }
+   }
+
+   static std::string websiteOutputDir()
+   {
+      std::string websiteOutputDir = module_context::websiteOutputDir();
+      if (!websiteOutputDir.empty())
+         websiteOutputDir = "/" + websiteOutputDir + "/";
+      return websiteOutputDir;
+   }
+
+   static bool isExcluded(const std::string& file,
+                          const std::string& websiteOutputDir)
+   {
+      if (file.find("/.Rproj.user/") != std::string::npos)
+         return true;
+      if (file.find("/.git/") != std::string::npos)
+         return true;
+      if (file.find("/.svn/") != std::string::npos)
+         return true;
+      if (file.find("/packrat/lib/") != std::string::npos)
+         return true;
+      if (file.find("/packrat/src/") != std::string::npos)
+         return true;
+      if (file.find("/.Rhistory") != std::string::npos)
+         return true;
+
+      if (!websiteOutputDir.empty() &&
+          file.find(websiteOutputDir) != std::string::npos)
+         return true;
+
+      return false;
+   }
+
+   void notifyResults(const json::Array& files,
+                      const json::Array& lineNums,
+                      const json::Array& contents,
+                      const json::Array& matchOns,
+                      const json::Array& matchOffs)
+   {
+      if (files.empty())
+         return;
+
+      json::Object result;
+      result["handle"] = handle();
+      json::Object results;
+      results["file"] = files;
+      results["line"] = lineNums;
+      results["lineValue"] = contents;
+      results["matchOn"] = matchOns;
+      results["matchOff"] = matchOffs;
+      result["results"] = results;
+
+      findResults().addResult(handle(),
+                              files,
+                              lineNums,
+                              contents,
+                              matchOns,
+                              matchOffs);
+
+      module_context::enqueClientEvent(
+               ClientEvent(client_events::kFindResult, result));
+   }
+
+   void notifyEnded()
+   {
+      findResults().onFindEnd(handle());
+      module_context::enqueClientEvent(
+            ClientEvent(client_events::kFindOperationEnded, handle()));
+   }
+
+private:
+   bool firstDecodeError_;
+   std::string encoding_;
+   std::string handle_;
+};
+
+class GrepOperation : public FindOperation,
+                      public boost::enable_shared_from_this<GrepOperation>
+{
+public:
+   static boost::shared_ptr<GrepOperation> create(
+                              const std::string& encoding,
+                              const FilePath& tempFile,
+                              const std::string& handle = std::string())
+   {
+      return boost::shared_ptr<GrepOperation>(new GrepOperation(encoding,
+                                                                tempFile,
+                                                                handle));
+   }
+
+private:
+   GrepOperation(const std::string& encoding,
+                 const FilePath& tempFile,
+                 const std::string& handle)
+      : FindOperation(encoding, handle), tempFile_(tempFile)
+   {
+   }
+
+public:
    core::system::ProcessCallbacks createProcessCallbacks()
    {
       core::system::ProcessCallbacks callbacks;
@@ -238,26 +397,15 @@ public:
 private:
    bool onContinue(const core::system::ProcessOperations& ops) const
    {
-      return findResults().isRunning() && findResults().handle() == handle();
+      return isActive();
    }
 
-   std::string decode(const std::string& encoded)
+   static bool isMatchMarker(const text::ControlSequence& sequence)
    {
-      if (encoded.empty())
-         return encoded;
-
-      std::string decoded;
-      Error error = r::util::iconvstr(encoded, encoding_, "UTF-8", true,
-                                      &decoded);
-
-      // Log error, but only once per grep operation
-      if (error && firstDecodeError_)
-      {
-         firstDecodeError_ = false;
-         LOG_ERROR(error);
-      }
-
-      return decoded;
+      return sequence.status == text::ControlSequence::Complete &&
+             !sequence.isPrivate &&
+             sequence.final == 'm' &&
+             (sequence.params.empty() || sequence.params.length() == 2);
    }
 
    void processContents(std::string* pContent,
@@ -267,45 +415,49 @@ private:
       // initialize some state
       std::string decodedLine;
       std::size_t nUtf8CharactersProcessed = 0;
-      
+
       const char* inputPos = pContent->c_str();
       const char* end = inputPos + pContent->size();
-      
-      boost::cmatch match;
-      while (regex_utils::search(inputPos, match, boost::regex("\x1B\\[(\\d\\d)?m(\x1B\\[K)?")))
+
+      // grep marks the start and end of each match with ESC[01m and ESC[m
+      // (or ESC[00m), each possibly followed by ESC[K
+      const char* pos = inputPos;
+      while ((pos = text::findEscape(pos, end)) != end)
       {
-         // decode the current match, and append it
-         std::string matchedString(inputPos, inputPos + match.position());
-         std::string decoded = decode(matchedString);
-         
-         // append and update
-         decodedLine.append(decoded);
-         inputPos += match.position() + match.length();
-         
-         // count the number of UTF-8 characters processed
-         std::size_t charSize;
-         Error error = string_utils::utf8Distance(decoded.begin(),
-                                                  decoded.end(),
-                                                  &charSize);
-         if (error)
-            charSize = decoded.size();
-         nUtf8CharactersProcessed += charSize;
+         text::ControlSequence sequence = text::parseControlSequence(pos, end);
+         if (!isMatchMarker(sequence))
+         {
+            pos++;
+            continue;
+         }
+
+         // decode the text before the marker, and append it
+         appendDecoded(std::string(inputPos, pos),
+                       &decodedLine,
+                       &nUtf8CharactersProcessed);
+         pos += sequence.length;
+         if (pos != end && *pos == '\033')
+         {
+            text::ControlSequence clear = text::parseControlSequence(pos, end);
+            if (clear.status == text::ControlSequence::Complete &&
+                !clear.isPrivate && clear.params.empty() && clear.final == 'K')
+            {
+               pos += clear.length;
+            }
+         }
+         inputPos = pos;
 
          // update the match state
-         if (match[1] == "01")
+         if (sequence.params == "01")
             pMatchOn->push_back(static_cast<int>(nUtf8CharactersProcessed));
          else
             pMatchOff->push_back(static_cast<int>(nUtf8CharactersProcessed));
       }
-      
+
       if (inputPos != end)
          decodedLine.append(decode(std::string(inputPos, end)));
 
-      if (decodedLine.size() > 300)
-      {
-         decodedLine = decodedLine.erase(300);
-         decodedLine.append("...");
-      }
+      truncateLine(&decodedLine);
 
       *pContent = decodedLine;
    }
@@ -322,9 +474,7 @@ private:
       if (recordsToProcess < 0)
          recordsToProcess = 0;
 
-      std::string websiteOutputDir = module_context::websiteOutputDir();
-      if (!websiteOutputDir.empty())
-         websiteOutputDir = "/" + websiteOutputDir + "/";
+      std::string outputDir = websiteOutputDir();
 
       stdOutBuf_.append(data);
       size_t nextLineStart = 0;
@@ -341,21 +491,7 @@ private:
             std::string file = module_context::createAliasedPath(
                   FilePath(string_utils::systemToUtf8(match[1])));
 
-            if (file.find("/.Rproj.user/") != std::string::npos)
-               continue;
-            if (file.find("/.git/") != std::string::npos)
-               continue;
-            if (file.find("/.svn/") != std::string::npos)
-               continue;
-            if (file.find("/packrat/lib/") != std::string::npos)
-               continue;
-            if (file.find("/packrat/src/") != std::string::npos)
-               continue;
-            if (file.find("/.Rhistory") != std::string::npos)
-               continue;
-
-            if (!websiteOutputDir.empty() &&
-                file.find(websiteOutputDir) != std::string::npos)
+            if (isExcluded(file, outputDir))
                continue;
 
             int lineNum = safe_convert::stringTo<int>(std::string(match[2]), -1);
@@ -379,28 +515,7 @@ private:
          stdOutBuf_.erase(0, nextLineStart);
       }
 
-      if (files.size() > 0)
-      {
-         json::Object result;
-         result["handle"] = handle();
-         json::Object results;
-         results["file"] = files;
-         results["line"] = lineNums;
-         results["lineValue"] = contents;
-         results["matchOn"] = matchOns;
-         results["matchOff"] = matchOffs;
-         result["results"] = results;
-
-         findResults().addResult(handle(),
-                                 files,
-                                 lineNums,
-                                 contents,
-                                 matchOns,
-                                 matchOffs);
-
-         module_context::enqueClientEvent(
-                  ClientEvent(client_events::kFindResult, result));
-      }
+      notifyResults(files, lineNums, contents, matchOns, matchOffs);
 
       if (recordsToProcess <= 0)
          findResults().onFindEnd(handle());
@@ -413,39 +528,33 @@ private:
 
    void onExit(int exitCode)
    {
-      findResults().onFindEnd(handle());
-      module_context::enqueClientEvent(
-            ClientEvent(client_events::kFindOperationEnded, handle()));
+      notifyEnded();
       if (!tempFile_.empty())
          tempFile_.removeIfExists();
    }
 
-   bool firstDecodeError_;
-   std::string encoding_;
    FilePath tempFile_;
    std::string stdOutBuf_;
-   std::string handle_;
 };
 
-} // namespace
-
-core::Error beginFind(const json::JsonRpcRequest& request,
-                      json::JsonRpcResponse* pResponse)
+// parameters of a find (with the search string in the file encoding)
+struct FindParams
 {
-   std::string searchString;
-   bool asRegex, ignoreCase;
-   std::string directory;
+   std::string encodedString;
+   bool asRegex;
+   bool ignoreCase;
    json::Array filePatterns;
+   std::string encoding;
+};
 
-   Error error = json::readParams(request.params,
-                                  &searchString,
-                                  &asRegex,
-                                  &ignoreCase,
-                                  &directory,
-                                  &filePatterns);
-   if (error)
-      return error;
-
+// run grep over the paths (files, or directories which are searched
+// recursively). if a handle is passed the results are reported as part of
+// that find, otherwise the operation gets a handle of its own
+Error runGrep(const FindParams& params,
+              const std::vector<std::string>& paths,
+              const std::string& handle,
+              boost::shared_ptr<GrepOperation>* pOperation)
+{
    core::system::ProcessOptions options;
 
    core::system::Options childEnv;
@@ -463,29 +572,15 @@ core::Error beginFind(const json::JsonRpcRequest& request,
    // Put the grep pattern in a file
    FilePath tempFile = module_context::tempFile("rs_grep", "txt");
    boost::shared_ptr<std::ostream> pStream;
-   error = tempFile.open_w(&pStream);
+   Error error = tempFile.open_w(&pStream);
    if (error)
       return error;
-   std::string encoding = projects::projectContext().hasProject() ?
-                          projects::projectContext().defaultEncoding() :
-                          userSettings().defaultEncoding();
-   std::string encodedString;
-   error = r::util::iconvstr(searchString,
-                             "UTF-8",
-                             encoding,
-                             false,
-                             &encodedString);
-   if (error)
-   {
-      LOG_ERROR(error);
-      encodedString = searchString;
-   }
 
-   *pStream << encodedString << std::endl;
+   *pStream << params.encodedString << std::endl;
    pStream.reset(); // release file handle
 
-   boost::shared_ptr<GrepOperation> ptrGrepOp = GrepOperation::create(encoding,
-                                                                      tempFile);
+   boost::shared_ptr<GrepOperation> ptrGrepOp =
+               GrepOperation::create(params.encoding, tempFile, handle);
    core::system::ProcessCallbacks callbacks =
                                        ptrGrepOp->createProcessCallbacks();
 
@@ -499,30 +594,726 @@ core::Error beginFind(const json::JsonRpcRequest& request,
    cmd << "--devices=skip";
 #endif
 
-   if (ignoreCase)
+   if (params.ignoreCase)
       cmd << "-i";
 
    // Use -f to pass pattern via file, so we don't have to worry about
    // escaping double quotes, etc.
    cmd << "-f";
    cmd << tempFile;
-   if (!asRegex)
+   if (!params.asRegex)
       cmd << "-F";
 
-   BOOST_FOREACH(json::Value filePattern, filePatterns)
+   BOOST_FOREACH(json::Value filePattern, params.filePatterns)
    {
       cmd << "--include=" + filePattern.get_str();
    }
 
    cmd << shell_utils::EscapeFilesOnly << "--" << shell_utils::EscapeAll;
-   cmd << module_context::resolveAliasedPath(directory);
-
-   // Clear existing results
-   findResults().clear();
+   BOOST_FOREACH(const std::string& path, paths)
+   {
+      cmd << FilePath(path);
+   }
 
    error = module_context::processSupervisor().runCommand(cmd,
                                                           options,
                                                           callbacks);
+   if (error)
+   {
+      tempFile.removeIfExists();
+      return error;
+   }
+
+   *pOperation = ptrGrepOp;
+   return Success();
+}
+
+// Trigram index of the contents of the files in the current project,
+// maintained from file monitor events. Searches within the project are
+// answered by scanning only the files which the index says may match
+// rather than by running grep over the whole tree. note that the file
+// monitor doesn't report the files and directories which are hidden from
+// the files pane (e.g. .Rprofile, .github), so those are found by listing
+// the monitored directories at search time and are searched by grep.
+//
+// The index is built on the main thread, one file per chunk of incremental
+// work (files are read and their trigrams added, so a chunk is bounded by
+// kMaxIndexedFileSize; larger files aren't read at all and are always
+// searched by grep). Searches made before indexing has caught up with the
+// file monitor go to grep too. Trigrams fold ASCII case only, so case
+// insensitive searches for non-ASCII text are also left to grep.
+class ProjectContentIndex : boost::noncopyable
+{
+public:
+   ProjectContentIndex() : enabled_(false), indexing_(false)
+   {
+   }
+
+   void onMonitoringEnabled(const tree<core::FileInfo>& files)
+   {
+      clear();
+      enabled_ = true;
+
+      using namespace rstudio::core::system;
+      for (tree<core::FileInfo>::iterator it = files.begin();
+           it != files.end();
+           ++it)
+      {
+         indexingQueue_.push(FileChangeEvent(FileChangeEvent::FileAdded, *it));
+      }
+      scheduleIndexing();
+   }
+
+   void onFilesChanged(const std::vector<core::system::FileChangeEvent>& events)
+   {
+      if (!enabled_)
+         return;
+
+      BOOST_FOREACH(const core::system::FileChangeEvent& event, events)
+      {
+         indexingQueue_.push(event);
+      }
+      scheduleIndexing();
+   }
+
+   void onMonitoringDisabled()
+   {
+      // clear the index so we don't ever get stale results
+      clear();
+   }
+
+   // can searches within the directory be answered from the index? (not
+   // while there are changes waiting to be indexed, since the results
+   // wouldn't reflect them)
+   bool canSearch(const FilePath& directory)
+   {
+      if (!enabled_ || !projects::projectContext().isMonitoringDirectory(directory))
+         return false;
+
+      return indexingQueue_.empty();
+   }
+
+   // indexed files within the directory which may contain all of the
+   // literals, the files within it which are too large to index (and so are
+   // always candidates), and the monitored directories within it (including
+   // itself)
+   void candidates(const FilePath& directory,
+                   const std::vector<std::string>& literals,
+                   std::vector<std::string>* pPaths,
+                   std::vector<std::string>* pOversized,
+                   std::vector<std::string>* pDirectories) const
+   {
+      std::vector<std::string> paths;
+      index_.candidates(literals, &paths);
+
+      std::string dir = directory.absolutePath();
+      std::string prefix = dir + "/";
+      pPaths->clear();
+      BOOST_FOREACH(const std::string& path, paths)
+      {
+         if (path == dir || boost::algorithm::starts_with(path, prefix))
+            pPaths->push_back(path);
+      }
+
+      pOversized->clear();
+      BOOST_FOREACH(const std::string& path, oversized_)
+      {
+         if (path == dir || boost::algorithm::starts_with(path, prefix))
+            pOversized->push_back(path);
+      }
+
+      pDirectories->clear();
+      pDirectories->push_back(dir);
+      std::set<std::string>::const_iterator it = directories_.lower_bound(prefix);
+      while (it != directories_.end() && boost::algorithm::starts_with(*it, prefix))
+         pDirectories->push_back(*it++);
+   }
+
+private:
+   void clear()
+   {
+      enabled_ = false;
+      index_.clear();
+      oversized_.clear();
+      directories_.clear();
+      indexingQueue_ = std::queue<core::system::FileChangeEvent>();
+   }
+
+   void scheduleIndexing()
+   {
+      // index during idle time in 20ms chunks (as with the source index
+      // this defends against large numbers of files tying up the main thread)
+      if (!indexingQueue_.empty() && !indexing_)
+      {
+         indexing_ = true;
+         module_context::scheduleIncrementalWork(
+                           boost::posix_time::milliseconds(20),
+                           boost::bind(&ProjectContentIndex::dequeAndIndex, this),
+                           false /* allow indexing even when non-idle */);
+      }
+   }
+
+   bool dequeAndIndex()
+   {
+      if (indexingQueue_.empty())
+      {
+         indexing_ = false;
+         return false;
+      }
+
+      core::system::FileChangeEvent event = indexingQueue_.front();
+      indexingQueue_.pop();
+      processEvent(event);
+
+      if (indexingQueue_.empty())
+      {
+         indexing_ = false;
+         return false;
+      }
+      return true;
+   }
+
+   void processEvent(const core::system::FileChangeEvent& event)
+   {
+      using namespace rstudio::core::system;
+      const core::FileInfo& fileInfo = event.fileInfo();
+      const std::string& path = fileInfo.absolutePath();
+
+      if (event.type() == FileChangeEvent::FileRemoved)
+      {
+         if (fileInfo.isDirectory())
+         {
+            index_.removeDirectory(path);
+            removeDirectory(path, &oversized_);
+            removeDirectory(path, &directories_);
+            directories_.erase(path);
+         }
+         else
+         {
+            index_.remove(path);
+            oversized_.erase(path);
+         }
+         return;
+      }
+
+      if (fileInfo.isDirectory())
+      {
+         directories_.insert(path);
+         return;
+      }
+
+      index_.remove(path);
+      oversized_.erase(path);
+
+      if (fileInfo.size() > kMaxIndexedFileSize)
+      {
+         oversized_.insert(path);
+         return;
+      }
+
+      std::string contents;
+      Error error = core::readStringFromFile(FilePath(path), &contents);
+      if (error)
+         return;
+
+      // binary files are never matched (as with --binary-files=without-match)
+      if (contents.find('\0') != std::string::npos)
+         return;
+
+      index_.add(path, contents);
+   }
+
+   // remove the paths within the directory from the set
+   static void removeDirectory(const std::string& path,
+                               std::set<std::string>* pPaths)
+   {
+      std::string prefix = path + "/";
+      std::set<std::string>::iterator it = pPaths->lower_bound(prefix);
+      while (it != pPaths->end() && boost::algorithm::starts_with(*it, prefix))
+         pPaths->erase(it++);
+   }
+
+private:
+   static const uintmax_t kMaxIndexedFileSize = 4 * 1024 * 1024;
+
+   bool enabled_;
+   bool indexing_;
+   std::queue<core::system::FileChangeEvent> indexingQueue_;
+   text::TrigramIndex index_;
+   std::set<std::string> oversized_;
+   std::set<std::string> directories_;
+};
+
+ProjectContentIndex s_projectContentIndex;
+
+// find operation which searches candidate files from the project index
+// in-process (one file per chunk of work so the session stays responsive).
+// the rest of the search is handed to grep (as part of the same find): files
+// too large to index, and the files and directories which the file monitor
+// doesn't report (found by listing the monitored directories)
+class IndexedFindOperation
+   : public FindOperation,
+     public boost::enable_shared_from_this<IndexedFindOperation>
+{
+public:
+   static boost::shared_ptr<IndexedFindOperation> create(
+                              const FindParams& params,
+                              const boost::regex& regex,
+                              const std::vector<boost::regex>& includes,
+                              const std::vector<std::string>& files,
+                              const std::vector<std::string>& oversized,
+                              const std::vector<std::string>& directories)
+   {
+      return boost::shared_ptr<IndexedFindOperation>(
+                     new IndexedFindOperation(params,
+                                              regex,
+                                              includes,
+                                              files,
+                                              oversized,
+                                              directories));
+   }
+
+private:
+   IndexedFindOperation(const FindParams& params,
+                        const boost::regex& regex,
+                        const std::vector<boost::regex>& includes,
+                        const std::vector<std::string>& files,
+                        const std::vector<std::string>& oversized,
+                        const std::vector<std::string>& directories)
+      : FindOperation(params.encoding),
+        params_(params),
+        regex_(regex),
+        includes_(includes),
+        files_(files),
+        nextFile_(0),
+        directories_(directories),
+        nextDirectory_(0),
+        recordsToProcess_(MAX_COUNT + 1),
+        outputDir_(websiteOutputDir())
+   {
+      BOOST_FOREACH(const std::string& file, oversized)
+      {
+         if (matchesIncludes(FilePath(file).filename()))
+            grepPaths_.push_back(file);
+      }
+   }
+
+public:
+   void start()
+   {
+      lastNotify_ = boost::posix_time::microsec_clock::universal_time();
+      module_context::scheduleIncrementalWork(
+                     boost::posix_time::milliseconds(20),
+                     boost::bind(&IndexedFindOperation::execute,
+                                 shared_from_this()),
+                     false /* search even when non-idle */);
+   }
+
+private:
+   bool execute()
+   {
+      // stopped by the user or superseded by another find
+      if (!isActive())
+      {
+         notifyEnded();
+         return false;
+      }
+
+      if (nextFile_ < files_.size())
+      {
+         const std::string& file = files_[nextFile_++];
+         if (matchesIncludes(FilePath(file).filename()))
+            searchFile(file);
+      }
+      else if (nextDirectory_ < directories_.size())
+      {
+         listUnmonitored(FilePath(directories_[nextDirectory_++]));
+      }
+
+      // deliver results in batches (but promptly for slow searches)
+      using namespace boost::posix_time;
+      if (pendingFiles_.size() >= kNotifyBatchSize ||
+          microsec_clock::universal_time() - lastNotify_ > milliseconds(250))
+      {
+         notifyPending();
+      }
+
+      bool done = nextFile_ >= files_.size() &&
+                  nextDirectory_ >= directories_.size();
+      if (done || recordsToProcess_ <= 0)
+      {
+         notifyPending();
+         if (done && recordsToProcess_ > 0 && !grepPaths_.empty())
+            runGrepOnRemaining();
+         else
+            notifyEnded();
+         return false;
+      }
+
+      return true;
+   }
+
+   void runGrepOnRemaining()
+   {
+      // grep reports its results (and the end of the find) under our handle
+      boost::shared_ptr<GrepOperation> ptrGrepOp;
+      Error error = runGrep(params_, grepPaths_, handle(), &ptrGrepOp);
+      if (error)
+      {
+         LOG_ERROR(error);
+         notifyEnded();
+      }
+   }
+
+   bool matchesIncludes(const std::string& filename) const
+   {
+      if (includes_.empty())
+         return true;
+
+      BOOST_FOREACH(const boost::regex& include, includes_)
+      {
+         if (regex_utils::match(filename, include))
+            return true;
+      }
+      return false;
+   }
+
+   // queue the children of the monitored directory which the file monitor
+   // doesn't report to be searched by grep
+   void listUnmonitored(const FilePath& directory)
+   {
+      std::vector<FilePath> children;
+      Error error = directory.children(&children);
+      if (error)
+         return;
+
+      BOOST_FOREACH(const FilePath& child, children)
+      {
+         if (module_context::fileListingFilter(core::FileInfo(child)))
+            continue;
+
+         // as for grep -r, symlinks within the tree aren't followed (grep
+         // would follow them if we passed them to it)
+         if (child.isSymlink())
+            continue;
+
+         if (child.isDirectory())
+         {
+            // skip directories whose results would all be excluded
+            std::string dir = module_context::createAliasedPath(child) + "/";
+            if (!isExcluded(dir, outputDir_))
+               grepPaths_.push_back(child.absolutePath());
+         }
+         else if (matchesIncludes(child.filename()))
+         {
+            grepPaths_.push_back(child.absolutePath());
+         }
+      }
+   }
+
+   void searchFile(const std::string& path)
+   {
+      std::string file = module_context::createAliasedPath(FilePath(path));
+      if (isExcluded(file, outputDir_))
+         return;
+
+      std::string contents;
+      Error error = core::readStringFromFile(FilePath(path), &contents);
+      if (error)
+         return;
+      if (contents.find('\0') != std::string::npos)
+         return;
+
+      std::string::const_iterator lineBegin = contents.begin();
+      std::string::const_iterator end = contents.end();
+      int lineNum = 1;
+      while (lineBegin != end && recordsToProcess_ > 0)
+      {
+         std::string::const_iterator lineEnd = std::find(lineBegin, end, '\n');
+
+         searchLine(file, lineNum, std::string(lineBegin, lineEnd));
+
+         if (lineEnd == end)
+            break;
+         lineBegin = lineEnd + 1;
+         lineNum++;
+      }
+   }
+
+   void searchLine(const std::string& file, int lineNum, const std::string& line)
+   {
+      // collect the byte ranges of (non-empty) matches
+      std::vector<std::pair<std::size_t, std::size_t> > matches;
+      bool matched = false;
+      boost::sregex_iterator end;
+      for (boost::sregex_iterator it(line.begin(), line.end(), regex_);
+           it != end;
+           ++it)
+      {
+         matched = true;
+         const boost::smatch& match = *it;
+         if (match.length() > 0)
+         {
+            std::size_t position = match.position();
+            matches.push_back(std::make_pair(position, position + match.length()));
+         }
+      }
+      if (!matched)
+         return;
+
+      // trim the line (as for grep output), clipping matches to the result
+      std::size_t first = line.find_first_not_of(" \t\r\f\v");
+      if (first == std::string::npos)
+         first = line.size();
+      std::size_t last = line.find_last_not_of(" \t\r\f\v");
+      last = (last == std::string::npos) ? first : last + 1;
+
+      std::string decodedLine;
+      std::size_t characters = 0;
+      std::size_t pos = first;
+      json::Array matchOn, matchOff;
+      for (std::size_t i = 0; i < matches.size(); i++)
+      {
+         std::size_t matchBegin = std::max(matches[i].first, first);
+         std::size_t matchEnd = std::min(matches[i].second, last);
+         if (matchBegin >= matchEnd)
+            continue;
+
+         appendDecoded(line.substr(pos, matchBegin - pos), &decodedLine, &characters);
+         matchOn.push_back(static_cast<int>(characters));
+         appendDecoded(line.substr(matchBegin, matchEnd - matchBegin),
+                       &decodedLine,
+                       &characters);
+         matchOff.push_back(static_cast<int>(characters));
+         pos = matchEnd;
+      }
+      if (pos < last)
+         decodedLine.append(decode(line.substr(pos, last - pos)));
+
+      truncateLine(&decodedLine);
+
+      pendingFiles_.push_back(file);
+      pendingLineNums_.push_back(lineNum);
+      pendingContents_.push_back(decodedLine);
+      pendingMatchOns_.push_back(matchOn);
+      pendingMatchOffs_.push_back(matchOff);
+
+      recordsToProcess_--;
+   }
+
+   void notifyPending()
+   {
+      notifyResults(pendingFiles_,
+                    pendingLineNums_,
+                    pendingContents_,
+                    pendingMatchOns_,
+                    pendingMatchOffs_);
+
+      pendingFiles_.clear();
+      pendingLineNums_.clear();
+      pendingContents_.clear();
+      pendingMatchOns_.clear();
+      pendingMatchOffs_.clear();
+      lastNotify_ = boost::posix_time::microsec_clock::universal_time();
+   }
+
+private:
+   static const std::size_t kNotifyBatchSize = 100;
+
+   FindParams params_;
+   boost::regex regex_;
+   std::vector<boost::regex> includes_;
+   std::vector<std::string> files_;
+   std::size_t nextFile_;
+   std::vector<std::string> directories_;
+   std::size_t nextDirectory_;
+   std::vector<std::string> grepPaths_;
+   int recordsToProcess_;
+   std::string outputDir_;
+
+   json::Array pendingFiles_;
+   json::Array pendingLineNums_;
+   json::Array pendingContents_;
+   json::Array pendingMatchOns_;
+   json::Array pendingMatchOffs_;
+   boost::posix_time::ptime lastNotify_;
+};
+
+bool isAscii(const std::string& str)
+{
+   for (std::size_t i = 0; i < str.size(); i++)
+   {
+      if (static_cast<unsigned char>(str[i]) >= 0x80)
+         return false;
+   }
+   return true;
+}
+
+bool hasGnuEscape(const std::string& pattern)
+{
+   for (std::size_t i = 0; i + 1 < pattern.size(); i++)
+   {
+      if (pattern[i] != '\\')
+         continue;
+
+      if (std::strchr("wWsSbB<>`'", pattern[i + 1]) != NULL)
+         return true;
+      i++;
+   }
+   return false;
+}
+
+// attempt to run the find from the project index. returns false if the
+// search can't be answered by the index (in which case grep is used)
+bool beginIndexedFind(const FindParams& params,
+                      const FilePath& directory,
+                      boost::shared_ptr<IndexedFindOperation>* pOperation)
+{
+   if (!s_projectContentIndex.canSearch(directory))
+      return false;
+
+   const std::string& encodedString = params.encodedString;
+   bool asRegex = params.asRegex;
+   bool ignoreCase = params.ignoreCase;
+
+   // we only fold the case of ASCII characters (grep folds them all in
+   // multibyte locales), so leave case insensitive searches for anything
+   // else to grep
+   if (ignoreCase && !isAscii(encodedString))
+      return false;
+
+   // --include patterns (we only support the '*' wildcard)
+   std::vector<boost::regex> includes;
+   BOOST_FOREACH(const json::Value& filePattern, params.filePatterns)
+   {
+      if (filePattern.type() != json::StringType)
+         return false;
+      const std::string& pattern = filePattern.get_str();
+      if (pattern.find_first_of("?[\\") != std::string::npos)
+         return false;
+      includes.push_back(regex_utils::wildcardPatternToRegex(pattern));
+   }
+
+   // compile the pattern with the same syntax as grep (basic regular
+   // expressions with the GNU \+, \? and \| extensions). the GNU word
+   // and space escapes (e.g. \w, \<) aren't supported so leave those to grep
+   if (asRegex && hasGnuEscape(encodedString))
+      return false;
+
+   boost::regex regex;
+   try
+   {
+      boost::regex::flag_type flags = asRegex ?
+            boost::regex::basic | boost::regex::bk_plus_qm | boost::regex::bk_vbar :
+            boost::regex::literal;
+      if (ignoreCase)
+         flags |= boost::regex::icase;
+      regex = boost::regex(encodedString, flags);
+   }
+   catch(const std::exception&)
+   {
+      // let grep report the error
+      return false;
+   }
+
+   std::vector<std::string> literals;
+   text::requiredLiterals(encodedString, asRegex, ignoreCase, &literals);
+
+   std::vector<std::string> files, oversized, directories;
+   s_projectContentIndex.candidates(directory,
+                                    literals,
+                                    &files,
+                                    &oversized,
+                                    &directories);
+
+   *pOperation = IndexedFindOperation::create(params,
+                                              regex,
+                                              includes,
+                                              files,
+                                              oversized,
+                                              directories);
+   return true;
+}
+
+void onFileMonitorEnabled(const tree<core::FileInfo>& files)
+{
+   s_projectContentIndex.onMonitoringEnabled(files);
+}
+
+void onFilesChanged(const std::vector<core::system::FileChangeEvent>& events)
+{
+   s_projectContentIndex.onFilesChanged(events);
+}
+
+void onFileMonitorDisabled()
+{
+   s_projectContentIndex.onMonitoringDisabled();
+}
+
+} // namespace
+
+core::Error beginFind(const json::JsonRpcRequest& request,
+                      json::JsonRpcResponse* pResponse)
+{
+   std::string searchString;
+   bool asRegex, ignoreCase;
+   std::string directory;
+   json::Array filePatterns;
+
+   Error error = json::readParams(request.params,
+                                  &searchString,
+                                  &asRegex,
+                                  &ignoreCase,
+                                  &directory,
+                                  &filePatterns);
+   if (error)
+      return error;
+
+   std::string encoding = projects::projectContext().hasProject() ?
+                          projects::projectContext().defaultEncoding() :
+                          userSettings().defaultEncoding();
+   std::string encodedString;
+   error = r::util::iconvstr(searchString,
+                             "UTF-8",
+                             encoding,
+                             false,
+                             &encodedString);
+   if (error)
+   {
+      LOG_ERROR(error);
+      encodedString = searchString;
+   }
+
+   FindParams params;
+   params.encodedString = encodedString;
+   params.asRegex = asRegex;
+   params.ignoreCase = ignoreCase;
+   params.filePatterns = filePatterns;
+   params.encoding = encoding;
+
+   // searches within the project are answered from the project index
+   boost::shared_ptr<IndexedFindOperation> ptrIndexedOp;
+   if (beginIndexedFind(params,
+                        module_context::resolveAliasedPath(directory),
+                        &ptrIndexedOp))
+   {
+      findResults().clear();
+      findResults().onFindBegin(ptrIndexedOp->handle(),
+                                searchString,
+                                directory,
+                                asRegex);
+      ptrIndexedOp->start();
+      pResponse->setResult(ptrIndexedOp->handle());
+      return Success();
+   }
+
+   // Clear existing results
+   findResults().clear();
+
+   std::vector<std::string> paths;
+   paths.push_back(module_context::resolveAliasedPath(directory).absolutePath());
+   boost::shared_ptr<GrepOperation> ptrGrepOp;
+   error = runGrep(params, paths, std::string(), &ptrGrepOp);
    if (error)
       return error;
 
@@ -593,6 +1384,15 @@ core::Error initialize()
    // register suspend handler
    addSuspendHandler(SuspendHandler(bind(onSuspend, _2), onResume));
 
+   // maintain the project content index from the file monitor
+   // (note that if there is no project this will no-op)
+   session::projects::FileMonitorCallbacks cb;
+   cb.onMonitoringEnabled = onFileMonitorEnabled;
+   cb.onFilesChanged = onFilesChanged;
+   cb.onMonitoringDisabled = onFileMonitorDisabled;
+   projects::projectContext().subscribeToFileMonitor("Find in files indexing",
+                                                     cb);
+
    // install handlers
    ExecBlock initBlock ;
    initBlock.addFunctions()
@@ -1439,6 +1439,353 @@ ParseResults parse(const FilePath &filePath, const ParseOptions &parseOptions)
             string_utils::utf8ToWide(contents),
             parseOptions);
 }
+
+namespace {
+
+// Index of the first token at or after 'position'.
+std::size_t tokenIndexAtPosition(const RTokens& rTokens,
+                                 const Position& position)
+{
+   std::size_t begin = 0;
+   std::size_t end = rTokens.size();
+   while (begin < end)
+   {
+      std::size_t middle = begin + (end - begin) / 2;
+      const RToken& token = rTokens.atUnsafe(middle);
+      if (Position(token.row(), token.column()) < position)
+         begin = middle + 1;
+      else
+         end = middle;
+   }
+   return begin;
+}
+
+// The text read when a call is resolved to a function in the parse tree
+// (see 'extractInfoFromFunctionDefinition'): from the function's position
+// up to the end of its formals.
+std::string functionSignature(const RTokens& rTokens, const ParseNode& node)
+{
+   std::size_t offset = tokenIndexAtPosition(rTokens, node.position());
+   if (offset >= rTokens.size())
+      return node.name();
+   
+   RTokenCursor cursor(rTokens, offset);
+   if (!cursor.isType(RToken::LPAREN) ||
+       !cursor.previousSignificantToken().contentEquals(L"function"))
+   {
+      while (!cursor.contentEquals(L"function"))
+         if (!cursor.moveToNextSignificantToken())
+            return node.name();
+      
+      if (!cursor.moveToNextSignificantToken())
+         return node.name();
+   }
+   
+   if (cursor.isType(RToken::LPAREN) && !cursor.fwdToMatchingToken())
+      cursor.setOffset(rTokens.size() - 1);
+   
+   return node.name() + " " + string_utils::wideToUtf8(
+            std::wstring(rTokens.atUnsafe(offset).begin(),
+                         cursor.currentToken().end()));
+}
+
+} // anonymous namespace
+
+ParseResults IncrementalParser::parse(const FilePath& filePath,
+                                      const std::wstring& rCode,
+                                      const ParseOptions& parseOptions)
+{
+   bool canReuse = pTokens_ &&
+                   filePath == filePath_ &&
+                   parseOptions == parseOptions_;
+   
+   if (canReuse && rCode == code_)
+      return results_;
+   
+   if (rCode.empty() || rCode.find_first_not_of(L" \r\n\t\v") == std::string::npos)
+   {
+      pTokens_.reset();
+      chunks_.clear();
+      return ParseResults();
+   }
+   
+   restartChunk_ = 0;
+   canResync_ = false;
+   if (canReuse)
+   {
+      // the edit is what lies between the common prefix and suffix
+      std::size_t n = std::min(code_.size(), rCode.size());
+      std::size_t prefix =
+            std::mismatch(code_.begin(), code_.begin() + n, rCode.begin()).first -
+            code_.begin();
+      
+      std::size_t suffix = 0;
+      while (suffix < n - prefix &&
+             code_[code_.size() - suffix - 1] == rCode[rCode.size() - suffix - 1])
+      {
+         ++suffix;
+      }
+      
+      pNewTokens_.reset(new RTokens(rCode,
+                                    *pTokens_,
+                                    prefix,
+                                    code_.size() - prefix - suffix,
+                                    rCode.size() - prefix - suffix));
+      
+      // restart from the statement before the one containing the first
+      // re-scanned token, as the parser looks ahead into the next statement
+      // in places
+      std::size_t reusedPrefixEnd = pNewTokens_->reusedPrefixEnd();
+      std::size_t begin = 0;
+      std::size_t end = chunks_.size();
+      while (begin < end)
+      {
+         std::size_t middle = begin + (end - begin) / 2;
+         if (chunks_[middle]->token <= reusedPrefixEnd)
+            begin = middle + 1;
+         else
+            end = middle;
+      }
+      restartChunk_ = begin > 1 ? begin - 2 : 0;
+      
+      // (but not from the last token, which 'doParse' would skip)
+      while (restartChunk_ > 0 &&
+             chunks_[restartChunk_]->token + 1 >= pNewTokens_->size())
+      {
+         --restartChunk_;
+      }
+      
+      canResync_ = true;
+   }
+   else
+   {
+      chunks_.clear();
+      pNewTokens_.reset(new RTokens(rCode, RTokens::StripComments));
+   }
+   
+   const RTokens& rTokens = *pNewTokens_;
+   if (rTokens.empty())
+   {
+      pTokens_.reset();
+      pNewTokens_.reset();
+      chunks_.clear();
+      return ParseResults();
+   }
+   
+   // parse from the restart statement, with the statements before it
+   // (but not the ones after it) already in the tree
+   boost::shared_ptr<ParseNode> pRoot = ParseNode::createRootNode();
+   for (std::size_t i = 0; i < restartChunk_; ++i)
+      pRoot->appendFragment(*chunks_[i]->pNode);
+   prefixChildren_ = pRoot->getChildren().size();
+   
+   std::size_t restartToken = chunks_.empty() ? 0 : chunks_[restartChunk_]->token;
+   RTokenCursor cursor(rTokens, restartToken);
+   checkpoints_.clear();
+   checkpoints_.push_back(Checkpoint(restartToken, cursor.row(), 0));
+   resyncChunk_ = chunks_.size();
+   
+   ParseStatus status(filePath, parseOptions, pRoot);
+   status.setCheckpointHandler(
+            boost::bind(&IncrementalParser::onCheckpoint, this, _1, &status));
+   
+   doParse(cursor, status);
+   
+   bool resynced = resyncChunk_ < chunks_.size();
+   Checkpoint resync = checkpoints_.back();
+   if (resynced)
+      checkpoints_.pop_back();
+   
+   std::size_t lintEnd = status.lint().size();
+   std::vector<LintItem> endLint;
+   if (!resynced)
+   {
+      if (status.node()->getParent() != NULL)
+         status.lint().unexpectedEndOfDocument(cursor.currentToken());
+      
+      status.addLintIfBracketStackNotEmpty();
+      endLint.assign(status.lint().begin() + lintEnd, status.lint().end());
+   }
+   
+   // keep the results for the statements parsed, split at the checkpoints
+   Chunks chunks(chunks_.begin(), chunks_.begin() + restartChunk_);
+   
+   std::vector<std::size_t> rows;
+   std::vector< boost::shared_ptr<ParseNode> > fragments;
+   BOOST_FOREACH(const Checkpoint& checkpoint, checkpoints_)
+   {
+      rows.push_back(checkpoint.row);
+      fragments.push_back(ParseNode::createRootNode());
+   }
+   pRoot->splitRows(rows, prefixChildren_, fragments);
+   
+   const std::vector<LintItem>& lint = status.lint().get();
+   for (std::size_t i = 0, n = checkpoints_.size(); i < n; ++i)
+   {
+      boost::shared_ptr<Chunk> pChunk(new Chunk());
+      pChunk->token = checkpoints_[i].token;
+      pChunk->row = checkpoints_[i].row;
+      pChunk->lint.assign(
+               lint.begin() + checkpoints_[i].lintIndex,
+               lint.begin() + (i + 1 < n ? checkpoints_[i + 1].lintIndex : lintEnd));
+      pChunk->pNode = fragments[i];
+      BOOST_FOREACH(const boost::shared_ptr<ParseNode>& pChild,
+                    fragments[i]->getChildren())
+      {
+         pChunk->signatures.push_back(functionSignature(rTokens, *pChild));
+      }
+      chunks.push_back(pChunk);
+   }
+   
+   // and move the results for the statements after the resync point
+   if (resynced)
+   {
+      std::size_t oldToken = chunks_[resyncChunk_]->token;
+      std::size_t oldRow = chunks_[resyncChunk_]->row;
+      int delta = static_cast<int>(resync.row) - static_cast<int>(oldRow);
+      for (std::size_t i = resyncChunk_; i < chunks_.size(); ++i)
+      {
+         Chunk& chunk = *chunks_[i];
+         chunk.token = chunk.token - oldToken + resync.token;
+         chunk.row = chunk.row - oldRow + resync.row;
+         if (delta != 0)
+         {
+            BOOST_FOREACH(LintItem& item, chunk.lint)
+            {
+               item.startRow += delta;
+               item.endRow += delta;
+            }
+            chunk.pNode->shiftRows(delta);
+         }
+         
+         pRoot->appendFragment(*chunk.pNode);
+         chunks.push_back(chunks_[i]);
+      }
+      
+      endLint.swap(endLint_);
+      BOOST_FOREACH(LintItem& item, endLint)
+      {
+         item.startRow += delta;
+         item.endRow += delta;
+      }
+   }
+   
+   LintItems lintItems(parseOptions);
+   BOOST_FOREACH(const boost::shared_ptr<Chunk>& pChunk, chunks)
+   {
+      BOOST_FOREACH(const LintItem& item, pChunk->lint)
+      {
+         lintItems.push_back(item);
+      }
+   }
+   
+   BOOST_FOREACH(const LintItem& item, endLint)
+   {
+      lintItems.push_back(item);
+   }
+   
+   filePath_ = filePath;
+   parseOptions_ = parseOptions;
+   code_ = rCode;
+   pTokens_ = pNewTokens_;
+   pNewTokens_.reset();
+   chunks_.swap(chunks);
+   endLint_.swap(endLint);
+   results_ = ParseResults(pRoot, lintItems, parseOptions.globals());
+   return results_;
+}
+
+bool IncrementalParser::onCheckpoint(const RTokenCursor& cursor,
+                                     ParseStatus* pStatus)
+{
+   std::size_t token = cursor.offset();
+   if (token == checkpoints_.back().token)
+      return false;
+   
+   std::size_t reusedSuffixBegin = pNewTokens_->reusedSuffixBegin();
+   bool afterEdit = checkpoints_.back().token >= reusedSuffixBegin;
+   checkpoints_.push_back(
+            Checkpoint(token, cursor.row(), pStatus->lint().size()));
+   
+   // Past the edit (with a statement's worth of tokens to spare for the
+   // parser's look behind), the previous parse can be picked up again at a
+   // statement it had a checkpoint at too, provided the statements parsed
+   // since the restart define the same things.
+   if (!canResync_ || !afterEdit)
+      return false;
+   
+   std::size_t oldToken = token - pNewTokens_->size() + pTokens_->size();
+   std::size_t begin = restartChunk_ + 1;
+   std::size_t end = chunks_.size();
+   while (begin < end)
+   {
+      std::size_t middle = begin + (end - begin) / 2;
+      if (chunks_[middle]->token < oldToken)
+         begin = middle + 1;
+      else
+         end = middle;
+   }
+   
+   if (begin == chunks_.size() || chunks_[begin]->token != oldToken)
+      return false;
+   
+   canResync_ = false;
+   if (!hasSameDefinitions(*pStatus->root(), begin))
+      return false;
+   
+   resyncChunk_ = begin;
+   return true;
+}
+
+// The statements before a checkpoint only affect the parse after it through
+// the symbols and functions they define at the top level.
+bool IncrementalParser::hasSameDefinitions(const ParseNode& root,
+                                           std::size_t endChunk) const
+{
+   std::size_t restartRow = checkpoints_.front().row;
+   
+   std::set<std::string> symbols;
+   const ParseNode::SymbolPositions& definedSymbols = root.getDefinedSymbols();
+   for (ParseNode::SymbolPositions::const_iterator it = definedSymbols.begin();
+        it != definedSymbols.end();
+        ++it)
+   {
+      if (!it->second.empty() && it->second.back().row >= restartRow)
+         symbols.insert(it->first);
+   }
+   
+   std::set<std::string> oldSymbols;
+   for (std::size_t i = restartChunk_; i < endChunk; ++i)
+   {
+      const ParseNode::SymbolPositions& oldDefinedSymbols =
+            chunks_[i]->pNode->getDefinedSymbols();
+      
+      for (ParseNode::SymbolPositions::const_iterator it = oldDefinedSymbols.begin();
+           it != oldDefinedSymbols.end();
+           ++it)
+      {
+         oldSymbols.insert(it->first);
+      }
+   }
+   
+   if (symbols != oldSymbols)
+      return false;
+   
+   std::vector<std::string> signatures;
+   const ParseNode::Children& children = root.getChildren();
+   for (std::size_t i = prefixChildren_; i < children.size(); ++i)
+      signatures.push_back(functionSignature(*pNewTokens_, *children[i]));
+   
+   std::vector<std::string> oldSignatures;
+   for (std::size_t i = restartChunk_; i < endChunk; ++i)
+   {
+      oldSignatures.insert(oldSignatures.end(),
+                           chunks_[i]->signatures.begin(),
+                           chunks_[i]->signatures.end());
+   }
+   
+   return signatures == oldSignatures;
+}
 namespace {
 
 bool closesArgumentList(const RTokenCursor& cursor,
@@ -2003,6 +2350,9 @@ void doParse(RTokenCursor& cursor, ParseStatus& status)
       
 START:
       
+      if (status.isAtCheckpoint(cursor) && status.onCheckpoint(cursor))
+         return;
+      
       DEBUG("== Current state: " << status.currentStateAsString());
       
       checkIncorrectComparison(cursor, status);
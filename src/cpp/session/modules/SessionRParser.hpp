@@ -41,6 +41,7 @@
 
 #include <boost/bind.hpp>
 #include <boost/container/flat_set.hpp>
+#include <boost/function.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/foreach.hpp>
 #include <boost/algorithm/string.hpp>
@@ -146,6 +147,16 @@ public:
    
    std::set<std::string>& globals() { return globals_; }
    const std::set<std::string>& globals() const { return globals_; }
+   
+   bool operator ==(const ParseOptions& other) const
+   {
+      return lintRFunctions_ == other.lintRFunctions_ &&
+             checkArgumentsToRFunctionCalls_ == other.checkArgumentsToRFunctionCalls_ &&
+             warnIfNoSuchVariableInScope_ == other.warnIfNoSuchVariableInScope_ &&
+             warnIfVariableIsDefinedButNotUsed_ == other.warnIfVariableIsDefinedButNotUsed_ &&
+             recordStyleLint_ == other.recordStyleLint_ &&
+             globals_ == other.globals_;
+   }
 
 private:
    bool lintRFunctions_;
@@ -459,12 +470,13 @@ public:
    void push_back(const LintItem& item)
    {
       lintItems_.push_back(item);
+      errorCount_ += item.type == LintTypeError;
    }
    
    void push_back(const LintItems& items)
    {
       for (std::size_t i = 0, n = items.size(); i < n; ++i)
-         lintItems_.push_back(items.get()[i]);
+         push_back(items.get()[i]);
    }
    
    typedef std::vector<LintItem>::iterator iterator;
@@ -818,8 +830,8 @@ public:
    bool symbolHasDefinitionInRange(const std::string& symbol,
                                    const Position& position) const
    {
-      for (SymbolRanges::const_iterator it = symbolRanges().begin();
-           it != symbolRanges().end();
+      for (SymbolRanges::const_iterator it = symbolRanges_.begin();
+           it != symbolRanges_.end();
            ++it)
       {
          if (it->first.contains(position) &&
@@ -828,6 +840,10 @@ public:
             return true;
          }
       }
+      
+      if (pParent_)
+         return pParent_->symbolHasDefinitionInRange(symbol, position);
+      
       return false;
    }
    
@@ -946,11 +962,158 @@ public:
          const Position& end)
    {
       core::algorithm::insert(
-            symbolRanges()[Range(begin, end)],
+            symbolRanges_[Range(begin, end)],
             symbols.begin(),
             symbols.end());
    }
    
+   // Incremental parsing ----
+   //
+   // The content of a root node can be split by rows into 'fragments'
+   // (themselves root nodes), so that the parse results for top-level
+   // statements can be kept, moved, and put back together again without
+   // re-parsing them.
+   
+   // Copy the content of this node from rows[0] onwards into 'fragments',
+   // with fragments[i] receiving the rows [rows[i], rows[i + 1]). Only the
+   // children from 'childIndex' onwards are copied (the children are shared,
+   // and keep this node as their parent).
+   void splitRows(const std::vector<std::size_t>& rows,
+                  std::size_t childIndex,
+                  const std::vector< boost::shared_ptr<ParseNode> >& fragments) const
+   {
+      splitPositions(definedSymbols_, rows, fragments, &ParseNode::definedSymbols_);
+      splitPositions(referencedSymbols_, rows, fragments, &ParseNode::referencedSymbols_);
+      splitPositions(nseReferencedSymbols_, rows, fragments, &ParseNode::nseReferencedSymbols_);
+      
+      for (SymbolRanges::const_iterator it = symbolRanges_.begin();
+           it != symbolRanges_.end();
+           ++it)
+      {
+         std::size_t index;
+         if (findRow(rows, it->first.begin().row, &index))
+            fragments[index]->symbolRanges_.insert(*it);
+      }
+      
+      for (std::size_t i = childIndex, n = children_.size(); i < n; ++i)
+      {
+         std::size_t index;
+         if (findRow(rows, children_[i]->position_.row, &index))
+            fragments[index]->children_.push_back(children_[i]);
+      }
+   }
+   
+   // Add the content of 'fragment' to this node, adopting its children.
+   void appendFragment(const ParseNode& fragment)
+   {
+      appendPositions(fragment.definedSymbols_, &definedSymbols_);
+      appendPositions(fragment.referencedSymbols_, &referencedSymbols_);
+      appendPositions(fragment.nseReferencedSymbols_, &nseReferencedSymbols_);
+      
+      for (SymbolRanges::const_iterator it = fragment.symbolRanges_.begin();
+           it != fragment.symbolRanges_.end();
+           ++it)
+      {
+         core::algorithm::insert(
+                  symbolRanges_[it->first],
+                  it->second.begin(),
+                  it->second.end());
+      }
+      
+      BOOST_FOREACH(const boost::shared_ptr<ParseNode>& pChild, fragment.children_)
+      {
+         pChild->pParent_ = this;
+         children_.push_back(pChild);
+      }
+   }
+   
+   // Move the content of this node (and of its children) down by 'delta' rows.
+   void shiftRows(int delta)
+   {
+      shiftPositions(&definedSymbols_, delta);
+      shiftPositions(&referencedSymbols_, delta);
+      shiftPositions(&nseReferencedSymbols_, delta);
+      
+      SymbolRanges symbolRanges;
+      for (SymbolRanges::const_iterator it = symbolRanges_.begin();
+           it != symbolRanges_.end();
+           ++it)
+      {
+         Position begin = it->first.begin();
+         Position end = it->first.end();
+         begin.row += delta;
+         end.row += delta;
+         symbolRanges.insert(symbolRanges.end(),
+                             std::make_pair(Range(begin, end), it->second));
+      }
+      symbolRanges_.swap(symbolRanges);
+      
+      BOOST_FOREACH(const boost::shared_ptr<ParseNode>& pChild, children_)
+      {
+         pChild->position_.row += delta;
+         pChild->shiftRows(delta);
+      }
+   }
+   
+private:
+   
+   static bool findRow(const std::vector<std::size_t>& rows,
+                       std::size_t row,
+                       std::size_t* pIndex)
+   {
+      std::vector<std::size_t>::const_iterator it =
+            std::upper_bound(rows.begin(), rows.end(), row);
+      
+      if (it == rows.begin())
+         return false;
+      
+      *pIndex = it - rows.begin() - 1;
+      return true;
+   }
+   
+   static void splitPositions(const SymbolPositions& symbols,
+                              const std::vector<std::size_t>& rows,
+                              const std::vector< boost::shared_ptr<ParseNode> >& fragments,
+                              SymbolPositions ParseNode::*member)
+   {
+      for (SymbolPositions::const_iterator it = symbols.begin();
+           it != symbols.end();
+           ++it)
+      {
+         BOOST_FOREACH(const Position& position, it->second)
+         {
+            std::size_t index;
+            if (findRow(rows, position.row, &index))
+               ((*fragments[index]).*member)[it->first].push_back(position);
+         }
+      }
+   }
+   
+   static void appendPositions(const SymbolPositions& symbols,
+                               SymbolPositions* pTarget)
+   {
+      for (SymbolPositions::const_iterator it = symbols.begin();
+           it != symbols.end();
+           ++it)
+      {
+         Positions& positions = (*pTarget)[it->first];
+         positions.insert(positions.end(), it->second.begin(), it->second.end());
+      }
+   }
+   
+   static void shiftPositions(SymbolPositions* pSymbols, int delta)
+   {
+      for (SymbolPositions::iterator it = pSymbols->begin();
+           it != pSymbols->end();
+           ++it)
+      {
+         BOOST_FOREACH(Position& position, it->second)
+         {
+            position.row += delta;
+         }
+      }
+   }
+   
 public:
    
    const std::string& name() const { return name_; }
@@ -986,12 +1149,10 @@ private:
    PackageSymbols internalSymbols_; // <pkg>::<foo>
    PackageSymbols exportedSymbols_; // <pgk>:::<bar>
    
+   // symbols made available within ranges of this scope (e.g. the
+   // fields of an R6 class within its methods)
    typedef std::map<Range, std::set<std::string> > SymbolRanges;
-   static SymbolRanges& symbolRanges()
-   {
-      static SymbolRanges instance;
-      return instance;
-   }
+   SymbolRanges symbolRanges_;
 };
 
 class ParseStatus
@@ -999,8 +1160,10 @@ class ParseStatus
    
 public:
    
-   explicit ParseStatus(const FilePath& filePath, const ParseOptions& parseOptions)
-      : pRoot_(ParseNode::createRootNode()),
+   explicit ParseStatus(const FilePath& filePath,
+                        const ParseOptions& parseOptions,
+                        boost::shared_ptr<ParseNode> pRoot = ParseNode::createRootNode())
+      : pRoot_(pRoot),
         pNode_(pRoot_.get()),
         lint_(parseOptions),
         parseOptions_(parseOptions),
@@ -1376,6 +1539,34 @@ public:
    {
       return filePath_;
    }
+   
+   // A 'checkpoint' is the start of a top-level statement at the start of a
+   // line: the parse state there is the same as at the start of the document
+   // (aside from the parse tree built so far), so parsing can be stopped and
+   // resumed there.
+   bool isAtCheckpoint(const RToken& token) const
+   {
+      return pNode_ == pRoot_.get() &&
+             parseStateStack_.size() == 1 &&
+             functionNames_.size() == 1 &&
+             nseCallStack_.empty() &&
+             bracketStack_.empty() &&
+             token.column() == 0;
+   }
+   
+   // The handler returns true if parsing should stop at the checkpoint.
+   typedef boost::function<bool(const core::r_util::token_cursor::RTokenCursor&)>
+           CheckpointHandler;
+   
+   void setCheckpointHandler(const CheckpointHandler& handler)
+   {
+      checkpointHandler_ = handler;
+   }
+   
+   bool onCheckpoint(const core::r_util::token_cursor::RTokenCursor& cursor)
+   {
+      return checkpointHandler_ && checkpointHandler_(cursor);
+   }
 
 private:
    boost::shared_ptr<ParseNode> pRoot_;
@@ -1403,6 +1594,7 @@ private:
    SymbolRanges symbolRanges_;
    
    FilePath filePath_;
+   CheckpointHandler checkpointHandler_;
 };
 
 class ParseResults {
@@ -1461,6 +1653,72 @@ ParseResults parse(const std::string& rCode,
 ParseResults parse(const std::wstring& rCode,
                    const ParseOptions& parseOptions = ParseOptions());
 
+// Parses successive versions of a document, re-parsing only the top-level
+// statements affected by the edits between them. The lint and parse tree
+// are the same as from 'parse' (the parse tree of the previous results is
+// reused, so it is only valid until the next call).
+class IncrementalParser : boost::noncopyable
+{
+public:
+   
+   IncrementalParser()
+      : restartChunk_(0),
+        prefixChildren_(0),
+        canResync_(false),
+        resyncChunk_(0)
+   {}
+   
+   ParseResults parse(const core::FilePath& filePath,
+                      const std::wstring& rCode,
+                      const ParseOptions& parseOptions);
+   
+private:
+   
+   // the results of parsing a top-level statement (or a run of them)
+   struct Chunk
+   {
+      std::size_t token; // index of first token
+      std::size_t row;
+      std::vector<LintItem> lint;
+      boost::shared_ptr<ParseNode> pNode; // content of the root node
+      std::vector<std::string> signatures; // of the functions defined
+   };
+   
+   typedef std::vector< boost::shared_ptr<Chunk> > Chunks;
+   
+   struct Checkpoint
+   {
+      Checkpoint(std::size_t token, std::size_t row, std::size_t lintIndex)
+         : token(token), row(row), lintIndex(lintIndex)
+      {}
+      
+      std::size_t token;
+      std::size_t row;
+      std::size_t lintIndex;
+   };
+   
+   bool onCheckpoint(const core::r_util::token_cursor::RTokenCursor& cursor,
+                     ParseStatus* pStatus);
+   
+   bool hasSameDefinitions(const ParseNode& root, std::size_t endChunk) const;
+   
+   core::FilePath filePath_;
+   ParseOptions parseOptions_;
+   std::wstring code_;
+   boost::shared_ptr<RTokens> pTokens_;
+   Chunks chunks_;
+   std::vector<LintItem> endLint_; // added at the end of the document
+   ParseResults results_;
+   
+   // state of the parse in progress
+   boost::shared_ptr<RTokens> pNewTokens_;
+   std::size_t restartChunk_;
+   std::size_t prefixChildren_;
+   std::vector<Checkpoint> checkpoints_;
+   bool canResync_;
+   std::size_t resyncChunk_;
+};
+
 } // namespace rparser
 } // namespace modules
 } // namespace session
@@ -1246,7 +1246,7 @@ Error initialize()
       (bind(registerRpcMethod, "close_all_documents", closeAllDocuments))
       (bind(registerRpcMethod, "get_source_template", getSourceTemplate))
       (bind(registerRpcMethod, "create_rd_shell", createRdShell))
-      (bind(registerRpcMethod, "is_read_only_file", isReadOnlyFile))
+      (bind(registerWorkerSafeRpcMethod, "is_read_only_file", isReadOnlyFile))
       (bind(registerRpcMethod, "get_minimal_source_path", getMinimalSourcePath))
       (bind(registerRpcMethod, "get_script_run_command", getScriptRunCommand))
       (bind(registerRpcMethod, "set_doc_order", setDocOrder))
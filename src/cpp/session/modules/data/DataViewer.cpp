@@ -14,6 +14,7 @@
  */
 
 #include "DataViewer.hpp"
+#include "FrameIndex.hpp"
 
 #include <string>
 #include <vector>
@@ -129,6 +130,14 @@ namespace {
  *    This allows us to efficiently perform operations on very large datasets
  *    once they've been winnowed down to smaller objects using searches and
  *    filters.
+ *
+ * INDEXED:
+ *    Most data frames (those with plain logical, numeric and character
+ *    columns) don't need a working copy at all: a FrameIndex sorts and
+ *    filters their rows in C++, and only the page of rows requested is ever
+ *    extracted in R. We keep the rows matching the current search and
+ *    filters (narrowing them as above) and those rows in the current order.
+ *    Frames the index can't handle fall back to the working copy.
  */    
 
 // indicates whether one filter string is a subset of another; e.g. if a column
@@ -298,6 +307,59 @@ struct CachedFrame
 // The set of active frames. Used primarily to check each for changes.
 std::map<std::string, CachedFrame> s_cachedFrames;
 
+// IndexedFrame represents the sorted and filtered state of a frame whose rows
+// are indexed in C++ (see FrameIndex)
+struct IndexedFrame
+{
+   IndexedFrame():
+      filtered(false),
+      ordered(false),
+      workingOrderCol(0)
+   {
+   }
+
+   boost::shared_ptr<FrameIndex> pIndex;
+
+   // The current search and filter set, and the rows which match them (in
+   // frame order)
+   bool filtered;
+   std::string workingSearch;
+   std::vector<std::string> workingFilters;
+   std::vector<int> workingMatches;
+
+   // The current order column and direction, and the matching rows in
+   // that order (these are the rows we page through)
+   bool ordered;
+   int workingOrderCol;
+   std::string workingOrderDir;
+   std::vector<int> workingRows;
+
+   // indicates whether the rows matching the new search and filters are all
+   // among the current matches (so we can filter those rather than the
+   // whole frame)
+   bool isSupersetOf(const std::string& newSearch,
+                     const std::vector<std::string>& newFilters)
+   {
+      if (!workingSearch.empty() &&
+          !boost::algorithm::icontains(newSearch, workingSearch))
+         return false;
+
+      for (unsigned i = 0; i < workingFilters.size(); i++)
+      {
+         if (workingFilters[i].empty())
+            continue;
+         if (i >= newFilters.size() ||
+             !isFilterSubset(workingFilters[i], newFilters[i]))
+            return false;
+      }
+
+      return true;
+   };
+};
+
+// The set of frames being sorted and filtered in C++, by cache key.
+std::map<std::string, IndexedFrame> s_indexedFrames;
+
 std::string viewerCacheDir() 
 {
    return module_context::sessionScratchPath().childPath(kViewerCacheDir)
@@ -461,6 +523,95 @@ json::Value getCols(SEXP dataSEXP)
    return result;
 }
 
+// sorts and filters the rows of the frame in C++, returning the rows to page
+// through; returns NULL if the frame (or the transform) can't be handled by
+// the index, in which case the transform is left to R
+const std::vector<int>* indexedTransform(const std::string& cacheKey,
+                                         SEXP dataSEXP,
+                                         int nrow,
+                                         const std::vector<std::string>& filters,
+                                         const std::string& search,
+                                         int ordercol,
+                                         const std::string& orderdir)
+{
+   if (cacheKey.empty())
+      return NULL;
+
+   // (re)build the index if we haven't seen this copy of the frame before
+   std::map<std::string, IndexedFrame>::iterator it =
+      s_indexedFrames.find(cacheKey);
+   if (it == s_indexedFrames.end() ||
+       it->second.pIndex->frame() != dataSEXP ||
+       it->second.pIndex->nrow() != nrow)
+   {
+      if (!FrameIndex::canIndex(dataSEXP, nrow))
+      {
+         if (it != s_indexedFrames.end())
+            s_indexedFrames.erase(it);
+         return NULL;
+      }
+
+      if (it == s_indexedFrames.end())
+         it = s_indexedFrames.insert(
+                  std::make_pair(cacheKey, IndexedFrame())).first;
+      else
+         it->second = IndexedFrame();
+      it->second.pIndex.reset(new FrameIndex(dataSEXP, nrow));
+   }
+   IndexedFrame& frame = it->second;
+
+   if (!frame.filtered ||
+       frame.workingSearch != search ||
+       frame.workingFilters != filters)
+   {
+      // start from the current matches if we're narrowing them, otherwise
+      // from the whole frame
+      std::vector<int> rows;
+      if (frame.filtered && frame.isSupersetOf(search, filters))
+      {
+         rows = frame.workingMatches;
+      }
+      else
+      {
+         rows.reserve(nrow);
+         for (int i = 0; i < nrow; i++)
+            rows.push_back(i);
+      }
+
+      if (!frame.pIndex->filter(filters, search, &rows))
+         return NULL;
+
+      frame.filtered = true;
+      frame.workingSearch = search;
+      frame.workingFilters = filters;
+      frame.workingMatches.swap(rows);
+      frame.ordered = false;
+   }
+
+   if (!frame.ordered ||
+       frame.workingOrderCol != ordercol ||
+       frame.workingOrderDir != orderdir)
+   {
+      frame.ordered = false;
+      if (ordercol > 0)
+      {
+         if (!frame.pIndex->order(ordercol, orderdir == "desc",
+                                  frame.workingMatches, &frame.workingRows))
+            return NULL;
+      }
+      else
+      {
+         frame.workingRows = frame.workingMatches;
+      }
+
+      frame.ordered = true;
+      frame.workingOrderCol = ordercol;
+      frame.workingOrderDir = orderdir;
+   }
+
+   return &frame.workingRows;
+}
+
 // given an object from which to return data, and a description of the data to
 // return via URL-encoded paramters supplied by the DataTables API, returns the
 // data requested by the parameters. 
@@ -515,6 +666,19 @@ json::Value getData(SEXP dataSEXP, const http::Fields& fields)
    bool needsTransform = ordercol > 0 || hasFilter || !search.empty();
    bool hasTransform = false;
 
+   // sort and filter in C++ if we can
+   const std::vector<int>* pIndexedRows = NULL;
+   if (needsTransform)
+   {
+      pIndexedRows = indexedTransform(cacheKey, dataSEXP, nrow, filters,
+                                      search, ordercol, orderdir);
+      if (pIndexedRows != NULL)
+      {
+         needsTransform = false;
+         hasTransform = true;
+      }
+   }
+
    // check to see if we have an ordered/filtered view we can build from
    std::map<std::string, CachedFrame>::iterator cachedFrame = 
       s_cachedFrames.find(cacheKey);
@@ -586,9 +750,12 @@ json::Value getData(SEXP dataSEXP, const http::Fields& fields)
    }
 
    // apply new row count if we've tansformed the data (or need to)
-   filteredNRow = needsTransform || hasTransform ?
-      safeDim(dataSEXP, DIM_ROWS) : 
-      nrow;
+   if (pIndexedRows != NULL)
+      filteredNRow = static_cast<int>(pIndexedRows->size());
+   else if (needsTransform || hasTransform)
+      filteredNRow = safeDim(dataSEXP, DIM_ROWS);
+   else
+      filteredNRow = nrow;
 
    // return the lesser of the rows available and rows requested
    length = std::min(length, filteredNRow - start);
@@ -596,6 +763,37 @@ json::Value getData(SEXP dataSEXP, const http::Fields& fields)
    // DataTables uses 0-based indexing, but R uses 1-based indexing
    start ++;
 
+   // the row at which to start formatting data
+   int formatStart = start;
+
+   SEXP rownamesSEXP = R_NilValue;
+   if (pIndexedRows != NULL)
+   {
+      // extract just the page of rows requested from the frame
+      int pageLength = std::max(length, 0);
+      SEXP rowsSEXP = Rf_allocVector(INTSXP, pageLength);
+      protect.add(rowsSEXP);
+      for (int i = 0; i < pageLength; i++)
+         INTEGER(rowsSEXP)[i] = (*pIndexedRows)[start - 1 + i] + 1;
+
+      r::exec::RFunction(".rs.formatIndexedRowNames", dataSEXP, rowsSEXP)
+         .call(&rownamesSEXP, &protect);
+
+      SEXP pageSEXP = R_NilValue;
+      error = r::exec::RFunction(".rs.indexedRows", dataSEXP, rowsSEXP)
+         .call(&pageSEXP, &protect);
+      if (error)
+         throw r::exec::RErrorException(error.summary());
+      dataSEXP = pageSEXP;
+      formatStart = 1;
+   }
+   else
+   {
+      // format the row names 
+      r::exec::RFunction(".rs.formatRowNames", dataSEXP, start, length)
+         .call(&rownamesSEXP, &protect);
+   }
+
    // extract the portion of the column vector requested by the client
    SEXP formattedDataSEXP = Rf_allocVector(VECSXP, ncol);
    protect.add(formattedDataSEXP);
@@ -611,7 +809,7 @@ json::Value getData(SEXP dataSEXP, const http::Fields& fields)
       SEXP formattedColumnSEXP;
       r::exec::RFunction formatFx(".rs.formatDataColumn");
       formatFx.addParam(columnSEXP);
-      formatFx.addParam(static_cast<int>(start));
+      formatFx.addParam(static_cast<int>(formatStart));
       formatFx.addParam(static_cast<int>(length));
       error = formatFx.call(&formattedColumnSEXP, &protect);
       if (error)
@@ -619,11 +817,6 @@ json::Value getData(SEXP dataSEXP, const http::Fields& fields)
       SET_VECTOR_ELT(formattedDataSEXP, i, formattedColumnSEXP);
     }
 
-   // format the row names 
-   SEXP rownamesSEXP;
-   r::exec::RFunction(".rs.formatRowNames", dataSEXP, start, length)
-      .call(&rownamesSEXP, &protect);
-   
    // create the result grid as JSON
    json::Array data;
    for (int row = 0; row < length; row++)
@@ -812,6 +1005,7 @@ Error removeCacheKey(const std::string& cacheKey)
       s_cachedFrames.find(cacheKey);
    if (pos != s_cachedFrames.end())
       s_cachedFrames.erase(pos);
+   s_indexedFrames.erase(cacheKey);
    
    // remove cache env object and backing file
    return r::exec::RFunction(".rs.removeCachedData", cacheKey, 
@@ -873,6 +1067,7 @@ void onDetectChanges(module_context::ChangeSource source)
 
          // clear working data for the object
          r::exec::RFunction(".rs.removeWorkingData", i->first).call();
+         s_indexedFrames.erase(i->first);
 
          // replace cached copy (if we have something to replace it with)
          if (sexp != NULL)
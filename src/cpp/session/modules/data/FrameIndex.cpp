@@ -0,0 +1,566 @@
+/*
+ * FrameIndex.cpp
+ *
+ * Copyright (C) 2009-17 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#include "FrameIndex.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include <boost/algorithm/string/classification.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/trim.hpp>
+
+#include <core/Log.hpp>
+#include <core/Error.hpp>
+
+#define R_INTERNAL_FUNCTIONS
+#include <r/RInternal.hpp>
+#include <r/RExec.hpp>
+#include <r/RSexp.hpp>
+
+using namespace rstudio::core;
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace data {
+namespace viewer {
+
+namespace {
+
+// splits a string as R's strsplit(x, sep, fixed = TRUE) does (in particular,
+// a trailing separator doesn't produce a trailing empty piece)
+std::vector<std::string> splitString(const std::string& value, char sep)
+{
+   std::vector<std::string> pieces;
+   boost::algorithm::split(pieces, value, boost::algorithm::is_any_of(
+            std::string(1, sep)));
+   if (pieces.size() > 1 && pieces.back().empty())
+      pieces.pop_back();
+   return pieces;
+}
+
+// converts a string to a number as as.numeric() does (NA if it isn't one)
+double parseNumber(const std::string& value)
+{
+   std::string trimmed = boost::algorithm::trim_copy(value);
+   if (trimmed.empty())
+      return NA_REAL;
+
+   char* pEnd = NULL;
+   double result = std::strtod(trimmed.c_str(), &pEnd);
+   return *pEnd == '\0' ? result : NA_REAL;
+}
+
+inline char fold(char ch)
+{
+   return (ch >= 'A' && ch <= 'Z') ? ch + ('a' - 'A') : ch;
+}
+
+// folds a search string to match the column text; returns false if it
+// contains anything we can't match the way R does (non-ASCII characters,
+// which R folds by their Unicode case, and the \E which ends R's quoting)
+bool foldNeedle(const std::string& value, std::string* pNeedle)
+{
+   if (value.find("\\E") != std::string::npos)
+      return false;
+
+   pNeedle->clear();
+   for (std::size_t i = 0; i < value.size(); i++)
+   {
+      unsigned char ch = static_cast<unsigned char>(value[i]);
+      if (ch == 0 || ch >= 0x80)
+         return false;
+      pNeedle->push_back(fold(value[i]));
+   }
+   return true;
+}
+
+// finds the needle in [begin, end); memchr does the heavy lifting so the
+// scan runs at (vectorized) libc speed when candidates are rare
+const char* findText(const char* begin, const char* end,
+                     const std::string& needle)
+{
+   std::size_t n = needle.size();
+   const char* pos = begin;
+   while (static_cast<std::size_t>(end - pos) >= n)
+   {
+      pos = static_cast<const char*>(
+               std::memchr(pos, needle[0], (end - pos) - n + 1));
+      if (pos == NULL)
+         return NULL;
+      if (std::memcmp(pos + 1, needle.data() + 1, n - 1) == 0)
+         return pos;
+      pos++;
+   }
+   return NULL;
+}
+
+// numeric value of a cell (NA_REAL if missing)
+inline double valueAt(SEXP colSEXP, int row)
+{
+   switch (TYPEOF(colSEXP))
+   {
+   case LGLSXP:
+   case INTSXP:
+   {
+      int value = INTEGER(colSEXP)[row];
+      return value == NA_INTEGER ? NA_REAL : value;
+   }
+   case REALSXP:
+      return REAL(colSEXP)[row];
+   default:
+      return NA_REAL;
+   }
+}
+
+// the numeric filters all test for values within a range (a single value
+// for equality tests)
+struct NumericFilter
+{
+   NumericFilter(double lower, double upper, bool finiteOnly)
+      : lower(lower), upper(upper), finiteOnly(finiteOnly)
+   {
+   }
+
+   bool matches(double value) const
+   {
+      if (finiteOnly ? !R_FINITE(value) : ISNAN(value))
+         return false;
+      return value >= lower && value <= upper;
+   }
+
+   double lower;
+   double upper;
+   bool finiteOnly;
+};
+
+void filterNumeric(SEXP colSEXP, const NumericFilter& filter,
+                   std::vector<int>* pRows)
+{
+   std::vector<int>& rows = *pRows;
+   std::size_t count = 0;
+   for (std::size_t i = 0; i < rows.size(); i++)
+   {
+      if (filter.matches(valueAt(colSEXP, rows[i])))
+         rows[count++] = rows[i];
+   }
+   rows.resize(count);
+}
+
+inline bool isMissing(int value) { return value == NA_INTEGER; }
+inline bool isMissing(double value) { return ISNAN(value); }
+
+template <typename T>
+class ValueComparator
+{
+public:
+   ValueComparator(const T* pValues, bool descending)
+      : pValues_(pValues), descending_(descending)
+   {
+   }
+
+   bool operator()(int lhs, int rhs) const
+   {
+      return descending_ ? pValues_[rhs] < pValues_[lhs] :
+                           pValues_[lhs] < pValues_[rhs];
+   }
+
+private:
+   const T* pValues_;
+   bool descending_;
+};
+
+// orders values as order() does: ties keep their original order and
+// missing values go last whatever the direction
+template <typename T>
+void orderValues(const T* pValues, int n, bool descending,
+                 std::vector<int>* pOrder)
+{
+   std::vector<int> missing;
+   pOrder->reserve(n);
+   for (int i = 0; i < n; i++)
+   {
+      if (isMissing(pValues[i]))
+         missing.push_back(i);
+      else
+         pOrder->push_back(i);
+   }
+
+   std::stable_sort(pOrder->begin(), pOrder->end(),
+                    ValueComparator<T>(pValues, descending));
+   pOrder->insert(pOrder->end(), missing.begin(), missing.end());
+}
+
+// whether order() on the column is the order of its underlying values (for
+// other classes, order() may dispatch to an xtfrm method)
+bool hasValueOrder(SEXP colSEXP)
+{
+   if (TYPEOF(colSEXP) != LGLSXP && TYPEOF(colSEXP) != INTSXP &&
+       TYPEOF(colSEXP) != REALSXP)
+      return false;
+
+   if (Rf_isNull(Rf_getAttrib(colSEXP, R_ClassSymbol)))
+      return true;
+
+   return r::sexp::inherits(colSEXP, "factor") ||
+          r::sexp::inherits(colSEXP, "Date") ||
+          r::sexp::inherits(colSEXP, "POSIXct") ||
+          r::sexp::inherits(colSEXP, "difftime");
+}
+
+} // anonymous namespace
+
+bool FrameIndex::canIndex(SEXP frameSEXP, int nrow)
+{
+   if (TYPEOF(frameSEXP) != VECSXP ||
+       !r::sexp::inherits(frameSEXP, "data.frame"))
+      return false;
+
+   for (int i = 0; i < Rf_length(frameSEXP); i++)
+   {
+      SEXP colSEXP = VECTOR_ELT(frameSEXP, i);
+      switch (TYPEOF(colSEXP))
+      {
+      case LGLSXP:
+      case INTSXP:
+      case REALSXP:
+      case STRSXP:
+         break;
+      default:
+         return false;
+      }
+
+      // matrix columns display (and search) differently
+      if (Rf_length(colSEXP) != nrow ||
+          !Rf_isNull(Rf_getAttrib(colSEXP, R_DimSymbol)))
+         return false;
+   }
+
+   return true;
+}
+
+FrameIndex::FrameIndex(SEXP frameSEXP, int nrow)
+   : frame_(frameSEXP), nrow_(nrow), ncol_(Rf_length(frameSEXP))
+{
+}
+
+SEXP FrameIndex::column(int col) const
+{
+   if (col < 1 || col > ncol_)
+      return R_NilValue;
+   return VECTOR_ELT(frame_.get(), col - 1);
+}
+
+const FrameIndex::ColumnText* FrameIndex::columnText(int col)
+{
+   std::map<int, boost::shared_ptr<ColumnText> >::const_iterator it =
+                                                            text_.find(col);
+   if (it != text_.end())
+      return it->second.get();
+
+   SEXP colSEXP = column(col);
+   if (Rf_isNull(colSEXP))
+      return NULL;
+
+   // let R convert other types to text, so that numbers, factors, dates etc.
+   // read just as they do when R searches them
+   r::sexp::Protect protect;
+   if (TYPEOF(colSEXP) != STRSXP)
+   {
+      Error error = r::exec::RFunction("as.character", colSEXP)
+            .call(&colSEXP, &protect);
+      if (error)
+      {
+         LOG_ERROR(error);
+         return NULL;
+      }
+      if (TYPEOF(colSEXP) != STRSXP || Rf_length(colSEXP) != nrow_)
+         return NULL;
+   }
+
+   boost::shared_ptr<ColumnText> pText(new ColumnText());
+   pText->offsets.reserve(nrow_ + 1);
+   for (int i = 0; i < nrow_; i++)
+   {
+      pText->offsets.push_back(pText->text.size());
+      SEXP elementSEXP = STRING_ELT(colSEXP, i);
+      if (elementSEXP != NA_STRING)
+      {
+         // (translation is guarded, since it can error)
+         std::string value = r::sexp::utf8String(elementSEXP);
+         for (std::size_t j = 0; j < value.size(); j++)
+            pText->text.push_back(fold(value[j]));
+      }
+      pText->text.push_back('\0');
+   }
+   pText->offsets.push_back(pText->text.size());
+
+   text_[col] = pText;
+   return pText.get();
+}
+
+const std::vector<int>* FrameIndex::sortOrder(int col, bool descending)
+{
+   std::pair<int, bool> key(col, descending);
+   std::map<std::pair<int, bool>, boost::shared_ptr<std::vector<int> > >
+                                 ::const_iterator it = orders_.find(key);
+   if (it != orders_.end())
+      return it->second.get();
+
+   SEXP colSEXP = column(col);
+   if (Rf_isNull(colSEXP))
+      return NULL;
+
+   boost::shared_ptr<std::vector<int> > pOrder(new std::vector<int>());
+   if (hasValueOrder(colSEXP))
+   {
+      if (TYPEOF(colSEXP) == REALSXP)
+         orderValues(REAL(colSEXP), nrow_, descending, pOrder.get());
+      else
+         orderValues(INTEGER(colSEXP), nrow_, descending, pOrder.get());
+   }
+   else
+   {
+      // character columns are ordered by R so they collate as they would
+      // there (by locale); we only pay for this once per direction
+      r::sexp::Protect protect;
+      SEXP orderSEXP = R_NilValue;
+      r::exec::RFunction orderFx("order");
+      orderFx.addParam(colSEXP);
+      orderFx.addParam("decreasing", descending);
+      Error error = orderFx.call(&orderSEXP, &protect);
+      if (error)
+      {
+         LOG_ERROR(error);
+         return NULL;
+      }
+      if (TYPEOF(orderSEXP) != INTSXP || Rf_length(orderSEXP) != nrow_)
+         return NULL;
+
+      pOrder->reserve(nrow_);
+      for (int i = 0; i < nrow_; i++)
+         pOrder->push_back(INTEGER(orderSEXP)[i] - 1);
+   }
+
+   orders_[key] = pOrder;
+   return pOrder.get();
+}
+
+bool FrameIndex::filter(const std::vector<std::string>& filters,
+                        const std::string& search,
+                        std::vector<int>* pRows)
+{
+   std::vector<int> rows(*pRows);
+
+   for (std::size_t i = 0; i < filters.size() && !rows.empty(); i++)
+   {
+      if (filters[i].empty())
+         continue;
+      if (!applyFilter(static_cast<int>(i) + 1, filters[i], &rows))
+         return false;
+   }
+
+   if (!search.empty() && !rows.empty())
+   {
+      if (!applySearch(search, &rows))
+         return false;
+   }
+
+   pRows->swap(rows);
+   return true;
+}
+
+bool FrameIndex::applyFilter(int col, const std::string& filter,
+                             std::vector<int>* pRows)
+{
+   SEXP colSEXP = column(col);
+   if (Rf_isNull(colSEXP))
+      return false;
+
+   // "type|value"; filters without a value don't apply
+   std::vector<std::string> pieces = splitString(filter, '|');
+   if (pieces.size() < 2)
+      return true;
+   const std::string& type = pieces[0];
+   const std::string& value = pieces[1];
+
+   bool isFactor = r::sexp::inherits(colSEXP, "factor");
+   if (type == "factor")
+   {
+      // value is the (1-based) level
+      if (TYPEOF(colSEXP) == STRSXP)
+         return false;
+      double level = parseNumber(value);
+      filterNumeric(colSEXP, NumericFilter(level, level, false), pRows);
+   }
+   else if (type == "character")
+   {
+      // case insensitive substring
+      std::string needle;
+      if (!foldNeedle(value, &needle))
+         return false;
+      if (needle.empty())
+         return true;
+
+      const ColumnText* pText = columnText(col);
+      if (pText == NULL)
+         return false;
+
+      std::vector<int>& rows = *pRows;
+      const char* text = pText->text.data();
+      std::size_t count = 0;
+      for (std::size_t i = 0; i < rows.size(); i++)
+      {
+         int row = rows[i];
+         if (findText(text + pText->offsets[row],
+                      text + pText->offsets[row + 1],
+                      needle) != NULL)
+         {
+            rows[count++] = row;
+         }
+      }
+      rows.resize(count);
+   }
+   else if (type == "numeric")
+   {
+      // finite values in a range ("2_32") or equal to a value ("15")
+      if (TYPEOF(colSEXP) == STRSXP || isFactor)
+         return false;
+      std::vector<std::string> bounds = splitString(value, '_');
+      double lower = parseNumber(bounds[0]);
+      double upper = bounds.size() > 1 ? parseNumber(bounds[1]) : lower;
+      filterNumeric(colSEXP, NumericFilter(lower, upper, true), pRows);
+   }
+   else if (type == "boolean")
+   {
+      if (TYPEOF(colSEXP) == STRSXP || isFactor)
+         return false;
+      double flag = value == "TRUE" ? 1 : 0;
+      filterNumeric(colSEXP, NumericFilter(flag, flag, false), pRows);
+   }
+
+   // unknown filter types are ignored
+   return true;
+}
+
+bool FrameIndex::applySearch(const std::string& search,
+                             std::vector<int>* pRows)
+{
+   std::string needle;
+   if (!foldNeedle(search, &needle))
+      return false;
+   if (needle.empty())
+      return true;
+
+   std::vector<const ColumnText*> columns;
+   for (int col = 1; col <= ncol_; col++)
+   {
+      const ColumnText* pText = columnText(col);
+      if (pText == NULL)
+         return false;
+      columns.push_back(pText);
+   }
+
+   std::vector<int>& rows = *pRows;
+   std::size_t count = 0;
+   if (rows.size() == static_cast<std::size_t>(nrow_))
+   {
+      // searching every row; scan each column's text in one pass
+      std::vector<char> matched(nrow_, 0);
+      for (std::size_t i = 0; i < columns.size(); i++)
+      {
+         const ColumnText* pText = columns[i];
+         const char* begin = pText->text.data();
+         const char* end = begin + pText->text.size();
+         const char* pos = begin;
+         while ((pos = findText(pos, end, needle)) != NULL)
+         {
+            // skip to the next row (needles can't span rows; they contain
+            // no NUL)
+            std::size_t row = std::upper_bound(pText->offsets.begin(),
+                                               pText->offsets.end(),
+                                               static_cast<std::size_t>(pos - begin)) -
+                              pText->offsets.begin() - 1;
+            matched[row] = 1;
+            pos = begin + pText->offsets[row + 1];
+         }
+      }
+
+      for (std::size_t i = 0; i < rows.size(); i++)
+      {
+         if (matched[rows[i]])
+            rows[count++] = rows[i];
+      }
+   }
+   else
+   {
+      for (std::size_t i = 0; i < rows.size(); i++)
+      {
+         int row = rows[i];
+         for (std::size_t j = 0; j < columns.size(); j++)
+         {
+            const char* text = columns[j]->text.data();
+            if (findText(text + columns[j]->offsets[row],
+                         text + columns[j]->offsets[row + 1],
+                         needle) != NULL)
+            {
+               rows[count++] = row;
+               break;
+            }
+         }
+      }
+   }
+   rows.resize(count);
+
+   return true;
+}
+
+bool FrameIndex::order(int col,
+                       bool descending,
+                       const std::vector<int>& rows,
+                       std::vector<int>* pOrdered)
+{
+   const std::vector<int>* pOrder = sortOrder(col, descending);
+   if (pOrder == NULL)
+      return false;
+
+   if (rows.size() == static_cast<std::size_t>(nrow_))
+   {
+      *pOrdered = *pOrder;
+      return true;
+   }
+
+   // pick the rows out of the column's order
+   std::vector<char> selected(nrow_, 0);
+   for (std::size_t i = 0; i < rows.size(); i++)
+      selected[rows[i]] = 1;
+
+   pOrdered->clear();
+   pOrdered->reserve(rows.size());
+   for (std::size_t i = 0; i < pOrder->size(); i++)
+   {
+      if (selected[(*pOrder)[i]])
+         pOrdered->push_back((*pOrder)[i]);
+   }
+   return true;
+}
+
+} // namespace viewer
+} // namespace data
+} // namespace modules
+} // namesapce session
+} // namespace rstudio
@@ -0,0 +1,105 @@
+/*
+ * FrameIndex.hpp
+ *
+ * Copyright (C) 2009-17 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+
+#ifndef SESSION_DATA_FRAME_INDEX_HPP
+#define SESSION_DATA_FRAME_INDEX_HPP
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/utility.hpp>
+
+#include <r/RSexp.hpp>
+
+namespace rstudio {
+namespace session {
+namespace modules {
+namespace data {
+namespace viewer {
+
+// Sorts and filters the rows of a data frame directly on its column vectors,
+// so that the data viewer can order, filter and search large frames without
+// evaluating (and copying) the frame in R on each request.
+//
+// Rows are identified by their 0-based position in the frame. The index
+// keeps the frame alive while it exists, and caches the sort order of each
+// column (per direction) and the searchable text of each column as they're
+// first needed.
+class FrameIndex : boost::noncopyable
+{
+public:
+   // whether the index can handle the frame: a data frame whose columns are
+   // all plain logical, integer, double or character vectors of nrow values
+   static bool canIndex(SEXP frameSEXP, int nrow);
+
+   FrameIndex(SEXP frameSEXP, int nrow);
+
+   SEXP frame() const { return frame_.get(); }
+   int nrow() const { return nrow_; }
+
+   // narrow rows (ascending) to those matching the column filters (in the
+   // "type|value" format used by the viewer) and the global search. returns
+   // false (leaving rows untouched) if the filters can't be applied here.
+   bool filter(const std::vector<std::string>& filters,
+               const std::string& search,
+               std::vector<int>* pRows);
+
+   // put rows (ascending) in the order of the given (1-based) column.
+   // returns false if the column can't be ordered.
+   bool order(int col,
+              bool descending,
+              const std::vector<int>& rows,
+              std::vector<int>* pOrdered);
+
+private:
+   struct ColumnText
+   {
+      // the column's values as text (ASCII folded to lower case), each one
+      // terminated by a NUL; missing values are empty
+      std::string text;
+
+      // the offset of each row's value within the text, followed by the
+      // end of the text
+      std::vector<std::size_t> offsets;
+   };
+
+   SEXP column(int col) const;
+   const ColumnText* columnText(int col);
+   const std::vector<int>* sortOrder(int col, bool descending);
+
+   bool applyFilter(int col, const std::string& filter,
+                    std::vector<int>* pRows);
+   bool applySearch(const std::string& search, std::vector<int>* pRows);
+
+private:
+   r::sexp::PreservedSEXP frame_;
+   int nrow_;
+   int ncol_;
+
+   // cached per column (text) and per column and direction (sort orders)
+   std::map<int, boost::shared_ptr<ColumnText> > text_;
+   std::map<std::pair<int, bool>, boost::shared_ptr<std::vector<int> > >
+                                                                   orders_;
+};
+
+} // namespace viewer
+} // namespace data
+} // namespace modules
+} // namesapce session
+} // namespace rstudio
+
+#endif // SESSION_DATA_FRAME_INDEX_HPP
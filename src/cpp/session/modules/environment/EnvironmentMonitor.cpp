@@ -15,6 +15,11 @@
 
 #include "EnvironmentMonitor.hpp"
 
+#include <algorithm>
+
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+
 #include <r/RSexp.hpp>
 #include <r/RInterface.hpp>
 #include <session/SessionModuleContext.hpp>
@@ -30,11 +35,9 @@ namespace modules {
 namespace environment {
 namespace {
 
-bool compareVarName(const r::sexp::Variable& var1,
-                    const r::sexp::Variable& var2)
-{
-   return var1.first < var2.first;
-}
+// time spent describing changed objects when checking for changes (any
+// others are described in the background once the session is idle)
+const int kDescribeBudgetMs = 100;
 
 void enqueRefreshEvent()
 {
@@ -42,43 +45,18 @@ void enqueRefreshEvent()
    module_context::enqueClientEvent(refreshEvent);
 }
 
-// if the given variable is an unevaluated promise, add it to the given
-// list of variables
-void addUnevaledPromise(std::vector<r::sexp::Variable>* pEnv,
-                        const r::sexp::Variable& var)
-{
-   if (isUnevaluatedPromise(var.second))
-   {
-      pEnv->push_back(var);
-   }
-}
-
-// If the given variable exists in the given list, remove it. Compares on name
-// only.
-void removeVarFromList(std::vector<r::sexp::Variable>* pEnv,
-                       const r::sexp::Variable& var)
-{
-   for (std::vector<r::sexp::Variable>::iterator iter = pEnv->begin();
-        iter != pEnv->end(); iter++)
-   {
-      if (iter->first == var.first)
-      {
-         pEnv->erase(iter);
-         break;
-      }
-   }
-}
-
 } // anonymous namespace
 
 EnvironmentMonitor::EnvironmentMonitor() :
+   generation_(0),
+   describing_(false),
    initialized_(false),
    refreshOnInit_(false)
 {}
 
-void EnvironmentMonitor::enqueRemovedEvent(const r::sexp::Variable& variable)
+void EnvironmentMonitor::enqueRemovedEvent(const std::string& name)
 {
-   ClientEvent removedEvent(client_events::kEnvironmentRemoved, variable.first);
+   ClientEvent removedEvent(client_events::kEnvironmentRemoved, name);
    module_context::enqueClientEvent(removedEvent);
 }
 
@@ -100,6 +78,7 @@ void EnvironmentMonitor::setMonitoredEnvironment(SEXP pEnvironment,
       return;
 
    environment_.set(pEnvironment);
+   clearBindings();
 
    // init the environment by doing an initial check for changes
    initialized_ = false;
@@ -117,124 +96,197 @@ bool EnvironmentMonitor::hasEnvironment()
    return getMonitoredEnvironment() != NULL;
 }
 
-void EnvironmentMonitor::listEnv(std::vector<r::sexp::Variable>* pEnv)
+void EnvironmentMonitor::clearBindings()
 {
-   r::sexp::Protect rProtect;
-   r::sexp::listEnvironment(getMonitoredEnvironment(),
-                            false,
-                            userSettings().showLastDotValue(),
-                            &rProtect,
-                            pEnv);
+   bindings_.clear();
+   pending_.clear();
 }
 
-void EnvironmentMonitor::checkForChanges()
+void EnvironmentMonitor::clearPending()
 {
-   // information about the current environment
-   std::vector<r::sexp::Variable> currentEnv ;
-   std::vector<r::sexp::Variable> currentPromises;
+   BOOST_FOREACH(SEXP symbolSEXP, pending_)
+   {
+      Bindings::iterator it = bindings_.find(symbolSEXP);
+      if (it != bindings_.end())
+         it->second.pending = false;
+   }
+   pending_.clear();
+}
 
-   // list of assigns/removes (includes both value changes and promise
-   // evaluations)
-   std::vector<r::sexp::Variable> addedVars;
-   std::vector<r::sexp::Variable> removedVars;
+void EnvironmentMonitor::updateBinding(const r::sexp::Binding& current,
+                                       std::vector<SEXP>* pChanged)
+{
+   r::sexp::ObjectFingerprint fingerprint(current.value);
 
-   // get the set of variables and promises in the current environment
-   listEnv(&currentEnv);
+   Bindings::iterator it = bindings_.find(current.symbol);
+   if (it == bindings_.end())
+   {
+      Binding& binding = bindings_[current.symbol];
+      binding.name = CHAR(PRINTNAME(current.symbol));
+      binding.fingerprint = fingerprint;
+      binding.active = current.active;
+      binding.generation = generation_;
+      pChanged->push_back(current.symbol);
+   }
+   else
+   {
+      Binding& binding = it->second;
+      if (binding.fingerprint != fingerprint ||
+          binding.active != current.active)
+      {
+         binding.fingerprint = fingerprint;
+         binding.active = current.active;
+         pChanged->push_back(current.symbol);
+      }
+      binding.generation = generation_;
+   }
+}
+
+void EnvironmentMonitor::checkForChanges()
+{
+   SEXP env = getMonitoredEnvironment();
+   if (env == NULL)
+      return;
 
-   // R returns an environment list sorted in dictionary order. Since the
-   // set difference algorithms below use simple string comparisons to
-   // establish order, we need to re-sort the list into canonical order
-   // to avoid the algorithms detecting superfluous insertions.
-   std::sort(currentEnv.begin(), currentEnv.end(), compareVarName);
+   // bindings which were added or whose values changed
+   std::vector<SEXP> changed;
+   bool wasEmpty = bindings_.empty();
+   ++generation_;
+
+   // compare the fingerprint of each binding's value to the one from the
+   // last check (bindings are keyed by symbol, so unchanged ones don't need
+   // their names converted to strings or sorted)
+   std::vector<r::sexp::Binding> current;
+   r::sexp::listEnvironmentBindings(env,
+                                    userSettings().showLastDotValue(),
+                                    &current);
+   BOOST_FOREACH(const r::sexp::Binding& binding, current)
+   {
+      updateBinding(binding, &changed);
+   }
 
-   std::for_each(currentEnv.begin(), currentEnv.end(),
-                 boost::bind(addUnevaledPromise, &currentPromises, _1));
+   // bindings not seen in this check have been removed
+   std::vector<std::string> removed;
+   for (Bindings::iterator it = bindings_.begin(); it != bindings_.end(); )
+   {
+      if (it->second.generation != generation_)
+      {
+         removed.push_back(it->second.name);
+         it = bindings_.erase(it);
+      }
+      else
+      {
+         ++it;
+      }
+   }
 
-   bool refreshEnqueued = false;
    if (!initialized_)
    {
-      if (refreshOnInit_ ||
-          getMonitoredEnvironment() == R_GlobalEnv)
-      {
+      if (refreshOnInit_ || env == R_GlobalEnv)
          enqueRefreshEvent();
-         refreshEnqueued = true;
-      }
       initialized_ = true;
       refreshOnInit_ = false;
+      return;
    }
-   else
+
+   if (changed.empty() && removed.empty())
+      return;
+
+   // optimize for empty environment (user reset workspace) or a previously
+   // empty one (startup) by just sending a single refresh event. only do
+   // this for the global environment--while debugging local environments,
+   // the environment object list is sent down as part of the context depth
+   // event.
+   if ((bindings_.empty() || wasEmpty) && env == R_GlobalEnv)
    {
-      if (currentEnv != lastEnv_)
-      {
-         // optimize for empty currentEnv (user reset workspace) or empty
-         // lastEnv_ (startup) by just sending a single refresh event
-         // only do this for the global environment--while debugging local
-         // environments, the environment object list is sent down as part of
-         // the context depth event.
-         if ((currentEnv.empty() || lastEnv_.empty())
-             && getMonitoredEnvironment() == R_GlobalEnv)
-         {
-            enqueRefreshEvent();
-            refreshEnqueued = true;
-         }
-         else
-         {
-            std::set_difference(lastEnv_.begin(), lastEnv_.end(),
-                                currentEnv.begin(), currentEnv.end(),
-                                std::back_inserter(removedVars),
-                                compareVarName);
-
-            // fire removed event for deletes
-            std::for_each(removedVars.begin(),
-                          removedVars.end(),
-                          boost::bind(&EnvironmentMonitor::enqueRemovedEvent,
-                                      this, _1));
-
-            // remove deleted objects from the list of uneval'ed promises
-            // so we'll stop monitoring them for evaluation
-            std::for_each(removedVars.begin(),
-                          removedVars.end(),
-                          boost::bind(removeVarFromList, &unevaledPromises_, _1));
-
-            // find adds & assigns (all variable name/value combinations in the
-            // current environment but NOT in the previous environment)
-            std::set_difference(currentEnv.begin(), currentEnv.end(),
-                                lastEnv_.begin(), lastEnv_.end(),
-                                std::back_inserter(addedVars));
-
-            // remove assigned objects from the list of uneval'ed promises
-            // (otherwise, we double-assign in the case where a promise SEXP
-            // is simultaneously forced/evaluated and assigned a new value)
-            std::for_each(addedVars.begin(),
-                          addedVars.end(),
-                          boost::bind(removeVarFromList, &unevaledPromises_, _1));
-
-         }
-      }
-      // if a refresh is scheduled there's no need to emit add events one by one
-      if (!refreshEnqueued)
+      clearPending();
+      enqueRefreshEvent();
+      return;
+   }
+
+   // fire removed events for deletes
+   std::sort(removed.begin(), removed.end());
+   std::for_each(removed.begin(),
+                 removed.end(),
+                 boost::bind(&EnvironmentMonitor::enqueRemovedEvent, this, _1));
+
+   // queue the adds, assigns and promise evaluations to be described (in
+   // name order); bindings which are already waiting keep their place
+   std::vector<std::pair<std::string, SEXP> > queued;
+   BOOST_FOREACH(SEXP symbolSEXP, changed)
+   {
+      Binding& binding = bindings_[symbolSEXP];
+      if (!binding.pending)
       {
-         // have any promises been evaluated since we last checked?
-         if (currentPromises != unevaledPromises_)
-         {
-            // for each promise that is in the set of promises we are monitoring
-            // for evaluation but not in the set of currently tracked promises,
-            // we assume this to be an eval--process as an assign
-            std::set_difference(unevaledPromises_.begin(), unevaledPromises_.end(),
-                                currentPromises.begin(), currentPromises.end(),
-                                std::back_inserter(addedVars));
-         }
-
-         // fire assigned event for adds, assigns, and promise evaluations
-         std::for_each(addedVars.begin(),
-                       addedVars.end(),
-                       boost::bind(&EnvironmentMonitor::enqueAssignedEvent,
-                                    this, _1));
+         binding.pending = true;
+         queued.push_back(std::make_pair(binding.name, symbolSEXP));
       }
    }
+   std::sort(queued.begin(), queued.end());
+   for (std::size_t i = 0; i < queued.size(); i++)
+      pending_.push_back(queued[i].second);
+
+   // describe as many as we can within our budget, and the rest once the
+   // session is idle
+   using namespace boost::posix_time;
+   ptime deadline = microsec_clock::universal_time() +
+                    milliseconds(kDescribeBudgetMs);
+   while (describeNextBinding())
+   {
+      if (microsec_clock::universal_time() >= deadline)
+         break;
+   }
 
-   unevaledPromises_ = currentPromises;
-   lastEnv_ = currentEnv;
+   if (!pending_.empty() && !describing_)
+   {
+      describing_ = true;
+      module_context::scheduleIncrementalWork(
+               milliseconds(20),
+               boost::bind(&EnvironmentMonitor::describeDeferredBindings,
+                           this),
+               true);
+   }
+}
+
+bool EnvironmentMonitor::describeNextBinding()
+{
+   while (!pending_.empty())
+   {
+      SEXP symbolSEXP = pending_.front();
+      pending_.pop_front();
+
+      // skip bindings which have since been removed
+      Bindings::iterator it = bindings_.find(symbolSEXP);
+      if (it == bindings_.end() || !it->second.pending)
+         continue;
+
+      Binding& binding = it->second;
+      binding.pending = false;
+
+      // describe the current value of the binding (which may have changed
+      // again since it was queued); only the monitored frame is searched,
+      // other than for .Last.value, which is bound in the base environment
+      SEXP envSEXP = getMonitoredEnvironment();
+      if (symbolSEXP == Rf_install(".Last.value"))
+         envSEXP = R_BaseEnv;
+
+      SEXP valueSEXP = R_NilValue;
+      if (!binding.active)
+         valueSEXP = r::sexp::findVarInFrame(symbolSEXP, envSEXP);
+      if (valueSEXP == R_UnboundValue)
+         continue;
+
+      enqueAssignedEvent(std::make_pair(binding.name, valueSEXP));
+      return !pending_.empty();
+   }
+
+   return false;
+}
+
+bool EnvironmentMonitor::describeDeferredBindings()
+{
+   describing_ = describeNextBinding();
+   return describing_;
 }
 
 } // namespace environment
@@ -13,6 +13,10 @@
  *
  */
 
+#include <deque>
+
+#include <boost/unordered_map.hpp>
+
 #include <r/RSexp.hpp>
 #include <r/RInterface.hpp>
 
@@ -32,12 +36,40 @@ public:
    bool hasEnvironment();
    void checkForChanges();
 private:
-   void listEnv(std::vector<r::sexp::Variable>* pEnvironment);
-   void enqueRemovedEvent(const r::sexp::Variable& variable);
+   struct Binding
+   {
+      Binding() : active(false), generation(0), pending(false) {}
+
+      std::string name;
+      r::sexp::ObjectFingerprint fingerprint;
+      bool active;
+
+      // the last check in which the binding was seen
+      int generation;
+
+      // whether the binding has changed since its description was sent
+      bool pending;
+   };
+
+   // bindings by symbol
+   typedef boost::unordered_map<SEXP, Binding> Bindings;
+
+   void updateBinding(const r::sexp::Binding& current,
+                      std::vector<SEXP>* pChanged);
+   void enqueRemovedEvent(const std::string& name);
    void enqueAssignedEvent(const r::sexp::Variable& variable);
+   bool describeNextBinding();
+   bool describeDeferredBindings();
+   void clearBindings();
+   void clearPending();
+
+   Bindings bindings_;
+   int generation_;
+
+   // changed bindings waiting to be described (oldest first)
+   std::deque<SEXP> pending_;
+   bool describing_;
 
-   std::vector<r::sexp::Variable> lastEnv_;
-   std::vector<r::sexp::Variable> unevaledPromises_;
    r::sexp::PreservedSEXP environment_;
    bool initialized_;
    bool refreshOnInit_;
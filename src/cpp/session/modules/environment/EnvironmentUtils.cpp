@@ -19,6 +19,7 @@
 #include <r/RCntxtUtils.hpp>
 #include <r/RExec.hpp>
 #include <r/RJson.hpp>
+#include <r/session/RSessionState.hpp>
 #include <core/FileSerializer.hpp>
 #include <core/FileUtils.hpp>
 #include <session/SessionModuleContext.hpp>
@@ -97,6 +98,29 @@ json::Value varToJson(SEXP env, const r::sexp::Variable& var)
    bool hasActiveBinding = isActiveBinding
          ? true
          : r::sexp::hasActiveBinding(var.first, env);
+
+   // objects restored lazily from a suspended session are described from
+   // what was recorded when they were saved (rather than being read just to
+   // list them)
+   if (isUnevaluatedPromise(varSEXP) && !isActiveBinding)
+   {
+      SEXP infoSEXP = r::session::state::lazyObjectInfo(varSEXP);
+      if (infoSEXP != R_NilValue)
+      {
+         SEXP description;
+         json::Value val;
+         r::sexp::Protect protect;
+         Error error = r::exec::RFunction(".rs.describeLazyObject",
+                                          var.first,
+                                          infoSEXP)
+                                          .call(&description, &protect);
+         if (!error)
+            error = r::json::jsonValueFromObject(description, &val);
+         if (!error)
+            return val;
+         LOG_ERROR(error);
+      }
+   }
    
    if ((varSEXP == R_UnboundValue) ||
        (varSEXP == R_MissingArg) ||
@@ -22,6 +22,7 @@
 #include <core/RecursionGuard.hpp>
 
 #define INTERNAL_R_FUNCTIONS
+#include <r/RInspect.hpp>
 #include <r/RJson.hpp>
 #include <r/RSexp.hpp>
 #include <r/RExec.hpp>
@@ -58,6 +59,9 @@ bool s_browserActive = false;
 
 namespace {
 
+// the most children summarized in a single inspection
+const int kMaxInspectPageSize = 200;
+
 // Keeps track of the data related to the most recent debugging event
 class LineDebugState
 {
@@ -835,6 +839,56 @@ Error getObjectContents(const json::JsonRpcRequest& request,
    return Success();
 }
 
+// Return summaries of a page of the children of the given object (or of one
+// of its descendants, found by following the path of child indices from it).
+// Called by the client as objects are expanded, so that the cost of each
+// expansion is bounded no matter how large the object is.
+Error inspectObject(const json::JsonRpcRequest& request,
+                    json::JsonRpcResponse* pResponse)
+{
+   std::string objectName;
+   json::Array path;
+   int offset, count;
+   Error error = json::readParams(request.params,
+                                  &objectName,
+                                  &path,
+                                  &offset,
+                                  &count);
+   if (error)
+      return error;
+
+   SEXP objectSEXP;
+   error = r::inspect::findObject(
+            objectName,
+            s_pEnvironmentMonitor->getMonitoredEnvironment(),
+            &objectSEXP);
+   if (error)
+      return error;
+
+   std::string name = objectName;
+   BOOST_FOREACH(const json::Value& indexValue, path)
+   {
+      if (!json::isType<int>(indexValue))
+         return Error(json::errc::ParamTypeMismatch, ERROR_LOCATION);
+
+      int index = indexValue.get_int();
+      if (index < 0 || index >= r::inspect::childCount(objectSEXP))
+         return Error(json::errc::ParamInvalid, ERROR_LOCATION);
+
+      objectSEXP = r::inspect::childAt(objectSEXP, index, &name);
+   }
+
+   json::Object result;
+   result["object"] = r::inspect::summarize(name, objectSEXP);
+   result["offset"] = std::max(offset, 0);
+   result["children"] = r::inspect::inspectChildren(
+            objectSEXP,
+            offset,
+            std::min(std::max(count, 0), kMaxInspectPageSize));
+   pResponse->setResult(result);
+   return Success();
+}
+
 // Called by the client to force a re-query of the currently monitored
 // context depth and environment.
 Error requeryContext(boost::shared_ptr<int> pContextDepth,
@@ -983,6 +1037,7 @@ Error initialize()
       (bind(registerRpcMethod, "remove_all_objects", removeAllObjects))
       (bind(registerRpcMethod, "get_environment_state", getEnv))
       (bind(registerRpcMethod, "get_object_contents", getObjectContents))
+      (bind(registerRpcMethod, "inspect_object", inspectObject))
       (bind(registerRpcMethod, "requery_context", requeryCtx))
       (bind(sourceModuleRFile, "SessionEnvironment.R"));
 
@@ -45,10 +45,11 @@ void handleViewPdf(const http::Request& request, http::Response* pResponse)
       return;
    }
 
-   // send it back
+   // send it back from disk (pdf.js requests large documents in ranges
+   // once it sees Accept-Ranges on the full response, so that is served
+   // unencoded too)
    pResponse->setNoCacheHeaders();
-   pResponse->setFile(filePath, request);
-   pResponse->setContentType("application/pdf");
+   pResponse->setRangeableFile(filePath, request);
 }
 
 void handlePdfJs(const http::Request& request, http::Response* pResponse)
@@ -33,13 +33,33 @@ public class Websocket {
         return _isWebsocket();
     }
 
+    private static native boolean _isTextDecoder() /*-{
+        return ("TextDecoder" in window);
+    }-*/;
+
+    /**
+     * Whether binary (UTF-8) messages can be received as text
+     */
+    public static boolean isBinaryTextSupported() {
+        return _isTextDecoder();
+    }
+
     private final Set<WebsocketListener> listeners = new HashSet<WebsocketListener>();
 
     private final String varName;
     private final String url;
+    private final String protocol;
 
     public Websocket(String url) {
+        this(url, null);
+    }
+
+    /**
+     * @param protocol subprotocol to request, or null for none
+     */
+    public Websocket(String url, String protocol) {
         this.url = url;
+        this.protocol = protocol;
         this.varName = "gwtws-" + counter++;
     }
 
@@ -47,12 +67,22 @@ public class Websocket {
         $wnd[s].close();
     }-*/;
 
-    private native void _open(Websocket ws, String s, String url) /*-{
-        $wnd[s] = new WebSocket(url);
+    private native void _open(Websocket ws, String s, String url, String protocol) /*-{
+        $wnd[s] = protocol ? new WebSocket(url, protocol) : new WebSocket(url);
+        $wnd[s].binaryType = "arraybuffer";
         $wnd[s].onopen = function() { ws.@com.sksamuel.gwt.websockets.Websocket::onOpen()(); };
         $wnd[s].onclose = function(evt) { ws.@com.sksamuel.gwt.websockets.Websocket::onClose(SLjava/lang/String;Z)(evt.code, evt.reason, evt.wasClean); };
         $wnd[s].onerror = function() { ws.@com.sksamuel.gwt.websockets.Websocket::onError()(); };
-        $wnd[s].onmessage = function(msg) { ws.@com.sksamuel.gwt.websockets.Websocket::onMessage(Ljava/lang/String;)(msg.data); }
+        $wnd[s].onmessage = function(msg) {
+            var data = msg.data;
+            if (typeof data !== "string") {
+                // binary messages are a stream of UTF-8, which may split characters
+                if (!$wnd[s].decoder)
+                    $wnd[s].decoder = new TextDecoder("utf-8");
+                data = $wnd[s].decoder.decode(new Uint8Array(data), { stream: true });
+            }
+            ws.@com.sksamuel.gwt.websockets.Websocket::onMessage(Ljava/lang/String;)(data);
+        }
     }-*/;
 
     private native void _send(String s, String msg) /*-{
@@ -108,7 +138,7 @@ public class Websocket {
     }
 
     public void open() {
-        _open(this, varName, url);
+        _open(this, varName, url, protocol);
     }
 
     public void send(String msg) {
@@ -165,6 +165,7 @@ import org.rstudio.studio.client.workbench.views.environment.model.DownloadInfo;
 import org.rstudio.studio.client.workbench.views.environment.model.EnvironmentContextData;
 import org.rstudio.studio.client.workbench.views.environment.model.EnvironmentFrame;
 import org.rstudio.studio.client.workbench.views.environment.model.ObjectContents;
+import org.rstudio.studio.client.workbench.views.environment.model.ObjectInspection;
 import org.rstudio.studio.client.workbench.views.environment.model.RObject;
 import org.rstudio.studio.client.workbench.views.files.model.DirectoryListing;
 import org.rstudio.studio.client.workbench.views.files.model.FileUploadToken;
@@ -315,6 +316,7 @@ public class RemoteServer implements Server
          {
             clientId_ = sessionInfo.getClientId();
             clientVersion_ = sessionInfo.getClientVersion();
+            eventSocketPort_ = sessionInfo.getEventSocketPort();
             requestCallback.onResponseReceived(sessionInfo);
          }
    
@@ -2539,6 +2541,18 @@ public class RemoteServer implements Server
       return eventBus_;
    }
 
+   String getClientId()
+   {
+      return clientId_;
+   }
+
+   // port of the websocket client events are pushed over (0 if events
+   // are only available via getEvents)
+   int getEventSocketPort()
+   {
+      return eventSocketPort_;
+   }
+
    RpcRequest getEvents(
                   int lastEventId,
                   ServerRequestCallback<JsArray<ClientEvent>> requestCallback,
@@ -3876,6 +3890,30 @@ public class RemoteServer implements Server
                   params,
                   requestCallback);
    }
+
+   @Override
+   public void inspectObject(
+                 String objectName,
+                 int[] path,
+                 int offset,
+                 int count,
+                 ServerRequestCallback<ObjectInspection> requestCallback)
+   {
+      JSONArray pathArray = new JSONArray();
+      for (int idx = 0; idx < path.length; idx++)
+      {
+         pathArray.set(idx, new JSONNumber(path[idx]));
+      }
+      JSONArray params = new JSONArray();
+      params.set(0, new JSONString(objectName));
+      params.set(1, pathArray);
+      params.set(2, new JSONNumber(offset));
+      params.set(3, new JSONNumber(count));
+      sendRequest(RPC_SCOPE,
+                  INSPECT_OBJECT,
+                  params,
+                  requestCallback);
+   }
    
    @Override
    public void getFunctionSteps(
@@ -5067,6 +5105,7 @@ public class RemoteServer implements Server
 
    private String clientId_;
    private String clientVersion_ = "";
+   private int eventSocketPort_ = 0;
    private boolean listeningForEvents_;
    private boolean disconnected_;
 
@@ -5364,6 +5403,7 @@ public class RemoteServer implements Server
    private static final String GET_ENVIRONMENT_NAMES = "get_environment_names";
    private static final String GET_ENVIRONMENT_STATE = "get_environment_state";
    private static final String GET_OBJECT_CONTENTS = "get_object_contents";
+   private static final String INSPECT_OBJECT = "inspect_object";
    private static final String REQUERY_CONTEXT = "requery_context";
    
    private static final String GET_FUNCTION_STEPS = "get_function_steps";
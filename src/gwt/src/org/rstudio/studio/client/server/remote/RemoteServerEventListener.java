@@ -16,14 +16,22 @@ package org.rstudio.studio.client.server.remote;
 
 import com.google.gwt.core.client.GWT;
 import com.google.gwt.core.client.JsArray;
+import com.google.gwt.json.client.JSONNumber;
+import com.google.gwt.json.client.JSONObject;
+import com.google.gwt.json.client.JSONString;
 import com.google.gwt.user.client.Timer;
 import com.google.gwt.user.client.Window;
 import com.google.gwt.user.client.Window.ClosingEvent;
 import com.google.gwt.user.client.Window.ClosingHandler;
+import com.sksamuel.gwt.websockets.CloseEvent;
+import com.sksamuel.gwt.websockets.Websocket;
+import com.sksamuel.gwt.websockets.WebsocketListenerExt;
+import org.rstudio.core.client.StringUtil;
 import org.rstudio.core.client.jsonrpc.RpcError;
 import org.rstudio.core.client.jsonrpc.RpcRequest;
 import org.rstudio.core.client.jsonrpc.RpcRequestCallback;
 import org.rstudio.core.client.jsonrpc.RpcResponse;
+import org.rstudio.studio.client.application.Desktop;
 import org.rstudio.studio.client.application.events.*;
 import org.rstudio.studio.client.server.ServerError;
 import org.rstudio.studio.client.server.ServerRequestCallback;
@@ -59,6 +67,7 @@ class RemoteServerEventListener
       listenErrorCount_ = 0;
       isListening_ = false;
       sessionWasQuit_ = false;
+      eventSocketFailed_ = false;
       
       // we take the liberty of stopping ourselves if the window is on 
       // the verge of being closed. this allows us to prevent the scenario:
@@ -121,14 +130,17 @@ class RemoteServerEventListener
       // eliminate this scenario then
       lastEventId_ = -1;
       
-      // start listening
-      listen();
+      // start listening (events are pushed to us over a websocket when the
+      // server offers one, otherwise we poll for them)
+      if (!openEventSocket())
+         listen();
    }
      
    public void stop()
    {        
       isListening_ = false;
       listenCount_ = 0;
+      closeEventSocket();
       if (activeRequestCallback_ != null)
       {
          activeRequestCallback_.cancel();
@@ -183,8 +195,10 @@ class RemoteServerEventListener
      } 
      
      // if we are listening then use the Watchdog to still make sure we 
-     // receive the events even if it requires restarting
-     else
+     // receive the events even if it requires restarting (not needed when
+     // the event socket is connected: events are pushed to us as they occur
+     // and if the socket is closed we fall back to polling)
+     else if (!eventSocketOpen_)
      {     
         // NOTE: Watchdog is required to work around pathological cases
         // where the browser has terminated our request for events but
@@ -356,6 +370,150 @@ class RemoteServerEventListener
    }
    
    
+   // connect to the server's event websocket (returns false if the server
+   // doesn't offer one or we can't use it, in which case the caller polls)
+   private boolean openEventSocket()
+   {
+      int port = server_.getEventSocketPort();
+      if (port <= 0 || eventSocketFailed_ || !Websocket.isSupported())
+         return false;
+
+      // for desktop talk directly to the websocket, otherwise go through
+      // the server via the /p proxy (as for terminals)
+      String urlSuffix = port + "/events/";
+      String url;
+      if (Desktop.isDesktop())
+      {
+         url = "ws://127.0.0.1:" + urlSuffix;
+      }
+      else
+      {
+         url = GWT.getHostPageBaseURL();
+         if (url.startsWith("https:"))
+            url = "wss:" + url.substring(6) + "p/" + urlSuffix;
+         else if (url.startsWith("http:"))
+            url = "ws:" + url.substring(5) + "p/" + urlSuffix;
+         else
+            return false;
+      }
+
+      final Websocket socket = new Websocket(url);
+      socket.addListener(new WebsocketListenerExt()
+      {
+         @Override
+         public void onOpen()
+         {
+            if (socket != eventSocket_)
+               return;
+
+            // tell the server which events we've seen; it then pushes all
+            // events still pending (including any we poll for meanwhile)
+            eventSocketOpen_ = true;
+            acknowledgeEvents();
+         }
+
+         @Override
+         public void onMessage(String msg)
+         {
+            if (socket != eventSocket_)
+               return;
+
+            watchdog_.notifyResponseReceived();
+            try
+            {
+               if (isListening_)
+                  dispatchEvents(parseEvents(msg));
+            }
+            catch(Throwable e)
+            {
+               GWT.log("ERROR: Processing client events", e);
+            }
+
+            // acknowledge receipt (so the server can release the events)
+            if (socket == eventSocket_ && eventSocketOpen_)
+               acknowledgeEvents();
+         }
+
+         @Override
+         public void onClose(CloseEvent event)
+         {
+            onEventSocketFailed(socket);
+         }
+
+         @Override
+         public void onError()
+         {
+            onEventSocketFailed(socket);
+         }
+      });
+
+      eventSocket_ = socket;
+      eventSocketOpen_ = false;
+      socket.open();
+      return true;
+   }
+
+   private void closeEventSocket()
+   {
+      if (eventSocket_ != null)
+      {
+         Websocket socket = eventSocket_;
+         eventSocket_ = null;
+         eventSocketOpen_ = false;
+         socket.close();
+      }
+   }
+
+   private void onEventSocketFailed(Websocket socket)
+   {
+      // ignore sockets we've since closed ourselves
+      if (socket != eventSocket_)
+         return;
+
+      eventSocket_ = null;
+      eventSocketOpen_ = false;
+
+      // fall back to polling for events (for the rest of this page load,
+      // so that a server or proxy which doesn't support websockets isn't
+      // retried on every restart)
+      eventSocketFailed_ = true;
+      if (isListening_ && !sessionWasQuit_ && !server_.isDisconnected())
+         listen();
+   }
+
+   private void acknowledgeEvents()
+   {
+      JSONObject ack = new JSONObject();
+      ack.put("clientId", new JSONString(StringUtil.notNull(
+                                                server_.getClientId())));
+      ack.put("lastEventId", new JSONNumber(lastEventId_));
+      eventSocket_.send(ack.toString());
+   }
+
+   private void dispatchEvents(JsArray<ClientEvent> events)
+   {
+      for (int i=0; i<events.length(); i++)
+      {
+         // we can stop listening in the middle of dispatching events (see
+         // doListen)
+         if (!isListening_)
+            return;
+
+         // events are re-sent after a reconnect and may also have been
+         // returned by a poll, so skip any we've already seen
+         ClientEvent event = events.get(i);
+         if (event.getId() <= lastEventId_)
+            continue;
+
+         dispatchEvent(event);
+         lastEventId_ = event.getId();
+      }
+   }
+
+   private static native JsArray<ClientEvent> parseEvents(String json) /*-{
+      return JSON.parse(json);
+   }-*/;
+
    private void dispatchEvent(ClientEvent event)
    {
       // do some special handling before calling the standard dispatcher
@@ -420,6 +578,11 @@ class RemoteServerEventListener
                {
                   if (!responseReceived_)
                   {
+                     // an event socket which never connected won't be
+                     // tried again (we poll instead)
+                     if (eventSocket_ != null && !eventSocketOpen_)
+                        eventSocketFailed_ = true;
+
                      // ensure that the workbench wasn't closed while we
                      // were waiting for the timer to run
                      if (!sessionWasQuit_) 
@@ -486,6 +649,10 @@ class RemoteServerEventListener
    private int listenCount_ ;
    private int listenErrorCount_ ;
    private boolean sessionWasQuit_ ;
+
+   private Websocket eventSocket_ ;
+   private boolean eventSocketOpen_ ;
+   private boolean eventSocketFailed_ ;
    
    private RpcRequest activeRequest_ ;
    private ServerRequestCallback<JsArray<ClientEvent>> activeRequestCallback_;
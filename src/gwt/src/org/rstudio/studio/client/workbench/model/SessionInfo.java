@@ -110,6 +110,10 @@ public class SessionInfo extends JavaScriptObject
       return this.mode;
    }-*/;
 
+   public final native int getEventSocketPort() /*-{
+      return this.event_socket_port || 0;
+   }-*/;
+
    public final native boolean getResumed() /*-{
       return this.resumed;
    }-*/;
@@ -66,6 +66,14 @@ public interface EnvironmentServerOperations
    void getObjectContents(
               String objectName,
               ServerRequestCallback<ObjectContents> requestCallback);
+
+   // path is the indices of the children to descend through from the object
+   void inspectObject(
+              String objectName,
+              int[] path,
+              int offset,
+              int count,
+              ServerRequestCallback<ObjectInspection> requestCallback);
    
    void requeryContext(ServerRequestCallback<Void> requestCallback);
 }
\ No newline at end of file
@@ -0,0 +1,70 @@
+/*
+ * ObjectInspection.java
+ *
+ * Copyright (C) 2009-17 by RStudio, Inc.
+ *
+ * Unless you have received this program directly from RStudio pursuant
+ * to the terms of a commercial license agreement with RStudio, then
+ * this program is licensed to you under the terms of version 3 of the
+ * GNU Affero General Public License. This program is distributed WITHOUT
+ * ANY EXPRESS OR IMPLIED WARRANTY, INCLUDING THOSE OF NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FITNESS FOR A PARTICULAR PURPOSE. Please refer to the
+ * AGPL (http://www.gnu.org/licenses/agpl-3.0.txt) for more details.
+ *
+ */
+package org.rstudio.studio.client.workbench.views.environment.model;
+
+import com.google.gwt.core.client.JavaScriptObject;
+import com.google.gwt.core.client.JsArray;
+import com.google.gwt.core.client.JsArrayInteger;
+
+// A page of the children of an object, as returned by inspectObject
+public class ObjectInspection extends JavaScriptObject
+{
+   protected ObjectInspection() {}
+
+   public static class Summary extends JavaScriptObject
+   {
+      protected Summary() {}
+
+      public native final String getName() /*-{
+         return this.name;
+      }-*/;
+
+      public native final String getType() /*-{
+         return this.type;
+      }-*/;
+
+      public native final String getClassName() /*-{
+         return this["class"];
+      }-*/;
+
+      public native final double getLength() /*-{
+         return this.length || 0;
+      }-*/;
+
+      public native final JsArrayInteger getDim() /*-{
+         return this.dim || null;
+      }-*/;
+
+      public native final String getValue() /*-{
+         return this.value;
+      }-*/;
+
+      public native final int getChildCount() /*-{
+         return this.child_count;
+      }-*/;
+   }
+
+   public native final Summary getObject() /*-{
+      return this.object;
+   }-*/;
+
+   public native final int getOffset() /*-{
+      return this.offset;
+   }-*/;
+
+   public native final JsArray<Summary> getChildren() /*-{
+      return this.children;
+   }-*/;
+}
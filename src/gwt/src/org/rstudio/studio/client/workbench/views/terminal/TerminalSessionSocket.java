@@ -225,7 +225,10 @@ public class TerminalSessionSocket
          }
 
          diagnostic("Try to connect to " + url);
-         socket_ = new Websocket(url);
+         // receive output as binary messages when we can decode them; the
+         // server then needn't split output at character boundaries
+         socket_ = new Websocket(url, Websocket.isBinaryTextSupported() ?
+               BINARY_OUTPUT_PROTOCOL : null);
          socket_.addListener(new WebsocketListenerExt() 
          {
             @Override
@@ -373,6 +376,9 @@ public class TerminalSessionSocket
    private boolean reportTypingLag_;
    private InputEchoTimeMonitor inputEchoTiming_;
    private Websocket socket_;
+
+   // must match kBinaryOutputProtocol in SessionConsoleProcessSocket.hpp
+   private static final String BINARY_OUTPUT_PROTOCOL = "rstudio-terminal-binary";
    
    // Injected ---- 
    private UIPrefs uiPrefs_;